@@ -0,0 +1,482 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Microbenchmarks for the CHiP C API, run against the in-process loopback transport.
+   Results are written as JSON so that they can be compared between releases.
+
+   Usage: bench [--iterations count] [--e2e-iterations count] [--delay microseconds] [--output filename]
+*/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "chip.h"
+#include "chip-response-queue.h"
+#include "loopback.h"
+
+
+// Default command line option values.
+#define BENCH_DEFAULT_ITERATIONS        1000000
+#define BENCH_DEFAULT_E2E_ITERATIONS    2000
+#define BENCH_DEFAULT_DELAY             100
+
+// Benchmarks are passed the context and number of operations to run.  Each operation is timed individually if
+// pLatencies isn't NULL.  The decode benchmarks work on the response placed in the context by captureResponse().
+typedef struct BenchContext
+{
+    CHiP*              pCHiP;
+    CHiPResponseQueue* pQueue;
+    uint64_t*          pLatencies;
+    uint8_t            response[CHIP_RESPONSE_MAX_LEN];
+    size_t             responseLength;
+} BenchContext;
+
+typedef int (*BenchFunction)(BenchContext* pContext, size_t iterations);
+
+typedef struct BenchOptions
+{
+    size_t      iterations;
+    size_t      e2eIterations;
+    uint32_t    delay;
+    const char* pOutputFilename;
+} BenchOptions;
+
+
+// Forward Declarations.
+static int      parseOptions(BenchOptions* pOptions, int argc, char** argv);
+static CHiP*    connectLoopback(uint32_t delay);
+static int      captureResponse(BenchContext* pContext, CHiP* pCHiP, uint8_t command);
+static uint64_t getNanoseconds(void);
+static int      runBenchmark(FILE* pFile, const char* pName, BenchFunction function, BenchContext* pContext,
+                             size_t iterations, int first);
+static int      compareUint64(const void* pv1, const void* pv2);
+static int      benchDrive(BenchContext* pContext, size_t iterations);
+static int      benchEncodeDriveFrames(BenchContext* pContext, size_t iterations);
+static int      benchSetCurrentDateTime(BenchContext* pContext, size_t iterations);
+static int      benchSetAlarmDateTime(BenchContext* pContext, size_t iterations);
+static int      benchPlaySound(BenchContext* pContext, size_t iterations);
+static int      benchSetVolume(BenchContext* pContext, size_t iterations);
+static int      benchGetBatteryLevel(BenchContext* pContext, size_t iterations);
+static int      benchGetCurrentDateTime(BenchContext* pContext, size_t iterations);
+static int      benchGetDogVersion(BenchContext* pContext, size_t iterations);
+static int      benchGetVolume(BenchContext* pContext, size_t iterations);
+static int      benchRawReceiveView(BenchContext* pContext, size_t iterations);
+static int      benchDecodeResponse(BenchContext* pContext, size_t iterations);
+static int      benchQueuePushPop(BenchContext* pContext, size_t iterations);
+static int      benchQueuePushOverflow(BenchContext* pContext, size_t iterations);
+static int      benchRawSend(BenchContext* pContext, size_t iterations);
+static int      benchRawReceive(BenchContext* pContext, size_t iterations);
+
+
+
+int main(int argc, char** argv)
+{
+    BenchOptions options = { BENCH_DEFAULT_ITERATIONS, BENCH_DEFAULT_E2E_ITERATIONS, BENCH_DEFAULT_DELAY, NULL };
+    BenchContext fast = { NULL, NULL, NULL };
+    BenchContext delayed = { NULL, NULL, NULL };
+    BenchContext timed = { NULL, NULL, NULL };
+    BenchContext decode = { NULL, NULL, NULL };
+    FILE*        pFile = stdout;
+    int          result = -1;
+
+    if (parseOptions(&options, argc, argv))
+        return 1;
+
+    fast.pCHiP = connectLoopback(0);
+    delayed.pCHiP = connectLoopback(options.delay);
+    fast.pQueue = chipResponseQueueAlloc(10);
+    timed.pCHiP = delayed.pCHiP;
+    timed.pLatencies = malloc(options.e2eIterations * sizeof(*timed.pLatencies));
+    if (!fast.pCHiP || !delayed.pCHiP || !fast.pQueue || !timed.pLatencies)
+    {
+        fprintf(stderr, "error: failed to initialize benchmarks\n");
+        goto Error;
+    }
+    if (options.pOutputFilename)
+    {
+        pFile = fopen(options.pOutputFilename, "w");
+        if (!pFile)
+        {
+            fprintf(stderr, "error: failed to create %s\n", options.pOutputFilename);
+            goto Error;
+        }
+    }
+
+    fprintf(pFile, "{\n");
+    fprintf(pFile, "  \"config\": { \"iterations\": %zu, \"e2e_iterations\": %zu, \"delay_us\": %u },\n",
+            options.iterations, options.e2eIterations, options.delay);
+    fprintf(pFile, "  \"benchmarks\": [\n");
+    result = runBenchmark(pFile, "encode/chipDrive", benchDrive, &fast, options.iterations, 1);
+    result |= runBenchmark(pFile, "encode/chipEncodeDriveFrames", benchEncodeDriveFrames, &fast, options.iterations, 0);
+    result |= runBenchmark(pFile, "encode/chipSetCurrentDateTime", benchSetCurrentDateTime, &fast, options.iterations, 0);
+    result |= runBenchmark(pFile, "encode/chipSetAlarmDateTime", benchSetAlarmDateTime, &fast, options.iterations, 0);
+    result |= runBenchmark(pFile, "encode/chipPlaySound", benchPlaySound, &fast, options.iterations, 0);
+    result |= runBenchmark(pFile, "encode/chipSetVolume", benchSetVolume, &fast, options.iterations, 0);
+    result |= captureResponse(&decode, fast.pCHiP, CHIP_CMD_GET_BATTERY_LEVEL);
+    result |= runBenchmark(pFile, "decode/batteryLevel", benchDecodeResponse, &decode, options.iterations, 0);
+    result |= captureResponse(&decode, fast.pCHiP, CHIP_CMD_GET_CURRENT_DATE_TIME);
+    result |= runBenchmark(pFile, "decode/currentDateTime", benchDecodeResponse, &decode, options.iterations, 0);
+    result |= captureResponse(&decode, fast.pCHiP, CHIP_CMD_GET_DOG_VERSION);
+    result |= runBenchmark(pFile, "decode/dogVersion", benchDecodeResponse, &decode, options.iterations, 0);
+    result |= captureResponse(&decode, fast.pCHiP, CHIP_CMD_GET_VOLUME);
+    result |= runBenchmark(pFile, "decode/volume", benchDecodeResponse, &decode, options.iterations, 0);
+    result |= runBenchmark(pFile, "roundtrip/chipGetBatteryLevel", benchGetBatteryLevel, &fast, options.iterations, 0);
+    result |= runBenchmark(pFile, "roundtrip/chipGetCurrentDateTime", benchGetCurrentDateTime, &fast,
+                           options.iterations, 0);
+    result |= runBenchmark(pFile, "roundtrip/chipGetDogVersion", benchGetDogVersion, &fast, options.iterations, 0);
+    result |= runBenchmark(pFile, "roundtrip/chipGetVolume", benchGetVolume, &fast, options.iterations, 0);
+    result |= runBenchmark(pFile, "roundtrip/chipRawReceiveView", benchRawReceiveView, &fast, options.iterations, 0);
+    result |= runBenchmark(pFile, "queue/push_pop", benchQueuePushPop, &fast, options.iterations, 0);
+    result |= runBenchmark(pFile, "queue/push_overflow", benchQueuePushOverflow, &fast, options.iterations, 0);
+    result |= runBenchmark(pFile, "e2e/chipRawSend", benchRawSend, &delayed, options.iterations, 0);
+    result |= runBenchmark(pFile, "e2e/chipRawReceive", benchRawReceive, &timed, options.e2eIterations, 0);
+    fprintf(pFile, "\n  ]\n}\n");
+    if (result)
+        fprintf(stderr, "error: one or more benchmarks failed\n");
+
+Error:
+    if (pFile && pFile != stdout)
+        fclose(pFile);
+    free(timed.pLatencies);
+    chipResponseQueueFree(fast.pQueue);
+    chipUninit(delayed.pCHiP);
+    chipUninit(fast.pCHiP);
+    return result ? 1 : 0;
+}
+
+static int parseOptions(BenchOptions* pOptions, int argc, char** argv)
+{
+    int i;
+
+    for (i = 1 ; i < argc ; i++)
+    {
+        if (i + 1 < argc && 0 == strcmp(argv[i], "--iterations"))
+            pOptions->iterations = strtoul(argv[++i], NULL, 0);
+        else if (i + 1 < argc && 0 == strcmp(argv[i], "--e2e-iterations"))
+            pOptions->e2eIterations = strtoul(argv[++i], NULL, 0);
+        else if (i + 1 < argc && 0 == strcmp(argv[i], "--delay"))
+            pOptions->delay = strtoul(argv[++i], NULL, 0);
+        else if (i + 1 < argc && 0 == strcmp(argv[i], "--output"))
+            pOptions->pOutputFilename = argv[++i];
+        else
+            goto Usage;
+    }
+    if (pOptions->iterations == 0 || pOptions->e2eIterations == 0)
+        goto Usage;
+    return 0;
+
+Usage:
+    fprintf(stderr, "Usage: %s [--iterations count] [--e2e-iterations count] [--delay microseconds] "
+                    "[--output filename]\n", argv[0]);
+    return -1;
+}
+
+static CHiP* connectLoopback(uint32_t delay)
+{
+    char  options[32];
+    CHiP* pCHiP = NULL;
+
+    snprintf(options, sizeof(options), "delay=%u", delay);
+    pCHiP = chipInit(options);
+    if (!pCHiP)
+        return NULL;
+    // The dog version is cached forever by default which would turn its benchmark into a cache read.
+    if (chipSetCacheMaxAge(pCHiP, CHIP_CACHE_DOG_VERSION, 0) || chipConnectToRobot(pCHiP, LOOPBACK_ROBOT_NAME))
+    {
+        chipUninit(pCHiP);
+        return NULL;
+    }
+    return pCHiP;
+}
+
+// Fetch the response to command from the loopback robot so that the decode benchmarks start from real response bytes.
+static int captureResponse(BenchContext* pContext, CHiP* pCHiP, uint8_t command)
+{
+    return chipRawReceive(pCHiP, &command, sizeof(command), pContext->response, sizeof(pContext->response),
+                          &pContext->responseLength);
+}
+
+static uint64_t getNanoseconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static int runBenchmark(FILE* pFile, const char* pName, BenchFunction function, BenchContext* pContext,
+                        size_t iterations, int first)
+{
+    uint64_t startTime;
+    uint64_t elapsed;
+    double   nsPerOp;
+    int      result;
+
+    // Warm up caches and branch predictors before taking the measurement.
+    result = function(pContext, iterations < 1000 ? iterations : 1000);
+    if (result)
+        return result;
+
+    startTime = getNanoseconds();
+    result = function(pContext, iterations);
+    elapsed = getNanoseconds() - startTime;
+    if (result)
+        return result;
+
+    nsPerOp = (double)elapsed / (double)iterations;
+    fprintf(pFile, "%s    { \"name\": \"%s\", \"iterations\": %zu, \"total_ns\": %llu, \"ns_per_op\": %.2f, "
+                   "\"ops_per_sec\": %.0f",
+            first ? "" : ",\n", pName, iterations, (unsigned long long)elapsed, nsPerOp,
+            elapsed ? 1.0e9 / nsPerOp : 0.0);
+    if (pContext->pLatencies)
+    {
+        uint64_t* pLatencies = pContext->pLatencies;
+
+        qsort(pLatencies, iterations, sizeof(*pLatencies), compareUint64);
+        fprintf(pFile, ", \"latency_ns\": { \"min\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu }",
+                (unsigned long long)pLatencies[0],
+                (unsigned long long)pLatencies[iterations * 50 / 100],
+                (unsigned long long)pLatencies[iterations * 90 / 100],
+                (unsigned long long)pLatencies[iterations * 99 / 100],
+                (unsigned long long)pLatencies[iterations - 1]);
+    }
+    fprintf(pFile, " }");
+
+    return 0;
+}
+
+static int compareUint64(const void* pv1, const void* pv2)
+{
+    uint64_t value1 = *(const uint64_t*)pv1;
+    uint64_t value2 = *(const uint64_t*)pv2;
+
+    return (value1 > value2) - (value1 < value2);
+}
+
+static int benchDrive(BenchContext* pContext, size_t iterations)
+{
+    int    result = 0;
+    size_t i;
+
+    for (i = 0 ; i < iterations ; i++)
+    {
+        // Sweep through the full -32 to 32 range of each parameter so that every sign of each axis is exercised.
+        result |= chipDrive(pContext->pCHiP, (int8_t)(i % 65) - 32, 32 - (int8_t)(i % 65), (int8_t)((i >> 3) % 65) - 32);
+    }
+    return result;
+}
+
+static int benchEncodeDriveFrames(BenchContext* pContext, size_t iterations)
+{
+    // Iterations count frames, encoded in batches the way a precomputed trajectory would be.
+    enum { BATCH_SIZE = 1024 };
+    static int8_t  forwardReverse[BATCH_SIZE];
+    static int8_t  leftRight[BATCH_SIZE];
+    static int8_t  spin[BATCH_SIZE];
+    static uint8_t frames[BATCH_SIZE * 4];
+    int            result = 0;
+    size_t         i;
+
+    for (i = 0 ; i < BATCH_SIZE ; i++)
+    {
+        forwardReverse[i] = (int8_t)(i % 65) - 32;
+        leftRight[i] = 32 - (int8_t)(i % 65);
+        spin[i] = (int8_t)((i >> 3) % 65) - 32;
+    }
+    for (i = 0 ; i < iterations ; i += BATCH_SIZE)
+    {
+        size_t frameCount = iterations - i < BATCH_SIZE ? iterations - i : BATCH_SIZE;
+        result |= chipEncodeDriveFrames(forwardReverse, leftRight, spin, frameCount, frames);
+    }
+    return result;
+}
+
+static int benchSetCurrentDateTime(BenchContext* pContext, size_t iterations)
+{
+    CHiPCurrentDateTime dateTime = { 2018, 1, 1, 0, 0, 0, 1 };
+    int                 result = 0;
+    size_t              i;
+
+    for (i = 0 ; i < iterations ; i++)
+    {
+        dateTime.second = i % 60;
+        result |= chipSetCurrentDateTime(pContext->pCHiP, &dateTime);
+    }
+    return result;
+}
+
+static int benchSetAlarmDateTime(BenchContext* pContext, size_t iterations)
+{
+    CHiPAlarmDateTime dateTime = { 2018, 1, 1, 7, 0 };
+    int               result = 0;
+    size_t            i;
+
+    for (i = 0 ; i < iterations ; i++)
+    {
+        dateTime.minute = i % 60;
+        result |= chipSetAlarmDateTime(pContext->pCHiP, &dateTime);
+    }
+    return result;
+}
+
+static int benchPlaySound(BenchContext* pContext, size_t iterations)
+{
+    int    result = 0;
+    size_t i;
+
+    for (i = 0 ; i < iterations ; i++)
+        result |= chipPlaySound(pContext->pCHiP, CHIP_SOUND_BARK_X1_ANGRY_A34 + (i & 7));
+    return result;
+}
+
+static int benchSetVolume(BenchContext* pContext, size_t iterations)
+{
+    int    result = 0;
+    size_t i;
+
+    for (i = 0 ; i < iterations ; i++)
+        result |= chipSetVolume(pContext->pCHiP, 1 + i % 11);
+    return result;
+}
+
+static int benchGetBatteryLevel(BenchContext* pContext, size_t iterations)
+{
+    CHiPBatteryLevel batteryLevel;
+    int              result = 0;
+    size_t           i;
+
+    for (i = 0 ; i < iterations ; i++)
+        result |= chipGetBatteryLevel(pContext->pCHiP, &batteryLevel);
+    return result;
+}
+
+static int benchGetCurrentDateTime(BenchContext* pContext, size_t iterations)
+{
+    CHiPCurrentDateTime dateTime;
+    int                 result = 0;
+    size_t              i;
+
+    for (i = 0 ; i < iterations ; i++)
+        result |= chipGetCurrentDateTime(pContext->pCHiP, &dateTime);
+    return result;
+}
+
+static int benchGetDogVersion(BenchContext* pContext, size_t iterations)
+{
+    CHiPDogVersion version;
+    int            result = 0;
+    size_t         i;
+
+    for (i = 0 ; i < iterations ; i++)
+        result |= chipGetDogVersion(pContext->pCHiP, &version);
+    return result;
+}
+
+static int benchGetVolume(BenchContext* pContext, size_t iterations)
+{
+    uint8_t volume;
+    int     result = 0;
+    size_t  i;
+
+    for (i = 0 ; i < iterations ; i++)
+        result |= chipGetVolume(pContext->pCHiP, &volume);
+    return result;
+}
+
+static int benchRawReceiveView(BenchContext* pContext, size_t iterations)
+{
+    static const uint8_t request[1] = { CHIP_CMD_GET_DOG_VERSION };
+    CHiPResponseView     view;
+    CHiPResponse         decoded;
+    int                  result = 0;
+    size_t               i;
+
+    for (i = 0 ; i < iterations ; i++)
+    {
+        result |= chipRawReceiveView(pContext->pCHiP, request, sizeof(request), &view);
+        if (result)
+            break;
+        result |= chipDecodeResponse(view.pData, view.length, &decoded);
+        chipReleaseResponseView(pContext->pCHiP, &view);
+    }
+    return result;
+}
+
+static int benchDecodeResponse(BenchContext* pContext, size_t iterations)
+{
+    CHiPResponse decoded;
+    int          result = 0;
+    size_t       i;
+
+    for (i = 0 ; i < iterations ; i++)
+        result |= chipDecodeResponse(pContext->response, pContext->responseLength, &decoded);
+    return result;
+}
+
+static int benchQueuePushPop(BenchContext* pContext, size_t iterations)
+{
+    static const uint8_t notification[2] = { 0x1A, 0x01 };
+    uint8_t              buffer[CHIP_RESPONSE_MAX_LEN];
+    size_t               length;
+    int                  result = 0;
+    size_t               i;
+
+    for (i = 0 ; i < iterations ; i++)
+    {
+        chipResponseQueuePush(pContext->pQueue, notification, sizeof(notification));
+        result |= chipResponseQueuePop(pContext->pQueue, buffer, sizeof(buffer), &length);
+    }
+    return result;
+}
+
+static int benchQueuePushOverflow(BenchContext* pContext, size_t iterations)
+{
+    static const uint8_t notification[2] = { 0x1A, 0x01 };
+    size_t               i;
+
+    // The queue is left full by this benchmark so every push after the first few drops the oldest entry.
+    for (i = 0 ; i < iterations ; i++)
+        chipResponseQueuePush(pContext->pQueue, notification, sizeof(notification));
+    return 0;
+}
+
+static int benchRawSend(BenchContext* pContext, size_t iterations)
+{
+    uint8_t request[1+3] = { 0x78, 0x00, 0x00, 0x00 };
+    int     result = 0;
+    size_t  i;
+
+    for (i = 0 ; i < iterations ; i++)
+    {
+        request[1] = (uint8_t)i;
+        result |= chipRawSend(pContext->pCHiP, request, sizeof(request));
+    }
+    return result;
+}
+
+static int benchRawReceive(BenchContext* pContext, size_t iterations)
+{
+    static const uint8_t request[1] = { 0x1C };
+    uint8_t              response[CHIP_RESPONSE_MAX_LEN];
+    size_t               responseLength;
+    int                  result = 0;
+    size_t               i;
+
+    for (i = 0 ; i < iterations ; i++)
+    {
+        uint64_t startTime = getNanoseconds();
+        result |= chipRawReceive(pContext->pCHiP, request, sizeof(request), response, sizeof(response), &responseLength);
+        pContext->pLatencies[i] = getNanoseconds() - startTime;
+    }
+    return result;
+}
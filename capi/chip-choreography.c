@@ -0,0 +1,502 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Compiler and memory mapped player for choreography files. */
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "chip-choreography.h"
+#include "chip-clock.h"
+#include "chip-protocol.h"
+
+
+// Longest line accepted in a text choreography.
+#define MAX_LINE_LENGTH                 256
+
+// Compiled frames can't be scheduled beyond this point since offsets are stored in 32 bits.
+#define MAX_OFFSET_SECONDS              (UINT32_MAX / 1000000.0)
+
+
+_Static_assert(sizeof(CHiPChoreographyHeader) == 32, "Choreography header layout changed");
+_Static_assert(sizeof(CHiPChoreographyFrame) == 16, "Choreography frame layout changed");
+_Static_assert(CHIP_REQUEST_MAX_LEN <= sizeof(((CHiPChoreographyFrame*)0)->request), "Frame too small for requests");
+
+
+struct CHiPChoreography
+{
+    const uint8_t*                pMapping;
+    size_t                        mappingSize;
+    const CHiPChoreographyHeader* pHeader;
+    const CHiPChoreographyFrame*  pFrames;
+    const uint32_t*               pIndex;
+};
+
+// Frame along with the source line it came from, used to keep cues given the same time in source order when sorting.
+typedef struct CompilerFrame
+{
+    CHiPChoreographyFrame frame;
+    size_t                line;
+} CompilerFrame;
+
+typedef struct Compiler
+{
+    CompilerFrame* pFrames;
+    size_t         frameCount;
+    size_t         frameAlloc;
+    size_t         line;
+} Compiler;
+
+
+// Forward Declarations.
+static int  parseLine(Compiler* pCompiler, char* pLine);
+static int  parseInteger(const char* pToken, long min, long max, long* pValue);
+static int  parseSeconds(const char* pToken, uint32_t* pMicroseconds);
+static int  parseDrive(Compiler* pCompiler, uint32_t offset, char** ppSavePtr);
+static int  parseRaw(Compiler* pCompiler, uint32_t offset, char** ppSavePtr);
+static int  addFrame(Compiler* pCompiler, uint32_t offset, const uint8_t* pRequest, size_t requestLength);
+static int  compareFrames(const void* pv1, const void* pv2);
+static int  writeChoreography(Compiler* pCompiler, const char* pOutputFilename);
+
+
+
+int chipChoreographyCompile(const char* pSourceFilename, const char* pOutputFilename, size_t* pErrorLine)
+{
+    Compiler compiler;
+    FILE*    pSource = NULL;
+    char     line[MAX_LINE_LENGTH];
+    int      result = CHIP_ERROR_NONE;
+
+    assert( pSourceFilename );
+    assert( pOutputFilename );
+
+    memset(&compiler, 0, sizeof(compiler));
+    if (pErrorLine)
+        *pErrorLine = 0;
+
+    pSource = fopen(pSourceFilename, "r");
+    if (!pSource)
+    {
+        result = CHIP_ERROR_MEMORY;
+        goto Error;
+    }
+    while (fgets(line, sizeof(line), pSource))
+    {
+        compiler.line++;
+        if (!strchr(line, '\n') && !feof(pSource))
+            result = CHIP_ERROR_PARAM;
+        else
+            result = parseLine(&compiler, line);
+        if (result)
+        {
+            if (pErrorLine && result == CHIP_ERROR_PARAM)
+                *pErrorLine = compiler.line;
+            goto Error;
+        }
+    }
+
+    qsort(compiler.pFrames, compiler.frameCount, sizeof(*compiler.pFrames), compareFrames);
+    result = writeChoreography(&compiler, pOutputFilename);
+Error:
+    if (pSource)
+        fclose(pSource);
+    free(compiler.pFrames);
+    return result;
+}
+
+static int parseLine(Compiler* pCompiler, char* pLine)
+{
+    char*    pComment = strchr(pLine, '#');
+    char*    pSavePtr = NULL;
+    char*    pTime;
+    char*    pCue;
+    char*    pArg;
+    uint32_t offset;
+    long     value;
+
+    if (pComment)
+        *pComment = '\0';
+    pTime = strtok_r(pLine, " \t\r\n", &pSavePtr);
+    if (!pTime)
+        return CHIP_ERROR_NONE;
+    pCue = strtok_r(NULL, " \t\r\n", &pSavePtr);
+    if (!pCue || parseSeconds(pTime, &offset))
+        return CHIP_ERROR_PARAM;
+
+    if (strcasecmp(pCue, "drive") == 0)
+        return parseDrive(pCompiler, offset, &pSavePtr);
+    if (strcasecmp(pCue, "raw") == 0)
+        return parseRaw(pCompiler, offset, &pSavePtr);
+    if (strcasecmp(pCue, "stop-sound") == 0)
+    {
+        uint8_t request[CHIP_CMD_PLAY_SOUND_REQUEST_LEN] = { CHIP_CMD_PLAY_SOUND, CHIP_SOUND_SHORT_MUTE_FOR_STOP, 0 };
+        if (strtok_r(NULL, " \t\r\n", &pSavePtr))
+            return CHIP_ERROR_PARAM;
+        return addFrame(pCompiler, offset, request, sizeof(request));
+    }
+
+    // The remaining cues all take a single integer argument.
+    pArg = strtok_r(NULL, " \t\r\n", &pSavePtr);
+    if (!pArg || strtok_r(NULL, " \t\r\n", &pSavePtr))
+        return CHIP_ERROR_PARAM;
+    if (strcasecmp(pCue, "action") == 0)
+    {
+        uint8_t request[CHIP_CMD_ACTION_REQUEST_LEN] = { CHIP_CMD_ACTION };
+        if (parseInteger(pArg, CHIP_ACTION_RESET, CHIP_ACTION_FACE_DOWN_FOR_CONTROLLING_CHIPPIES, &value))
+            return CHIP_ERROR_PARAM;
+        request[1] = value;
+        return addFrame(pCompiler, offset, request, sizeof(request));
+    }
+    if (strcasecmp(pCue, "sound") == 0)
+    {
+        uint8_t request[CHIP_CMD_PLAY_SOUND_REQUEST_LEN] = { CHIP_CMD_PLAY_SOUND };
+        if (parseInteger(pArg, CHIP_SOUND_BARK_X1_ANGRY_A34, CHIP_SOUND_SHORT_MUTE_FOR_STOP, &value))
+            return CHIP_ERROR_PARAM;
+        request[1] = value;
+        return addFrame(pCompiler, offset, request, sizeof(request));
+    }
+    if (strcasecmp(pCue, "volume") == 0)
+    {
+        uint8_t request[CHIP_CMD_SET_VOLUME_REQUEST_LEN] = { CHIP_CMD_SET_VOLUME };
+        if (parseInteger(pArg, 1, 11, &value))
+            return CHIP_ERROR_PARAM;
+        request[1] = value;
+        return addFrame(pCompiler, offset, request, sizeof(request));
+    }
+    if (strcasecmp(pCue, "eyes") == 0)
+    {
+        uint8_t request[CHIP_CMD_SET_EYE_BRIGHTNESS_REQUEST_LEN] = { CHIP_CMD_SET_EYE_BRIGHTNESS };
+        if (parseInteger(pArg, 0, 255, &value))
+            return CHIP_ERROR_PARAM;
+        request[1] = value;
+        return addFrame(pCompiler, offset, request, sizeof(request));
+    }
+
+    return CHIP_ERROR_PARAM;
+}
+
+static int parseInteger(const char* pToken, long min, long max, long* pValue)
+{
+    char* pEnd = NULL;
+    long  value = strtol(pToken, &pEnd, 0);
+
+    if (pEnd == pToken || *pEnd != '\0' || value < min || value > max)
+        return CHIP_ERROR_PARAM;
+    *pValue = value;
+    return CHIP_ERROR_NONE;
+}
+
+static int parseSeconds(const char* pToken, uint32_t* pMicroseconds)
+{
+    char*  pEnd = NULL;
+    double seconds = strtod(pToken, &pEnd);
+
+    if (pEnd == pToken || *pEnd != '\0' || !(seconds >= 0.0 && seconds <= MAX_OFFSET_SECONDS))
+        return CHIP_ERROR_PARAM;
+    *pMicroseconds = (uint32_t)(seconds * 1000000.0 + 0.5);
+    return CHIP_ERROR_NONE;
+}
+
+static int parseDrive(Compiler* pCompiler, uint32_t offset, char** ppSavePtr)
+{
+    int8_t   axes[3];
+    uint8_t  frame[CHIP_CMD_DRIVE_REQUEST_LEN];
+    uint32_t duration = 0;
+    uint64_t time;
+    char*    pToken;
+    long     value;
+    int      result;
+    size_t   i;
+
+    // forwardReverse, leftRight and spin.
+    for (i = 0 ; i < sizeof(axes) ; i++)
+    {
+        pToken = strtok_r(NULL, " \t\r\n", ppSavePtr);
+        if (!pToken || parseInteger(pToken, -32, 32, &value))
+            return CHIP_ERROR_PARAM;
+        axes[i] = value;
+    }
+    pToken = strtok_r(NULL, " \t\r\n", ppSavePtr);
+    if (pToken && (parseSeconds(pToken, &duration) || strtok_r(NULL, " \t\r\n", ppSavePtr)))
+        return CHIP_ERROR_PARAM;
+
+    result = chipEncodeDriveFrames(&axes[0], &axes[1], &axes[2], 1, frame);
+    if (result)
+        return result;
+
+    // A drive cue without a duration sends a single frame.
+    time = offset;
+    do
+    {
+        if (time > UINT32_MAX)
+            return CHIP_ERROR_PARAM;
+        result = addFrame(pCompiler, (uint32_t)time, frame, sizeof(frame));
+        if (result)
+            return result;
+        time += CHIP_CHOREOGRAPHY_DRIVE_INTERVAL_US;
+    } while (time < (uint64_t)offset + duration);
+
+    return CHIP_ERROR_NONE;
+}
+
+static int parseRaw(Compiler* pCompiler, uint32_t offset, char** ppSavePtr)
+{
+    uint8_t request[CHIP_REQUEST_MAX_LEN];
+    size_t  requestLength = 0;
+    char*   pToken;
+    long    value;
+
+    while ((pToken = strtok_r(NULL, " \t\r\n", ppSavePtr)) != NULL)
+    {
+        char* pEnd = NULL;
+
+        if (requestLength >= sizeof(request))
+            return CHIP_ERROR_PARAM;
+        value = strtol(pToken, &pEnd, 16);
+        if (pEnd == pToken || *pEnd != '\0' || value < 0 || value > 255)
+            return CHIP_ERROR_PARAM;
+        request[requestLength++] = value;
+    }
+    if (requestLength == 0)
+        return CHIP_ERROR_PARAM;
+
+    return addFrame(pCompiler, offset, request, requestLength);
+}
+
+static int addFrame(Compiler* pCompiler, uint32_t offset, const uint8_t* pRequest, size_t requestLength)
+{
+    CompilerFrame* pFrame;
+
+    if (pCompiler->frameCount >= UINT32_MAX)
+        return CHIP_ERROR_PARAM;
+    if (pCompiler->frameCount == pCompiler->frameAlloc)
+    {
+        size_t         newAlloc = pCompiler->frameAlloc ? pCompiler->frameAlloc * 2 : 256;
+        CompilerFrame* pRealloc = realloc(pCompiler->pFrames, newAlloc * sizeof(*pRealloc));
+
+        if (!pRealloc)
+            return CHIP_ERROR_MEMORY;
+        pCompiler->pFrames = pRealloc;
+        pCompiler->frameAlloc = newAlloc;
+    }
+
+    pFrame = &pCompiler->pFrames[pCompiler->frameCount++];
+    memset(pFrame, 0, sizeof(*pFrame));
+    pFrame->frame.offsetMicroseconds = offset;
+    pFrame->frame.length = requestLength;
+    memcpy(pFrame->frame.request, pRequest, requestLength);
+    pFrame->line = pCompiler->line;
+
+    return CHIP_ERROR_NONE;
+}
+
+static int compareFrames(const void* pv1, const void* pv2)
+{
+    const CompilerFrame* p1 = (const CompilerFrame*)pv1;
+    const CompilerFrame* p2 = (const CompilerFrame*)pv2;
+
+    if (p1->frame.offsetMicroseconds != p2->frame.offsetMicroseconds)
+        return p1->frame.offsetMicroseconds < p2->frame.offsetMicroseconds ? -1 : 1;
+    if (p1->line != p2->line)
+        return p1->line < p2->line ? -1 : 1;
+    return 0;
+}
+
+static int writeChoreography(Compiler* pCompiler, const char* pOutputFilename)
+{
+    CHiPChoreographyHeader header;
+    FILE*                  pOutput = NULL;
+    uint32_t               duration = 0;
+    uint32_t               indexEntry;
+    size_t                 frame = 0;
+    size_t                 i;
+    int                    result = CHIP_ERROR_MEMORY;
+
+    if (pCompiler->frameCount > 0)
+        duration = pCompiler->pFrames[pCompiler->frameCount - 1].frame.offsetMicroseconds;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = CHIP_CHOREOGRAPHY_MAGIC;
+    header.version = CHIP_CHOREOGRAPHY_VERSION;
+    header.frameSize = sizeof(CHiPChoreographyFrame);
+    header.frameCount = pCompiler->frameCount;
+    header.indexIntervalMicroseconds = CHIP_CHOREOGRAPHY_INDEX_INTERVAL_US;
+    header.indexCount = duration / CHIP_CHOREOGRAPHY_INDEX_INTERVAL_US + 1;
+    header.durationMicroseconds = duration;
+    header.framesOffset = sizeof(header);
+    header.indexOffset = sizeof(header) + pCompiler->frameCount * sizeof(CHiPChoreographyFrame);
+    if (header.indexOffset != sizeof(header) + pCompiler->frameCount * sizeof(CHiPChoreographyFrame))
+        return CHIP_ERROR_PARAM;
+
+    pOutput = fopen(pOutputFilename, "wb");
+    if (!pOutput)
+        return CHIP_ERROR_MEMORY;
+    if (fwrite(&header, sizeof(header), 1, pOutput) != 1)
+        goto Error;
+    for (i = 0 ; i < pCompiler->frameCount ; i++)
+    {
+        if (fwrite(&pCompiler->pFrames[i].frame, sizeof(CHiPChoreographyFrame), 1, pOutput) != 1)
+            goto Error;
+    }
+    for (i = 0 ; i < header.indexCount ; i++)
+    {
+        uint64_t indexTime = (uint64_t)i * CHIP_CHOREOGRAPHY_INDEX_INTERVAL_US;
+
+        while (frame < pCompiler->frameCount && pCompiler->pFrames[frame].frame.offsetMicroseconds < indexTime)
+            frame++;
+        indexEntry = frame;
+        if (fwrite(&indexEntry, sizeof(indexEntry), 1, pOutput) != 1)
+            goto Error;
+    }
+    result = CHIP_ERROR_NONE;
+Error:
+    if (fclose(pOutput) != 0)
+        result = CHIP_ERROR_MEMORY;
+    if (result)
+        remove(pOutputFilename);
+    return result;
+}
+
+
+
+CHiPChoreography* chipChoreographyOpen(const char* pFilename)
+{
+    CHiPChoreography*             pChoreography = NULL;
+    const CHiPChoreographyHeader* pHeader;
+    struct stat                   fileStat;
+    void*                         pMapping = MAP_FAILED;
+    uint64_t                      framesEnd;
+    uint64_t                      indexEnd;
+    int                           fd = -1;
+
+    assert( pFilename );
+
+    fd = open(pFilename, O_RDONLY);
+    if (fd < 0)
+        goto Error;
+    if (fstat(fd, &fileStat) || fileStat.st_size < (off_t)sizeof(CHiPChoreographyHeader))
+        goto Error;
+    pMapping = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (pMapping == MAP_FAILED)
+        goto Error;
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    fd = -1;
+
+    // A file compiled on a host of the other byte order has its magic number reversed so it is rejected here.
+    pHeader = (const CHiPChoreographyHeader*)pMapping;
+    framesEnd = (uint64_t)pHeader->framesOffset + (uint64_t)pHeader->frameCount * pHeader->frameSize;
+    indexEnd = (uint64_t)pHeader->indexOffset + (uint64_t)pHeader->indexCount * sizeof(uint32_t);
+    if (pHeader->magic != CHIP_CHOREOGRAPHY_MAGIC ||
+        pHeader->version != CHIP_CHOREOGRAPHY_VERSION ||
+        pHeader->frameSize != sizeof(CHiPChoreographyFrame) ||
+        pHeader->indexIntervalMicroseconds == 0 ||
+        pHeader->indexCount != pHeader->durationMicroseconds / pHeader->indexIntervalMicroseconds + 1 ||
+        pHeader->framesOffset % sizeof(uint32_t) != 0 ||
+        pHeader->indexOffset % sizeof(uint32_t) != 0 ||
+        framesEnd > (uint64_t)fileStat.st_size ||
+        indexEnd > (uint64_t)fileStat.st_size)
+    {
+        goto Error;
+    }
+
+    pChoreography = calloc(1, sizeof(*pChoreography));
+    if (!pChoreography)
+        goto Error;
+    pChoreography->pMapping = pMapping;
+    pChoreography->mappingSize = fileStat.st_size;
+    pChoreography->pHeader = pHeader;
+    pChoreography->pFrames = (const CHiPChoreographyFrame*)((const uint8_t*)pMapping + pHeader->framesOffset);
+    pChoreography->pIndex = (const uint32_t*)((const uint8_t*)pMapping + pHeader->indexOffset);
+
+    return pChoreography;
+Error:
+    if (pMapping != MAP_FAILED)
+        munmap(pMapping, fileStat.st_size);
+    if (fd >= 0)
+        close(fd);
+    return NULL;
+}
+
+void chipChoreographyClose(CHiPChoreography* pChoreography)
+{
+    if (!pChoreography)
+        return;
+    munmap((void*)pChoreography->pMapping, pChoreography->mappingSize);
+    free(pChoreography);
+}
+
+const CHiPChoreographyHeader* chipChoreographyGetHeader(const CHiPChoreography* pChoreography)
+{
+    assert( pChoreography );
+    return pChoreography->pHeader;
+}
+
+const CHiPChoreographyFrame* chipChoreographyGetFrames(const CHiPChoreography* pChoreography)
+{
+    assert( pChoreography );
+    return pChoreography->pFrames;
+}
+
+uint32_t chipChoreographySeek(const CHiPChoreography* pChoreography, uint32_t offsetMicroseconds)
+{
+    const CHiPChoreographyHeader* pHeader;
+    uint32_t                      slot;
+    uint32_t                      frame;
+
+    assert( pChoreography );
+
+    pHeader = pChoreography->pHeader;
+    if (offsetMicroseconds > pHeader->durationMicroseconds)
+        return pHeader->frameCount;
+
+    // The index gets within one interval of the frame and the remaining frames are scanned from there.
+    slot = offsetMicroseconds / pHeader->indexIntervalMicroseconds;
+    frame = pChoreography->pIndex[slot];
+    while (frame < pHeader->frameCount && pChoreography->pFrames[frame].offsetMicroseconds < offsetMicroseconds)
+        frame++;
+    return frame;
+}
+
+int chipChoreographyPlay(CHiP* pCHiP, const CHiPChoreography* pChoreography, uint32_t startMicroseconds)
+{
+    CHiPClock* pClock = chipClockGetDefault();
+    uint32_t   frameCount;
+    uint32_t   frame;
+    uint64_t   baseTime;
+    int        result = CHIP_ERROR_NONE;
+
+    assert( pCHiP );
+    assert( pChoreography );
+
+    frameCount = pChoreography->pHeader->frameCount;
+    baseTime = chipClockGetMicroseconds(pClock) - startMicroseconds;
+    for (frame = chipChoreographySeek(pChoreography, startMicroseconds) ; frame < frameCount ; frame++)
+    {
+        const CHiPChoreographyFrame* pFrame = &pChoreography->pFrames[frame];
+
+        if (pFrame->length == 0 || pFrame->length > CHIP_REQUEST_MAX_LEN)
+            return CHIP_ERROR_PARAM;
+        chipClockSleepUntil(pClock, baseTime + pFrame->offsetMicroseconds);
+        result = chipRawSend(pCHiP, pFrame->request, pFrame->length);
+        if (result)
+            break;
+    }
+    return result;
+}
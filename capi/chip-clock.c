@@ -0,0 +1,363 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Real and virtual implementations of the clock interface used by the transports. */
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+#include "chip.h"
+#include "chip-clock.h"
+
+
+// A thread blocked in a virtual clock's waitUntil().  Lives on the waiting thread's stack and the thread doesn't
+// return until any wake up it is owed has been delivered, so other threads can safely hold pointers to it.
+typedef struct VirtualWaiter
+{
+    struct VirtualWaiter* pNext;
+    struct VirtualWaiter* pNextWake;
+    pthread_cond_t*       pCondition;
+    pthread_mutex_t*      pMutex;
+    uint64_t              deadline;
+    int                   expired;      // Protected by the clock's mutex.
+    int                   delivered;    // Protected by pMutex.
+} VirtualWaiter;
+
+typedef struct VirtualClock
+{
+    CHiPClock          clock;
+    pthread_mutex_t    mutex;
+    _Atomic uint64_t   now;
+    VirtualWaiter*     pWaiters;
+    uint32_t           threadCount;
+    uint32_t           waitingCount;
+} VirtualClock;
+
+// Expired waiters to be signalled once the virtual clock's mutex has been released.
+typedef struct WakeList
+{
+    VirtualWaiter* pHead;
+} WakeList;
+
+
+// Forward Declarations.
+static uint64_t realGetMicroseconds(CHiPClock* pClock);
+static int      realWaitUntil(CHiPClock* pClock, pthread_cond_t* pCondition, pthread_mutex_t* pMutex, uint64_t deadline);
+static void     realSleepUntil(CHiPClock* pClock, uint64_t deadline);
+static uint64_t virtualGetMicroseconds(CHiPClock* pClock);
+static int      virtualWaitUntil(CHiPClock* pClock, pthread_cond_t* pCondition, pthread_mutex_t* pMutex,
+                                 uint64_t deadline);
+static void     virtualSleepUntil(CHiPClock* pClock, uint64_t deadline);
+static VirtualClock* getVirtualClock(CHiPClock* pClock);
+static void     advanceIfAllWaiting(VirtualClock* pVirtual, WakeList* pWake);
+static void     expireWaiters(VirtualClock* pVirtual, WakeList* pWake);
+static void     wakeWaiters(WakeList* pWake, pthread_mutex_t* pHeldMutex);
+
+
+static CHiPClock            g_realClock = { realGetMicroseconds, realWaitUntil, realSleepUntil };
+static _Atomic(CHiPClock*)  g_pDefaultClock = NULL;
+
+
+
+CHiPClock* chipClockGetReal(void)
+{
+    return &g_realClock;
+}
+
+CHiPClock* chipClockGetDefault(void)
+{
+    CHiPClock* pClock = atomic_load(&g_pDefaultClock);
+    return pClock ? pClock : &g_realClock;
+}
+
+void chipClockSetDefault(CHiPClock* pClock)
+{
+    atomic_store(&g_pDefaultClock, pClock);
+}
+
+
+static uint64_t realGetMicroseconds(CHiPClock* pClock)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_nsec / 1000ULL;
+}
+
+static int realWaitUntil(CHiPClock* pClock, pthread_cond_t* pCondition, pthread_mutex_t* pMutex, uint64_t deadline)
+{
+    uint64_t        now = realGetMicroseconds(pClock);
+    uint64_t        wallDeadline;
+    struct timeval  tv;
+    struct timespec ts;
+
+    if (now >= deadline)
+        return CHIP_ERROR_TIMEOUT;
+
+    // pthread_cond_timedwait() takes a wall clock time so convert the remaining monotonic time into one.
+    gettimeofday(&tv, NULL);
+    wallDeadline = (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec + (deadline - now);
+    ts.tv_sec = wallDeadline / 1000000ULL;
+    ts.tv_nsec = (wallDeadline % 1000000ULL) * 1000ULL;
+    if (pthread_cond_timedwait(pCondition, pMutex, &ts) == ETIMEDOUT)
+        return CHIP_ERROR_TIMEOUT;
+    return CHIP_ERROR_NONE;
+}
+
+static void realSleepUntil(CHiPClock* pClock, uint64_t deadline)
+{
+#if defined(__linux__)
+    // Sleep until the absolute deadline so that time spent by the caller before sleeping doesn't push out the wake up
+    // and schedules built from a series of deadlines don't drift.
+    struct timespec wake;
+
+    // Deadlines which have already passed return straight away rather than paying for the timer slack of a sleep.
+    if (realGetMicroseconds(pClock) >= deadline)
+        return;
+    wake.tv_sec = deadline / 1000000ULL;
+    wake.tv_nsec = (deadline % 1000000ULL) * 1000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR)
+    {
+    }
+#else
+    // No absolute sleep is available so sleep for the remaining time, rechecking the deadline after each early wake.
+    uint64_t now = realGetMicroseconds(pClock);
+
+    while (now < deadline)
+    {
+        struct timespec delay;
+        uint64_t        remaining = deadline - now;
+
+        delay.tv_sec = remaining / 1000000ULL;
+        delay.tv_nsec = (remaining % 1000000ULL) * 1000ULL;
+        nanosleep(&delay, NULL);
+        now = realGetMicroseconds(pClock);
+    }
+#endif
+}
+
+
+CHiPClock* chipClockCreateVirtual(uint64_t startMicroseconds, uint32_t threadCount)
+{
+    VirtualClock* pVirtual = NULL;
+
+    pVirtual = calloc(1, sizeof(*pVirtual));
+    if (!pVirtual)
+        return NULL;
+    if (pthread_mutex_init(&pVirtual->mutex, NULL))
+    {
+        free(pVirtual);
+        return NULL;
+    }
+    pVirtual->clock.getMicroseconds = virtualGetMicroseconds;
+    pVirtual->clock.waitUntil = virtualWaitUntil;
+    pVirtual->clock.sleepUntil = virtualSleepUntil;
+    pVirtual->threadCount = threadCount;
+    atomic_init(&pVirtual->now, startMicroseconds);
+
+    return &pVirtual->clock;
+}
+
+void chipClockFreeVirtual(CHiPClock* pClock)
+{
+    VirtualClock* pVirtual = getVirtualClock(pClock);
+
+    if (!pVirtual)
+        return;
+    pthread_mutex_destroy(&pVirtual->mutex);
+    free(pVirtual);
+}
+
+static VirtualClock* getVirtualClock(CHiPClock* pClock)
+{
+    if (!pClock || pClock->getMicroseconds != virtualGetMicroseconds)
+        return NULL;
+    return (VirtualClock*)pClock;
+}
+
+void chipClockAttachThread(CHiPClock* pClock)
+{
+    VirtualClock* pVirtual = getVirtualClock(pClock);
+
+    if (!pVirtual)
+        return;
+    pthread_mutex_lock(&pVirtual->mutex);
+        pVirtual->threadCount++;
+    pthread_mutex_unlock(&pVirtual->mutex);
+}
+
+void chipClockDetachThread(CHiPClock* pClock)
+{
+    VirtualClock* pVirtual = getVirtualClock(pClock);
+    WakeList      wake = { NULL };
+
+    if (!pVirtual)
+        return;
+    pthread_mutex_lock(&pVirtual->mutex);
+    {
+        if (pVirtual->threadCount > 0)
+            pVirtual->threadCount--;
+        // The remaining threads may have been waiting for this one to block before advancing time.
+        advanceIfAllWaiting(pVirtual, &wake);
+    }
+    pthread_mutex_unlock(&pVirtual->mutex);
+    wakeWaiters(&wake, NULL);
+}
+
+void chipClockAdvance(CHiPClock* pClock, uint64_t microseconds)
+{
+    VirtualClock* pVirtual = getVirtualClock(pClock);
+    WakeList      wake = { NULL };
+
+    if (!pVirtual)
+        return;
+    pthread_mutex_lock(&pVirtual->mutex);
+    {
+        atomic_store(&pVirtual->now, atomic_load(&pVirtual->now) + microseconds);
+        expireWaiters(pVirtual, &wake);
+    }
+    pthread_mutex_unlock(&pVirtual->mutex);
+    wakeWaiters(&wake, NULL);
+}
+
+static uint64_t virtualGetMicroseconds(CHiPClock* pClock)
+{
+    return atomic_load(&((VirtualClock*)pClock)->now);
+}
+
+static int virtualWaitUntil(CHiPClock* pClock, pthread_cond_t* pCondition, pthread_mutex_t* pMutex, uint64_t deadline)
+{
+    VirtualClock*  pVirtual = (VirtualClock*)pClock;
+    VirtualWaiter  waiter = { NULL, NULL, pCondition, pMutex, deadline, 0, 0 };
+    VirtualWaiter** ppCurr;
+    WakeList       wake = { NULL };
+    int            expired = 0;
+
+    pthread_mutex_lock(&pVirtual->mutex);
+    {
+        if (atomic_load(&pVirtual->now) >= deadline)
+        {
+            pthread_mutex_unlock(&pVirtual->mutex);
+            return CHIP_ERROR_TIMEOUT;
+        }
+        waiter.pNext = pVirtual->pWaiters;
+        pVirtual->pWaiters = &waiter;
+        pVirtual->waitingCount++;
+        advanceIfAllWaiting(pVirtual, &wake);
+    }
+    pthread_mutex_unlock(&pVirtual->mutex);
+    wakeWaiters(&wake, pMutex);
+
+    // Block unless this thread was the one whose deadline was just reached.  The advancing thread can't signal
+    // pCondition until this thread releases pMutex inside pthread_cond_wait() so the wake up can't be missed.
+    if (!waiter.delivered)
+        pthread_cond_wait(pCondition, pMutex);
+
+    pthread_mutex_lock(&pVirtual->mutex);
+    {
+        for (ppCurr = &pVirtual->pWaiters ; *ppCurr ; ppCurr = &(*ppCurr)->pNext)
+        {
+            if (*ppCurr == &waiter)
+            {
+                *ppCurr = waiter.pNext;
+                break;
+            }
+        }
+        // Expired waiters were already removed from the waiting count when time was advanced.
+        expired = waiter.expired;
+        if (!expired)
+            pVirtual->waitingCount--;
+    }
+    pthread_mutex_unlock(&pVirtual->mutex);
+
+    // Woken up by someone else just as the deadline expired so wait for the advancing thread to finish with this
+    // waiter before its stack is released.
+    while (expired && !waiter.delivered)
+        pthread_cond_wait(pCondition, pMutex);
+
+    return expired ? CHIP_ERROR_TIMEOUT : CHIP_ERROR_NONE;
+}
+
+static void advanceIfAllWaiting(VirtualClock* pVirtual, WakeList* pWake)
+{
+    VirtualWaiter* pCurr;
+    uint64_t       nextDeadline = UINT64_MAX;
+
+    if (pVirtual->waitingCount == 0 || pVirtual->waitingCount < pVirtual->threadCount)
+        return;
+
+    for (pCurr = pVirtual->pWaiters ; pCurr ; pCurr = pCurr->pNext)
+    {
+        if (!pCurr->expired && pCurr->deadline < nextDeadline)
+            nextDeadline = pCurr->deadline;
+    }
+    if (nextDeadline == UINT64_MAX)
+        return;
+    if (nextDeadline > atomic_load(&pVirtual->now))
+        atomic_store(&pVirtual->now, nextDeadline);
+    expireWaiters(pVirtual, pWake);
+}
+
+static void expireWaiters(VirtualClock* pVirtual, WakeList* pWake)
+{
+    VirtualWaiter* pCurr;
+    uint64_t       now = atomic_load(&pVirtual->now);
+
+    for (pCurr = pVirtual->pWaiters ; pCurr ; pCurr = pCurr->pNext)
+    {
+        if (pCurr->expired || pCurr->deadline > now)
+            continue;
+        pCurr->expired = 1;
+        pVirtual->waitingCount--;
+        pCurr->pNextWake = pWake->pHead;
+        pWake->pHead = pCurr;
+    }
+}
+
+static void wakeWaiters(WakeList* pWake, pthread_mutex_t* pHeldMutex)
+{
+    VirtualWaiter* pCurr = pWake->pHead;
+
+    while (pCurr)
+    {
+        // Read everything needed from the waiter before delivering since it can return as soon as its mutex is
+        // released.  Taking the mutex also guarantees that it has entered pthread_cond_wait() before it is signalled.
+        VirtualWaiter*   pNext = pCurr->pNextWake;
+        pthread_mutex_t* pMutex = pCurr->pMutex;
+        pthread_cond_t*  pCondition = pCurr->pCondition;
+
+        if (pMutex != pHeldMutex)
+            pthread_mutex_lock(pMutex);
+        pCurr->delivered = 1;
+        pthread_cond_broadcast(pCondition);
+        if (pMutex != pHeldMutex)
+            pthread_mutex_unlock(pMutex);
+        pCurr = pNext;
+    }
+}
+
+static void virtualSleepUntil(CHiPClock* pClock, uint64_t deadline)
+{
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t  condition = PTHREAD_COND_INITIALIZER;
+
+    pthread_mutex_lock(&mutex);
+    while (virtualWaitUntil(pClock, &condition, &mutex, deadline) != CHIP_ERROR_TIMEOUT)
+    {
+    }
+    pthread_mutex_unlock(&mutex);
+    pthread_cond_destroy(&condition);
+    pthread_mutex_destroy(&mutex);
+}
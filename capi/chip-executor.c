@@ -0,0 +1,410 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Work-stealing executor for running an operation across many robots.
+   Each worker owns a contiguous range of robot indices packed into a single 64-bit atomic as (begin << 32) | end.
+   The owner claims robots one at a time from the front of its range while thieves take the back half of a victim's
+   range, both with a compare and swap.  An index is consumed the first time it is claimed so a range can never return
+   to a previous value and the compare and swap is free from ABA problems.
+*/
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip-clock.h"
+#include "chip-executor.h"
+
+
+#define CACHE_LINE_SIZE 64
+
+
+typedef struct Worker
+{
+    // Aligning the range also aligns and pads out the whole Worker, so each worker starts on its own cache line and
+    // the compare and swap on one worker's range never contends with the fields of its neighbours.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t range;
+    CHiPExecutor*    pExecutor;
+    pthread_t        thread;
+    uint32_t         index;
+    uint32_t         tasksRun;
+    uint32_t         tasksStolen;
+    uint64_t         busyMicroseconds;
+} Worker;
+
+struct CHiPExecutor
+{
+    pthread_mutex_t  runMutex;
+    pthread_mutex_t  mutex;
+    pthread_cond_t   startCondition;
+    pthread_cond_t   doneCondition;
+    CHiPClock*       pClock;
+    Worker*          pWorkers;
+    uint32_t         workerCount;
+    uint32_t         threadsStarted;
+    uint32_t         activeWorkers;
+    uint64_t         generation;
+    int              shutdown;
+
+    // Description of the operation currently being run.
+    CHiP**           ppCHiPs;
+    CHiPExecutorTask task;
+    void*            pContext;
+    uint8_t*         pResults;
+    size_t           resultSize;
+    int*             pResultCodes;
+    // Robot index of the lowest failing task in the upper 32 bits and the code it returned in the lower 32 bits so that
+    // both are updated together.  UINT64_MAX when no task has failed.
+    _Atomic uint64_t firstFailure;
+    uint64_t         elapsedMicroseconds;
+};
+
+typedef struct SetCurrentDateTimeContext
+{
+    const CHiPCurrentDateTime* pDateTime;
+} SetCurrentDateTimeContext;
+
+
+// Forward Declarations.
+static void*   workerThread(void* pArg);
+static void    runTasks(Worker* pWorker);
+static int64_t claimOwnTask(Worker* pWorker);
+static int     stealTasks(Worker* pThief);
+static void    recordFailure(CHiPExecutor* pExecutor, size_t robotIndex, int result);
+static int     getBatteryLevelTask(void* pContext, CHiP* pCHiP, size_t robotIndex, void* pResult);
+static int     setCurrentDateTimeTask(void* pContext, CHiP* pCHiP, size_t robotIndex, void* pResult);
+static int     getDogVersionTask(void* pContext, CHiP* pCHiP, size_t robotIndex, void* pResult);
+
+
+
+CHiPExecutor* chipExecutorCreate(uint32_t workerCount)
+{
+    CHiPExecutor* pExecutor = NULL;
+    uint32_t      i;
+
+    if (workerCount == 0)
+        workerCount = CHIP_EXECUTOR_DEFAULT_WORKERS;
+
+    pExecutor = calloc(1, sizeof(*pExecutor));
+    if (!pExecutor)
+        return NULL;
+    // calloc() doesn't honour the cache line alignment of Worker.
+    if (posix_memalign((void**)&pExecutor->pWorkers, CACHE_LINE_SIZE, workerCount * sizeof(*pExecutor->pWorkers)))
+    {
+        free(pExecutor);
+        return NULL;
+    }
+    memset(pExecutor->pWorkers, 0, workerCount * sizeof(*pExecutor->pWorkers));
+    pthread_mutex_init(&pExecutor->runMutex, NULL);
+    pthread_mutex_init(&pExecutor->mutex, NULL);
+    pthread_cond_init(&pExecutor->startCondition, NULL);
+    pthread_cond_init(&pExecutor->doneCondition, NULL);
+    pExecutor->pClock = chipClockGetDefault();
+    pExecutor->workerCount = workerCount;
+
+    for (i = 0 ; i < workerCount ; i++)
+    {
+        Worker* pWorker = &pExecutor->pWorkers[i];
+
+        pWorker->pExecutor = pExecutor;
+        pWorker->index = i;
+        if (pthread_create(&pWorker->thread, NULL, workerThread, pWorker))
+            goto Error;
+        pExecutor->threadsStarted++;
+    }
+
+    return pExecutor;
+Error:
+    chipExecutorDestroy(pExecutor);
+    return NULL;
+}
+
+void chipExecutorDestroy(CHiPExecutor* pExecutor)
+{
+    uint32_t i;
+
+    if (!pExecutor)
+        return;
+
+    pthread_mutex_lock(&pExecutor->mutex);
+        pExecutor->shutdown = 1;
+        pthread_cond_broadcast(&pExecutor->startCondition);
+    pthread_mutex_unlock(&pExecutor->mutex);
+    for (i = 0 ; i < pExecutor->threadsStarted ; i++)
+        pthread_join(pExecutor->pWorkers[i].thread, NULL);
+
+    pthread_cond_destroy(&pExecutor->doneCondition);
+    pthread_cond_destroy(&pExecutor->startCondition);
+    pthread_mutex_destroy(&pExecutor->mutex);
+    pthread_mutex_destroy(&pExecutor->runMutex);
+    free(pExecutor->pWorkers);
+    free(pExecutor);
+}
+
+uint32_t chipExecutorGetWorkerCount(CHiPExecutor* pExecutor)
+{
+    assert( pExecutor );
+    return pExecutor->workerCount;
+}
+
+int chipExecutorRun(CHiPExecutor* pExecutor, CHiP** ppCHiPs, size_t robotCount, CHiPExecutorTask task, void* pContext,
+                    void* pResults, size_t resultSize, int* pResultCodes)
+{
+    uint64_t startTime;
+    uint64_t firstFailure;
+    uint32_t i;
+    int      result = CHIP_ERROR_NONE;
+
+    assert( pExecutor );
+    assert( task );
+    if (robotCount > UINT32_MAX)
+        return CHIP_ERROR_PARAM;
+
+    pthread_mutex_lock(&pExecutor->runMutex);
+
+    pExecutor->ppCHiPs = ppCHiPs;
+    pExecutor->task = task;
+    pExecutor->pContext = pContext;
+    pExecutor->pResults = pResults;
+    pExecutor->resultSize = resultSize;
+    pExecutor->pResultCodes = pResultCodes;
+    atomic_store(&pExecutor->firstFailure, UINT64_MAX);
+
+    // Start with the robots split evenly between the workers.
+    for (i = 0 ; i < pExecutor->workerCount ; i++)
+    {
+        Worker*  pWorker = &pExecutor->pWorkers[i];
+        uint64_t begin = robotCount * i / pExecutor->workerCount;
+        uint64_t end = robotCount * (i + 1) / pExecutor->workerCount;
+
+        pWorker->tasksRun = 0;
+        pWorker->tasksStolen = 0;
+        pWorker->busyMicroseconds = 0;
+        atomic_store(&pWorker->range, (begin << 32) | end);
+        // Attach on behalf of the workers before any of them start so that a virtual clock can't advance until all
+        // of them are waiting.
+        chipClockAttachThread(pExecutor->pClock);
+    }
+
+    startTime = chipClockGetMicroseconds(pExecutor->pClock);
+    pthread_mutex_lock(&pExecutor->mutex);
+    {
+        pExecutor->activeWorkers = pExecutor->workerCount;
+        pExecutor->generation++;
+        pthread_cond_broadcast(&pExecutor->startCondition);
+        while (pExecutor->activeWorkers > 0)
+            pthread_cond_wait(&pExecutor->doneCondition, &pExecutor->mutex);
+    }
+    pthread_mutex_unlock(&pExecutor->mutex);
+    pExecutor->elapsedMicroseconds = chipClockGetMicroseconds(pExecutor->pClock) - startTime;
+
+    firstFailure = atomic_load(&pExecutor->firstFailure);
+    if (firstFailure != UINT64_MAX)
+        result = (int)(uint32_t)firstFailure;
+
+    pthread_mutex_unlock(&pExecutor->runMutex);
+
+    return result;
+}
+
+static void* workerThread(void* pArg)
+{
+    Worker*       pWorker = (Worker*)pArg;
+    CHiPExecutor* pExecutor = pWorker->pExecutor;
+    uint64_t      generation = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pExecutor->mutex);
+        {
+            while (!pExecutor->shutdown && pExecutor->generation == generation)
+                pthread_cond_wait(&pExecutor->startCondition, &pExecutor->mutex);
+            generation = pExecutor->generation;
+        }
+        pthread_mutex_unlock(&pExecutor->mutex);
+        if (pExecutor->shutdown)
+            break;
+
+        runTasks(pWorker);
+        chipClockDetachThread(pExecutor->pClock);
+
+        pthread_mutex_lock(&pExecutor->mutex);
+        {
+            if (--pExecutor->activeWorkers == 0)
+                pthread_cond_signal(&pExecutor->doneCondition);
+        }
+        pthread_mutex_unlock(&pExecutor->mutex);
+    }
+
+    return NULL;
+}
+
+static void runTasks(Worker* pWorker)
+{
+    CHiPExecutor* pExecutor = pWorker->pExecutor;
+
+    for (;;)
+    {
+        int64_t  robotIndex = claimOwnTask(pWorker);
+        uint64_t startTime;
+        void*    pResult = NULL;
+        int      result;
+
+        if (robotIndex < 0)
+        {
+            if (!stealTasks(pWorker))
+                break;
+            continue;
+        }
+
+        if (pExecutor->pResults)
+            pResult = pExecutor->pResults + robotIndex * pExecutor->resultSize;
+        startTime = chipClockGetMicroseconds(pExecutor->pClock);
+        result = pExecutor->task(pExecutor->pContext, pExecutor->ppCHiPs[robotIndex], robotIndex, pResult);
+        pWorker->busyMicroseconds += chipClockGetMicroseconds(pExecutor->pClock) - startTime;
+        pWorker->tasksRun++;
+
+        if (pExecutor->pResultCodes)
+            pExecutor->pResultCodes[robotIndex] = result;
+        if (result)
+            recordFailure(pExecutor, robotIndex, result);
+    }
+}
+
+static int64_t claimOwnTask(Worker* pWorker)
+{
+    uint64_t range = atomic_load(&pWorker->range);
+
+    for (;;)
+    {
+        uint64_t begin = range >> 32;
+        uint64_t end = range & 0xFFFFFFFF;
+
+        if (begin >= end)
+            return -1;
+        if (atomic_compare_exchange_weak(&pWorker->range, &range, ((begin + 1) << 32) | end))
+            return begin;
+    }
+}
+
+static int stealTasks(Worker* pThief)
+{
+    CHiPExecutor* pExecutor = pThief->pExecutor;
+    uint32_t      workerCount = pExecutor->workerCount;
+    uint32_t      i;
+
+    // Visit the other workers in a different order from each thief to spread out contention.
+    for (i = 1 ; i < workerCount ; i++)
+    {
+        Worker*  pVictim = &pExecutor->pWorkers[(pThief->index + i) % workerCount];
+        uint64_t range = atomic_load(&pVictim->range);
+
+        for (;;)
+        {
+            uint64_t begin = range >> 32;
+            uint64_t end = range & 0xFFFFFFFF;
+            uint64_t stealCount = (end - begin + 1) / 2;
+
+            if (begin >= end)
+                break;
+            if (atomic_compare_exchange_weak(&pVictim->range, &range, (begin << 32) | (end - stealCount)))
+            {
+                // Only this thread claims from its own range and it is empty so a plain store is safe.
+                atomic_store(&pThief->range, ((end - stealCount) << 32) | end);
+                pThief->tasksStolen += stealCount;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void recordFailure(CHiPExecutor* pExecutor, size_t robotIndex, int result)
+{
+    uint64_t failure = ((uint64_t)robotIndex << 32) | (uint32_t)result;
+    uint64_t firstFailure = atomic_load(&pExecutor->firstFailure);
+
+    // Ordering on the packed value orders on the robot index since each index is only run once.
+    while (failure < firstFailure)
+    {
+        if (atomic_compare_exchange_weak(&pExecutor->firstFailure, &firstFailure, failure))
+            break;
+    }
+}
+
+int chipExecutorGetWorkerStats(CHiPExecutor* pExecutor, uint32_t workerIndex, CHiPWorkerStats* pStats)
+{
+    Worker* pWorker;
+
+    assert( pExecutor );
+    assert( pStats );
+    if (workerIndex >= pExecutor->workerCount)
+        return CHIP_ERROR_PARAM;
+
+    pthread_mutex_lock(&pExecutor->runMutex);
+    {
+        pWorker = &pExecutor->pWorkers[workerIndex];
+        pStats->tasksRun = pWorker->tasksRun;
+        pStats->tasksStolen = pWorker->tasksStolen;
+        pStats->busyMicroseconds = pWorker->busyMicroseconds;
+        pStats->elapsedMicroseconds = pExecutor->elapsedMicroseconds;
+        pStats->utilization = 0.0f;
+        if (pExecutor->elapsedMicroseconds)
+            pStats->utilization = (float)pWorker->busyMicroseconds / (float)pExecutor->elapsedMicroseconds;
+    }
+    pthread_mutex_unlock(&pExecutor->runMutex);
+
+    return CHIP_ERROR_NONE;
+}
+
+
+
+int chipExecutorGetBatteryLevels(CHiPExecutor* pExecutor, CHiP** ppCHiPs, size_t robotCount,
+                                 CHiPBatteryLevel* pBatteryLevels, int* pResultCodes)
+{
+    return chipExecutorRun(pExecutor, ppCHiPs, robotCount, getBatteryLevelTask, NULL,
+                           pBatteryLevels, sizeof(*pBatteryLevels), pResultCodes);
+}
+
+static int getBatteryLevelTask(void* pContext, CHiP* pCHiP, size_t robotIndex, void* pResult)
+{
+    return chipGetBatteryLevel(pCHiP, (CHiPBatteryLevel*)pResult);
+}
+
+int chipExecutorSetCurrentDateTimes(CHiPExecutor* pExecutor, CHiP** ppCHiPs, size_t robotCount,
+                                    const CHiPCurrentDateTime* pDateTime, int* pResultCodes)
+{
+    SetCurrentDateTimeContext context = { pDateTime };
+
+    return chipExecutorRun(pExecutor, ppCHiPs, robotCount, setCurrentDateTimeTask, &context,
+                           NULL, 0, pResultCodes);
+}
+
+static int setCurrentDateTimeTask(void* pContext, CHiP* pCHiP, size_t robotIndex, void* pResult)
+{
+    SetCurrentDateTimeContext* pSetContext = (SetCurrentDateTimeContext*)pContext;
+    return chipSetCurrentDateTime(pCHiP, pSetContext->pDateTime);
+}
+
+int chipExecutorGetDogVersions(CHiPExecutor* pExecutor, CHiP** ppCHiPs, size_t robotCount,
+                               CHiPDogVersion* pVersions, int* pResultCodes)
+{
+    return chipExecutorRun(pExecutor, ppCHiPs, robotCount, getDogVersionTask, NULL,
+                           pVersions, sizeof(*pVersions), pResultCodes);
+}
+
+static int getDogVersionTask(void* pContext, CHiP* pCHiP, size_t robotIndex, void* pResult)
+{
+    return chipGetDogVersion(pCHiP, (CHiPDogVersion*)pResult);
+}
@@ -0,0 +1,496 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Implementation of the Prometheus text format metrics exporter. */
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "chip-exporter.h"
+
+
+// Maximum number of robots which can be added to a single exporter.
+#define CHIP_EXPORTER_MAX_ROBOTS    64
+
+// Maximum length of the robot label attached to each metric.
+#define CHIP_EXPORTER_MAX_LABEL     64
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+
+typedef struct CHiPExporterRobot
+{
+    CHiP* pCHiP;
+    char  label[CHIP_EXPORTER_MAX_LABEL];
+} CHiPExporterRobot;
+
+struct CHiPExporter
+{
+    char*             pFilename;
+    char*             pSocketPath;
+    int               listenSocket;
+    int               stopPipe[2];
+    uint32_t          intervalMilliseconds;
+    pthread_t         thread;
+    pthread_mutex_t   robotsMutex;
+    // Held by the exporter thread while it is using its snapshot of the robot list.
+    pthread_mutex_t   formatMutex;
+    size_t            robotCount;
+    CHiPExporterRobot robots[CHIP_EXPORTER_MAX_ROBOTS];
+    // Output is formatted into this growable buffer.
+    char*             pBuffer;
+    size_t            bufferAlloc;
+    size_t            bufferUsed;
+    // Set when the output couldn't be formatted in full so that a truncated scrape is never published.
+    int               isFormatFailed;
+    // Snapshot of the robot list and each robot's statistics, gathered before formatting.
+    size_t            snapshotCount;
+    CHiPExporterRobot snapshotRobots[CHIP_EXPORTER_MAX_ROBOTS];
+    CHiPStats         stats[CHIP_EXPORTER_MAX_ROBOTS];
+};
+
+
+static CHiPExporter* allocateExporter(void);
+static void freeExporter(CHiPExporter* pExporter);
+static void* fileExporterThread(void* pArg);
+static void* socketExporterThread(void* pArg);
+static int waitForStop(CHiPExporter* pExporter, int timeoutMilliseconds);
+static int formatMetrics(CHiPExporter* pExporter);
+static void formatCounter(CHiPExporter* pExporter, const char* pName, const char* pHelp, size_t fieldOffset,
+                          int isCounter);
+static void appendFormatted(CHiPExporter* pExporter, const char* pFormat, ...) __attribute__((format(printf, 2, 3)));
+static int writeMetricsFile(CHiPExporter* pExporter);
+static void sendMetrics(CHiPExporter* pExporter, int clientSocket);
+
+
+CHiPExporter* chipExporterStartFile(const char* pFilename, uint32_t intervalMilliseconds)
+{
+    CHiPExporter* pExporter = NULL;
+
+    assert( pFilename );
+
+    pExporter = allocateExporter();
+    if (!pExporter)
+        return NULL;
+    pExporter->intervalMilliseconds = intervalMilliseconds;
+    pExporter->pFilename = strdup(pFilename);
+    if (!pExporter->pFilename)
+        goto Error;
+    if (pthread_create(&pExporter->thread, NULL, fileExporterThread, pExporter))
+        goto Error;
+
+    return pExporter;
+
+Error:
+    freeExporter(pExporter);
+    return NULL;
+}
+
+CHiPExporter* chipExporterStartSocket(const char* pSocketPath)
+{
+    CHiPExporter*      pExporter = NULL;
+    struct sockaddr_un address;
+
+    assert( pSocketPath );
+
+    if (strlen(pSocketPath) >= sizeof(address.sun_path))
+        return NULL;
+    pExporter = allocateExporter();
+    if (!pExporter)
+        return NULL;
+    pExporter->pSocketPath = strdup(pSocketPath);
+    if (!pExporter->pSocketPath)
+        goto Error;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, pSocketPath);
+    unlink(pSocketPath);
+    pExporter->listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (pExporter->listenSocket < 0)
+        goto Error;
+    if (bind(pExporter->listenSocket, (struct sockaddr*)&address, sizeof(address)) ||
+        listen(pExporter->listenSocket, 4))
+    {
+        goto Error;
+    }
+    if (pthread_create(&pExporter->thread, NULL, socketExporterThread, pExporter))
+        goto Error;
+
+    return pExporter;
+
+Error:
+    freeExporter(pExporter);
+    return NULL;
+}
+
+static CHiPExporter* allocateExporter(void)
+{
+    CHiPExporter* pExporter = calloc(1, sizeof(*pExporter));
+    if (!pExporter)
+        return NULL;
+    pExporter->listenSocket = -1;
+    pExporter->stopPipe[0] = -1;
+    pExporter->stopPipe[1] = -1;
+    if (pthread_mutex_init(&pExporter->robotsMutex, NULL))
+    {
+        free(pExporter);
+        return NULL;
+    }
+    if (pthread_mutex_init(&pExporter->formatMutex, NULL))
+    {
+        pthread_mutex_destroy(&pExporter->robotsMutex);
+        free(pExporter);
+        return NULL;
+    }
+    if (pipe(pExporter->stopPipe))
+    {
+        freeExporter(pExporter);
+        return NULL;
+    }
+    return pExporter;
+}
+
+static void freeExporter(CHiPExporter* pExporter)
+{
+    if (!pExporter)
+        return;
+    if (pExporter->listenSocket >= 0)
+    {
+        close(pExporter->listenSocket);
+        unlink(pExporter->pSocketPath);
+    }
+    if (pExporter->stopPipe[0] >= 0)
+        close(pExporter->stopPipe[0]);
+    if (pExporter->stopPipe[1] >= 0)
+        close(pExporter->stopPipe[1]);
+    pthread_mutex_destroy(&pExporter->formatMutex);
+    pthread_mutex_destroy(&pExporter->robotsMutex);
+    free(pExporter->pBuffer);
+    free(pExporter->pSocketPath);
+    free(pExporter->pFilename);
+    free(pExporter);
+}
+
+void chipExporterStop(CHiPExporter* pExporter)
+{
+    static const char stop = 0;
+
+    if (!pExporter)
+        return;
+    // The thread has to be joined before its exporter is freed, even if waking it up takes more than one attempt.
+    while (write(pExporter->stopPipe[1], &stop, sizeof(stop)) < 0 && errno == EINTR)
+    {
+    }
+    pthread_join(pExporter->thread, NULL);
+    freeExporter(pExporter);
+}
+
+int chipExporterAddRobot(CHiPExporter* pExporter, CHiP* pCHiP, const char* pRobotLabel)
+{
+    int result = CHIP_ERROR_MEMORY;
+
+    assert( pExporter );
+    assert( pCHiP );
+    assert( pRobotLabel );
+
+    if (strlen(pRobotLabel) >= CHIP_EXPORTER_MAX_LABEL || strpbrk(pRobotLabel, "\"\\\n"))
+        return CHIP_ERROR_PARAM;
+
+    pthread_mutex_lock(&pExporter->robotsMutex);
+    if (pExporter->robotCount < CHIP_EXPORTER_MAX_ROBOTS)
+    {
+        CHiPExporterRobot* pRobot = &pExporter->robots[pExporter->robotCount++];
+        pRobot->pCHiP = pCHiP;
+        strcpy(pRobot->label, pRobotLabel);
+        result = CHIP_ERROR_NONE;
+    }
+    pthread_mutex_unlock(&pExporter->robotsMutex);
+
+    return result;
+}
+
+int chipExporterRemoveRobot(CHiPExporter* pExporter, CHiP* pCHiP)
+{
+    int result = CHIP_ERROR_PARAM;
+
+    assert( pExporter );
+
+    pthread_mutex_lock(&pExporter->robotsMutex);
+    for (size_t i = 0 ; i < pExporter->robotCount ; i++)
+    {
+        if (pExporter->robots[i].pCHiP == pCHiP)
+        {
+            memmove(&pExporter->robots[i], &pExporter->robots[i + 1],
+                    (pExporter->robotCount - i - 1) * sizeof(pExporter->robots[0]));
+            pExporter->robotCount--;
+            result = CHIP_ERROR_NONE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pExporter->robotsMutex);
+
+    // Wait for the exporter thread to finish with any snapshot which might still reference this robot so that the
+    // caller can safely call chipUninit() once this function returns.
+    pthread_mutex_lock(&pExporter->formatMutex);
+    pthread_mutex_unlock(&pExporter->formatMutex);
+
+    return result;
+}
+
+static void* fileExporterThread(void* pArg)
+{
+    CHiPExporter* pExporter = (CHiPExporter*)pArg;
+
+    do
+    {
+        pthread_mutex_lock(&pExporter->formatMutex);
+            int result = formatMetrics(pExporter);
+        pthread_mutex_unlock(&pExporter->formatMutex);
+        if (result == CHIP_ERROR_NONE)
+            writeMetricsFile(pExporter);
+    } while (!waitForStop(pExporter, pExporter->intervalMilliseconds));
+
+    return NULL;
+}
+
+static void* socketExporterThread(void* pArg)
+{
+    CHiPExporter* pExporter = (CHiPExporter*)pArg;
+
+    while (1)
+    {
+        struct pollfd fds[2] = { { pExporter->stopPipe[0], POLLIN, 0 }, { pExporter->listenSocket, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0 && errno != EINTR)
+            break;
+        if (fds[0].revents)
+            break;
+        if (fds[1].revents & POLLIN)
+        {
+            int clientSocket = accept(pExporter->listenSocket, NULL, NULL);
+            if (clientSocket < 0)
+                continue;
+            pthread_mutex_lock(&pExporter->formatMutex);
+                int result = formatMetrics(pExporter);
+            pthread_mutex_unlock(&pExporter->formatMutex);
+            if (result == CHIP_ERROR_NONE)
+                sendMetrics(pExporter, clientSocket);
+            close(clientSocket);
+        }
+    }
+
+    return NULL;
+}
+
+// Returns non-zero if chipExporterStop() was called before the timeout expired.
+static int waitForStop(CHiPExporter* pExporter, int timeoutMilliseconds)
+{
+    struct pollfd fds = { pExporter->stopPipe[0], POLLIN, 0 };
+    int           result = -1;
+
+    do
+    {
+        result = poll(&fds, 1, timeoutMilliseconds);
+    } while (result < 0 && errno == EINTR);
+    return result != 0;
+}
+
+static int formatMetrics(CHiPExporter* pExporter)
+{
+    const CHiPExporterRobot* pRobots = pExporter->snapshotRobots;
+    size_t                   robotCount = 0;
+
+    // Take a copy of the robot list so that the mutex isn't held while gathering and formatting.
+    pthread_mutex_lock(&pExporter->robotsMutex);
+        robotCount = pExporter->robotCount;
+        memcpy(pExporter->snapshotRobots, pExporter->robots, robotCount * sizeof(pExporter->robots[0]));
+    pthread_mutex_unlock(&pExporter->robotsMutex);
+    pExporter->snapshotCount = robotCount;
+
+    for (size_t i = 0 ; i < robotCount ; i++)
+        chipGetStats(pRobots[i].pCHiP, &pExporter->stats[i]);
+    pExporter->bufferUsed = 0;
+    pExporter->isFormatFailed = 0;
+
+    formatCounter(pExporter, "chip_connected", "1 if connected to the robot, 0 otherwise.",
+                  offsetof(CHiPStats, connected), 0);
+    formatCounter(pExporter, "chip_writes_total", "Requests written to the robot, excluding retries.",
+                  offsetof(CHiPStats, writes), 1);
+    formatCounter(pExporter, "chip_retries_total", "Requests resent after a response timeout.",
+                  offsetof(CHiPStats, retries), 1);
+    formatCounter(pExporter, "chip_timeouts_total", "Requests which failed after all retries.",
+                  offsetof(CHiPStats, timeouts), 1);
+    formatCounter(pExporter, "chip_bad_responses_total", "Responses rejected as malformed.",
+                  offsetof(CHiPStats, badResponses), 1);
+    formatCounter(pExporter, "chip_coalesced_total", "Getter calls which shared another caller's outstanding request.",
+                  offsetof(CHiPStats, coalesced), 1);
+    formatCounter(pExporter, "chip_debounced_total", "Setter calls replaced by a later value before being sent.",
+                  offsetof(CHiPStats, debounced), 1);
+    formatCounter(pExporter, "chip_oob_drops_total", "Out of band notifications dropped unread.",
+                  offsetof(CHiPStats, oobDrops), 1);
+    formatCounter(pExporter, "chip_oob_queue_depth", "Out of band notifications waiting to be read.",
+                  offsetof(CHiPStats, oobQueueDepth), 0);
+
+    appendFormatted(pExporter, "# HELP chip_bytes_total Request and response bytes transferred.\n"
+                               "# TYPE chip_bytes_total counter\n");
+    for (size_t i = 0 ; i < robotCount ; i++)
+    {
+        appendFormatted(pExporter, "chip_bytes_total{robot=\"%s\",direction=\"sent\"} %llu\n",
+                        pRobots[i].label, (unsigned long long)pExporter->stats[i].bytesSent);
+        appendFormatted(pExporter, "chip_bytes_total{robot=\"%s\",direction=\"received\"} %llu\n",
+                        pRobots[i].label, (unsigned long long)pExporter->stats[i].bytesReceived);
+    }
+
+    appendFormatted(pExporter, "# HELP chip_rtt_seconds Request round trip time.\n"
+                               "# TYPE chip_rtt_seconds summary\n");
+    for (size_t i = 0 ; i < robotCount ; i++)
+    {
+        static const float quantiles[] = { 0.5f, 0.9f, 0.99f, 1.0f };
+        const CHiPStats*   pStats = &pExporter->stats[i];
+
+        for (size_t j = 0 ; j < pStats->commandCount ; j++)
+        {
+            const CHiPCommandStats* pCommand = &pStats->commands[j];
+            for (size_t k = 0 ; k < sizeof(quantiles)/sizeof(quantiles[0]) ; k++)
+            {
+                appendFormatted(pExporter, "chip_rtt_seconds{robot=\"%s\",command=\"0x%02X\",quantile=\"%g\"} %.6f\n",
+                                pRobots[i].label, pCommand->command, quantiles[k],
+                                chipStatsGetPercentile(pCommand, quantiles[k]) / 1000000.0);
+            }
+            appendFormatted(pExporter, "chip_rtt_seconds_sum{robot=\"%s\",command=\"0x%02X\"} %.6f\n",
+                            pRobots[i].label, pCommand->command, pCommand->totalMicroseconds / 1000000.0);
+            appendFormatted(pExporter, "chip_rtt_seconds_count{robot=\"%s\",command=\"0x%02X\"} %u\n",
+                            pRobots[i].label, pCommand->command, pCommand->count);
+        }
+    }
+
+    appendFormatted(pExporter, "# HELP chip_battery_level Last battery level read from the robot (0.0 - 1.0).\n"
+                               "# TYPE chip_battery_level gauge\n");
+    for (size_t i = 0 ; i < robotCount ; i++)
+    {
+        CHiPBatteryLevel batteryLevel;
+        uint32_t         ageMilliseconds = 0;
+
+        if (chipGetLastBatteryLevel(pRobots[i].pCHiP, &batteryLevel, &ageMilliseconds) != CHIP_ERROR_NONE)
+            continue;
+        appendFormatted(pExporter, "chip_battery_level{robot=\"%s\",charging_status=\"%d\",charger_type=\"%d\"} %.3f\n",
+                        pRobots[i].label, batteryLevel.chargingStatus, batteryLevel.chargerType,
+                        batteryLevel.batteryLevel);
+        appendFormatted(pExporter, "chip_battery_level_age_seconds{robot=\"%s\"} %.3f\n",
+                        pRobots[i].label, ageMilliseconds / 1000.0);
+    }
+
+    return pExporter->pBuffer ? CHIP_ERROR_NONE : CHIP_ERROR_MEMORY;
+}
+
+static void formatCounter(CHiPExporter* pExporter, const char* pName, const char* pHelp, size_t fieldOffset,
+                          int isCounter)
+{
+    appendFormatted(pExporter, "# HELP %s %s\n# TYPE %s %s\n", pName, pHelp, pName, isCounter ? "counter" : "gauge");
+    for (size_t i = 0 ; i < pExporter->snapshotCount ; i++)
+    {
+        // All of the fields exported by this function are 32-bit.
+        uint32_t value = 0;
+        memcpy(&value, (const uint8_t*)&pExporter->stats[i] + fieldOffset, sizeof(value));
+        appendFormatted(pExporter, "%s{robot=\"%s\"} %u\n", pName, pExporter->snapshotRobots[i].label, value);
+    }
+}
+
+static void appendFormatted(CHiPExporter* pExporter, const char* pFormat, ...)
+{
+    va_list args;
+    int     length = 0;
+
+    while (1)
+    {
+        size_t available = pExporter->bufferAlloc - pExporter->bufferUsed;
+
+        va_start(args, pFormat);
+        length = vsnprintf(pExporter->pBuffer + pExporter->bufferUsed, available, pFormat, args);
+        va_end(args);
+        if (length < 0)
+        {
+            pExporter->isFormatFailed = 1;
+            return;
+        }
+        if ((size_t)length < available)
+            break;
+
+        // Grow the buffer and try again.
+        size_t newAlloc = pExporter->bufferAlloc * 2 + length + 1;
+        char*  pNewBuffer = realloc(pExporter->pBuffer, newAlloc);
+        if (!pNewBuffer)
+        {
+            pExporter->isFormatFailed = 1;
+            return;
+        }
+        pExporter->pBuffer = pNewBuffer;
+        pExporter->bufferAlloc = newAlloc;
+    }
+    pExporter->bufferUsed += length;
+}
+
+static int writeMetricsFile(CHiPExporter* pExporter)
+{
+    char   tempFilename[1024];
+    FILE*  pFile = NULL;
+    size_t written = 0;
+
+    // Leave the last complete scrape in place rather than replacing it with a truncated one.
+    if (pExporter->isFormatFailed)
+        return CHIP_ERROR_MEMORY;
+    if ((size_t)snprintf(tempFilename, sizeof(tempFilename), "%s.tmp", pExporter->pFilename) >= sizeof(tempFilename))
+        return CHIP_ERROR_PARAM;
+    pFile = fopen(tempFilename, "w");
+    if (!pFile)
+        return CHIP_ERROR_PARAM;
+    written = fwrite(pExporter->pBuffer, 1, pExporter->bufferUsed, pFile);
+    if (fclose(pFile) || written != pExporter->bufferUsed || rename(tempFilename, pExporter->pFilename))
+    {
+        unlink(tempFilename);
+        return CHIP_ERROR_PARAM;
+    }
+    return CHIP_ERROR_NONE;
+}
+
+static void sendMetrics(CHiPExporter* pExporter, int clientSocket)
+{
+    size_t sent = 0;
+
+    // Closing the connection without any output is reported by Prometheus as a failed scrape.
+    if (pExporter->isFormatFailed)
+        return;
+#ifdef SO_NOSIGPIPE
+    int noSigPipe = 1;
+    setsockopt(clientSocket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+    while (sent < pExporter->bufferUsed)
+    {
+        ssize_t result = send(clientSocket, pExporter->pBuffer + sent, pExporter->bufferUsed - sent, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return;
+        sent += result;
+    }
+}
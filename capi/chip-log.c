@@ -0,0 +1,341 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Implementation of the low overhead logging ring with deferred formatting. */
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "chip.h"
+#include "chip-log.h"
+
+
+// The ring is a bounded multiple producer / single consumer queue.  Each cell has a sequence number which tells
+// producers and the consumer whose turn it is to access that cell.  The sequence stored in each cell is relative to
+// the cell's index so that the zero initialized ring starts out in the correct state.
+typedef struct CHiPLogCell
+{
+    _Atomic uint64_t sequence;
+    CHiPLogRecord    record;
+} CHiPLogCell;
+
+#define CHIP_LOG_RING_MASK  (CHIP_LOG_RING_SIZE - 1)
+_Static_assert((CHIP_LOG_RING_SIZE & CHIP_LOG_RING_MASK) == 0, "CHIP_LOG_RING_SIZE must be a power of 2");
+
+
+static CHiPLogCell      g_ring[CHIP_LOG_RING_SIZE];
+static _Atomic uint64_t g_enqueuePos;
+static uint64_t         g_dequeuePos;
+static _Atomic uint32_t g_dropCount;
+static _Atomic int      g_level = CHIP_LOG_LEVEL_INFO;
+static pthread_mutex_t  g_flushMutex = PTHREAD_MUTEX_INITIALIZER;
+static CHiPLogSink      g_sink;
+static void*            g_pSinkContext;
+
+static pthread_mutex_t  g_flusherMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   g_flusherCondition = PTHREAD_COND_INITIALIZER;
+static pthread_t        g_flusherThread;
+static int              g_isFlusherRunning;
+static int              g_stopFlusher;
+static uint32_t         g_flushIntervalMilliseconds;
+
+
+static uint64_t getMicroseconds(void);
+static void defaultSink(void* pContext, const CHiPLogRecord* pRecord, const char* pMessage);
+static void* flusherThread(void* pArg);
+static size_t formatConversion(const char* pSpec, size_t specLength, char conversion, int lengthBits, uint64_t arg,
+                               char* pBuffer, size_t bufferSize);
+
+
+void chipLogSetLevel(int level)
+{
+    atomic_store_explicit(&g_level, level, memory_order_relaxed);
+}
+
+void chipLogSetSink(CHiPLogSink sink, void* pContext)
+{
+    pthread_mutex_lock(&g_flushMutex);
+        g_sink = sink;
+        g_pSinkContext = pContext;
+    pthread_mutex_unlock(&g_flushMutex);
+}
+
+uint32_t chipLogGetDropCount(void)
+{
+    return atomic_load_explicit(&g_dropCount, memory_order_relaxed);
+}
+
+void chipLogWrite(int level, const char* pFormat, int argCount,
+                  uint64_t arg0, uint64_t arg1, uint64_t arg2, uint64_t arg3)
+{
+    CHiPLogCell* pCell = NULL;
+    uint64_t     pos = 0;
+
+    if (level < atomic_load_explicit(&g_level, memory_order_relaxed))
+        return;
+
+    pos = atomic_load_explicit(&g_enqueuePos, memory_order_relaxed);
+    while (1)
+    {
+        pCell = &g_ring[pos & CHIP_LOG_RING_MASK];
+        uint64_t sequence = atomic_load_explicit(&pCell->sequence, memory_order_acquire) + (pos & CHIP_LOG_RING_MASK);
+        int64_t  diff = (int64_t)(sequence - pos);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&g_enqueuePos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // The ring is full so drop this record rather than block.
+            atomic_fetch_add_explicit(&g_dropCount, 1, memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&g_enqueuePos, memory_order_relaxed);
+        }
+    }
+
+    pCell->record.timestamp = getMicroseconds();
+    pCell->record.pFormat = pFormat;
+    pCell->record.level = level;
+    pCell->record.argCount = argCount;
+    pCell->record.args[0] = arg0;
+    pCell->record.args[1] = arg1;
+    pCell->record.args[2] = arg2;
+    pCell->record.args[3] = arg3;
+    atomic_store_explicit(&pCell->sequence, pos + 1 - (pos & CHIP_LOG_RING_MASK), memory_order_release);
+}
+
+size_t chipLogFlush(void)
+{
+    size_t flushed = 0;
+
+    pthread_mutex_lock(&g_flushMutex);
+    while (1)
+    {
+        CHiPLogCell*  pCell = &g_ring[g_dequeuePos & CHIP_LOG_RING_MASK];
+        uint64_t      index = g_dequeuePos & CHIP_LOG_RING_MASK;
+        CHiPLogRecord record;
+        char          message[256];
+
+        if (atomic_load_explicit(&pCell->sequence, memory_order_acquire) + index != g_dequeuePos + 1)
+            break;
+        record = pCell->record;
+        atomic_store_explicit(&pCell->sequence, g_dequeuePos + CHIP_LOG_RING_SIZE - index, memory_order_release);
+        g_dequeuePos++;
+
+        chipLogFormat(&record, message, sizeof(message));
+        if (g_sink)
+            g_sink(g_pSinkContext, &record, message);
+        else
+            defaultSink(NULL, &record, message);
+        flushed++;
+    }
+    pthread_mutex_unlock(&g_flushMutex);
+
+    return flushed;
+}
+
+static void defaultSink(void* pContext, const CHiPLogRecord* pRecord, const char* pMessage)
+{
+    static const char* levelNames[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+    const char*        pLevelName = pRecord->level < sizeof(levelNames)/sizeof(levelNames[0]) ?
+                                    levelNames[pRecord->level] : "?";
+
+    fprintf(stderr, "[%llu.%06llu] %s: %s\n",
+            (unsigned long long)(pRecord->timestamp / 1000000), (unsigned long long)(pRecord->timestamp % 1000000),
+            pLevelName, pMessage);
+}
+
+// Formats the record using its format string.  Each conversion specification is formatted separately with snprintf()
+// so that the 64-bit argument can be passed in with the length modifier that matches it.
+void chipLogFormat(const CHiPLogRecord* pRecord, char* pBuffer, size_t bufferSize)
+{
+    const char* pCurr = pRecord->pFormat;
+    size_t      used = 0;
+    int         argIndex = 0;
+
+    if (bufferSize == 0)
+        return;
+    while (*pCurr && used + 1 < bufferSize)
+    {
+        if (*pCurr != '%' || pCurr[1] == '%')
+        {
+            pBuffer[used++] = *pCurr;
+            pCurr += (*pCurr == '%') ? 2 : 1;
+            continue;
+        }
+
+        // Parse the flags, width and precision which are passed straight through to snprintf().
+        const char* pSpec = pCurr++;
+        while (*pCurr && strchr("-+ #0123456789.", *pCurr))
+            pCurr++;
+        size_t specLength = pCurr - pSpec;
+
+        // Parse the length modifier.
+        int lengthBits = 32;
+        while (*pCurr && strchr("hlzjt", *pCurr))
+        {
+            if (*pCurr == 'h')
+                lengthBits = lengthBits == 16 ? 8 : 16;
+            else
+                lengthBits = 64;
+            pCurr++;
+        }
+
+        char     conversion = *pCurr ? *pCurr++ : '\0';
+        uint64_t arg = argIndex < pRecord->argCount ? pRecord->args[argIndex] : 0;
+        argIndex++;
+        used += formatConversion(pSpec, specLength, conversion, lengthBits, arg, pBuffer + used, bufferSize - used);
+    }
+    pBuffer[used < bufferSize ? used : bufferSize - 1] = '\0';
+}
+
+static size_t formatConversion(const char* pSpec, size_t specLength, char conversion, int lengthBits, uint64_t arg,
+                               char* pBuffer, size_t bufferSize)
+{
+    char format[32];
+    int  length = 0;
+
+    if (specLength > sizeof(format) - 4)
+        specLength = sizeof(format) - 4;
+    memcpy(format, pSpec, specLength);
+
+    switch (conversion)
+    {
+    case 'd':
+    case 'i':
+    {
+        long long value = lengthBits == 64 ? (long long)(int64_t)arg :
+                          lengthBits == 16 ? (long long)(int16_t)arg :
+                          lengthBits == 8  ? (long long)(int8_t)arg : (long long)(int32_t)arg;
+        memcpy(format + specLength, "lld", 4);
+        length = snprintf(pBuffer, bufferSize, format, value);
+        break;
+    }
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+    {
+        unsigned long long value = lengthBits == 64 ? (unsigned long long)arg :
+                                   lengthBits == 16 ? (unsigned long long)(uint16_t)arg :
+                                   lengthBits == 8  ? (unsigned long long)(uint8_t)arg :
+                                                      (unsigned long long)(uint32_t)arg;
+        format[specLength] = 'l';
+        format[specLength + 1] = 'l';
+        format[specLength + 2] = conversion;
+        format[specLength + 3] = '\0';
+        length = snprintf(pBuffer, bufferSize, format, value);
+        break;
+    }
+    case 'c':
+        memcpy(format + specLength, "c", 2);
+        length = snprintf(pBuffer, bufferSize, format, (int)(char)arg);
+        break;
+    case 's':
+        memcpy(format + specLength, "s", 2);
+        length = snprintf(pBuffer, bufferSize, format, arg ? (const char*)(uintptr_t)arg : "(null)");
+        break;
+    case 'p':
+        memcpy(format + specLength, "p", 2);
+        length = snprintf(pBuffer, bufferSize, format, (void*)(uintptr_t)arg);
+        break;
+    default:
+        length = snprintf(pBuffer, bufferSize, "<%%%c?>", conversion ? conversion : ' ');
+        break;
+    }
+
+    if (length < 0)
+        return 0;
+    return (size_t)length < bufferSize ? (size_t)length : bufferSize - 1;
+}
+
+int chipLogStartFlusher(uint32_t intervalMilliseconds)
+{
+    int result = CHIP_ERROR_NONE;
+
+    pthread_mutex_lock(&g_flusherMutex);
+    if (!g_isFlusherRunning)
+    {
+        g_flushIntervalMilliseconds = intervalMilliseconds;
+        g_stopFlusher = 0;
+        if (pthread_create(&g_flusherThread, NULL, flusherThread, NULL))
+            result = CHIP_ERROR_MEMORY;
+        else
+            g_isFlusherRunning = 1;
+    }
+    pthread_mutex_unlock(&g_flusherMutex);
+
+    return result;
+}
+
+void chipLogStopFlusher(void)
+{
+    int wasRunning = 0;
+
+    pthread_mutex_lock(&g_flusherMutex);
+        wasRunning = g_isFlusherRunning;
+        g_stopFlusher = 1;
+        g_isFlusherRunning = 0;
+    pthread_mutex_unlock(&g_flusherMutex);
+    pthread_cond_signal(&g_flusherCondition);
+
+    if (wasRunning)
+        pthread_join(g_flusherThread, NULL);
+    chipLogFlush();
+}
+
+static void* flusherThread(void* pArg)
+{
+    int stop = 0;
+
+    while (!stop)
+    {
+        struct timeval  tv;
+        struct timespec ts;
+
+        gettimeofday(&tv, NULL);
+        uint64_t nanoseconds = (uint64_t)tv.tv_usec * 1000 + (uint64_t)g_flushIntervalMilliseconds * 1000000;
+        ts.tv_sec = tv.tv_sec + nanoseconds / 1000000000;
+        ts.tv_nsec = nanoseconds % 1000000000;
+
+        pthread_mutex_lock(&g_flusherMutex);
+            int res = 0;
+            while (!g_stopFlusher && res != ETIMEDOUT)
+                res = pthread_cond_timedwait(&g_flusherCondition, &g_flusherMutex, &ts);
+            stop = g_stopFlusher;
+        pthread_mutex_unlock(&g_flusherMutex);
+
+        chipLogFlush();
+    }
+
+    return NULL;
+}
+
+static uint64_t getMicroseconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
@@ -0,0 +1,191 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Settings profiles which are captured from a robot in one pass and applied by writing only the fields that differ. */
+#include <assert.h>
+#include <string.h>
+#include "chip-profile.h"
+
+
+// Forward Declarations.
+static int     isValidProfile(const CHiPProfile* pProfile);
+static int     isFieldUnchanged(const CHiPProfile* pProfile, const CHiPStatus* pStatus, uint32_t field);
+static int     isSameAlarm(const CHiPAlarmDateTime* p1, const CHiPAlarmDateTime* p2);
+static int64_t secondsFromDateTime(const CHiPCurrentDateTime* pDateTime);
+static int     writeField(CHiP* pCHiP, const CHiPProfile* pProfile, uint32_t field);
+
+
+
+int chipProfileCapture(CHiP* pCHiP, CHiPProfile* pProfile)
+{
+    CHiPStatus status;
+    int        result;
+
+    assert( pCHiP );
+    assert( pProfile );
+
+    result = chipGetStatusFields(pCHiP, CHIP_PROFILE_FIELDS, &status);
+    memset(pProfile, 0, sizeof(*pProfile));
+    pProfile->fieldMask = status.validMask;
+    pProfile->speed = status.speed;
+    pProfile->volume = status.volume;
+    pProfile->eyeBrightness = status.eyeBrightness;
+    pProfile->currentDateTime = status.currentDateTime;
+    pProfile->alarmDateTime = status.alarmDateTime;
+
+    return result;
+}
+
+int chipProfileApply(CHiP* pCHiP, const CHiPProfile* pProfile, CHiPProfileReport* pReport)
+{
+    CHiPProfileReport report;
+    CHiPStatus        status;
+    uint32_t          field;
+    int               result = CHIP_ERROR_NONE;
+
+    assert( pCHiP );
+    assert( pProfile );
+
+    memset(&report, 0, sizeof(report));
+    if (!isValidProfile(pProfile))
+    {
+        result = CHIP_ERROR_PARAM;
+        goto Done;
+    }
+
+    // Fields which can't be read are left out of validMask and get written below as if they differed.
+    chipGetStatusFields(pCHiP, pProfile->fieldMask, &status);
+    for (field = 1 ; field <= CHIP_STATUS_ALARM_DATE_TIME ; field <<= 1)
+    {
+        int writeResult;
+
+        if (!(pProfile->fieldMask & field))
+            continue;
+        if ((status.validMask & field) && isFieldUnchanged(pProfile, &status, field))
+        {
+            report.unchangedMask |= field;
+            continue;
+        }
+
+        // Settings are written without waiting for a response so these all go out back to back.
+        writeResult = writeField(pCHiP, pProfile, field);
+        if (writeResult)
+        {
+            report.failedMask |= field;
+            if (result == CHIP_ERROR_NONE)
+                result = writeResult;
+            continue;
+        }
+        report.writtenMask |= field;
+    }
+
+Done:
+    if (pReport)
+        *pReport = report;
+    return result;
+}
+
+static int isValidProfile(const CHiPProfile* pProfile)
+{
+    const CHiPCurrentDateTime* pDateTime = &pProfile->currentDateTime;
+    const CHiPAlarmDateTime*   pAlarm = &pProfile->alarmDateTime;
+    uint32_t                   fieldMask = pProfile->fieldMask;
+
+    if (fieldMask & ~CHIP_PROFILE_FIELDS)
+        return 0;
+    if ((fieldMask & CHIP_STATUS_SPEED) && pProfile->speed > CHIP_SPEED_KID)
+        return 0;
+    if ((fieldMask & CHIP_STATUS_VOLUME) && (pProfile->volume < 1 || pProfile->volume > 11))
+        return 0;
+    if ((fieldMask & CHIP_STATUS_CURRENT_DATE_TIME) &&
+        (pDateTime->month < 1 || pDateTime->month > 12 || pDateTime->day < 1 || pDateTime->day > 31 ||
+         pDateTime->hour >= 24 || pDateTime->minute >= 60 || pDateTime->second >= 60 || pDateTime->dayOfWeek >= 7))
+    {
+        return 0;
+    }
+    if ((fieldMask & CHIP_STATUS_ALARM_DATE_TIME) && pAlarm->month != 0 &&
+        (pAlarm->month > 12 || pAlarm->day < 1 || pAlarm->day > 31 || pAlarm->hour >= 24 || pAlarm->minute >= 60))
+    {
+        return 0;
+    }
+    return 1;
+}
+
+static int isFieldUnchanged(const CHiPProfile* pProfile, const CHiPStatus* pStatus, uint32_t field)
+{
+    int64_t skew;
+
+    switch (field)
+    {
+    case CHIP_STATUS_SPEED:
+        return pProfile->speed == pStatus->speed;
+    case CHIP_STATUS_VOLUME:
+        return pProfile->volume == pStatus->volume;
+    case CHIP_STATUS_EYE_BRIGHTNESS:
+        return pProfile->eyeBrightness == pStatus->eyeBrightness;
+    case CHIP_STATUS_CURRENT_DATE_TIME:
+        skew = secondsFromDateTime(&pProfile->currentDateTime) - secondsFromDateTime(&pStatus->currentDateTime);
+        if (skew < 0)
+            skew = -skew;
+        return skew <= pProfile->clockToleranceSeconds;
+    case CHIP_STATUS_ALARM_DATE_TIME:
+        return isSameAlarm(&pProfile->alarmDateTime, &pStatus->alarmDateTime);
+    default:
+        return 0;
+    }
+}
+
+static int isSameAlarm(const CHiPAlarmDateTime* p1, const CHiPAlarmDateTime* p2)
+{
+    // Any two cancelled alarms match no matter what else they contain.
+    if (p1->month == 0 || p2->month == 0)
+        return p1->month == p2->month;
+    return p1->year == p2->year && p1->month == p2->month && p1->day == p2->day &&
+           p1->hour == p2->hour && p1->minute == p2->minute;
+}
+
+static int64_t secondsFromDateTime(const CHiPCurrentDateTime* pDateTime)
+{
+    // Days since 1970-01-01 in the proleptic Gregorian calendar.
+    int64_t  year = (int64_t)pDateTime->year - (pDateTime->month <= 2);
+    int64_t  era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yearOfEra = (unsigned)(year - era * 400);
+    unsigned month = pDateTime->month;
+    unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + pDateTime->day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int64_t  days = era * 146097 + (int64_t)dayOfEra - 719468;
+
+    return days * 86400 + pDateTime->hour * 3600 + pDateTime->minute * 60 + pDateTime->second;
+}
+
+static int writeField(CHiP* pCHiP, const CHiPProfile* pProfile, uint32_t field)
+{
+    switch (field)
+    {
+    case CHIP_STATUS_SPEED:
+        return chipSetSpeed(pCHiP, pProfile->speed);
+    case CHIP_STATUS_VOLUME:
+        return chipSetVolume(pCHiP, pProfile->volume);
+    case CHIP_STATUS_EYE_BRIGHTNESS:
+        return chipSetEyeBrightness(pCHiP, pProfile->eyeBrightness);
+    case CHIP_STATUS_CURRENT_DATE_TIME:
+        return chipSetCurrentDateTime(pCHiP, &pProfile->currentDateTime);
+    case CHIP_STATUS_ALARM_DATE_TIME:
+        if (pProfile->alarmDateTime.month == 0)
+            return chipCancelAlarm(pCHiP);
+        return chipSetAlarmDateTime(pCHiP, &pProfile->alarmDateTime);
+    default:
+        return CHIP_ERROR_PARAM;
+    }
+}
@@ -0,0 +1,179 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Lookup tables, validation and decoding generated from CHIP_PROTOCOL_TABLE. */
+#include <assert.h>
+#include "chip.h"
+#include "chip-protocol.h"
+
+
+typedef void (*ResponseDecoder)(const uint8_t* pResponse, CHiPResponse* pDecoded);
+
+
+// Forward Declarations.
+static void decodeNone(const uint8_t* pResponse, CHiPResponse* pDecoded);
+static void decodeSpeed(const uint8_t* pResponse, CHiPResponse* pDecoded);
+static void decodeEyeBrightness(const uint8_t* pResponse, CHiPResponse* pDecoded);
+static void decodeVolume(const uint8_t* pResponse, CHiPResponse* pDecoded);
+static void decodeBatteryLevel(const uint8_t* pResponse, CHiPResponse* pDecoded);
+static void decodeCurrentDateTime(const uint8_t* pResponse, CHiPResponse* pDecoded);
+static void decodeAlarmDateTime(const uint8_t* pResponse, CHiPResponse* pDecoded);
+static void decodeDogVersion(const uint8_t* pResponse, CHiPResponse* pDecoded);
+
+
+// Valid byte ranges for each command's response.  Each list ends with an unused entry so that it is never empty.
+#define RANGE_ARRAY(NAME, CODE, REQUEST_LEN, RESPONSE_LEN, DECODER, RANGES) \
+    static const CHiPProtocolRange g_ranges##NAME[] = { RANGES { 0, 0, 0 } };
+CHIP_PROTOCOL_TABLE(RANGE_ARRAY)
+#undef RANGE_ARRAY
+
+// Indexed by command code so that any request, response or notification can be looked up in O(1).  Unused codes are
+// left zeroed with a NULL pName.
+#define COMMAND_ENTRY(NAME, CODE, REQUEST_LEN, RESPONSE_LEN, DECODER, RANGES) \
+    [CODE] = { #NAME, g_ranges##NAME, sizeof(g_ranges##NAME) / sizeof(g_ranges##NAME[0]) - 1, \
+               CODE, REQUEST_LEN, RESPONSE_LEN },
+static const CHiPProtocolCommand g_commands[256] =
+{
+    CHIP_PROTOCOL_TABLE(COMMAND_ENTRY)
+};
+#undef COMMAND_ENTRY
+
+#define DECODER_ENTRY(NAME, CODE, REQUEST_LEN, RESPONSE_LEN, DECODER, RANGES) \
+    [CODE] = decode##DECODER,
+static const ResponseDecoder g_decoders[256] =
+{
+    CHIP_PROTOCOL_TABLE(DECODER_ENTRY)
+};
+#undef DECODER_ENTRY
+
+
+
+const CHiPProtocolCommand* chipProtocolLookup(uint8_t code)
+{
+    const CHiPProtocolCommand* pCommand = &g_commands[code];
+
+    if (!pCommand->pName)
+        return NULL;
+    return pCommand;
+}
+
+int chipProtocolValidateResponse(const uint8_t* pResponse, size_t responseLength)
+{
+    const CHiPProtocolCommand* pCommand;
+    uint8_t                    i;
+
+    assert( pResponse || responseLength == 0 );
+
+    if (responseLength == 0)
+        return CHIP_ERROR_BAD_RESPONSE;
+    pCommand = chipProtocolLookup(pResponse[0]);
+    if (!pCommand || pCommand->responseLength == 0 || responseLength != pCommand->responseLength)
+        return CHIP_ERROR_BAD_RESPONSE;
+    for (i = 0 ; i < pCommand->rangeCount ; i++)
+    {
+        const CHiPProtocolRange* pRange = &pCommand->pRanges[i];
+        uint8_t                  value = pResponse[pRange->offset];
+
+        if (value < pRange->min || value > pRange->max)
+            return CHIP_ERROR_BAD_RESPONSE;
+    }
+
+    return CHIP_ERROR_NONE;
+}
+
+int chipDecodeResponse(const uint8_t* pResponse, size_t responseLength, CHiPResponse* pDecoded)
+{
+    int result;
+
+    assert( pDecoded );
+
+    result = chipProtocolValidateResponse(pResponse, responseLength);
+    if (result)
+        return result;
+
+    pDecoded->command = pResponse[0];
+    g_decoders[pResponse[0]](pResponse, pDecoded);
+    return CHIP_ERROR_NONE;
+}
+
+static void decodeNone(const uint8_t* pResponse, CHiPResponse* pDecoded)
+{
+    // Commands without a response are rejected by chipProtocolValidateResponse() before getting here.
+    assert( 0 );
+}
+
+static void decodeSpeed(const uint8_t* pResponse, CHiPResponse* pDecoded)
+{
+    pDecoded->speed = pResponse[1];
+}
+
+static void decodeEyeBrightness(const uint8_t* pResponse, CHiPResponse* pDecoded)
+{
+    pDecoded->eyeBrightness = pResponse[1];
+}
+
+static void decodeVolume(const uint8_t* pResponse, CHiPResponse* pDecoded)
+{
+    pDecoded->volume = pResponse[1];
+}
+
+static void decodeBatteryLevel(const uint8_t* pResponse, CHiPResponse* pDecoded)
+{
+    // Convert battery integer value to floating point percentage value between 0.0f and 1.0f.
+    pDecoded->batteryLevel.chargingStatus = pResponse[1];
+    pDecoded->batteryLevel.chargerType = pResponse[2];
+    pDecoded->batteryLevel.batteryLevel = (float)(pResponse[3] - 0x7D) / 34.0f;
+}
+
+static void decodeCurrentDateTime(const uint8_t* pResponse, CHiPResponse* pDecoded)
+{
+    CHiPCurrentDateTime* pDateTime = &pDecoded->currentDateTime;
+
+    // Year is stored in 2 bytes, big endian.
+    pDateTime->year = ((uint16_t)pResponse[1] << 8) | (uint16_t)pResponse[2];
+    pDateTime->month = pResponse[3];
+    pDateTime->day = pResponse[4];
+    pDateTime->hour = pResponse[5];
+    pDateTime->minute = pResponse[6];
+    pDateTime->second = pResponse[7];
+    pDateTime->dayOfWeek = pResponse[8];
+}
+
+static void decodeAlarmDateTime(const uint8_t* pResponse, CHiPResponse* pDecoded)
+{
+    CHiPAlarmDateTime* pDateTime = &pDecoded->alarmDateTime;
+
+    // Year is stored in 2 bytes, big endian.
+    pDateTime->year = ((uint16_t)pResponse[1] << 8) | (uint16_t)pResponse[2];
+    pDateTime->month = pResponse[3];
+    pDateTime->day = pResponse[4];
+    pDateTime->hour = pResponse[5];
+    pDateTime->minute = pResponse[6];
+}
+
+static void decodeDogVersion(const uint8_t* pResponse, CHiPResponse* pDecoded)
+{
+    CHiPDogVersion* pVersion = &pDecoded->dogVersion;
+
+    pVersion->bodyHardware = pResponse[1];
+    pVersion->headHardware = pResponse[2];
+    pVersion->mechanic = pResponse[3];
+    pVersion->bleSpiFlash = pResponse[4];
+    pVersion->nuvotonSpiFlash = pResponse[5];
+    pVersion->bleBootloader = pResponse[6];
+    pVersion->bleApromFirmware = pResponse[7];
+    pVersion->nuvotonBootloaderFirmware = pResponse[8];
+    pVersion->nuvotonApromFirmware = pResponse[9];
+    pVersion->nuvoton = pResponse[10];
+}
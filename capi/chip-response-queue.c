@@ -0,0 +1,134 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Fixed sized circular queue of CHiP responses which supports push overflow. */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "chip.h"
+#include "chip-response-queue.h"
+
+
+typedef struct CHiPQueuedResponse
+{
+    uint8_t length;
+    uint8_t content[CHIP_RESPONSE_MAX_LEN];
+} CHiPQueuedResponse;
+
+struct CHiPResponseQueue
+{
+    CHiPQueuedResponse* pResponses;
+    size_t              alloc;
+    size_t              count;
+    size_t              push;
+    size_t              pop;
+    pthread_mutex_t     mutex;
+    _Atomic uint32_t    dropCount;
+};
+
+
+CHiPResponseQueue* chipResponseQueueAlloc(size_t itemCount)
+{
+    CHiPResponseQueue* pQueue = NULL;
+    int                mutexInit = -1;
+
+    pQueue = calloc(1, sizeof(*pQueue));
+    if (!pQueue)
+        goto Error;
+    pQueue->pResponses = malloc(itemCount * sizeof(*pQueue->pResponses));
+    if (!pQueue->pResponses)
+        goto Error;
+    mutexInit = pthread_mutex_init(&pQueue->mutex, NULL);
+    if (mutexInit)
+        goto Error;
+    pQueue->alloc = itemCount;
+
+    return pQueue;
+Error:
+    if (pQueue)
+        free(pQueue->pResponses);
+    free(pQueue);
+    return NULL;
+}
+
+void chipResponseQueueFree(CHiPResponseQueue* pQueue)
+{
+    if (!pQueue)
+        return;
+    pthread_mutex_destroy(&pQueue->mutex);
+    free(pQueue->pResponses);
+    free(pQueue);
+}
+
+void chipResponseQueuePush(CHiPResponseQueue* pQueue, const uint8_t* pData, size_t length)
+{
+    size_t copyLen = length;
+    if (copyLen > sizeof(pQueue->pResponses[0].content))
+        copyLen = sizeof(pQueue->pResponses[0].content);
+    pthread_mutex_lock(&pQueue->mutex);
+    {
+        memcpy(pQueue->pResponses[pQueue->push].content, pData, copyLen);
+        pQueue->pResponses[pQueue->push].length = copyLen;
+        pQueue->push = (pQueue->push + 1) % pQueue->alloc;
+        if (pQueue->count == pQueue->alloc)
+        {
+            // Queue was already full so drop oldest item by advancing the pop index.
+            pQueue->pop = (pQueue->pop + 1) % pQueue->alloc;
+            atomic_fetch_add_explicit(&pQueue->dropCount, 1, memory_order_relaxed);
+        }
+        else
+        {
+            pQueue->count++;
+        }
+    }
+    pthread_mutex_unlock(&pQueue->mutex);
+}
+
+int chipResponseQueuePop(CHiPResponseQueue* pQueue, uint8_t* pBuffer, size_t size, size_t* pActual)
+{
+    int ret = CHIP_ERROR_EMPTY;
+
+    pthread_mutex_lock(&pQueue->mutex);
+    {
+        if (pQueue->count > 0)
+        {
+            size_t copyLen = pQueue->pResponses[pQueue->pop].length;
+            if (copyLen > size)
+                copyLen = size;
+            memcpy(pBuffer, pQueue->pResponses[pQueue->pop].content, copyLen);
+            *pActual = copyLen;
+            pQueue->pop = (pQueue->pop + 1) % pQueue->alloc;
+            pQueue->count--;
+            ret = CHIP_ERROR_NONE;
+        }
+    }
+    pthread_mutex_unlock(&pQueue->mutex);
+
+    return ret;
+}
+
+uint32_t chipResponseQueueDepth(CHiPResponseQueue* pQueue)
+{
+    uint32_t count = 0;
+
+    pthread_mutex_lock(&pQueue->mutex);
+        count = pQueue->count;
+    pthread_mutex_unlock(&pQueue->mutex);
+    return count;
+}
+
+uint32_t chipResponseQueueDropCount(CHiPResponseQueue* pQueue)
+{
+    return atomic_load_explicit(&pQueue->dropCount, memory_order_relaxed);
+}
@@ -0,0 +1,391 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Sound and action duration tables and the sequencer which plays them back to back. */
+#include <assert.h>
+#include <stdlib.h>
+#include "chip-clock.h"
+#include "chip-sequencer.h"
+
+
+#define SOUND_COUNT     (CHIP_SOUND_CHIO_DOG_EMO_RESPONSE_2A + 1)
+#define ACTION_COUNT    (CHIP_ACTION_FACE_DOWN_FOR_CONTROLLING_CHIPPIES + 1)
+
+
+struct CHiPSequencer
+{
+    CHiPTimeline* pTimeline;
+    uint64_t      duration;
+};
+
+
+// Nominal length of each clip in microseconds.
+static uint32_t g_soundDurations[SOUND_COUNT] =
+{
+    [CHIP_SOUND_BARK_X1_ANGRY_A34]                 =   600000,
+    [CHIP_SOUND_BARK_X1_CURIOUS_PLAYFUL_HAPPY_A34] =   600000,
+    [CHIP_SOUND_BARK_X1_NEUTRAL_A34]               =   600000,
+    [CHIP_SOUND_BARK_X1_SCARED_A34]                =   600000,
+    [CHIP_SOUND_BARK_X2_ANGRY_A34]                 =  1000000,
+    [CHIP_SOUND_BARK_X2_CURIOUS_PLAYFUL_HAPPY_A34] =  1000000,
+    [CHIP_SOUND_BARK_X2_NEUTRAL_A34]               =  1000000,
+    [CHIP_SOUND_BARK_X2_SCARED_A34]                =  1000000,
+    [CHIP_SOUND_CRY_A34]                           =  2000000,
+    [CHIP_SOUND_GROWL_A_A34]                       =  1500000,
+    [CHIP_SOUND_GROWL_B_A34]                       =  1500000,
+    [CHIP_SOUND_GROWL_C_A34]                       =  1500000,
+    [CHIP_SOUND_HUH_LONG_A34]                      =  1000000,
+    [CHIP_SOUND_HUH_SHORT_A34]                     =   600000,
+    [CHIP_SOUND_LICK_1_A34]                        =   800000,
+    [CHIP_SOUND_LICK_2_A34]                        =   800000,
+    [CHIP_SOUND_PANT_FAST_A34]                     =  1500000,
+    [CHIP_SOUND_PANT_MEDIUM_A34]                   =  2000000,
+    [CHIP_SOUND_PANT_SLOW_A34]                     =  2500000,
+    [CHIP_SOUND_SNIFF_1_A34]                       =  1000000,
+    [CHIP_SOUND_SNIFF_2_A34]                       =  1000000,
+    [CHIP_SOUND_YAWN_A_A34]                        =  2000000,
+    [CHIP_SOUND_YAWN_B_A34]                        =  2000000,
+    [CHIP_SOUND_ONE_A34]                           =   600000,
+    [CHIP_SOUND_TWO_A34]                           =   600000,
+    [CHIP_SOUND_THREE_A34]                         =   600000,
+    [CHIP_SOUND_FOUR_A34]                          =   600000,
+    [CHIP_SOUND_FIVE_A34]                          =   600000,
+    [CHIP_SOUND_SIX_A34]                           =   600000,
+    [CHIP_SOUND_SEVEN_A34]                         =   600000,
+    [CHIP_SOUND_EIGHT_A34]                         =   600000,
+    [CHIP_SOUND_NIGHT_A34]                         =   600000,
+    [CHIP_SOUND_TEN_A34]                           =   600000,
+    [CHIP_SOUND_ZERO_A34]                          =   600000,
+    [CHIP_SOUND_CHIP_DOG_COUGH_2_A34]              =  1000000,
+    [CHIP_SOUND_CHIP_DOG_CRY_2_A34]                =  2000000,
+    [CHIP_SOUND_CHIP_DOG_CRY_3_A34]                =  2000000,
+    [CHIP_SOUND_CHIP_DOG_CRY_4_A34]                =  2000000,
+    [CHIP_SOUND_CHIP_DOG_CRY_5_A34]                =  2000000,
+    [CHIP_SOUND_CHIP_DOG_EMO_CURIOUS_1_A34]        =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_CURIOUS_2_A34]        =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_CURIOUS_3_A34]        =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_EXCITED_1_A34]        =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_EXCITED_2_A34]        =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_EXCITED_3_A34]        =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_LAZY_1_A34]           =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_LAZY_2_A34]           =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_LAZY_3_A34]           =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_RESPONSE_1_A34]       =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_RESPONSE_2_A34]       =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_RESPONSE_3_A34]       =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_SCARED_YIP_2_A34]     =   800000,
+    [CHIP_SOUND_CHIP_DOG_EMO_SCARED_YIP_3_A34]     =   800000,
+    [CHIP_SOUND_CHIP_DOG_FART_1_A34]               =  1200000,
+    [CHIP_SOUND_CHIP_DOG_FART_2_A34]               =  1200000,
+    [CHIP_SOUND_CHIP_DOG_FART_3_A34]               =  1200000,
+    [CHIP_SOUND_CHIP_DOG_GROWL_1_A34]              =  1500000,
+    [CHIP_SOUND_CHIP_DOG_GROWL_2_A34]              =  1500000,
+    [CHIP_SOUND_CHIP_DOG_GROWL_4_A34]              =  1500000,
+    [CHIP_SOUND_CHIP_DOG_GROWL_5_A34]              =  1500000,
+    [CHIP_SOUND_CHIP_DOG_HICCUP_1_A34]             =   800000,
+    [CHIP_SOUND_CHIP_DOG_HICCUP_2_A34]             =   800000,
+    [CHIP_SOUND_CHIP_DOG_HOWL_1_A34]               =  3000000,
+    [CHIP_SOUND_CHIP_DOG_HOWL_2_A34]               =  3000000,
+    [CHIP_SOUND_CHIP_DOG_HOWL_3_A34]               =  3000000,
+    [CHIP_SOUND_CHIP_DOG_HOWL_4_A34]               =  3000000,
+    [CHIP_SOUND_CHIP_DOG_HOWL_5_A34]               =  3000000,
+    [CHIP_SOUND_CHIP_DOG_LICK_2_A34]               =   800000,
+    [CHIP_SOUND_CHIP_DOG_LICK_3_A34]               =   800000,
+    [CHIP_SOUND_CHIP_DOG_LOWBATTERY_1_A34]         =  2000000,
+    [CHIP_SOUND_CHIP_DOG_LOWBATTERY_2_A34]         =  2000000,
+    [CHIP_SOUND_CHIP_DOG_MUFFLE_1_A34]             =  1200000,
+    [CHIP_SOUND_CHIP_DOG_MUFFLE_2_A34]             =  1200000,
+    [CHIP_SOUND_CHIP_DOG_MUFFLE_3_A34]             =  1200000,
+    [CHIP_SOUND_CHIP_DOG_PANT_1_A34]               =  1500000,
+    [CHIP_SOUND_CHIP_DOG_PANT_2_A34]               =  1500000,
+    [CHIP_SOUND_CHIP_DOG_PANT_3_A34]               =  1500000,
+    [CHIP_SOUND_CHIP_DOG_PANT_4_A34]               =  1500000,
+    [CHIP_SOUND_CHIP_DOG_PANT_5_L_A34]             =  3000000,
+    [CHIP_SOUND_CHIP_DOG_SMOOCH_1_A34]             =   800000,
+    [CHIP_SOUND_CHIP_DOG_SMOOCH_2_A34]             =   800000,
+    [CHIP_SOUND_CHIP_DOG_SMOOCH_3_A34]             =   800000,
+    [CHIP_SOUND_CHIP_DOG_SNEEZE_1_A34]             =  1200000,
+    [CHIP_SOUND_CHIP_DOG_SNEEZE_2_A34]             =  1200000,
+    [CHIP_SOUND_CHIP_DOG_SNEEZE_3_A34]             =  1200000,
+    [CHIP_SOUND_CHIP_DOG_SNIFF_1_A34]              =  1000000,
+    [CHIP_SOUND_CHIP_DOG_SNIFF_2_A34]              =  1000000,
+    [CHIP_SOUND_CHIP_DOG_SNIFF_4_A34]              =  1000000,
+    [CHIP_SOUND_CHIP_DOG_SNORE_1_A34]              =  3000000,
+    [CHIP_SOUND_CHIP_DOG_SNORE_2_A34]              =  3000000,
+    [CHIP_SOUND_CHIP_DOG_SPECIAL_1_A34]            =  2000000,
+    [CHIP_SOUND_CHIP_SING_DO1_SHORT_A34]           =   500000,
+    [CHIP_SOUND_CHIP_SING_DO2_SHORT_A34]           =   500000,
+    [CHIP_SOUND_CHIP_SING_FA_SHORT_A34]            =   500000,
+    [CHIP_SOUND_CHIP_SING_LA_SHORT_A34]            =   500000,
+    [CHIP_SOUND_CHIP_SING_MI_SHORT_A34]            =   500000,
+    [CHIP_SOUND_CHIP_SING_RE_SHORT_A34]            =   500000,
+    [CHIP_SOUND_CHIP_SING_SO_SHORT_A34]            =   500000,
+    [CHIP_SOUND_CHIP_SING_TI_SHORT_A34]            =   500000,
+    [CHIP_SOUND_CHIP_DOG_BARK_3_A34]               =   800000,
+    [CHIP_SOUND_CHIP_DOG_BARK_4_A34]               =   800000,
+    [CHIP_SOUND_CHIP_DOG_BARK_5_A34]               =   800000,
+    [CHIP_SOUND_CHIP_DOG_BARK_MULTI_3_A34]         =  1500000,
+    [CHIP_SOUND_CHIP_DOG_BARK_MULTI_4_A34]         =  1500000,
+    [CHIP_SOUND_CHIP_DOG_BARK_MULTI_5_A34]         =  1500000,
+    [CHIP_SOUND_CHIP_DOG_BURP_1_A34]               =  1000000,
+    [CHIP_SOUND_CHIP_DOG_BURP_2_A34]               =  1000000,
+    [CHIP_SOUND_CHIP_DOG_COUGH_1_A34]              =  1000000,
+    [CHIP_SOUND_CHIO_DOG_EMO_RESPONSE_3A]          =  1500000,
+    [CHIP_SOUND_CHIP_DEMO_MUSIC_2]                 = 20000000,
+    [CHIP_SOUND_CHIP_DEMO_MUSIC_3]                 = 20000000,
+    [CHIP_SOUND_CHIP_DOG_BARK_1]                   =   800000,
+    [CHIP_SOUND_CHIP_DOG_BARK_2]                   =   800000,
+    [CHIP_SOUND_CHIP_DOG_BARK_MULTI_1]             =  1500000,
+    [CHIP_SOUND_CHIP_DOG_BARK_MULTI_2]             =  1500000,
+    [CHIP_SOUND_CHIP_DOG_CRY_1]                    =  2000000,
+    [CHIP_SOUND_CHIP_DOG_EMO_CURIOUS_2A]           =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_EXCITED_3A]           =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_LAZY_1A]              =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_LAZY_2A]              =  1500000,
+    [CHIP_SOUND_CHIP_DOG_EMO_LAZY_3A]              =  1500000,
+    [CHIP_SOUND_CHIP_DOG_GROWL_3]                  =  1500000,
+    [CHIP_SOUND_CHIP_DOG_HOWL_1A]                  =  3000000,
+    [CHIP_SOUND_CHIP_DOG_HOWL_3A]                  =  3000000,
+    [CHIP_SOUND_CHIP_DOG_HOWL_4A]                  =  3000000,
+    [CHIP_SOUND_CHIP_DOG_HOWL_5A]                  =  3000000,
+    [CHIP_SOUND_CHIP_DOG_LICK_1]                   =   800000,
+    [CHIP_SOUND_CHIP_DOG_LOWBATTERY_1A]            =  2000000,
+    [CHIP_SOUND_CHIP_DOG_LOWBATTERY_2A]            =  2000000,
+    [CHIP_SOUND_CHIP_DOG_MUFFLE_1A]                =  1200000,
+    [CHIP_SOUND_CHIP_DOG_SMOOCH_3A]                =   800000,
+    [CHIP_SOUND_CHIP_DOG_SNEEZE_1A]                =  1200000,
+    [CHIP_SOUND_CHIP_DOG_SNIFF_3]                  =  1000000,
+    [CHIP_SOUND_CHIP_DOG_SNIFF_4A]                 =  1000000,
+    [CHIP_SOUND_CHIP_MUSIC_DEMO_1]                 = 30000000,
+    [CHIP_SOUND_CHIO_DOG_EMO_RESPONSE_1A]          =  1500000,
+    [CHIP_SOUND_CHIO_DOG_EMO_RESPONSE_2A]          =  1500000,
+};
+
+// Nominal length of each action in microseconds.  Actions which switch the robot into a mode that lasts until another
+// action is sent are left at 0.
+static uint32_t g_actionDurations[ACTION_COUNT] =
+{
+    [CHIP_ACTION_RESET]                              =  2000000,
+    [CHIP_ACTION_SIT]                                =  3000000,
+    [CHIP_ACTION_LIE_DOWN]                           =  4000000,
+    [CHIP_ACTION_ALL_IDLE_MODE]                      =        0,
+    [CHIP_ACTION_DANCE]                              = 15000000,
+    [CHIP_ACTION_VR_TRAINING1]                       =  5000000,
+    [CHIP_ACTION_VR_TRAINING2]                       =  5000000,
+    [CHIP_ACTION_RESET2]                             =  2000000,
+    [CHIP_ACTION_JUMP]                               =  3000000,
+    [CHIP_ACTION_YOGA]                               =  8000000,
+    [CHIP_ACTION_WATCH_COME]                         =        0,
+    [CHIP_ACTION_WATCH_FOLLOW]                       =        0,
+    [CHIP_ACTION_WATCH_FETCH]                        =        0,
+    [CHIP_ACTION_BALL_TRACKING]                      =        0,
+    [CHIP_ACTION_BALL_SOCCER]                        =        0,
+    [CHIP_ACTION_BASE]                               =        0,
+    [CHIP_ACTION_DANCE_BASE]                         = 15000000,
+    [CHIP_ACTION_STOP_OR_STAND_FROM_BASE]            =  2000000,
+    [CHIP_ACTION_GUARD_MODE]                         =        0,
+    [CHIP_ACTION_FREE_ROAM]                          =        0,
+    [CHIP_ACTION_FACE_DOWN_FOR_CONTROLLING_CHIPPIES] =        0,
+};
+
+
+// Forward Declarations.
+static int isValidSound(CHiPSoundIndex sound);
+static int isValidAction(CHiPAction action);
+static int waitForEnd(int result, uint64_t startTime, uint32_t duration);
+
+
+
+uint32_t chipGetSoundDuration(CHiPSoundIndex sound)
+{
+    if (!isValidSound(sound))
+        return 0;
+    return g_soundDurations[sound];
+}
+
+uint32_t chipGetActionDuration(CHiPAction action)
+{
+    if (!isValidAction(action))
+        return 0;
+    return g_actionDurations[action];
+}
+
+int chipSetSoundDuration(CHiPSoundIndex sound, uint32_t durationMicroseconds)
+{
+    if (!isValidSound(sound))
+        return CHIP_ERROR_PARAM;
+    g_soundDurations[sound] = durationMicroseconds;
+    return CHIP_ERROR_NONE;
+}
+
+int chipSetActionDuration(CHiPAction action, uint32_t durationMicroseconds)
+{
+    if (!isValidAction(action))
+        return CHIP_ERROR_PARAM;
+    g_actionDurations[action] = durationMicroseconds;
+    return CHIP_ERROR_NONE;
+}
+
+static int isValidSound(CHiPSoundIndex sound)
+{
+    return sound >= CHIP_SOUND_BARK_X1_ANGRY_A34 && sound < SOUND_COUNT;
+}
+
+static int isValidAction(CHiPAction action)
+{
+    return action >= CHIP_ACTION_RESET && action < ACTION_COUNT;
+}
+
+int chipPlaySoundAndWait(CHiP* pCHiP, CHiPSoundIndex sound)
+{
+    uint32_t duration = chipGetSoundDuration(sound);
+    uint64_t startTime;
+
+    assert( pCHiP );
+
+    if (duration == 0)
+        return CHIP_ERROR_PARAM;
+    startTime = chipClockGetMicroseconds(chipClockGetDefault());
+    return waitForEnd(chipPlaySound(pCHiP, sound), startTime, duration);
+}
+
+int chipActionAndWait(CHiP* pCHiP, CHiPAction action)
+{
+    uint32_t duration = chipGetActionDuration(action);
+    uint64_t startTime;
+
+    assert( pCHiP );
+
+    if (duration == 0)
+        return CHIP_ERROR_PARAM;
+    startTime = chipClockGetMicroseconds(chipClockGetDefault());
+    return waitForEnd(chipAction(pCHiP, action), startTime, duration);
+}
+
+static int waitForEnd(int result, uint64_t startTime, uint32_t duration)
+{
+    // The wait is measured from before the request was sent so that time spent sending it isn't added on top.
+    if (result)
+        return result;
+    chipClockSleepUntil(chipClockGetDefault(), startTime + duration);
+    return CHIP_ERROR_NONE;
+}
+
+CHiPSequencer* chipSequencerCreate(void)
+{
+    CHiPSequencer* pSequencer = NULL;
+
+    pSequencer = calloc(1, sizeof(*pSequencer));
+    if (!pSequencer)
+        goto Error;
+    pSequencer->pTimeline = chipTimelineCreate(0);
+    if (!pSequencer->pTimeline)
+        goto Error;
+
+    return pSequencer;
+
+Error:
+    chipSequencerFree(pSequencer);
+    return NULL;
+}
+
+void chipSequencerFree(CHiPSequencer* pSequencer)
+{
+    if (!pSequencer)
+        return;
+    chipTimelineFree(pSequencer->pTimeline);
+    free(pSequencer);
+}
+
+void chipSequencerClear(CHiPSequencer* pSequencer)
+{
+    assert( pSequencer );
+
+    chipTimelineClear(pSequencer->pTimeline);
+    pSequencer->duration = 0;
+}
+
+int chipSequencerAddSound(CHiPSequencer* pSequencer, CHiPSoundIndex sound)
+{
+    uint8_t  request[CHIP_CMD_PLAY_SOUND_REQUEST_LEN];
+    uint32_t duration = chipGetSoundDuration(sound);
+    int      result;
+
+    assert( pSequencer );
+
+    if (duration == 0)
+        return CHIP_ERROR_PARAM;
+    request[0] = CHIP_CMD_PLAY_SOUND;
+    request[1] = sound;
+    request[2] = 0;
+    result = chipTimelineAddRequest(pSequencer->pTimeline, pSequencer->duration, request, sizeof(request));
+    if (result)
+        return result;
+    pSequencer->duration += duration;
+
+    return CHIP_ERROR_NONE;
+}
+
+int chipSequencerAddAction(CHiPSequencer* pSequencer, CHiPAction action)
+{
+    uint8_t  request[CHIP_CMD_ACTION_REQUEST_LEN];
+    uint32_t duration = chipGetActionDuration(action);
+    int      result;
+
+    assert( pSequencer );
+
+    if (duration == 0)
+        return CHIP_ERROR_PARAM;
+    request[0] = CHIP_CMD_ACTION;
+    request[1] = action;
+    result = chipTimelineAddRequest(pSequencer->pTimeline, pSequencer->duration, request, sizeof(request));
+    if (result)
+        return result;
+    pSequencer->duration += duration;
+
+    return CHIP_ERROR_NONE;
+}
+
+int chipSequencerAddPause(CHiPSequencer* pSequencer, uint32_t durationMicroseconds)
+{
+    assert( pSequencer );
+
+    pSequencer->duration += durationMicroseconds;
+    return CHIP_ERROR_NONE;
+}
+
+uint64_t chipSequencerGetDuration(const CHiPSequencer* pSequencer)
+{
+    assert( pSequencer );
+    return pSequencer->duration;
+}
+
+int chipSequencerRun(CHiPSequencer* pSequencer, CHiP* pCHiP, CHiPTimelineReport* pReport)
+{
+    CHiPClock* pClock = chipClockGetDefault();
+    uint64_t   startTime;
+    int        result;
+
+    assert( pSequencer );
+    assert( pCHiP );
+
+    // The timeline returns as soon as the last entry starts so wait out the rest of it, and any trailing pause, here.
+    startTime = chipClockGetMicroseconds(pClock);
+    result = chipTimelineRun(pSequencer->pTimeline, pCHiP, pReport);
+    if (result)
+        return result;
+    chipClockSleepUntil(pClock, startTime + pSequencer->duration);
+
+    return CHIP_ERROR_NONE;
+}
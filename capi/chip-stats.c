@@ -0,0 +1,190 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Lock free recording of the CHiP C API statistics returned by chipGetStats(). */
+#include <assert.h>
+#include <string.h>
+#include "chip-stats.h"
+
+
+// The latency histograms are log-linear: each power of 2 range is split into this many linearly spaced buckets.
+#define CHIP_STATS_SUB_BUCKET_BITS  2
+#define CHIP_STATS_SUB_BUCKETS      (1 << CHIP_STATS_SUB_BUCKET_BITS)
+
+
+static size_t bucketFromMicroseconds(uint64_t microseconds);
+static uint64_t bucketLowerLimit(size_t bucket);
+static CHiPCommandStatsRecorder* findCommandRecorder(CHiPStatsRecorder* pRecorder, uint8_t command);
+static void atomicMax32(_Atomic uint32_t* pValue, uint32_t newValue);
+
+
+void chipStatsRecordWrite(CHiPStatsRecorder* pRecorder, size_t byteCount)
+{
+    atomic_fetch_add_explicit(&pRecorder->writes, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pRecorder->bytesSent, byteCount, memory_order_relaxed);
+}
+
+void chipStatsRecordRead(CHiPStatsRecorder* pRecorder, size_t byteCount)
+{
+    atomic_fetch_add_explicit(&pRecorder->bytesReceived, byteCount, memory_order_relaxed);
+}
+
+void chipStatsRecordRoundTrip(CHiPStatsRecorder* pRecorder, uint8_t command, uint64_t microseconds)
+{
+    CHiPCommandStatsRecorder* pCommand = findCommandRecorder(pRecorder, command);
+    if (!pCommand)
+        return;
+
+    atomic_fetch_add_explicit(&pCommand->histogram[bucketFromMicroseconds(microseconds)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pCommand->totalMicroseconds, microseconds, memory_order_relaxed);
+    atomicMax32(&pCommand->maxMicroseconds, microseconds > UINT32_MAX ? UINT32_MAX : (uint32_t)microseconds);
+    atomic_fetch_add_explicit(&pCommand->count, 1, memory_order_release);
+}
+
+static CHiPCommandStatsRecorder* findCommandRecorder(CHiPStatsRecorder* pRecorder, uint8_t command)
+{
+    uint8_t slot = atomic_load_explicit(&pRecorder->commandToSlot[command], memory_order_acquire);
+    if (slot)
+        return &pRecorder->commands[slot - 1];
+
+    // First time this command has been seen so claim a free slot for it.  If another thread races us for the same
+    // command then the loser's slot is simply left unused.
+    uint32_t newSlot = atomic_fetch_add_explicit(&pRecorder->commandsUsed, 1, memory_order_relaxed);
+    if (newSlot >= CHIP_STATS_MAX_COMMANDS)
+        return NULL;
+    atomic_store_explicit(&pRecorder->commands[newSlot].command, command, memory_order_relaxed);
+
+    uint8_t expected = 0;
+    if (atomic_compare_exchange_strong_explicit(&pRecorder->commandToSlot[command], &expected, newSlot + 1,
+                                                memory_order_acq_rel, memory_order_acquire))
+    {
+        return &pRecorder->commands[newSlot];
+    }
+    return &pRecorder->commands[expected - 1];
+}
+
+static void atomicMax32(_Atomic uint32_t* pValue, uint32_t newValue)
+{
+    uint32_t currValue = atomic_load_explicit(pValue, memory_order_relaxed);
+    while (newValue > currValue &&
+           !atomic_compare_exchange_weak_explicit(pValue, &currValue, newValue,
+                                                  memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+}
+
+void chipStatsRecordBadResponse(CHiPStatsRecorder* pRecorder)
+{
+    atomic_fetch_add_explicit(&pRecorder->badResponses, 1, memory_order_relaxed);
+}
+
+void chipStatsRecordCoalesced(CHiPStatsRecorder* pRecorder)
+{
+    atomic_fetch_add_explicit(&pRecorder->coalesced, 1, memory_order_relaxed);
+}
+
+void chipStatsRecordDebounced(CHiPStatsRecorder* pRecorder)
+{
+    atomic_fetch_add_explicit(&pRecorder->debounced, 1, memory_order_relaxed);
+}
+
+void chipStatsSnapshot(CHiPStatsRecorder* pRecorder, CHiPStats* pStats)
+{
+    size_t slotCount = atomic_load_explicit(&pRecorder->commandsUsed, memory_order_relaxed);
+    if (slotCount > CHIP_STATS_MAX_COMMANDS)
+        slotCount = CHIP_STATS_MAX_COMMANDS;
+
+    memset(pStats, 0, sizeof(*pStats));
+    pStats->writes = atomic_load_explicit(&pRecorder->writes, memory_order_relaxed);
+    pStats->bytesSent = atomic_load_explicit(&pRecorder->bytesSent, memory_order_relaxed);
+    pStats->bytesReceived = atomic_load_explicit(&pRecorder->bytesReceived, memory_order_relaxed);
+    pStats->badResponses = atomic_load_explicit(&pRecorder->badResponses, memory_order_relaxed);
+    pStats->coalesced = atomic_load_explicit(&pRecorder->coalesced, memory_order_relaxed);
+    pStats->debounced = atomic_load_explicit(&pRecorder->debounced, memory_order_relaxed);
+
+    for (size_t slot = 0 ; slot < slotCount ; slot++)
+    {
+        CHiPCommandStatsRecorder* pSrc = &pRecorder->commands[slot];
+        CHiPCommandStats*         pDest = &pStats->commands[pStats->commandCount];
+
+        pDest->count = atomic_load_explicit(&pSrc->count, memory_order_acquire);
+        if (pDest->count == 0)
+            continue;
+        pDest->command = atomic_load_explicit(&pSrc->command, memory_order_relaxed);
+        pDest->totalMicroseconds = atomic_load_explicit(&pSrc->totalMicroseconds, memory_order_relaxed);
+        pDest->maxMicroseconds = atomic_load_explicit(&pSrc->maxMicroseconds, memory_order_relaxed);
+        for (size_t i = 0 ; i < CHIP_STATS_HISTOGRAM_BUCKETS ; i++)
+            pDest->histogram[i] = atomic_load_explicit(&pSrc->histogram[i], memory_order_relaxed);
+        pStats->commandCount++;
+    }
+}
+
+uint32_t chipStatsGetBucketLimit(size_t bucket)
+{
+    assert( bucket < CHIP_STATS_HISTOGRAM_BUCKETS );
+
+    // The last bucket also collects all samples that are too large for the histogram.
+    if (bucket == CHIP_STATS_HISTOGRAM_BUCKETS - 1)
+        return UINT32_MAX;
+    return (uint32_t)(bucketLowerLimit(bucket + 1) - 1);
+}
+
+uint32_t chipStatsGetPercentile(const CHiPCommandStats* pCommandStats, float percentile)
+{
+    assert( pCommandStats );
+    assert( percentile >= 0.0f && percentile <= 1.0f );
+
+    // Use the nearest-rank method: the smallest sample with at least percentile of the samples at or below it.
+    float    rank = percentile * pCommandStats->count;
+    uint64_t threshold = (uint64_t)rank;
+    uint64_t cumulative = 0;
+
+    if (threshold < rank || threshold == 0)
+        threshold++;
+    for (size_t bucket = 0 ; bucket < CHIP_STATS_HISTOGRAM_BUCKETS ; bucket++)
+    {
+        cumulative += pCommandStats->histogram[bucket];
+        if (cumulative >= threshold)
+        {
+            uint32_t limit = chipStatsGetBucketLimit(bucket);
+            return limit < pCommandStats->maxMicroseconds ? limit : pCommandStats->maxMicroseconds;
+        }
+    }
+    return pCommandStats->maxMicroseconds;
+}
+
+// Values below CHIP_STATS_SUB_BUCKETS get a bucket each.  Larger values are placed in one of CHIP_STATS_SUB_BUCKETS
+// linear buckets within their power of 2 range.
+static size_t bucketFromMicroseconds(uint64_t microseconds)
+{
+    if (microseconds < CHIP_STATS_SUB_BUCKETS)
+        return (size_t)microseconds;
+
+    size_t msb = 63 - __builtin_clzll(microseconds);
+    size_t sub = (microseconds >> (msb - CHIP_STATS_SUB_BUCKET_BITS)) & (CHIP_STATS_SUB_BUCKETS - 1);
+    size_t bucket = (msb - CHIP_STATS_SUB_BUCKET_BITS + 1) * CHIP_STATS_SUB_BUCKETS + sub;
+    if (bucket >= CHIP_STATS_HISTOGRAM_BUCKETS)
+        bucket = CHIP_STATS_HISTOGRAM_BUCKETS - 1;
+    return bucket;
+}
+
+static uint64_t bucketLowerLimit(size_t bucket)
+{
+    if (bucket < CHIP_STATS_SUB_BUCKETS)
+        return bucket;
+
+    size_t msb = bucket / CHIP_STATS_SUB_BUCKETS + CHIP_STATS_SUB_BUCKET_BITS - 1;
+    size_t sub = bucket % CHIP_STATS_SUB_BUCKETS;
+    return (uint64_t)(CHIP_STATS_SUB_BUCKETS + sub) << (msb - CHIP_STATS_SUB_BUCKET_BITS);
+}
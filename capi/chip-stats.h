@@ -0,0 +1,57 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Internal interface used by the CHiP C API to record the statistics returned by chipGetStats().
+   All of the chipStatsRecord*() functions are lock free so that they can be called from any thread on the hot path.
+*/
+#ifndef CHIP_STATS_H_
+#define CHIP_STATS_H_
+
+#include <stdatomic.h>
+#include "chip.h"
+
+
+typedef struct CHiPCommandStatsRecorder
+{
+    _Atomic uint8_t  command;
+    _Atomic uint32_t count;
+    _Atomic uint64_t totalMicroseconds;
+    _Atomic uint32_t maxMicroseconds;
+    _Atomic uint32_t histogram[CHIP_STATS_HISTOGRAM_BUCKETS];
+} CHiPCommandStatsRecorder;
+
+typedef struct CHiPStatsRecorder
+{
+    _Atomic uint32_t         writes;
+    _Atomic uint64_t         bytesSent;
+    _Atomic uint64_t         bytesReceived;
+    _Atomic uint32_t         badResponses;
+    _Atomic uint32_t         coalesced;
+    _Atomic uint32_t         debounced;
+    _Atomic uint32_t         commandsUsed;
+    // Maps a command code to its index in commands[] + 1.  0 indicates that no slot has been claimed yet.
+    _Atomic uint8_t          commandToSlot[256];
+    CHiPCommandStatsRecorder commands[CHIP_STATS_MAX_COMMANDS];
+} CHiPStatsRecorder;
+
+
+void chipStatsRecordWrite(CHiPStatsRecorder* pRecorder, size_t byteCount);
+void chipStatsRecordRead(CHiPStatsRecorder* pRecorder, size_t byteCount);
+void chipStatsRecordRoundTrip(CHiPStatsRecorder* pRecorder, uint8_t command, uint64_t microseconds);
+void chipStatsRecordBadResponse(CHiPStatsRecorder* pRecorder);
+void chipStatsRecordCoalesced(CHiPStatsRecorder* pRecorder);
+void chipStatsRecordDebounced(CHiPStatsRecorder* pRecorder);
+void chipStatsSnapshot(CHiPStatsRecorder* pRecorder, CHiPStats* pStats);
+
+#endif // CHIP_STATS_H_
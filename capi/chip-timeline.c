@@ -0,0 +1,281 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Timeline scheduler which dispatches commands at absolute deadlines and records how late each one was. */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip-clock.h"
+#include "chip-timeline.h"
+
+
+// Lateness recorded for commands which weren't reached before the run stopped.
+#define NOT_DISPATCHED  UINT32_MAX
+
+
+typedef struct TimelineEntry
+{
+    uint64_t             offsetMicroseconds;
+    size_t               sequence;              // Order added, to keep commands with the same time in that order.
+    CHiPTimelineFunction pFunction;             // NULL for raw requests.
+    void*                pContext;
+    uint32_t             latenessMicroseconds;
+    uint8_t              requestLength;
+    uint8_t              request[CHIP_REQUEST_MAX_LEN];
+} TimelineEntry;
+
+struct CHiPTimeline
+{
+    TimelineEntry* pEntries;
+    uint32_t*      pLatenesses;                 // Scratch space used to find the percentile when reporting.
+    size_t         entryCount;
+    size_t         entryAlloc;
+    size_t         nextSequence;
+    uint32_t       lateThresholdMicroseconds;
+    int            isSorted;
+};
+
+
+// Forward Declarations.
+static TimelineEntry* addEntry(CHiPTimeline* pTimeline, uint64_t offsetMicroseconds);
+static int            compareEntries(const void* pv1, const void* pv2);
+static int            compareLatenesses(const void* pv1, const void* pv2);
+static void           fillReport(CHiPTimeline* pTimeline, size_t dispatchCount, CHiPTimelineReport* pReport);
+
+
+
+CHiPTimeline* chipTimelineCreate(uint32_t lateThresholdMicroseconds)
+{
+    CHiPTimeline* pTimeline = NULL;
+
+    pTimeline = calloc(1, sizeof(*pTimeline));
+    if (!pTimeline)
+        return NULL;
+    pTimeline->lateThresholdMicroseconds = lateThresholdMicroseconds;
+    pTimeline->isSorted = 1;
+    return pTimeline;
+}
+
+void chipTimelineFree(CHiPTimeline* pTimeline)
+{
+    if (!pTimeline)
+        return;
+    free(pTimeline->pEntries);
+    free(pTimeline->pLatenesses);
+    free(pTimeline);
+}
+
+void chipTimelineClear(CHiPTimeline* pTimeline)
+{
+    assert( pTimeline );
+
+    pTimeline->entryCount = 0;
+    pTimeline->nextSequence = 0;
+    pTimeline->isSorted = 1;
+}
+
+int chipTimelineAddRequest(CHiPTimeline* pTimeline, uint64_t offsetMicroseconds,
+                           const uint8_t* pRequest, size_t requestLength)
+{
+    TimelineEntry* pEntry;
+
+    assert( pTimeline );
+    assert( pRequest );
+
+    if (requestLength == 0 || requestLength > CHIP_REQUEST_MAX_LEN)
+        return CHIP_ERROR_PARAM;
+    pEntry = addEntry(pTimeline, offsetMicroseconds);
+    if (!pEntry)
+        return CHIP_ERROR_MEMORY;
+    pEntry->requestLength = requestLength;
+    memcpy(pEntry->request, pRequest, requestLength);
+
+    return CHIP_ERROR_NONE;
+}
+
+int chipTimelineAddCall(CHiPTimeline* pTimeline, uint64_t offsetMicroseconds,
+                        CHiPTimelineFunction pFunction, void* pContext)
+{
+    TimelineEntry* pEntry;
+
+    assert( pTimeline );
+    assert( pFunction );
+
+    pEntry = addEntry(pTimeline, offsetMicroseconds);
+    if (!pEntry)
+        return CHIP_ERROR_MEMORY;
+    pEntry->pFunction = pFunction;
+    pEntry->pContext = pContext;
+
+    return CHIP_ERROR_NONE;
+}
+
+static TimelineEntry* addEntry(CHiPTimeline* pTimeline, uint64_t offsetMicroseconds)
+{
+    TimelineEntry* pEntry;
+
+    if (pTimeline->entryCount == pTimeline->entryAlloc)
+    {
+        size_t         newAlloc = pTimeline->entryAlloc ? pTimeline->entryAlloc * 2 : 64;
+        TimelineEntry* pEntries = realloc(pTimeline->pEntries, newAlloc * sizeof(*pEntries));
+        uint32_t*      pLatenesses;
+
+        if (!pEntries)
+            return NULL;
+        pTimeline->pEntries = pEntries;
+        pLatenesses = realloc(pTimeline->pLatenesses, newAlloc * sizeof(*pLatenesses));
+        if (!pLatenesses)
+            return NULL;
+        pTimeline->pLatenesses = pLatenesses;
+        pTimeline->entryAlloc = newAlloc;
+    }
+
+    pEntry = &pTimeline->pEntries[pTimeline->entryCount++];
+    memset(pEntry, 0, sizeof(*pEntry));
+    pEntry->offsetMicroseconds = offsetMicroseconds;
+    pEntry->sequence = pTimeline->nextSequence++;
+    pEntry->latenessMicroseconds = NOT_DISPATCHED;
+    pTimeline->isSorted = 0;
+
+    return pEntry;
+}
+
+size_t chipTimelineGetCount(const CHiPTimeline* pTimeline)
+{
+    assert( pTimeline );
+    return pTimeline->entryCount;
+}
+
+int chipTimelineRun(CHiPTimeline* pTimeline, CHiP* pCHiP, CHiPTimelineReport* pReport)
+{
+    CHiPClock* pClock = chipClockGetDefault();
+    uint64_t   startTime;
+    size_t     i;
+    int        result = CHIP_ERROR_NONE;
+
+    assert( pTimeline );
+    assert( pCHiP );
+
+    if (!pTimeline->isSorted)
+    {
+        qsort(pTimeline->pEntries, pTimeline->entryCount, sizeof(*pTimeline->pEntries), compareEntries);
+        pTimeline->isSorted = 1;
+    }
+    for (i = 0 ; i < pTimeline->entryCount ; i++)
+        pTimeline->pEntries[i].latenessMicroseconds = NOT_DISPATCHED;
+
+    // Every deadline is relative to this one reading of the clock so that dispatch costs never accumulate.
+    startTime = chipClockGetMicroseconds(pClock);
+    for (i = 0 ; i < pTimeline->entryCount ; i++)
+    {
+        TimelineEntry* pEntry = &pTimeline->pEntries[i];
+        uint64_t       deadline = startTime + pEntry->offsetMicroseconds;
+        uint64_t       now;
+        uint64_t       lateness;
+
+        chipClockSleepUntil(pClock, deadline);
+        now = chipClockGetMicroseconds(pClock);
+        lateness = now > deadline ? now - deadline : 0;
+        pEntry->latenessMicroseconds = lateness < NOT_DISPATCHED ? lateness : NOT_DISPATCHED - 1;
+
+        if (pEntry->pFunction)
+            result = pEntry->pFunction(pCHiP, pEntry->pContext);
+        else
+            result = chipRawSend(pCHiP, pEntry->request, pEntry->requestLength);
+        if (result)
+        {
+            i++;
+            break;
+        }
+    }
+
+    if (pReport)
+    {
+        fillReport(pTimeline, i, pReport);
+        pReport->durationMicroseconds = chipClockGetMicroseconds(pClock) - startTime;
+    }
+    return result;
+}
+
+static int compareEntries(const void* pv1, const void* pv2)
+{
+    const TimelineEntry* p1 = (const TimelineEntry*)pv1;
+    const TimelineEntry* p2 = (const TimelineEntry*)pv2;
+
+    if (p1->offsetMicroseconds != p2->offsetMicroseconds)
+        return p1->offsetMicroseconds < p2->offsetMicroseconds ? -1 : 1;
+    if (p1->sequence != p2->sequence)
+        return p1->sequence < p2->sequence ? -1 : 1;
+    return 0;
+}
+
+static void fillReport(CHiPTimeline* pTimeline, size_t dispatchCount, CHiPTimelineReport* pReport)
+{
+    uint64_t total = 0;
+    size_t   i;
+
+    memset(pReport, 0, sizeof(*pReport));
+    pReport->commandCount = dispatchCount;
+    if (dispatchCount == 0)
+        return;
+
+    for (i = 0 ; i < dispatchCount ; i++)
+    {
+        uint32_t lateness = pTimeline->pEntries[i].latenessMicroseconds;
+
+        pTimeline->pLatenesses[i] = lateness;
+        total += lateness;
+        if (lateness > pTimeline->lateThresholdMicroseconds)
+            pReport->lateCount++;
+        if (lateness > pReport->maxLatenessMicroseconds)
+        {
+            pReport->maxLatenessMicroseconds = lateness;
+            pReport->maxLatenessIndex = i;
+        }
+    }
+    pReport->meanLatenessMicroseconds = total / dispatchCount;
+
+    qsort(pTimeline->pLatenesses, dispatchCount, sizeof(*pTimeline->pLatenesses), compareLatenesses);
+    pReport->p99LatenessMicroseconds = pTimeline->pLatenesses[(dispatchCount - 1) * 99 / 100];
+}
+
+static int compareLatenesses(const void* pv1, const void* pv2)
+{
+    uint32_t lateness1 = *(const uint32_t*)pv1;
+    uint32_t lateness2 = *(const uint32_t*)pv2;
+
+    if (lateness1 != lateness2)
+        return lateness1 < lateness2 ? -1 : 1;
+    return 0;
+}
+
+int chipTimelineGetLateness(const CHiPTimeline* pTimeline, size_t index,
+                            uint64_t* pOffsetMicroseconds, uint32_t* pLatenessMicroseconds)
+{
+    const TimelineEntry* pEntry;
+
+    assert( pTimeline );
+    assert( pLatenessMicroseconds );
+
+    if (index >= pTimeline->entryCount)
+        return CHIP_ERROR_PARAM;
+    pEntry = &pTimeline->pEntries[index];
+    if (!pTimeline->isSorted || pEntry->latenessMicroseconds == NOT_DISPATCHED)
+        return CHIP_ERROR_EMPTY;
+
+    if (pOffsetMicroseconds)
+        *pOffsetMicroseconds = pEntry->offsetMicroseconds;
+    *pLatenessMicroseconds = pEntry->latenessMicroseconds;
+    return CHIP_ERROR_NONE;
+}
@@ -0,0 +1,246 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Implementation of opt-in request tracing with per-thread ring buffers. */
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include "chip.h"
+#include "chip-trace.h"
+
+
+// The fields are atomic so that chipTraceWriteJson() can read an event while its thread overwrites it.  They are only
+// ever accessed with relaxed ordering which compiles to plain loads and stores.
+typedef struct CHiPTraceEvent
+{
+    _Atomic(const char*) pName;
+    _Atomic uint64_t     startTime;
+    _Atomic uint64_t     endTime;
+    _Atomic uint32_t     requestId;
+} CHiPTraceEvent;
+
+// Each thread records into its own ring so that no locking is required on the recording path.  Only the thread which
+// owns the ring writes to its events and written count.  The rings are linked together so that chipTraceWriteJson()
+// can find all of them.  When a thread exits, its ring goes onto a free list to be picked up by the next thread which
+// records a span, so the number of rings is bounded by the number of threads alive at once.
+typedef struct CHiPTraceRing
+{
+    struct CHiPTraceRing* pNext;
+    struct CHiPTraceRing* pNextFree;
+    uint32_t              threadIndex;
+    size_t                alloc;
+    // Number of events whose writing has started.  chipTraceWriteJson() uses it to detect events overwritten under it.
+    _Atomic uint64_t      started;
+    // Stored with release semantics after each event is filled in so that readers see complete events.
+    _Atomic uint64_t      written;
+    // Value of written when chipTraceClear() was last called.  Kept separately so that clearing never writes to the
+    // count that the owning thread is incrementing.
+    _Atomic uint64_t      cleared;
+    CHiPTraceEvent        events[];
+} CHiPTraceRing;
+
+
+_Atomic int g_chipTraceEnabled;
+
+static pthread_mutex_t              g_ringListMutex = PTHREAD_MUTEX_INITIALIZER;
+static CHiPTraceRing*               g_pRingList;
+static CHiPTraceRing*               g_pFreeRingList;
+static pthread_once_t               g_ringKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t                g_ringKey;
+static uint32_t                     g_ringCount;
+static size_t                       g_eventsPerThread = CHIP_TRACE_DEFAULT_EVENTS_PER_THREAD;
+static _Atomic uint32_t             g_lastRequestId;
+static _Thread_local CHiPTraceRing* t_pRing;
+static _Thread_local uint32_t       t_currentRequestId;
+
+
+static CHiPTraceRing* allocateRingForThisThread(void);
+static void           createRingKey(void);
+static void           freeRingForExitingThread(void* pContext);
+
+
+int chipTraceStart(size_t eventsPerThread)
+{
+    pthread_mutex_lock(&g_ringListMutex);
+        g_eventsPerThread = eventsPerThread ? eventsPerThread : CHIP_TRACE_DEFAULT_EVENTS_PER_THREAD;
+    pthread_mutex_unlock(&g_ringListMutex);
+    atomic_store_explicit(&g_chipTraceEnabled, 1, memory_order_relaxed);
+    return CHIP_ERROR_NONE;
+}
+
+void chipTraceStop(void)
+{
+    atomic_store_explicit(&g_chipTraceEnabled, 0, memory_order_relaxed);
+}
+
+void chipTraceClear(void)
+{
+    pthread_mutex_lock(&g_ringListMutex);
+        for (CHiPTraceRing* pRing = g_pRingList ; pRing ; pRing = pRing->pNext)
+            atomic_store_explicit(&pRing->cleared, atomic_load_explicit(&pRing->written, memory_order_acquire),
+                                  memory_order_relaxed);
+    pthread_mutex_unlock(&g_ringListMutex);
+}
+
+int chipTraceWriteJson(const char* pFilename)
+{
+    FILE*       pFile = NULL;
+    const char* pSeparator = "";
+
+    pFile = fopen(pFilename, "w");
+    if (!pFile)
+        return CHIP_ERROR_PARAM;
+
+    fprintf(pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    pthread_mutex_lock(&g_ringListMutex);
+    for (CHiPTraceRing* pRing = g_pRingList ; pRing ; pRing = pRing->pNext)
+    {
+        uint64_t written = atomic_load_explicit(&pRing->written, memory_order_acquire);
+        uint64_t cleared = atomic_load_explicit(&pRing->cleared, memory_order_relaxed);
+        uint64_t first = written > pRing->alloc ? written - pRing->alloc : 0;
+        if (first < cleared)
+            first = cleared;
+        for (uint64_t i = first ; i < written ; i++)
+        {
+            CHiPTraceEvent* pEvent = &pRing->events[i % pRing->alloc];
+            const char*     pName = atomic_load_explicit(&pEvent->pName, memory_order_relaxed);
+            uint64_t        startTime = atomic_load_explicit(&pEvent->startTime, memory_order_relaxed);
+            uint64_t        endTime = atomic_load_explicit(&pEvent->endTime, memory_order_relaxed);
+            uint32_t        requestId = atomic_load_explicit(&pEvent->requestId, memory_order_relaxed);
+
+            // Skip the event if its thread has since started to overwrite it with event i + alloc.
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&pRing->started, memory_order_relaxed) > i + pRing->alloc)
+                continue;
+            fprintf(pFile, "%s\n{\"name\":\"%s\",\"cat\":\"chip\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                           "\"ts\":%llu,\"dur\":%llu,\"args\":{\"request\":%u}}",
+                    pSeparator, pName, pRing->threadIndex,
+                    (unsigned long long)startTime, (unsigned long long)(endTime - startTime), requestId);
+            pSeparator = ",";
+        }
+    }
+    pthread_mutex_unlock(&g_ringListMutex);
+    fprintf(pFile, "\n]}\n");
+
+    if (fclose(pFile))
+        return CHIP_ERROR_PARAM;
+    return CHIP_ERROR_NONE;
+}
+
+uint64_t chipTraceGetMicroseconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void chipTraceRecord(const char* pName, uint32_t requestId, uint64_t startTime, uint64_t endTime)
+{
+    CHiPTraceRing* pRing = t_pRing;
+
+    if (!pRing)
+    {
+        pRing = allocateRingForThisThread();
+        if (!pRing)
+            return;
+    }
+
+    uint64_t        written = atomic_load_explicit(&pRing->written, memory_order_relaxed);
+    CHiPTraceEvent* pEvent = &pRing->events[written % pRing->alloc];
+
+    // Pairs with the fence in chipTraceWriteJson() so that a reader which sees any of these stores also sees the
+    // update to started.
+    atomic_store_explicit(&pRing->started, written + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&pEvent->pName, pName, memory_order_relaxed);
+    atomic_store_explicit(&pEvent->startTime, startTime, memory_order_relaxed);
+    atomic_store_explicit(&pEvent->endTime, endTime, memory_order_relaxed);
+    atomic_store_explicit(&pEvent->requestId, requestId, memory_order_relaxed);
+    atomic_store_explicit(&pRing->written, written + 1, memory_order_release);
+}
+
+static CHiPTraceRing* allocateRingForThisThread(void)
+{
+    CHiPTraceRing* pRing = NULL;
+
+    if (pthread_once(&g_ringKeyOnce, createRingKey))
+        return NULL;
+
+    pthread_mutex_lock(&g_ringListMutex);
+    {
+        // A recycled ring keeps the spans of the thread which exited, and its size, so they still show up in the dump.
+        pRing = g_pFreeRingList;
+        if (pRing)
+        {
+            g_pFreeRingList = pRing->pNextFree;
+        }
+        else
+        {
+            pRing = malloc(sizeof(*pRing) + g_eventsPerThread * sizeof(pRing->events[0]));
+            if (pRing)
+            {
+                pRing->alloc = g_eventsPerThread;
+                atomic_init(&pRing->started, 0);
+                atomic_init(&pRing->written, 0);
+                atomic_init(&pRing->cleared, 0);
+                pRing->threadIndex = ++g_ringCount;
+                pRing->pNext = g_pRingList;
+                g_pRingList = pRing;
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_ringListMutex);
+    if (pRing && pthread_setspecific(g_ringKey, pRing))
+    {
+        freeRingForExitingThread(pRing);
+        return NULL;
+    }
+
+    t_pRing = pRing;
+    return pRing;
+}
+
+static void createRingKey(void)
+{
+    pthread_key_create(&g_ringKey, freeRingForExitingThread);
+}
+
+// Called as a thread which recorded spans exits.  Its ring stays on g_pRingList so that its spans can still be dumped.
+static void freeRingForExitingThread(void* pContext)
+{
+    CHiPTraceRing* pRing = (CHiPTraceRing*)pContext;
+
+    t_pRing = NULL;
+    pthread_mutex_lock(&g_ringListMutex);
+    {
+        pRing->pNextFree = g_pFreeRingList;
+        g_pFreeRingList = pRing;
+    }
+    pthread_mutex_unlock(&g_ringListMutex);
+}
+
+uint32_t chipTraceNewRequest(void)
+{
+    if (!atomic_load_explicit(&g_chipTraceEnabled, memory_order_relaxed))
+        t_currentRequestId = 0;
+    else
+        t_currentRequestId = atomic_fetch_add_explicit(&g_lastRequestId, 1, memory_order_relaxed) + 1;
+    return t_currentRequestId;
+}
+
+uint32_t chipTraceCurrentRequest(void)
+{
+    return t_currentRequestId;
+}
@@ -0,0 +1,245 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Jerk and acceleration limited velocity ramps which emit the fewest quantized drive frames needed to follow them. */
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include "chip-trajectory.h"
+
+
+#define AXIS_FORWARD_REVERSE    0
+#define AXIS_LEFT_RIGHT         1
+#define AXIS_SPIN               2
+#define AXIS_COUNT              3
+
+#define STEP_SECONDS            (CHIP_TRAJECTORY_STEP_US / 1000000.0f)
+
+
+typedef struct Axis
+{
+    CHiPTrajectoryLimits limits;
+    float                target;
+    float                velocity;
+    float                acceleration;
+    int8_t               lastSent;
+} Axis;
+
+struct CHiPTrajectory
+{
+    Axis     axes[AXIS_COUNT];
+    uint32_t minIntervalMicroseconds;
+    uint32_t maxIntervalMicroseconds;
+    uint32_t elapsedMicroseconds;
+    uint32_t lastSentMicroseconds;
+    int      hasSent;
+    int      isSettled;
+};
+
+
+// Forward Declarations.
+static int    isValidLimits(const CHiPTrajectoryLimits* pLimits);
+static void   stepAxis(Axis* pAxis);
+static int8_t quantize(float velocity);
+
+
+
+CHiPTrajectory* chipTrajectoryCreate(const CHiPTrajectoryLimits* pForwardReverse,
+                                     const CHiPTrajectoryLimits* pLeftRight,
+                                     const CHiPTrajectoryLimits* pSpin,
+                                     uint32_t minIntervalMicroseconds,
+                                     uint32_t maxIntervalMicroseconds)
+{
+    CHiPTrajectory* pTrajectory = NULL;
+
+    assert( pForwardReverse && pLeftRight && pSpin );
+
+    if (!isValidLimits(pForwardReverse) || !isValidLimits(pLeftRight) || !isValidLimits(pSpin))
+        return NULL;
+    pTrajectory = calloc(1, sizeof(*pTrajectory));
+    if (!pTrajectory)
+        return NULL;
+    pTrajectory->axes[AXIS_FORWARD_REVERSE].limits = *pForwardReverse;
+    pTrajectory->axes[AXIS_LEFT_RIGHT].limits = *pLeftRight;
+    pTrajectory->axes[AXIS_SPIN].limits = *pSpin;
+    pTrajectory->minIntervalMicroseconds = minIntervalMicroseconds;
+    pTrajectory->maxIntervalMicroseconds = maxIntervalMicroseconds;
+    pTrajectory->isSettled = 1;
+
+    return pTrajectory;
+}
+
+static int isValidLimits(const CHiPTrajectoryLimits* pLimits)
+{
+    return pLimits->maxAcceleration > 0.0f && pLimits->maxJerk >= 0.0f;
+}
+
+void chipTrajectoryFree(CHiPTrajectory* pTrajectory)
+{
+    free(pTrajectory);
+}
+
+int chipTrajectorySetTarget(CHiPTrajectory* pTrajectory, int8_t forwardReverse, int8_t leftRight, int8_t spin)
+{
+    assert( pTrajectory );
+
+    if (forwardReverse < -32 || forwardReverse > 32 ||
+        leftRight < -32 || leftRight > 32 ||
+        spin < -32 || spin > 32)
+    {
+        return CHIP_ERROR_PARAM;
+    }
+    pTrajectory->axes[AXIS_FORWARD_REVERSE].target = forwardReverse;
+    pTrajectory->axes[AXIS_LEFT_RIGHT].target = leftRight;
+    pTrajectory->axes[AXIS_SPIN].target = spin;
+    pTrajectory->elapsedMicroseconds = 0;
+    pTrajectory->lastSentMicroseconds = 0;
+    pTrajectory->hasSent = 0;
+    pTrajectory->isSettled = 0;
+
+    return CHIP_ERROR_NONE;
+}
+
+int chipTrajectoryNext(CHiPTrajectory* pTrajectory, CHiPTrajectoryFrame* pFrame)
+{
+    assert( pTrajectory );
+    assert( pFrame );
+
+    while (!pTrajectory->isSettled)
+    {
+        int8_t   quantized[AXIS_COUNT];
+        uint32_t sinceLastSent;
+        int      isChanged = 0;
+        int      isRamping = 0;
+        int      i;
+
+        pTrajectory->elapsedMicroseconds += CHIP_TRAJECTORY_STEP_US;
+        for (i = 0 ; i < AXIS_COUNT ; i++)
+        {
+            Axis* pAxis = &pTrajectory->axes[i];
+
+            stepAxis(pAxis);
+            quantized[i] = quantize(pAxis->velocity);
+            isChanged |= quantized[i] != pAxis->lastSent;
+            isRamping |= pAxis->velocity != pAxis->target;
+        }
+        if (!isRamping)
+            pTrajectory->isSettled = 1;
+
+        // The first frame after a new target goes out straight away.  After that, changes are held back until the
+        // minimum interval has passed, except for the final frame which is sent as soon as that interval allows.
+        sinceLastSent = pTrajectory->hasSent ? pTrajectory->elapsedMicroseconds - pTrajectory->lastSentMicroseconds
+                                             : UINT32_MAX;
+        if (isChanged && !isRamping && sinceLastSent < pTrajectory->minIntervalMicroseconds)
+        {
+            pTrajectory->elapsedMicroseconds += pTrajectory->minIntervalMicroseconds - sinceLastSent;
+        }
+        else if (!(isChanged && sinceLastSent >= pTrajectory->minIntervalMicroseconds) &&
+                 !(isRamping && pTrajectory->maxIntervalMicroseconds != 0 &&
+                   sinceLastSent >= pTrajectory->maxIntervalMicroseconds))
+        {
+            continue;
+        }
+
+        for (i = 0 ; i < AXIS_COUNT ; i++)
+            pTrajectory->axes[i].lastSent = quantized[i];
+        pTrajectory->lastSentMicroseconds = pTrajectory->elapsedMicroseconds;
+        pTrajectory->hasSent = 1;
+        pFrame->offsetMicroseconds = pTrajectory->elapsedMicroseconds;
+        pFrame->forwardReverse = quantized[AXIS_FORWARD_REVERSE];
+        pFrame->leftRight = quantized[AXIS_LEFT_RIGHT];
+        pFrame->spin = quantized[AXIS_SPIN];
+        return CHIP_ERROR_NONE;
+    }
+
+    return CHIP_ERROR_EMPTY;
+}
+
+static void stepAxis(Axis* pAxis)
+{
+    float error = pAxis->target - pAxis->velocity;
+    float direction = error < 0.0f ? -1.0f : 1.0f;
+    float desired;
+    float velocity;
+
+    if (error == 0.0f && pAxis->acceleration == 0.0f)
+        return;
+
+    // Use the largest acceleration from which the jerk limit can still bring acceleration back to 0 by the time the
+    // target is reached: v = a^2 / (2 * jerk).
+    desired = direction * pAxis->limits.maxAcceleration;
+    if (pAxis->limits.maxJerk > 0.0f)
+    {
+        float maxDelta = pAxis->limits.maxJerk * STEP_SECONDS;
+        float braking = direction * sqrtf(2.0f * pAxis->limits.maxJerk * fabsf(error));
+
+        if (fabsf(braking) < fabsf(desired))
+            desired = braking;
+        if (desired > pAxis->acceleration + maxDelta)
+            desired = pAxis->acceleration + maxDelta;
+        else if (desired < pAxis->acceleration - maxDelta)
+            desired = pAxis->acceleration - maxDelta;
+    }
+    pAxis->acceleration = desired;
+
+    // Snap to the target once this step would reach or pass it.
+    velocity = pAxis->velocity + pAxis->acceleration * STEP_SECONDS;
+    if ((pAxis->target - velocity) * direction <= 0.0f)
+    {
+        pAxis->velocity = pAxis->target;
+        pAxis->acceleration = 0.0f;
+    }
+    else
+    {
+        pAxis->velocity = velocity;
+    }
+}
+
+static int8_t quantize(float velocity)
+{
+    float rounded = roundf(velocity);
+
+    if (rounded > 32.0f)
+        return 32;
+    if (rounded < -32.0f)
+        return -32;
+    return (int8_t)rounded;
+}
+
+int chipTrajectoryAddToTimeline(CHiPTrajectory* pTrajectory, CHiPTimeline* pTimeline, uint64_t startMicroseconds,
+                                size_t* pFrameCount)
+{
+    CHiPTrajectoryFrame frame;
+    size_t              frameCount = 0;
+    int                 result = CHIP_ERROR_NONE;
+
+    assert( pTrajectory );
+    assert( pTimeline );
+
+    while (chipTrajectoryNext(pTrajectory, &frame) == CHIP_ERROR_NONE)
+    {
+        uint8_t request[CHIP_CMD_DRIVE_REQUEST_LEN];
+
+        chipEncodeDriveFrames(&frame.forwardReverse, &frame.leftRight, &frame.spin, 1, request);
+        result = chipTimelineAddRequest(pTimeline, startMicroseconds + frame.offsetMicroseconds,
+                                        request, sizeof(request));
+        if (result)
+            break;
+        frameCount++;
+    }
+
+    if (pFrameCount)
+        *pFrameCount = frameCount;
+    return result;
+}
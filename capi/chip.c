@@ -14,52 +14,279 @@
 */
 /* Implementation of CHiP C API. */
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "chip.h"
+#include "chip-clock.h"
+#include "chip-protocol.h"
 #include "chip-transport.h"
+#include "chip-stats.h"
+#include "chip-trace.h"
 
 
-// CHiP Protocol Commands.
-// These command codes are placed in the first byte of requests sent to the CHiP and responses sent back from the CHiP.
-// See https://github.com/WowWeeLabs/CHiP-BLE-Protocol/blob/master/CHiP-Protocol.md for more information.
-#define CHIP_CMD_PLAY_SOUND              0x06
-#define CHIP_CMD_ACTION                  0x07
-#define CHIP_CMD_GET_DOG_VERSION         0x14
-#define CHIP_CMD_GET_VOLUME              0x16
-#define CHIP_CMD_SET_VOLUME              0x18
-#define CHIP_CMD_GET_BATTERY_LEVEL       0x1C
-#define CHIP_CMD_GET_CURRENT_DATE_TIME   0x3A
-#define CHIP_CMD_SET_CURRENT_DATE_TIME   0x43
-#define CHIP_CMD_SET_ALARM_DATE_TIME     0x44
-#define CHIP_CMD_SET_SPEED               0x45
-#define CHIP_CMD_GET_SPEED               0x46
-#define CHIP_CMD_SET_EYE_BRIGHTNESS      0x48
-#define CHIP_CMD_GET_EYE_BRIGHTNESS      0x49
-#define CHIP_CMD_GET_ALARM_DATE_TIME     0x4A
-#define CHIP_CMD_DRIVE                   0x78
-#define CHIP_CMD_FORCE_SLEEP             0xFA
-
-// Special sound index used to stop any current playing sound.
-#define CHIP_SOUND_SHORT_MUTE_FOR_STOP   138
+// How long to wait for another thread's request to complete before checking again.
+#define REQUEST_LOCK_WAIT_US             1000000
 
+// Number of different getter commands which can be coalesced at the same time.  Getters issued while every slot is in
+// use send their own request as usual.
+#define MAX_FLIGHTS                      8
+
+// Change in battery level, one step of the robot's raw reading, still treated as stable by the battery poller.
+#define BATTERY_STABLE_DELTA             (1.0f / 34.0f)
+
+// Every debounced setter is a command byte followed by the new value.
+#define DEBOUNCE_REQUEST_LEN             2
+
+// Retry and timeout behaviour for requests started with chipStartRequest().  Matches the transports' own handling of
+// blocking requests.
+#define ASYNC_MAXIMUM_RETRIES            2
+#define ASYNC_RESPONSE_TIMEOUT_US        1000000
+
+
+// Command used to read each field of the settings cache from the robot.
+static const uint8_t g_cacheCommands[CHIP_CACHE_FIELD_COUNT] =
+{
+    [CHIP_CACHE_SPEED] = CHIP_CMD_GET_SPEED,
+    [CHIP_CACHE_EYE_BRIGHTNESS] = CHIP_CMD_GET_EYE_BRIGHTNESS,
+    [CHIP_CACHE_VOLUME] = CHIP_CMD_GET_VOLUME,
+    [CHIP_CACHE_ALARM_DATE_TIME] = CHIP_CMD_GET_ALARM_DATE_TIME,
+    [CHIP_CACHE_DOG_VERSION] = CHIP_CMD_GET_DOG_VERSION
+};
+
+// Command read for each field of CHiPStatus by chipGetStatusSnapshot(), indexed by the bit number of its CHIP_STATUS_*
+// flag.
+static const uint8_t g_statusCommands[] =
+{
+    CHIP_CMD_GET_BATTERY_LEVEL,
+    CHIP_CMD_GET_SPEED,
+    CHIP_CMD_GET_VOLUME,
+    CHIP_CMD_GET_EYE_BRIGHTNESS,
+    CHIP_CMD_GET_CURRENT_DATE_TIME,
+    CHIP_CMD_GET_ALARM_DATE_TIME
+};
+
+#define STATUS_FIELD_COUNT (sizeof(g_statusCommands) / sizeof(g_statusCommands[0]))
+
+// Settings which chipSetDebounceWindow() applies to.
+typedef enum DebounceSetting
+{
+    DEBOUNCE_EYE_BRIGHTNESS,
+    DEBOUNCE_VOLUME,
+    DEBOUNCE_SETTING_COUNT
+} DebounceSetting;
+
+// Command used to write each of the debounced settings.
+static const uint8_t g_debounceCommands[DEBOUNCE_SETTING_COUNT] =
+{
+    [DEBOUNCE_EYE_BRIGHTNESS] = CHIP_CMD_SET_EYE_BRIGHTNESS,
+    [DEBOUNCE_VOLUME] = CHIP_CMD_SET_VOLUME
+};
+
+// chipWaitAny() can't poll() the event pipes when the robots run on a clock other than the real one, since poll()
+// always times out in real time.  It waits on this condition through the robots' clock instead and raiseEvents()
+// broadcasts it whenever such a waiter exists.
+static pthread_mutex_t  g_eventWaitMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   g_eventWaitCondition = PTHREAD_COND_INITIALIZER;
+static _Atomic uint32_t g_eventWaiterCount = 0;
+
+
+// A getter request which other callers asking for the same command can wait on rather than sending their own.  A slot
+// can only be reused once isInProgress is clear and every waiter has copied out the result.
+typedef struct Flight
+{
+    CHiPResponse response;
+    int          result;
+    uint32_t     waiterCount;
+    uint8_t      command;
+    uint8_t      isInProgress;
+} Flight;
+
+// State of the request started by chipStartRequest().
+typedef enum AsyncState
+{
+    ASYNC_IDLE,
+    ASYNC_WAITING,
+    ASYNC_COMPLETE
+} AsyncState;
+
+// Latest value written to a debounced setting.  isPending is set while value is waiting to be sent.
+typedef struct DebouncedSetting
+{
+    uint64_t lastSent;
+    uint8_t  value;
+    uint8_t  isPending;
+    uint8_t  hasSent;
+} DebouncedSetting;
 
 struct CHiP
 {
     CHiPTransport*            pTransport;
+    CHiPClock*                pClock;
+    CHiPStatsRecorder         stats;
+    uint64_t                  traceDecodeStart;
+    uint32_t                  traceRequestId;
+    // Serializes requests made by the application and the cache warming thread.  requestBusy is set from the time a
+    // request is sent until its response has been released.
+    pthread_mutex_t           requestMutex;
+    pthread_cond_t            requestCondition;
+    pthread_t                 requestOwner;
+    int                       requestBusy;
+    // Getter requests being coalesced.  Protected by requestMutex and flightCondition is broadcast as each completes.
+    pthread_cond_t            flightCondition;
+    Flight                    flights[MAX_FLIGHTS];
+    // Non-zero while a response borrowed from the transport hasn't been released yet.
+    int                       responseBorrowed;
+
+    // Settings cache.  A field is valid when its bit is set in cacheValidMask.
+    pthread_mutex_t           cacheMutex;
+    CHiPResponse              cacheValues[CHIP_CACHE_FIELD_COUNT];
+    uint64_t                  cacheTimestamps[CHIP_CACHE_FIELD_COUNT];
+    uint32_t                  cacheMaxAges[CHIP_CACHE_FIELD_COUNT];
+    uint32_t                  cacheValidMask;
+    pthread_t                 warmThread;
+    int                       warmThreadStarted;
+    _Atomic int               stopWarming;
+
+    // Most recent battery level read from the robot.  Protected by a sequence lock so that any thread can read it
+    // without blocking.  The sequence is odd while an update is in progress and 0 if no level has been read yet.
+    _Atomic uint32_t          batterySequence;
+    _Atomic uint32_t          batteryLevelBits;
+    _Atomic uint8_t           batteryChargingStatus;
+    _Atomic uint8_t           batteryChargerType;
+    _Atomic uint64_t          batteryTimestamp;
+
+    // Background battery poller.  See chipStartBatteryPoller().  The mutex and condition only exist while
+    // pollerStarted is set.
+    pthread_mutex_t           pollerMutex;
+    pthread_cond_t            pollerCondition;
+    pthread_t                 pollerThread;
+    int                       pollerStarted;
+    int                       stopPolling;
+    uint32_t                  pollerMinInterval;
+    uint32_t                  pollerMaxInterval;
+
+    // Debounced setters.  See chipSetDebounceWindow().  Protected by debounceMutex.  The flushing thread only runs
+    // while values are pending and exits once they have all been sent.
+    pthread_mutex_t           debounceMutex;
+    pthread_cond_t            debounceCondition;
+    pthread_t                 debounceThread;
+    int                       debounceThreadStarted;
+    int                       debounceThreadRunning;
+    int                       stopDebouncing;
+    uint64_t                  debounceWindow;
+    DebouncedSetting          debounced[DEBOUNCE_SETTING_COUNT];
+
+    // Event loop support.  See chipGetPollFd().  CHIP_EVENT_* bits are collected in pendingEvents and a byte is
+    // written to the pipe whenever it goes from empty to non-empty.  The pipe is only created once asked for so its
+    // write end is -1 until then.  isStartRefused is set, under requestMutex, when chipStartRequest() found the request
+    // lock busy so that CHIP_EVENT_READY can be raised once it is released.
+    _Atomic uint32_t          pendingEvents;
+    _Atomic int               eventWriteFd;
+    int                       eventReadFd;
+    int                       isStartRefused;
+
+    // Request started by chipStartRequest().  The request lock is held from the time it is sent until it completes.
+    AsyncState                asyncState;
+    int                       asyncResult;
+    int                       asyncRetries;
+    uint64_t                  asyncStartTime;
+    uint64_t                  asyncDeadline;
+    size_t                    asyncRequestLength;
+    size_t                    asyncResponseLength;
+    uint8_t                   asyncRequest[CHIP_REQUEST_MAX_LEN];
+    uint8_t                   asyncResponse[CHIP_RESPONSE_MAX_LEN];
 };
 
 
+static inline void encodeDriveFrame(uint8_t* pFrame, int8_t forwardReverse, int8_t leftRight, int8_t spin);
+static inline uint8_t encodeDriveAxis(int8_t value, uint8_t positiveBase, uint8_t negativeBase);
+static int receiveCachedResponse(CHiP* pCHiP, CHiPCacheField field, CHiPResponse* pResponse);
+static int receiveResponse(CHiP* pCHiP, uint8_t command, CHiPResponse* pResponse);
+static Flight* findFlight(CHiP* pCHiP, uint8_t command);
+static Flight* claimFlight(CHiP* pCHiP, uint8_t command);
+static int waitForFlight(CHiP* pCHiP, Flight* pFlight, CHiPResponse* pResponse);
+static void completeFlight(CHiP* pCHiP, Flight* pFlight, int result, const CHiPResponse* pResponse);
+static int requestResponse(CHiP* pCHiP, uint8_t command, CHiPResponse* pResponse);
+static void publishBatteryLevel(CHiP* pCHiP, const CHiPBatteryLevel* pBatteryLevel);
+static void lockRequests(CHiP* pCHiP);
+static void unlockRequests(CHiP* pCHiP);
+static int findCacheField(uint8_t command);
+static int readCache(CHiP* pCHiP, CHiPCacheField field, CHiPResponse* pResponse);
+static void writeCache(CHiP* pCHiP, const CHiPResponse* pResponse);
+static void invalidateCacheField(CHiP* pCHiP, CHiPCacheField field);
+static void writeCacheFromRequest(CHiP* pCHiP, const uint8_t* pRequest, size_t requestLength);
+static int startWarmingCache(CHiP* pCHiP);
+static void stopWarmingCache(CHiP* pCHiP);
+static void* warmCacheThread(void* pv);
+static void* batteryPollerThread(void* pv);
+static int isBatteryLevelStable(const CHiPBatteryLevel* pPrevious, const CHiPBatteryLevel* pCurrent);
+static void storeStatusField(CHiPStatus* pStatus, const CHiPResponse* pResponse);
+static int sendDebounced(CHiP* pCHiP, DebounceSetting setting, uint8_t value);
+static int startDebounceThread(CHiP* pCHiP);
+static void stopDebounceThread(CHiP* pCHiP);
+static void* debounceThread(void* pv);
+static int takePendingSetting(CHiP* pCHiP, uint64_t now, int isForced, uint8_t* pRequest, uint64_t* pNextDue);
+static void handleTransportEvent(void* pContext, uint32_t events);
+static void raiseEvents(CHiP* pCHiP, uint32_t events);
+static void waitForEvents(CHiP** ppCHiPs, size_t count, CHiPClock* pClock, uint64_t deadline);
+static void signalPollFd(CHiP* pCHiP);
+static int tryLockRequests(CHiP* pCHiP);
+static int sendAsyncRequest(CHiP* pCHiP);
+static int updateAsyncRequest(CHiP* pCHiP);
+static void completeAsyncRequest(CHiP* pCHiP, int result);
+static void cancelAsyncRequest(CHiP* pCHiP);
+
+
 CHiP* chipInit(const char* pInitOptions)
 {
     CHiP* pCHiP = NULL;
+    int   requestMutexInit = 0;
+    int   requestConditionInit = 0;
+    int   flightConditionInit = 0;
+    int   cacheMutexInit = 0;
+    int   debounceMutexInit = 0;
+    int   debounceConditionInit = 0;
 
     pCHiP = calloc(1, sizeof(*pCHiP));
     if (!pCHiP)
         goto Error;
+    requestMutexInit = !pthread_mutex_init(&pCHiP->requestMutex, NULL);
+    if (!requestMutexInit)
+        goto Error;
+    requestConditionInit = !pthread_cond_init(&pCHiP->requestCondition, NULL);
+    if (!requestConditionInit)
+        goto Error;
+    flightConditionInit = !pthread_cond_init(&pCHiP->flightCondition, NULL);
+    if (!flightConditionInit)
+        goto Error;
+    cacheMutexInit = !pthread_mutex_init(&pCHiP->cacheMutex, NULL);
+    if (!cacheMutexInit)
+        goto Error;
+    debounceMutexInit = !pthread_mutex_init(&pCHiP->debounceMutex, NULL);
+    if (!debounceMutexInit)
+        goto Error;
+    debounceConditionInit = !pthread_cond_init(&pCHiP->debounceCondition, NULL);
+    if (!debounceConditionInit)
+        goto Error;
+
+    // The dog version can't change while connected so it is always worth keeping.
+    pCHiP->cacheMaxAges[CHIP_CACHE_DOG_VERSION] = CHIP_CACHE_FOREVER;
+
+    // Capture the same clock as the transport so that the warming thread can take part in a virtual clock.
+    pCHiP->pClock = chipClockGetDefault();
+    pCHiP->eventReadFd = -1;
+    atomic_init(&pCHiP->eventWriteFd, -1);
     pCHiP->pTransport = chipTransportInit(pInitOptions);
     if (!pCHiP->pTransport)
         goto Error;
+    chipTransportSetEventHandler(pCHiP->pTransport, handleTransportEvent, pCHiP);
 
     return pCHiP;
 
@@ -67,6 +294,18 @@ Error:
     if (pCHiP)
     {
         chipTransportUninit(pCHiP->pTransport);
+        if (debounceConditionInit)
+            pthread_cond_destroy(&pCHiP->debounceCondition);
+        if (debounceMutexInit)
+            pthread_mutex_destroy(&pCHiP->debounceMutex);
+        if (cacheMutexInit)
+            pthread_mutex_destroy(&pCHiP->cacheMutex);
+        if (flightConditionInit)
+            pthread_cond_destroy(&pCHiP->flightCondition);
+        if (requestConditionInit)
+            pthread_cond_destroy(&pCHiP->requestCondition);
+        if (requestMutexInit)
+            pthread_mutex_destroy(&pCHiP->requestMutex);
         free(pCHiP);
     }
     return NULL;
@@ -76,18 +315,55 @@ void chipUninit(CHiP* pCHiP)
 {
     if (!pCHiP)
         return;
+    // The background threads could be waiting on the request lock held by a request started with chipStartRequest().
+    cancelAsyncRequest(pCHiP);
+    chipStopBatteryPoller(pCHiP);
+    stopWarmingCache(pCHiP);
+    stopDebounceThread(pCHiP);
+    chipFlushDebounced(pCHiP);
+    chipTransportSetEventHandler(pCHiP->pTransport, NULL, NULL);
     chipTransportUninit(pCHiP->pTransport);
+    if (pCHiP->eventReadFd >= 0)
+    {
+        close(pCHiP->eventReadFd);
+        close(atomic_load(&pCHiP->eventWriteFd));
+    }
+    pthread_cond_destroy(&pCHiP->debounceCondition);
+    pthread_mutex_destroy(&pCHiP->debounceMutex);
+    pthread_mutex_destroy(&pCHiP->cacheMutex);
+    pthread_cond_destroy(&pCHiP->flightCondition);
+    pthread_cond_destroy(&pCHiP->requestCondition);
+    pthread_mutex_destroy(&pCHiP->requestMutex);
+    free(pCHiP);
 }
 
 int chipConnectToRobot(CHiP* pCHiP, const char* pRobotName)
 {
+    int result;
+
     assert( pCHiP );
-    return chipTransportConnectToRobot(pCHiP->pTransport, pRobotName);
+
+    stopWarmingCache(pCHiP);
+    chipInvalidateCache(pCHiP);
+    result = chipTransportConnectToRobot(pCHiP->pTransport, pRobotName);
+    if (result)
+        return result;
+
+    // Failing to start the warming thread only means that the first reads go to the robot.
+    startWarmingCache(pCHiP);
+    return CHIP_ERROR_NONE;
 }
 
 int chipDisconnectFromRobot(CHiP* pCHiP)
 {
     assert( pCHiP );
+
+    cancelAsyncRequest(pCHiP);
+    stopWarmingCache(pCHiP);
+    // Deliver the final value of any setting still being debounced before the link goes away.
+    stopDebounceThread(pCHiP);
+    chipFlushDebounced(pCHiP);
+    chipInvalidateCache(pCHiP);
     return chipTransportDisconnectFromRobot(pCHiP->pTransport);
 }
 
@@ -117,42 +393,66 @@ int chipStopRobotDiscovery(CHiP* pCHiP)
 
 int chipDrive(CHiP* pCHiP, int8_t forwardReverse, int8_t leftRight, int8_t spin)
 {
-    uint8_t command[1+3];
+    uint8_t command[CHIP_CMD_DRIVE_REQUEST_LEN];
 
     assert( pCHiP );
     assert( forwardReverse >= -32 && forwardReverse <= 32 );
     assert( leftRight >= -32 && leftRight <= 32 );
     assert( spin >= -32 && spin <= 32 );
 
-    command[0] = CHIP_CMD_DRIVE;
-
-    if (forwardReverse == 0)
-        command[1] = 0x00;
-    else if (forwardReverse < 0)
-        command[1] = 0x20 + (-forwardReverse);
-    else
-        command[1] = forwardReverse;
-
-    if (spin == 0)
-        command[2] = 0x00;
-    else if (spin < 0)
-        command[2] = 0x60 + (-spin);
-    else
-        command[2] = 0x40 + spin;
-
-    if (leftRight == 0)
-        command[3] = 0x00;
-    else if (leftRight < 0)
-        command[3] = 0xA0 + (-leftRight);
-    else
-        command[3] = 0x80 + leftRight;
+    encodeDriveFrame(command, forwardReverse, leftRight, spin);
 
     return chipRawSend(pCHiP, command, sizeof(command));
 }
 
+int chipEncodeDriveFrames(const int8_t* pForwardReverse, const int8_t* pLeftRight, const int8_t* pSpin,
+                          size_t frameCount, uint8_t* pFrames)
+{
+    uint8_t outOfRange = 0;
+    size_t  i;
+
+    assert( frameCount == 0 || (pForwardReverse && pLeftRight && pSpin && pFrames) );
+
+    // Validate everything up front so that nothing is written for a bad batch.  Adding 32 maps the valid range onto
+    // 0..64 so a single unsigned compare per value catches both ends and the OR reduction has no early exit, which
+    // lets the compiler vectorize this loop.
+    for (i = 0 ; i < frameCount ; i++)
+    {
+        outOfRange |= (uint8_t)(pForwardReverse[i] + 32) > 64;
+        outOfRange |= (uint8_t)(pLeftRight[i] + 32) > 64;
+        outOfRange |= (uint8_t)(pSpin[i] + 32) > 64;
+    }
+    if (outOfRange)
+        return CHIP_ERROR_PARAM;
+
+    for (i = 0 ; i < frameCount ; i++)
+        encodeDriveFrame(&pFrames[i * CHIP_CMD_DRIVE_REQUEST_LEN], pForwardReverse[i], pLeftRight[i], pSpin[i]);
+
+    return CHIP_ERROR_NONE;
+}
+
+static inline void encodeDriveFrame(uint8_t* pFrame, int8_t forwardReverse, int8_t leftRight, int8_t spin)
+{
+    pFrame[0] = CHIP_CMD_DRIVE;
+    pFrame[1] = encodeDriveAxis(forwardReverse, 0x00, 0x20);
+    pFrame[2] = encodeDriveAxis(spin, 0x40, 0x60);
+    pFrame[3] = encodeDriveAxis(leftRight, 0x80, 0xA0);
+}
+
+static inline uint8_t encodeDriveAxis(int8_t value, uint8_t positiveBase, uint8_t negativeBase)
+{
+    // Each axis is sent as its magnitude added to a base which depends on its sign, with 0 always sent as 0x00.
+    // Build the sign and non-zero masks arithmetically rather than branching on them.
+    uint8_t negativeMask = (uint8_t)(value >> 7);
+    uint8_t magnitude = ((uint8_t)value ^ negativeMask) - negativeMask;
+    uint8_t nonZeroMask = -(uint8_t)(magnitude != 0);
+
+    return magnitude + (nonZeroMask & positiveBase) + (negativeMask & (uint8_t)(negativeBase - positiveBase));
+}
+
 int chipAction(CHiP* pCHiP, CHiPAction action)
 {
-    uint8_t command[1+1];
+    uint8_t command[CHIP_CMD_ACTION_REQUEST_LEN];
 
     assert( pCHiP );
     assert( action >= CHIP_ACTION_RESET && action <= CHIP_ACTION_FACE_DOWN_FOR_CONTROLLING_CHIPPIES );
@@ -165,32 +465,23 @@ int chipAction(CHiP* pCHiP, CHiPAction action)
 
 int chipGetSpeed(CHiP* pCHiP, CHiPSpeed* pSpeed)
 {
-    static const uint8_t getSpeed[1] = { CHIP_CMD_GET_SPEED };
-    uint8_t              response[1+1];
-    size_t               responseLength;
-    int                  result;
+    CHiPResponse response;
+    int          result;
 
     assert( pCHiP );
     assert( pSpeed );
 
-    result = chipRawReceive(pCHiP, getSpeed, sizeof(getSpeed), response, sizeof(response), &responseLength);
+    result = receiveCachedResponse(pCHiP, CHIP_CACHE_SPEED, &response);
     if (result)
         return result;
-    if (responseLength != 2 ||
-        response[0] != CHIP_CMD_GET_SPEED ||
-        response[1] > CHIP_SPEED_KID)
-    {
-        return CHIP_ERROR_BAD_RESPONSE;
-    }
-
-    *pSpeed = response[1];
 
+    *pSpeed = response.speed;
     return CHIP_ERROR_NONE;
 }
 
 int chipSetSpeed(CHiP* pCHiP, CHiPSpeed speed)
 {
-    uint8_t command[1+1];
+    uint8_t command[CHIP_CMD_SET_SPEED_REQUEST_LEN];
 
     assert( pCHiP );
     assert ( speed <= CHIP_SPEED_KID );
@@ -203,43 +494,30 @@ int chipSetSpeed(CHiP* pCHiP, CHiPSpeed speed)
 
 int chipGetEyeBrightness(CHiP* pCHiP, uint8_t* pBrightness)
 {
-    static const uint8_t getBrightness[1] = { CHIP_CMD_GET_EYE_BRIGHTNESS };
-    uint8_t              response[1+1];
-    size_t               responseLength;
-    int                  result;
+    CHiPResponse response;
+    int          result;
 
     assert( pCHiP );
     assert( pBrightness );
 
-    result = chipRawReceive(pCHiP, getBrightness, sizeof(getBrightness), response, sizeof(response), &responseLength);
+    result = receiveCachedResponse(pCHiP, CHIP_CACHE_EYE_BRIGHTNESS, &response);
     if (result)
         return result;
-    if (responseLength != 2 ||
-        response[0] != CHIP_CMD_GET_EYE_BRIGHTNESS)
-    {
-        return CHIP_ERROR_BAD_RESPONSE;
-    }
-
-    *pBrightness = response[1];
 
+    *pBrightness = response.eyeBrightness;
     return CHIP_ERROR_NONE;
 }
 
 int chipSetEyeBrightness(CHiP* pCHiP, uint8_t brightness)
 {
-    uint8_t command[1+1];
-
     assert( pCHiP );
 
-    command[0] = CHIP_CMD_SET_EYE_BRIGHTNESS;
-    command[1] = brightness;
-
-    return chipRawSend(pCHiP, command, sizeof(command));
+    return sendDebounced(pCHiP, DEBOUNCE_EYE_BRIGHTNESS, brightness);
 }
 
 int chipPlaySound(CHiP* pCHiP, CHiPSoundIndex sound)
 {
-    uint8_t command[1+2];
+    uint8_t command[CHIP_CMD_PLAY_SOUND_REQUEST_LEN];
 
     assert( pCHiP );
     assert( sound >= CHIP_SOUND_BARK_X1_ANGRY_A34 && sound <= CHIP_SOUND_SHORT_MUTE_FOR_STOP );
@@ -258,109 +536,230 @@ int chipStopSound(CHiP* pCHiP)
 
 int chipGetVolume(CHiP* pCHiP, uint8_t* pVolume)
 {
-    static const uint8_t getVolume[1] = { CHIP_CMD_GET_VOLUME };
-    uint8_t              response[1+1];
-    size_t               responseLength;
-    int                  result;
+    CHiPResponse response;
+    int          result;
 
     assert( pCHiP );
     assert( pVolume );
 
-    result = chipRawReceive(pCHiP, getVolume, sizeof(getVolume), response, sizeof(response), &responseLength);
+    result = receiveCachedResponse(pCHiP, CHIP_CACHE_VOLUME, &response);
     if (result)
         return result;
-    if (responseLength != sizeof(response) ||
-        response[0] != CHIP_CMD_GET_VOLUME ||
-        response[1] == 0 || response[1] > 11)
-    {
-        return CHIP_ERROR_BAD_RESPONSE;
-    }
 
-    *pVolume = response[1];
-    return result;
+    *pVolume = response.volume;
+    return CHIP_ERROR_NONE;
 }
 
 int chipSetVolume(CHiP* pCHiP, uint8_t volume)
 {
-    uint8_t command[1+1];
-
     assert( pCHiP );
     assert( volume >= 1 && volume <= 11 );
 
-    command[0] = CHIP_CMD_SET_VOLUME;
-    command[1] = volume;
-
-    return chipRawSend(pCHiP, command, sizeof(command));
+    return sendDebounced(pCHiP, DEBOUNCE_VOLUME, volume);
 }
 
 int chipGetBatteryLevel(CHiP* pCHiP, CHiPBatteryLevel* pBatteryLevel)
 {
-    static const uint8_t getBatteryLevel[1] = { CHIP_CMD_GET_BATTERY_LEVEL };
-    uint8_t              response[1+3];
-    size_t               responseLength;
-    int                  result;
+    CHiPResponse response;
+    int          result;
 
     assert( pCHiP );
     assert( pBatteryLevel );
 
-    result = chipRawReceive(pCHiP, getBatteryLevel, sizeof(getBatteryLevel), response, sizeof(response), &responseLength);
+    result = receiveResponse(pCHiP, CHIP_CMD_GET_BATTERY_LEVEL, &response);
     if (result)
         return result;
-    if (responseLength != 4 ||
-        response[0] != CHIP_CMD_GET_BATTERY_LEVEL ||
-        response[1] > CHIP_CHARGING_STATUS_CHARGING_FINISHED ||
-        response[2] > CHIP_CHARGER_TYPE_BASE)
+
+    *pBatteryLevel = response.batteryLevel;
+    publishBatteryLevel(pCHiP, pBatteryLevel);
+    return CHIP_ERROR_NONE;
+}
+
+static void publishBatteryLevel(CHiP* pCHiP, const CHiPBatteryLevel* pBatteryLevel)
+{
+    uint32_t sequence = atomic_load_explicit(&pCHiP->batterySequence, memory_order_relaxed);
+    uint32_t levelBits = 0;
+
+    // Make the sequence odd to claim the writer side.  Spins if another thread is in the middle of an update.
+    do
     {
-        return CHIP_ERROR_BAD_RESPONSE;
+        sequence &= ~1U;
+    } while (!atomic_compare_exchange_weak_explicit(&pCHiP->batterySequence, &sequence, sequence + 1,
+                                                    memory_order_acquire, memory_order_relaxed));
+    atomic_thread_fence(memory_order_release);
+
+    memcpy(&levelBits, &pBatteryLevel->batteryLevel, sizeof(levelBits));
+    atomic_store_explicit(&pCHiP->batteryLevelBits, levelBits, memory_order_relaxed);
+    atomic_store_explicit(&pCHiP->batteryChargingStatus, pBatteryLevel->chargingStatus, memory_order_relaxed);
+    atomic_store_explicit(&pCHiP->batteryChargerType, pBatteryLevel->chargerType, memory_order_relaxed);
+    atomic_store_explicit(&pCHiP->batteryTimestamp, chipTransportGetMicroseconds(pCHiP->pTransport),
+                          memory_order_relaxed);
+
+    atomic_store_explicit(&pCHiP->batterySequence, sequence + 2, memory_order_release);
+}
+
+int chipGetLastBatteryLevel(CHiP* pCHiP, CHiPBatteryLevel* pBatteryLevel, uint32_t* pAgeMilliseconds)
+{
+    uint32_t sequence = 0;
+    uint32_t levelBits = 0;
+    uint64_t timestamp = 0;
+    uint64_t ageMilliseconds = 0;
+
+    assert( pCHiP );
+    assert( pBatteryLevel );
+
+    do
+    {
+        sequence = atomic_load_explicit(&pCHiP->batterySequence, memory_order_acquire);
+        if (sequence == 0)
+            return CHIP_ERROR_EMPTY;
+        levelBits = atomic_load_explicit(&pCHiP->batteryLevelBits, memory_order_relaxed);
+        pBatteryLevel->chargingStatus = atomic_load_explicit(&pCHiP->batteryChargingStatus, memory_order_relaxed);
+        pBatteryLevel->chargerType = atomic_load_explicit(&pCHiP->batteryChargerType, memory_order_relaxed);
+        timestamp = atomic_load_explicit(&pCHiP->batteryTimestamp, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((sequence & 1) || sequence != atomic_load_explicit(&pCHiP->batterySequence, memory_order_relaxed));
+
+    memcpy(&pBatteryLevel->batteryLevel, &levelBits, sizeof(pBatteryLevel->batteryLevel));
+    if (pAgeMilliseconds)
+    {
+        ageMilliseconds = (chipTransportGetMicroseconds(pCHiP->pTransport) - timestamp) / 1000;
+        *pAgeMilliseconds = ageMilliseconds > UINT32_MAX ? UINT32_MAX : (uint32_t)ageMilliseconds;
     }
+    return CHIP_ERROR_NONE;
+}
+
+int chipStartBatteryPoller(CHiP* pCHiP, uint32_t minIntervalMilliseconds, uint32_t maxIntervalMilliseconds)
+{
+    int mutexInit = 0;
+    int conditionInit = 0;
+
+    assert( pCHiP );
+
+    if (minIntervalMilliseconds == 0 || minIntervalMilliseconds > maxIntervalMilliseconds)
+        return CHIP_ERROR_PARAM;
+    chipStopBatteryPoller(pCHiP);
+
+    mutexInit = !pthread_mutex_init(&pCHiP->pollerMutex, NULL);
+    if (!mutexInit)
+        goto Error;
+    conditionInit = !pthread_cond_init(&pCHiP->pollerCondition, NULL);
+    if (!conditionInit)
+        goto Error;
+    pCHiP->stopPolling = 0;
+    pCHiP->pollerMinInterval = minIntervalMilliseconds;
+    pCHiP->pollerMaxInterval = maxIntervalMilliseconds;
+
+    // Attach on behalf of the new thread before it starts so that a virtual clock can't advance without it.
+    chipClockAttachThread(pCHiP->pClock);
+    if (pthread_create(&pCHiP->pollerThread, NULL, batteryPollerThread, pCHiP))
+    {
+        chipClockDetachThread(pCHiP->pClock);
+        goto Error;
+    }
+    pCHiP->pollerStarted = 1;
 
-    // Convert battery integer value to floating point percentage value between 0.0f and 1.0f.
-    pBatteryLevel->chargingStatus = response[1];
-    pBatteryLevel->chargerType = response[2];
-    pBatteryLevel->batteryLevel = (float)(response[3] - 0x7D) / 34.0f;
     return CHIP_ERROR_NONE;
+
+Error:
+    if (conditionInit)
+        pthread_cond_destroy(&pCHiP->pollerCondition);
+    if (mutexInit)
+        pthread_mutex_destroy(&pCHiP->pollerMutex);
+    return CHIP_ERROR_MEMORY;
+}
+
+void chipStopBatteryPoller(CHiP* pCHiP)
+{
+    assert( pCHiP );
+
+    if (!pCHiP->pollerStarted)
+        return;
+    pthread_mutex_lock(&pCHiP->pollerMutex);
+    {
+        pCHiP->stopPolling = 1;
+        pthread_cond_signal(&pCHiP->pollerCondition);
+    }
+    pthread_mutex_unlock(&pCHiP->pollerMutex);
+    pthread_join(pCHiP->pollerThread, NULL);
+
+    pthread_cond_destroy(&pCHiP->pollerCondition);
+    pthread_mutex_destroy(&pCHiP->pollerMutex);
+    pCHiP->pollerStarted = 0;
+}
+
+static void* batteryPollerThread(void* pv)
+{
+    CHiP*            pCHiP = (CHiP*)pv;
+    CHiPBatteryLevel previous;
+    int              hasPrevious = 0;
+    uint32_t         interval = pCHiP->pollerMinInterval;
+    int              stop = 0;
+    int              result;
+
+    while (!stop)
+    {
+        CHiPBatteryLevel current;
+        uint64_t         deadline;
+
+        // chipGetBatteryLevel() publishes each reading for chipGetLastBatteryLevel().  Back off while the readings
+        // are stable or failing, such as while disconnected, and drop back to the fastest rate when they change.
+        result = chipGetBatteryLevel(pCHiP, &current);
+        if (result == CHIP_ERROR_NONE && !(hasPrevious && isBatteryLevelStable(&previous, &current)))
+            interval = pCHiP->pollerMinInterval;
+        else if (interval < pCHiP->pollerMaxInterval)
+            interval = interval > pCHiP->pollerMaxInterval / 2 ? pCHiP->pollerMaxInterval : interval * 2;
+        if (result == CHIP_ERROR_NONE)
+        {
+            previous = current;
+            hasPrevious = 1;
+        }
+
+        deadline = chipClockGetMicroseconds(pCHiP->pClock) + (uint64_t)interval * 1000;
+        pthread_mutex_lock(&pCHiP->pollerMutex);
+        {
+            while (!pCHiP->stopPolling &&
+                   chipClockWaitUntil(pCHiP->pClock, &pCHiP->pollerCondition, &pCHiP->pollerMutex, deadline) !=
+                   CHIP_ERROR_TIMEOUT)
+            {
+            }
+            stop = pCHiP->stopPolling;
+        }
+        pthread_mutex_unlock(&pCHiP->pollerMutex);
+    }
+
+    chipClockDetachThread(pCHiP->pClock);
+    return NULL;
+}
+
+static int isBatteryLevelStable(const CHiPBatteryLevel* pPrevious, const CHiPBatteryLevel* pCurrent)
+{
+    float delta = pCurrent->batteryLevel - pPrevious->batteryLevel;
+
+    return pCurrent->chargingStatus == pPrevious->chargingStatus &&
+           pCurrent->chargerType == pPrevious->chargerType &&
+           delta <= BATTERY_STABLE_DELTA && delta >= -BATTERY_STABLE_DELTA;
 }
 
 int chipGetCurrentDateTime(CHiP* pCHiP, CHiPCurrentDateTime* pDateTime)
 {
-    static const uint8_t getCurrentDateTime[1] = { CHIP_CMD_GET_CURRENT_DATE_TIME };
-    uint8_t              response[1+8];
-    size_t               responseLength;
-    int                  result;
+    CHiPResponse response;
+    int          result;
 
     assert( pCHiP );
     assert( pDateTime );
 
-    result = chipRawReceive(pCHiP, getCurrentDateTime, sizeof(getCurrentDateTime), response, sizeof(response), &responseLength);
+    result = receiveResponse(pCHiP, CHIP_CMD_GET_CURRENT_DATE_TIME, &response);
     if (result)
         return result;
-    if (responseLength != 9 ||
-        response[0] != CHIP_CMD_GET_CURRENT_DATE_TIME ||
-        response[3] > 12 || // Month
-        response[4] > 31 || // Day
-        response[5] > 23 || // Hour
-        response[6] > 59 || // Minute
-        response[7] > 59 || // Second
-        response[8] > 7)    // Day of Week
-    {
-        return CHIP_ERROR_BAD_RESPONSE;
-    }
-
-    // Year is stored in 2 bytes, big endian.
-    pDateTime->year = ((uint16_t)response[1] << 8) | (uint16_t)response[2];
-    pDateTime->month = response[3];
-    pDateTime->day = response[4];
-    pDateTime->hour = response[5];
-    pDateTime->minute = response[6];
-    pDateTime->second = response[7];
-    pDateTime->dayOfWeek = response[8];
-    
+
+    *pDateTime = response.currentDateTime;
     return CHIP_ERROR_NONE;
 }
 
 int chipSetCurrentDateTime(CHiP* pCHiP, const CHiPCurrentDateTime* pDateTime)
 {
-    uint8_t command[1+8];
+    uint8_t command[CHIP_CMD_SET_CURRENT_DATE_TIME_REQUEST_LEN];
 
     assert( pCHiP );
     assert( pDateTime->month >= 1 && pDateTime->month <= 12 );
@@ -385,40 +784,23 @@ int chipSetCurrentDateTime(CHiP* pCHiP, const CHiPCurrentDateTime* pDateTime)
 
 int chipGetAlarmDateTime(CHiP* pCHiP, CHiPAlarmDateTime* pDateTime)
 {
-    static const uint8_t getAlarmDateTime[1] = { CHIP_CMD_GET_ALARM_DATE_TIME };
-    uint8_t              response[1+6];
-    size_t               responseLength;
-    int                  result;
+    CHiPResponse response;
+    int          result;
 
     assert( pCHiP );
     assert( pDateTime );
 
-    result = chipRawReceive(pCHiP, getAlarmDateTime, sizeof(getAlarmDateTime), response, sizeof(response), &responseLength);
+    result = receiveCachedResponse(pCHiP, CHIP_CACHE_ALARM_DATE_TIME, &response);
     if (result)
         return result;
-    if (responseLength != 7 ||
-        response[0] != CHIP_CMD_GET_ALARM_DATE_TIME ||
-        response[3] > 12 || // Month
-        response[4] > 31 || // Day
-        response[5] > 23 || // Hour
-        response[6] > 59)   // Minute
-    {
-        return CHIP_ERROR_BAD_RESPONSE;
-    }
-
-    // Year is stored in 2 bytes, big endian.
-    pDateTime->year = ((uint16_t)response[1] << 8) | (uint16_t)response[2];
-    pDateTime->month = response[3];
-    pDateTime->day = response[4];
-    pDateTime->hour = response[5];
-    pDateTime->minute = response[6];
-    
+
+    *pDateTime = response.alarmDateTime;
     return CHIP_ERROR_NONE;
 }
 
 int chipSetAlarmDateTime(CHiP* pCHiP, const CHiPAlarmDateTime* pDateTime)
 {
-    uint8_t command[1+6];
+    uint8_t command[CHIP_CMD_SET_ALARM_DATE_TIME_REQUEST_LEN];
 
     assert( pCHiP );
     assert( pDateTime->month >= 1 && pDateTime->month <= 12 );
@@ -439,7 +821,7 @@ int chipSetAlarmDateTime(CHiP* pCHiP, const CHiPAlarmDateTime* pDateTime)
 
 int chipCancelAlarm(CHiP* pCHiP)
 {
-    uint8_t command[1+6];
+    uint8_t command[CHIP_CMD_SET_ALARM_DATE_TIME_REQUEST_LEN];
 
     assert( pCHiP );
 
@@ -451,38 +833,23 @@ int chipCancelAlarm(CHiP* pCHiP)
 
 int chipGetDogVersion(CHiP* pCHiP, CHiPDogVersion* pVersion)
 {
-    static const uint8_t getDogVersion[1] = { CHIP_CMD_GET_DOG_VERSION };
-    uint8_t              response[1+10];
-    size_t               responseLength;
-    int                  result;
+    CHiPResponse response;
+    int          result;
 
     assert( pCHiP );
     assert( pVersion );
 
-    result = chipRawReceive(pCHiP, getDogVersion, sizeof(getDogVersion), response, sizeof(response), &responseLength);
+    result = receiveCachedResponse(pCHiP, CHIP_CACHE_DOG_VERSION, &response);
     if (result)
         return result;
-    if (responseLength != sizeof(response) || response[0] != CHIP_CMD_GET_DOG_VERSION)
-    {
-        return CHIP_ERROR_BAD_RESPONSE;
-    }
 
-    pVersion->bodyHardware = response[1];
-    pVersion->headHardware = response[2];
-    pVersion->mechanic = response[3];
-    pVersion->bleSpiFlash = response[4];
-    pVersion->nuvotonSpiFlash = response[5];
-    pVersion->bleBootloader = response[6];
-    pVersion->bleApromFirmware = response[7];
-    pVersion->nuvotonBootloaderFirmware = response[8];
-    pVersion->nuvotonApromFirmware = response[9];
-    pVersion->nuvoton = response[10];
-    return result;
+    *pVersion = response.dogVersion;
+    return CHIP_ERROR_NONE;
 }
 
 int chipForceSleep(CHiP* pCHiP)
 {
-    uint8_t command[1+2];
+    uint8_t command[CHIP_CMD_FORCE_SLEEP_REQUEST_LEN];
 
     assert( pCHiP );
 
@@ -493,23 +860,384 @@ int chipForceSleep(CHiP* pCHiP)
     return chipRawSend(pCHiP, command, sizeof(command));
 }
 
+int chipGetStatusSnapshot(CHiP* pCHiP, CHiPStatus* pStatus)
+{
+    return chipGetStatusFields(pCHiP, CHIP_STATUS_ALL, pStatus);
+}
+
+int chipGetStatusFields(CHiP* pCHiP, uint32_t fieldMask, CHiPStatus* pStatus)
+{
+    CHiPTransportBatchItem items[STATUS_FIELD_COUNT];
+    uint8_t                requests[STATUS_FIELD_COUNT];
+    uint8_t                responses[STATUS_FIELD_COUNT][CHIP_RESPONSE_MAX_LEN];
+    CHiPResponse           response;
+    size_t                 itemCount = 0;
+    size_t                 i;
+    int                    result = CHIP_ERROR_NONE;
+    uint32_t               requestId = chipTraceNewRequest();
+    uint64_t               traceStart = chipTraceBegin();
+
+    assert( pCHiP );
+    assert( pStatus );
+
+    memset(pStatus, 0, sizeof(*pStatus));
+    if (fieldMask & ~CHIP_STATUS_ALL)
+    {
+        result = CHIP_ERROR_PARAM;
+        goto Done;
+    }
+
+    // Settings which are still fresh in the cache don't need to be read from the robot at all.
+    memset(items, 0, sizeof(items));
+    for (i = 0 ; i < STATUS_FIELD_COUNT ; i++)
+    {
+        int field = findCacheField(g_statusCommands[i]);
+
+        if (!(fieldMask & (1U << i)))
+            continue;
+        if (field >= 0 && readCache(pCHiP, field, &response))
+        {
+            storeStatusField(pStatus, &response);
+            continue;
+        }
+        requests[itemCount] = g_statusCommands[i];
+        items[itemCount].pRequest = &requests[itemCount];
+        items[itemCount].requestLength = 1;
+        items[itemCount].pResponse = responses[itemCount];
+        itemCount++;
+    }
+    if (itemCount == 0)
+        goto Done;
+
+    // The rest go out back to back so that the whole snapshot costs about one round trip.
+    lockRequests(pCHiP);
+    for (i = 0 ; i < itemCount ; i++)
+        chipStatsRecordWrite(&pCHiP->stats, items[i].requestLength);
+    result = chipTransportSendRequestBatch(pCHiP->pTransport, items, itemCount);
+    unlockRequests(pCHiP);
+    if (result)
+        goto Done;
+
+    for (i = 0 ; i < itemCount ; i++)
+    {
+        CHiPTransportBatchItem* pItem = &items[i];
+        int                     itemResult = pItem->result;
+
+        if (itemResult == CHIP_ERROR_NONE)
+        {
+            chipStatsRecordRead(&pCHiP->stats, pItem->responseLength);
+            // Each response has its own round trip time rather than that of the whole batch which waits on the slowest.
+            chipStatsRecordRoundTrip(&pCHiP->stats, pItem->pRequest[0], pItem->roundTrip);
+            itemResult = chipDecodeResponse(pItem->pResponse, pItem->responseLength, &response);
+            if (itemResult || response.command != pItem->pRequest[0])
+            {
+                chipStatsRecordBadResponse(&pCHiP->stats);
+                itemResult = CHIP_ERROR_BAD_RESPONSE;
+            }
+        }
+        // Keep going so that the caller still gets every field which could be read.
+        if (itemResult)
+        {
+            if (result == CHIP_ERROR_NONE)
+                result = itemResult;
+            continue;
+        }
+
+        writeCache(pCHiP, &response);
+        if (response.command == CHIP_CMD_GET_BATTERY_LEVEL)
+            publishBatteryLevel(pCHiP, &response.batteryLevel);
+        storeStatusField(pStatus, &response);
+    }
+
+Done:
+    chipTraceEnd("chipGetStatusFields", requestId, traceStart);
+    return result;
+}
+
+static void storeStatusField(CHiPStatus* pStatus, const CHiPResponse* pResponse)
+{
+    switch (pResponse->command)
+    {
+    case CHIP_CMD_GET_BATTERY_LEVEL:
+        pStatus->batteryLevel = pResponse->batteryLevel;
+        pStatus->validMask |= CHIP_STATUS_BATTERY_LEVEL;
+        break;
+    case CHIP_CMD_GET_SPEED:
+        pStatus->speed = pResponse->speed;
+        pStatus->validMask |= CHIP_STATUS_SPEED;
+        break;
+    case CHIP_CMD_GET_VOLUME:
+        pStatus->volume = pResponse->volume;
+        pStatus->validMask |= CHIP_STATUS_VOLUME;
+        break;
+    case CHIP_CMD_GET_EYE_BRIGHTNESS:
+        pStatus->eyeBrightness = pResponse->eyeBrightness;
+        pStatus->validMask |= CHIP_STATUS_EYE_BRIGHTNESS;
+        break;
+    case CHIP_CMD_GET_CURRENT_DATE_TIME:
+        pStatus->currentDateTime = pResponse->currentDateTime;
+        pStatus->validMask |= CHIP_STATUS_CURRENT_DATE_TIME;
+        break;
+    case CHIP_CMD_GET_ALARM_DATE_TIME:
+        pStatus->alarmDateTime = pResponse->alarmDateTime;
+        pStatus->validMask |= CHIP_STATUS_ALARM_DATE_TIME;
+        break;
+    }
+}
+
+static int receiveCachedResponse(CHiP* pCHiP, CHiPCacheField field, CHiPResponse* pResponse)
+{
+    if (readCache(pCHiP, field, pResponse))
+        return CHIP_ERROR_NONE;
+    return receiveResponse(pCHiP, g_cacheCommands[field], pResponse);
+}
+
+static int receiveResponse(CHiP* pCHiP, uint8_t command, CHiPResponse* pResponse)
+{
+    Flight* pFlight = NULL;
+    int     isShared = 0;
+    int     result = -1;
+
+    // Responses are only matched to requests by their command byte so sending the same getter again while one is
+    // still outstanding just adds radio traffic.  Later callers wait for the first one and share its result instead.
+    pthread_mutex_lock(&pCHiP->requestMutex);
+    {
+        pFlight = findFlight(pCHiP, command);
+        if (pFlight)
+        {
+            result = waitForFlight(pCHiP, pFlight, pResponse);
+            isShared = 1;
+        }
+        else
+        {
+            pFlight = claimFlight(pCHiP, command);
+        }
+    }
+    pthread_mutex_unlock(&pCHiP->requestMutex);
+    if (isShared)
+    {
+        chipStatsRecordCoalesced(&pCHiP->stats);
+        return result;
+    }
+
+    result = requestResponse(pCHiP, command, pResponse);
+    if (pFlight)
+        completeFlight(pCHiP, pFlight, result, pResponse);
+    return result;
+}
+
+static Flight* findFlight(CHiP* pCHiP, uint8_t command)
+{
+    size_t i;
+
+    for (i = 0 ; i < MAX_FLIGHTS ; i++)
+    {
+        Flight* pFlight = &pCHiP->flights[i];
+
+        if (pFlight->isInProgress && pFlight->command == command)
+            return pFlight;
+    }
+    return NULL;
+}
+
+static Flight* claimFlight(CHiP* pCHiP, uint8_t command)
+{
+    size_t i;
+
+    for (i = 0 ; i < MAX_FLIGHTS ; i++)
+    {
+        Flight* pFlight = &pCHiP->flights[i];
+
+        if (!pFlight->isInProgress && pFlight->waiterCount == 0)
+        {
+            pFlight->command = command;
+            pFlight->isInProgress = 1;
+            return pFlight;
+        }
+    }
+    return NULL;
+}
+
+static int waitForFlight(CHiP* pCHiP, Flight* pFlight, CHiPResponse* pResponse)
+{
+    int result;
+
+    // Wait through the clock for the same reason as lockRequests().
+    pFlight->waiterCount++;
+    while (pFlight->isInProgress)
+    {
+        uint64_t deadline = chipClockGetMicroseconds(pCHiP->pClock) + REQUEST_LOCK_WAIT_US;
+
+        chipClockWaitUntil(pCHiP->pClock, &pCHiP->flightCondition, &pCHiP->requestMutex, deadline);
+    }
+    result = pFlight->result;
+    if (result == CHIP_ERROR_NONE)
+        *pResponse = pFlight->response;
+    pFlight->waiterCount--;
+
+    return result;
+}
+
+static void completeFlight(CHiP* pCHiP, Flight* pFlight, int result, const CHiPResponse* pResponse)
+{
+    pthread_mutex_lock(&pCHiP->requestMutex);
+    {
+        pFlight->result = result;
+        if (result == CHIP_ERROR_NONE)
+            pFlight->response = *pResponse;
+        pFlight->isInProgress = 0;
+        pthread_cond_broadcast(&pCHiP->flightCondition);
+    }
+    pthread_mutex_unlock(&pCHiP->requestMutex);
+}
+
+static int requestResponse(CHiP* pCHiP, uint8_t command, CHiPResponse* pResponse)
+{
+    const uint8_t    request[1] = { command };
+    CHiPResponseView view;
+    int              result;
+
+    // Decode straight out of the transport's buffer rather than copying the response out first.
+    result = chipRawReceiveView(pCHiP, request, sizeof(request), &view);
+    if (result)
+        return result;
+    result = chipDecodeResponse(view.pData, view.length, pResponse);
+    if (result || pResponse->command != command)
+    {
+        chipStatsRecordBadResponse(&pCHiP->stats);
+        result = CHIP_ERROR_BAD_RESPONSE;
+    }
+    // The trace fields belong to whichever thread holds the request lock so end the span before releasing it.
+    chipTraceEnd("decode", pCHiP->traceRequestId, pCHiP->traceDecodeStart);
+    chipReleaseResponseView(pCHiP, &view);
+    if (result)
+        return result;
+
+    writeCache(pCHiP, pResponse);
+    return CHIP_ERROR_NONE;
+}
+
 int chipRawSend(CHiP* pCHiP, const uint8_t* pRequest, size_t requestLength)
 {
+    int result;
+
     assert( pCHiP );
-    return chipTransportSendRequest(pCHiP->pTransport, pRequest, requestLength, CHIP_EXPECT_NO_RESPONSE);
+
+    lockRequests(pCHiP);
+    chipStatsRecordWrite(&pCHiP->stats, requestLength);
+    result = chipTransportSendRequest(pCHiP->pTransport, pRequest, requestLength, CHIP_EXPECT_NO_RESPONSE);
+    if (result == CHIP_ERROR_NONE)
+        writeCacheFromRequest(pCHiP, pRequest, requestLength);
+    unlockRequests(pCHiP);
+
+    return result;
 }
 
 int chipRawReceive(CHiP* pCHiP, const uint8_t* pRequest, size_t requestLength,
                    uint8_t* pResponseBuffer, size_t responseBufferSize, size_t* pResponseLength)
 {
-    int result = -1;
+    CHiPResponseView view;
+    size_t           copyLength;
+    int              result;
+
+    result = chipRawReceiveView(pCHiP, pRequest, requestLength, &view);
+    if (result)
+        return result;
+
+    copyLength = view.length;
+    if (copyLength > responseBufferSize)
+        copyLength = responseBufferSize;
+    memcpy(pResponseBuffer, view.pData, copyLength);
+    *pResponseLength = copyLength;
+    chipReleaseResponseView(pCHiP, &view);
+
+    return CHIP_ERROR_NONE;
+}
+
+int chipRawReceiveView(CHiP* pCHiP, const uint8_t* pRequest, size_t requestLength, CHiPResponseView* pView)
+{
+    int      result = -1;
+    uint64_t startTime = 0;
+    uint32_t requestId = chipTraceNewRequest();
+    uint64_t traceStart = chipTraceBegin();
 
     assert( pCHiP );
+    assert( pView );
 
+    lockRequests(pCHiP);
+    pCHiP->traceDecodeStart = 0;
+    startTime = chipTransportGetMicroseconds(pCHiP->pTransport);
+    chipStatsRecordWrite(&pCHiP->stats, requestLength);
     result = chipTransportSendRequest(pCHiP->pTransport, pRequest, requestLength, CHIP_EXPECT_RESPONSE);
     if (result)
-        return result;
-    return chipTransportGetResponse(pCHiP->pTransport, pResponseBuffer, responseBufferSize, pResponseLength);
+        goto Done;
+    result = chipTransportBorrowResponse(pCHiP->pTransport, &pView->pData, &pView->length);
+    if (result)
+        goto Done;
+    pCHiP->responseBorrowed = 1;
+
+    chipStatsRecordRead(&pCHiP->stats, pView->length);
+    chipStatsRecordRoundTrip(&pCHiP->stats, pRequest[0], chipTransportGetMicroseconds(pCHiP->pTransport) - startTime);
+
+    // Typed getters will end this span once they have validated and decoded the response.
+    pCHiP->traceRequestId = requestId;
+    pCHiP->traceDecodeStart = chipTraceBegin();
+Done:
+    // The request lock stays held until chipReleaseResponseView() is called for a successfully borrowed response.
+    if (result)
+        unlockRequests(pCHiP);
+    chipTraceEnd("chipRawReceive", requestId, traceStart);
+    return result;
+}
+
+void chipReleaseResponseView(CHiP* pCHiP, CHiPResponseView* pView)
+{
+    assert( pCHiP );
+    assert( pView );
+
+    if (!pCHiP->responseBorrowed)
+        return;
+    chipTransportReleaseResponse(pCHiP->pTransport);
+    pCHiP->responseBorrowed = 0;
+    pView->pData = NULL;
+    pView->length = 0;
+    unlockRequests(pCHiP);
+}
+
+static void lockRequests(CHiP* pCHiP)
+{
+    pthread_mutex_lock(&pCHiP->requestMutex);
+    {
+        // This thread would wait forever if it still held a response borrowed with chipRawReceiveView().
+        assert( !pCHiP->requestBusy || !pthread_equal(pCHiP->requestOwner, pthread_self()) );
+
+        // Wait through the clock so that a virtual clock counts this thread as blocked and keeps advancing time for
+        // the thread whose request is in progress.
+        while (pCHiP->requestBusy)
+        {
+            uint64_t deadline = chipClockGetMicroseconds(pCHiP->pClock) + REQUEST_LOCK_WAIT_US;
+
+            chipClockWaitUntil(pCHiP->pClock, &pCHiP->requestCondition, &pCHiP->requestMutex, deadline);
+        }
+        pCHiP->requestBusy = 1;
+        pCHiP->requestOwner = pthread_self();
+    }
+    pthread_mutex_unlock(&pCHiP->requestMutex);
+}
+
+static void unlockRequests(CHiP* pCHiP)
+{
+    pthread_mutex_lock(&pCHiP->requestMutex);
+    {
+        pCHiP->requestBusy = 0;
+        pthread_cond_signal(&pCHiP->requestCondition);
+        if (pCHiP->isStartRefused)
+        {
+            pCHiP->isStartRefused = 0;
+            raiseEvents(pCHiP, CHIP_EVENT_READY);
+        }
+    }
+    pthread_mutex_unlock(&pCHiP->requestMutex);
 }
 
 int chipRawReceiveNotification(CHiP* pCHiP, uint8_t* pNotifyBuffer, size_t notifyBufferSize, size_t* pNotifyLength)
@@ -517,3 +1245,795 @@ int chipRawReceiveNotification(CHiP* pCHiP, uint8_t* pNotifyBuffer, size_t notif
     assert( pCHiP );
     return chipTransportGetOutOfBandResponse(pCHiP->pTransport, pNotifyBuffer, notifyBufferSize, pNotifyLength);
 }
+
+int chipGetStats(CHiP* pCHiP, CHiPStats* pStats)
+{
+    CHiPTransportStats transportStats;
+
+    assert( pCHiP );
+    assert( pStats );
+
+    chipStatsSnapshot(&pCHiP->stats, pStats);
+    chipTransportGetStats(pCHiP->pTransport, &transportStats);
+    pStats->retries = transportStats.retries;
+    pStats->timeouts = transportStats.timeouts;
+    pStats->oobDrops = transportStats.oobDrops;
+    pStats->oobQueueDepth = transportStats.oobQueueDepth;
+    pStats->connected = transportStats.connected;
+
+    return CHIP_ERROR_NONE;
+}
+
+int chipSetCacheMaxAge(CHiP* pCHiP, CHiPCacheField field, uint32_t maxAgeMilliseconds)
+{
+    assert( pCHiP );
+
+    if ((unsigned int)field >= CHIP_CACHE_FIELD_COUNT)
+        return CHIP_ERROR_PARAM;
+    pthread_mutex_lock(&pCHiP->cacheMutex);
+    pCHiP->cacheMaxAges[field] = maxAgeMilliseconds;
+    pthread_mutex_unlock(&pCHiP->cacheMutex);
+
+    return CHIP_ERROR_NONE;
+}
+
+void chipInvalidateCache(CHiP* pCHiP)
+{
+    assert( pCHiP );
+
+    pthread_mutex_lock(&pCHiP->cacheMutex);
+    pCHiP->cacheValidMask = 0;
+    pthread_mutex_unlock(&pCHiP->cacheMutex);
+}
+
+static int findCacheField(uint8_t command)
+{
+    int field;
+
+    for (field = 0 ; field < CHIP_CACHE_FIELD_COUNT ; field++)
+    {
+        if (g_cacheCommands[field] == command)
+            return field;
+    }
+    return -1;
+}
+
+static int readCache(CHiP* pCHiP, CHiPCacheField field, CHiPResponse* pResponse)
+{
+    uint64_t now = chipTransportGetMicroseconds(pCHiP->pTransport);
+    uint32_t maxAge;
+    int      isHit = 0;
+
+    pthread_mutex_lock(&pCHiP->cacheMutex);
+    maxAge = pCHiP->cacheMaxAges[field];
+    // A max age of 0 disables caching of the field so it is always a miss, even when written this microsecond.
+    if ((pCHiP->cacheValidMask & (1U << field)) && maxAge != 0 &&
+        (maxAge == CHIP_CACHE_FOREVER || now - pCHiP->cacheTimestamps[field] <= (uint64_t)maxAge * 1000))
+    {
+        *pResponse = pCHiP->cacheValues[field];
+        isHit = 1;
+    }
+    pthread_mutex_unlock(&pCHiP->cacheMutex);
+
+    return isHit;
+}
+
+static void writeCache(CHiP* pCHiP, const CHiPResponse* pResponse)
+{
+    int field = findCacheField(pResponse->command);
+
+    if (field < 0)
+        return;
+    pthread_mutex_lock(&pCHiP->cacheMutex);
+    pCHiP->cacheValues[field] = *pResponse;
+    pCHiP->cacheTimestamps[field] = chipTransportGetMicroseconds(pCHiP->pTransport);
+    pCHiP->cacheValidMask |= 1U << field;
+    pthread_mutex_unlock(&pCHiP->cacheMutex);
+}
+
+static void invalidateCacheField(CHiP* pCHiP, CHiPCacheField field)
+{
+    pthread_mutex_lock(&pCHiP->cacheMutex);
+    pCHiP->cacheValidMask &= ~(1U << field);
+    pthread_mutex_unlock(&pCHiP->cacheMutex);
+}
+
+static void writeCacheFromRequest(CHiP* pCHiP, const uint8_t* pRequest, size_t requestLength)
+{
+    CHiPResponse response;
+
+    // Setters are recognized here rather than in each chipSet*() function so that the same settings sent through
+    // chipRawSend(), a timeline or a choreography also keep the cache up to date.
+    memset(&response, 0, sizeof(response));
+    switch (pRequest[0])
+    {
+    case CHIP_CMD_SET_SPEED:
+        if (requestLength != CHIP_CMD_SET_SPEED_REQUEST_LEN || pRequest[1] > CHIP_SPEED_KID)
+            return;
+        response.command = CHIP_CMD_GET_SPEED;
+        response.speed = pRequest[1];
+        break;
+    case CHIP_CMD_SET_EYE_BRIGHTNESS:
+        if (requestLength != CHIP_CMD_SET_EYE_BRIGHTNESS_REQUEST_LEN)
+            return;
+        response.command = CHIP_CMD_GET_EYE_BRIGHTNESS;
+        response.eyeBrightness = pRequest[1];
+        break;
+    case CHIP_CMD_SET_VOLUME:
+        if (requestLength != CHIP_CMD_SET_VOLUME_REQUEST_LEN || pRequest[1] < 1 || pRequest[1] > 11)
+            return;
+        response.command = CHIP_CMD_GET_VOLUME;
+        response.volume = pRequest[1];
+        break;
+    case CHIP_CMD_SET_ALARM_DATE_TIME:
+        // A cancelled alarm is sent as all zeroes and what the robot reports back for it isn't known, so drop it.
+        if (requestLength != CHIP_CMD_SET_ALARM_DATE_TIME_REQUEST_LEN || pRequest[3] == 0)
+        {
+            invalidateCacheField(pCHiP, CHIP_CACHE_ALARM_DATE_TIME);
+            return;
+        }
+        response.command = CHIP_CMD_GET_ALARM_DATE_TIME;
+        response.alarmDateTime.year = ((uint16_t)pRequest[1] << 8) | (uint16_t)pRequest[2];
+        response.alarmDateTime.month = pRequest[3];
+        response.alarmDateTime.day = pRequest[4];
+        response.alarmDateTime.hour = pRequest[5];
+        response.alarmDateTime.minute = pRequest[6];
+        break;
+    default:
+        return;
+    }
+    writeCache(pCHiP, &response);
+}
+
+static int startWarmingCache(CHiP* pCHiP)
+{
+    uint32_t fieldMask = 0;
+    int      field;
+
+    pthread_mutex_lock(&pCHiP->cacheMutex);
+    for (field = 0 ; field < CHIP_CACHE_FIELD_COUNT ; field++)
+    {
+        if (pCHiP->cacheMaxAges[field])
+            fieldMask |= 1U << field;
+    }
+    pthread_mutex_unlock(&pCHiP->cacheMutex);
+    if (fieldMask == 0)
+        return CHIP_ERROR_NONE;
+
+    // Attach on behalf of the new thread before it starts so that a virtual clock can't advance without it.
+    atomic_store(&pCHiP->stopWarming, 0);
+    chipClockAttachThread(pCHiP->pClock);
+    if (pthread_create(&pCHiP->warmThread, NULL, warmCacheThread, pCHiP))
+    {
+        chipClockDetachThread(pCHiP->pClock);
+        return CHIP_ERROR_MEMORY;
+    }
+    pCHiP->warmThreadStarted = 1;
+
+    return CHIP_ERROR_NONE;
+}
+
+static void stopWarmingCache(CHiP* pCHiP)
+{
+    if (!pCHiP->warmThreadStarted)
+        return;
+    atomic_store(&pCHiP->stopWarming, 1);
+    pthread_join(pCHiP->warmThread, NULL);
+    pCHiP->warmThreadStarted = 0;
+}
+
+static void* warmCacheThread(void* pv)
+{
+    CHiP* pCHiP = (CHiP*)pv;
+    int   field;
+
+    for (field = 0 ; field < CHIP_CACHE_FIELD_COUNT && !atomic_load(&pCHiP->stopWarming) ; field++)
+    {
+        CHiPResponse response;
+        uint32_t     maxAge;
+
+        pthread_mutex_lock(&pCHiP->cacheMutex);
+        maxAge = pCHiP->cacheMaxAges[field];
+        pthread_mutex_unlock(&pCHiP->cacheMutex);
+        // Errors are ignored since the application's own read of the field will go to the robot and report them.
+        if (maxAge)
+            receiveCachedResponse(pCHiP, field, &response);
+    }
+
+    chipClockDetachThread(pCHiP->pClock);
+    return NULL;
+}
+
+int chipSetDebounceWindow(CHiP* pCHiP, uint32_t windowMilliseconds)
+{
+    assert( pCHiP );
+
+    pthread_mutex_lock(&pCHiP->debounceMutex);
+    {
+        pCHiP->debounceWindow = (uint64_t)windowMilliseconds * 1000;
+        // Values already pending become due sooner, or straight away, when the window shrinks.
+        pthread_cond_signal(&pCHiP->debounceCondition);
+    }
+    pthread_mutex_unlock(&pCHiP->debounceMutex);
+
+    if (windowMilliseconds == 0)
+        return chipFlushDebounced(pCHiP);
+    return CHIP_ERROR_NONE;
+}
+
+int chipFlushDebounced(CHiP* pCHiP)
+{
+    int result = CHIP_ERROR_NONE;
+
+    assert( pCHiP );
+
+    for (;;)
+    {
+        uint8_t  request[DEBOUNCE_REQUEST_LEN];
+        uint64_t nextDue;
+        int      isTaken;
+        int      sendResult;
+
+        pthread_mutex_lock(&pCHiP->debounceMutex);
+            isTaken = takePendingSetting(pCHiP, chipClockGetMicroseconds(pCHiP->pClock), 1, request, &nextDue);
+        pthread_mutex_unlock(&pCHiP->debounceMutex);
+        if (!isTaken)
+            break;
+
+        sendResult = chipRawSend(pCHiP, request, sizeof(request));
+        if (sendResult && !result)
+            result = sendResult;
+    }
+
+    return result;
+}
+
+static int sendDebounced(CHiP* pCHiP, DebounceSetting setting, uint8_t value)
+{
+    DebouncedSetting* pSetting = &pCHiP->debounced[setting];
+    uint8_t           request[DEBOUNCE_REQUEST_LEN] = { g_debounceCommands[setting], value };
+    int               isQueued = 0;
+
+    pthread_mutex_lock(&pCHiP->debounceMutex);
+    {
+        uint64_t now = chipClockGetMicroseconds(pCHiP->pClock);
+
+        // A value is sent straight away unless the same setting was already sent within the window, so a single
+        // change, or the first of a burst, is never delayed.  Values which follow it in the window replace each other
+        // and only the last one is sent by the flushing thread once the window has passed.
+        if (pCHiP->debounceWindow != 0 &&
+            (pSetting->isPending || (pSetting->hasSent && now - pSetting->lastSent < pCHiP->debounceWindow)) &&
+            startDebounceThread(pCHiP) == CHIP_ERROR_NONE)
+        {
+            if (pSetting->isPending)
+                chipStatsRecordDebounced(&pCHiP->stats);
+            pSetting->value = value;
+            pSetting->isPending = 1;
+            pthread_cond_signal(&pCHiP->debounceCondition);
+            isQueued = 1;
+        }
+        else
+        {
+            // Any value still pending, left by a window which has since shrunk to 0 or a flushing thread which failed
+            // to start, is older than this one and mustn't be flushed after it.
+            if (pSetting->isPending)
+                chipStatsRecordDebounced(&pCHiP->stats);
+            pSetting->isPending = 0;
+            pSetting->lastSent = now;
+            pSetting->hasSent = 1;
+        }
+    }
+    pthread_mutex_unlock(&pCHiP->debounceMutex);
+
+    if (!isQueued)
+        return chipRawSend(pCHiP, request, sizeof(request));
+
+    // The getters should see the value last written even though it hasn't reached the robot yet.
+    writeCacheFromRequest(pCHiP, request, sizeof(request));
+    return CHIP_ERROR_NONE;
+}
+
+static int startDebounceThread(CHiP* pCHiP)
+{
+    // Called with debounceMutex held.
+    if (pCHiP->debounceThreadRunning)
+        return CHIP_ERROR_NONE;
+    // A thread which has already exited only needs to be reaped.  It no longer touches debounceMutex after clearing
+    // debounceThreadRunning so it is safe to join here.
+    if (pCHiP->debounceThreadStarted)
+    {
+        pthread_join(pCHiP->debounceThread, NULL);
+        pCHiP->debounceThreadStarted = 0;
+    }
+
+    // Attach on behalf of the new thread before it starts so that a virtual clock can't advance without it.
+    chipClockAttachThread(pCHiP->pClock);
+    if (pthread_create(&pCHiP->debounceThread, NULL, debounceThread, pCHiP))
+    {
+        chipClockDetachThread(pCHiP->pClock);
+        return CHIP_ERROR_MEMORY;
+    }
+    pCHiP->debounceThreadStarted = 1;
+    pCHiP->debounceThreadRunning = 1;
+
+    return CHIP_ERROR_NONE;
+}
+
+static void stopDebounceThread(CHiP* pCHiP)
+{
+    int isStarted;
+
+    pthread_mutex_lock(&pCHiP->debounceMutex);
+    {
+        pCHiP->stopDebouncing = 1;
+        pthread_cond_signal(&pCHiP->debounceCondition);
+        isStarted = pCHiP->debounceThreadStarted;
+        pCHiP->debounceThreadStarted = 0;
+    }
+    pthread_mutex_unlock(&pCHiP->debounceMutex);
+    if (isStarted)
+        pthread_join(pCHiP->debounceThread, NULL);
+
+    pthread_mutex_lock(&pCHiP->debounceMutex);
+        pCHiP->stopDebouncing = 0;
+    pthread_mutex_unlock(&pCHiP->debounceMutex);
+}
+
+static void* debounceThread(void* pv)
+{
+    CHiP* pCHiP = (CHiP*)pv;
+
+    pthread_mutex_lock(&pCHiP->debounceMutex);
+    while (!pCHiP->stopDebouncing)
+    {
+        uint8_t  request[DEBOUNCE_REQUEST_LEN];
+        uint64_t nextDue;
+
+        if (takePendingSetting(pCHiP, chipClockGetMicroseconds(pCHiP->pClock), 0, request, &nextDue))
+        {
+            // There is no caller left to report a failure to.  The value is still in the settings cache, as for a
+            // failed chipSet*() call which is retried by the application.
+            pthread_mutex_unlock(&pCHiP->debounceMutex);
+            chipRawSend(pCHiP, request, sizeof(request));
+            pthread_mutex_lock(&pCHiP->debounceMutex);
+            continue;
+        }
+        if (nextDue == UINT64_MAX)
+            break;
+        chipClockWaitUntil(pCHiP->pClock, &pCHiP->debounceCondition, &pCHiP->debounceMutex, nextDue);
+    }
+    pCHiP->debounceThreadRunning = 0;
+    pthread_mutex_unlock(&pCHiP->debounceMutex);
+
+    chipClockDetachThread(pCHiP->pClock);
+    return NULL;
+}
+
+static int takePendingSetting(CHiP* pCHiP, uint64_t now, int isForced, uint8_t* pRequest, uint64_t* pNextDue)
+{
+    size_t i;
+
+    // Called with debounceMutex held.  Takes the first pending value which is due, or any pending value if isForced
+    // is set, and marks it as sent.  Otherwise pNextDue is set to the time at which the next one falls due.
+    *pNextDue = UINT64_MAX;
+    for (i = 0 ; i < DEBOUNCE_SETTING_COUNT ; i++)
+    {
+        DebouncedSetting* pSetting = &pCHiP->debounced[i];
+        uint64_t          due = pSetting->lastSent + pCHiP->debounceWindow;
+
+        if (!pSetting->isPending)
+            continue;
+        if (isForced || due <= now)
+        {
+            pRequest[0] = g_debounceCommands[i];
+            pRequest[1] = pSetting->value;
+            pSetting->isPending = 0;
+            pSetting->lastSent = now;
+            pSetting->hasSent = 1;
+            return 1;
+        }
+        if (due < *pNextDue)
+            *pNextDue = due;
+    }
+
+    return 0;
+}
+
+int chipGetPollFd(CHiP* pCHiP)
+{
+    int fds[2];
+
+    assert( pCHiP );
+
+    pthread_mutex_lock(&pCHiP->requestMutex);
+    {
+        if (pCHiP->eventReadFd < 0 && pipe(fds) == 0)
+        {
+            // Neither end can be allowed to block.  A full pipe already wakes the reader so failed writes don't matter.
+            fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+            fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+            fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+            fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+            pCHiP->eventReadFd = fds[0];
+            atomic_store(&pCHiP->eventWriteFd, fds[1]);
+
+            // Events which arrived before the pipe existed still need to wake up the first poll.
+            if (atomic_load(&pCHiP->pendingEvents))
+                signalPollFd(pCHiP);
+        }
+    }
+    pthread_mutex_unlock(&pCHiP->requestMutex);
+
+    return pCHiP->eventReadFd;
+}
+
+uint32_t chipProcessEvents(CHiP* pCHiP)
+{
+    uint32_t events;
+
+    assert( pCHiP );
+
+    // Empty the pipe before collecting the events so that any event reported after this point writes to it again.
+    if (pCHiP->eventReadFd >= 0)
+    {
+        uint8_t buffer[64];
+
+        while (read(pCHiP->eventReadFd, buffer, sizeof(buffer)) > 0)
+        {
+        }
+    }
+    // Responses are only reported once the request they belong to has completed, which can also happen on a timeout.
+    events = atomic_exchange(&pCHiP->pendingEvents, 0) & ~CHIP_EVENT_RESPONSE;
+    if (updateAsyncRequest(pCHiP))
+        events |= CHIP_EVENT_RESPONSE;
+
+    return events;
+}
+
+int chipGetPollTimeout(CHiP* pCHiP)
+{
+    uint64_t deadline;
+    uint64_t responseTime;
+    uint64_t now;
+    uint64_t milliseconds;
+
+    assert( pCHiP );
+
+    // Nothing more happens to a completed request until its response is collected.
+    if (pCHiP->asyncState != ASYNC_WAITING)
+        return -1;
+
+    deadline = pCHiP->asyncDeadline;
+    responseTime = chipTransportGetResponseTime(pCHiP->pTransport);
+    if (responseTime < deadline)
+        deadline = responseTime;
+    now = chipClockGetMicroseconds(pCHiP->pClock);
+    if (deadline <= now)
+        return 0;
+    // Round up so that a poll() which times out is never woken before the deadline.
+    milliseconds = (deadline - now + 999) / 1000;
+    return milliseconds > INT_MAX ? INT_MAX : (int)milliseconds;
+}
+
+int chipStartRequest(CHiP* pCHiP, const uint8_t* pRequest, size_t requestLength)
+{
+    int result;
+
+    assert( pCHiP );
+    assert( pRequest );
+
+    if (requestLength < 1 || requestLength > CHIP_REQUEST_MAX_LEN)
+        return CHIP_ERROR_PARAM;
+    if (pCHiP->asyncState != ASYNC_IDLE)
+        return CHIP_ERROR_BUSY;
+    if (!tryLockRequests(pCHiP))
+        return CHIP_ERROR_BUSY;
+
+    memcpy(pCHiP->asyncRequest, pRequest, requestLength);
+    pCHiP->asyncRequestLength = requestLength;
+    pCHiP->asyncRetries = ASYNC_MAXIMUM_RETRIES;
+    pCHiP->asyncStartTime = chipTransportGetMicroseconds(pCHiP->pTransport);
+    chipStatsRecordWrite(&pCHiP->stats, requestLength);
+    result = sendAsyncRequest(pCHiP);
+    if (result)
+    {
+        unlockRequests(pCHiP);
+        return result;
+    }
+    pCHiP->asyncState = ASYNC_WAITING;
+
+    return CHIP_ERROR_NONE;
+}
+
+int chipGetRequestResponse(CHiP* pCHiP, uint8_t* pResponseBuffer, size_t responseBufferSize, size_t* pResponseLength)
+{
+    size_t copyLength;
+
+    assert( pCHiP );
+    assert( pResponseBuffer );
+    assert( pResponseLength );
+
+    updateAsyncRequest(pCHiP);
+    if (pCHiP->asyncState == ASYNC_IDLE)
+        return CHIP_ERROR_NO_REQUEST;
+    if (pCHiP->asyncState == ASYNC_WAITING)
+        return CHIP_ERROR_EMPTY;
+
+    pCHiP->asyncState = ASYNC_IDLE;
+    if (pCHiP->asyncResult)
+        return pCHiP->asyncResult;
+    copyLength = pCHiP->asyncResponseLength;
+    if (copyLength > responseBufferSize)
+        copyLength = responseBufferSize;
+    memcpy(pResponseBuffer, pCHiP->asyncResponse, copyLength);
+    *pResponseLength = copyLength;
+
+    return CHIP_ERROR_NONE;
+}
+
+void chipCancelRequest(CHiP* pCHiP)
+{
+    assert( pCHiP );
+
+    cancelAsyncRequest(pCHiP);
+    pCHiP->asyncState = ASYNC_IDLE;
+}
+
+int chipWaitAny(CHiP** ppCHiPs, size_t count, int timeoutMilliseconds, uint32_t* pEvents, size_t* pReadyCount)
+{
+    CHiPClock*     pClock = NULL;
+    struct pollfd* pFds = NULL;
+    uint64_t       deadline = UINT64_MAX;
+    size_t         readyCount = 0;
+    size_t         i;
+    int            isRealClock;
+    int            result = CHIP_ERROR_NONE;
+
+    assert( ppCHiPs );
+    assert( pEvents );
+
+    if (count == 0)
+        return CHIP_ERROR_PARAM;
+    // Deadlines from chipGetPollTimeout() are measured on the robots' clock so all waiting is done against it too.
+    pClock = ppCHiPs[0]->pClock;
+    isRealClock = pClock == chipClockGetReal();
+    if (isRealClock)
+    {
+        pFds = malloc(count * sizeof(*pFds));
+        if (!pFds)
+            return CHIP_ERROR_MEMORY;
+        for (i = 0 ; i < count ; i++)
+        {
+            pFds[i].fd = chipGetPollFd(ppCHiPs[i]);
+            pFds[i].events = POLLIN;
+            if (pFds[i].fd < 0)
+            {
+                result = CHIP_ERROR_MEMORY;
+                goto Error;
+            }
+        }
+    }
+    if (timeoutMilliseconds >= 0)
+        deadline = chipClockGetMicroseconds(pClock) + (uint64_t)timeoutMilliseconds * 1000;
+
+    for (;;)
+    {
+        uint64_t now;
+        uint64_t waitDeadline = deadline;
+
+        // Every robot is checked after each wakeup, rather than just those whose descriptor is readable, since
+        // resends and timeouts are only noticed by chipProcessEvents() when asked.
+        for (i = 0 ; i < count ; i++)
+        {
+            pEvents[i] = chipProcessEvents(ppCHiPs[i]);
+            if (pEvents[i])
+                readyCount++;
+        }
+        if (readyCount > 0)
+            break;
+
+        now = chipClockGetMicroseconds(pClock);
+        if (now >= deadline)
+        {
+            result = CHIP_ERROR_TIMEOUT;
+            break;
+        }
+        for (i = 0 ; i < count ; i++)
+        {
+            int robotTimeout = chipGetPollTimeout(ppCHiPs[i]);
+
+            if (robotTimeout >= 0 && now + (uint64_t)robotTimeout * 1000 < waitDeadline)
+                waitDeadline = now + (uint64_t)robotTimeout * 1000;
+        }
+
+        if (!isRealClock)
+        {
+            waitForEvents(ppCHiPs, count, pClock, waitDeadline);
+        }
+        else
+        {
+            uint64_t pollTimeout = waitDeadline == UINT64_MAX ? UINT64_MAX : (waitDeadline - now + 999) / 1000;
+
+            if (poll(pFds, count, pollTimeout > INT_MAX ? -1 : (int)pollTimeout) < 0 && errno != EINTR)
+            {
+                result = errno == ENOMEM ? CHIP_ERROR_MEMORY : CHIP_ERROR_PARAM;
+                break;
+            }
+        }
+    }
+
+Error:
+    free(pFds);
+    if (pReadyCount)
+        *pReadyCount = readyCount;
+    return result;
+}
+
+static void waitForEvents(CHiP** ppCHiPs, size_t count, CHiPClock* pClock, uint64_t deadline)
+{
+    size_t i;
+    int    isPending = 0;
+
+    // The waiter is counted before pendingEvents is checked and raiseEvents() sets pendingEvents before checking the
+    // count, so an event raised during the check is either seen here or broadcast once this thread is waiting.
+    atomic_fetch_add(&g_eventWaiterCount, 1);
+    pthread_mutex_lock(&g_eventWaitMutex);
+    {
+        for (i = 0 ; i < count && !isPending ; i++)
+            isPending = atomic_load(&ppCHiPs[i]->pendingEvents) != 0;
+        if (!isPending)
+            chipClockWaitUntil(pClock, &g_eventWaitCondition, &g_eventWaitMutex, deadline);
+    }
+    pthread_mutex_unlock(&g_eventWaitMutex);
+    atomic_fetch_sub(&g_eventWaiterCount, 1);
+}
+
+static void handleTransportEvent(void* pContext, uint32_t transportEvents)
+{
+    CHiP*    pCHiP = (CHiP*)pContext;
+    uint32_t events = 0;
+
+    if (transportEvents & CHIP_TRANSPORT_EVENT_RESPONSE)
+        events |= CHIP_EVENT_RESPONSE;
+    if (transportEvents & CHIP_TRANSPORT_EVENT_NOTIFICATION)
+        events |= CHIP_EVENT_NOTIFICATION;
+    if (transportEvents & CHIP_TRANSPORT_EVENT_CONNECTION)
+        events |= CHIP_EVENT_CONNECTION;
+    raiseEvents(pCHiP, events);
+}
+
+static void raiseEvents(CHiP* pCHiP, uint32_t events)
+{
+    // Only the first event since the last chipProcessEvents() call needs to wake up the poll.
+    if (atomic_fetch_or(&pCHiP->pendingEvents, events) != 0)
+        return;
+    signalPollFd(pCHiP);
+    if (atomic_load(&g_eventWaiterCount) > 0)
+    {
+        pthread_mutex_lock(&g_eventWaitMutex);
+            pthread_cond_broadcast(&g_eventWaitCondition);
+        pthread_mutex_unlock(&g_eventWaitMutex);
+    }
+}
+
+static void signalPollFd(CHiP* pCHiP)
+{
+    int     fd = atomic_load(&pCHiP->eventWriteFd);
+    uint8_t byte = 0;
+
+    if (fd < 0)
+        return;
+    while (write(fd, &byte, sizeof(byte)) < 0 && errno == EINTR)
+    {
+    }
+}
+
+static int tryLockRequests(CHiP* pCHiP)
+{
+    int isLocked = 0;
+
+    pthread_mutex_lock(&pCHiP->requestMutex);
+    {
+        if (!pCHiP->requestBusy)
+        {
+            pCHiP->requestBusy = 1;
+            pCHiP->requestOwner = pthread_self();
+            isLocked = 1;
+        }
+        else
+        {
+            pCHiP->isStartRefused = 1;
+        }
+    }
+    pthread_mutex_unlock(&pCHiP->requestMutex);
+
+    return isLocked;
+}
+
+static int sendAsyncRequest(CHiP* pCHiP)
+{
+    int result;
+
+    result = chipTransportSendRequest(pCHiP->pTransport, pCHiP->asyncRequest, pCHiP->asyncRequestLength,
+                                      CHIP_EXPECT_RESPONSE);
+    pCHiP->asyncDeadline = chipClockGetMicroseconds(pCHiP->pClock) + ASYNC_RESPONSE_TIMEOUT_US;
+    return result;
+}
+
+static int updateAsyncRequest(CHiP* pCHiP)
+{
+    CHiPTransportStats transportStats;
+    const uint8_t*     pResponse;
+    size_t             responseLength;
+    int                result;
+
+    // Returns non-zero when the request completes, successfully or not, during this call.
+    if (pCHiP->asyncState != ASYNC_WAITING)
+        return 0;
+
+    if (chipTransportIsResponseAvailable(pCHiP->pTransport))
+    {
+        CHiPResponse decoded;
+
+        result = chipTransportBorrowResponse(pCHiP->pTransport, &pResponse, &responseLength);
+        if (result == CHIP_ERROR_NONE)
+        {
+            memcpy(pCHiP->asyncResponse, pResponse, responseLength);
+            pCHiP->asyncResponseLength = responseLength;
+            chipTransportReleaseResponse(pCHiP->pTransport);
+            chipStatsRecordRead(&pCHiP->stats, responseLength);
+            chipStatsRecordRoundTrip(&pCHiP->stats, pCHiP->asyncRequest[0],
+                                     chipTransportGetMicroseconds(pCHiP->pTransport) - pCHiP->asyncStartTime);
+
+            // Keep the settings cache and last battery level as fresh as the blocking getters would have.
+            if (chipDecodeResponse(pCHiP->asyncResponse, responseLength, &decoded) == CHIP_ERROR_NONE &&
+                decoded.command == pCHiP->asyncRequest[0])
+            {
+                writeCache(pCHiP, &decoded);
+                if (decoded.command == CHIP_CMD_GET_BATTERY_LEVEL)
+                    publishBatteryLevel(pCHiP, &decoded.batteryLevel);
+            }
+        }
+        completeAsyncRequest(pCHiP, result);
+        return 1;
+    }
+
+    chipTransportGetStats(pCHiP->pTransport, &transportStats);
+    if (!transportStats.connected)
+    {
+        chipTransportAbandonRequest(pCHiP->pTransport);
+        completeAsyncRequest(pCHiP, CHIP_ERROR_NOT_CONNECTED);
+        return 1;
+    }
+    if (chipClockGetMicroseconds(pCHiP->pClock) < pCHiP->asyncDeadline)
+        return 0;
+
+    chipTransportAbandonRequest(pCHiP->pTransport);
+    if (pCHiP->asyncRetries-- == 0)
+    {
+        completeAsyncRequest(pCHiP, CHIP_ERROR_TIMEOUT);
+        return 1;
+    }
+    result = sendAsyncRequest(pCHiP);
+    if (result)
+    {
+        completeAsyncRequest(pCHiP, result);
+        return 1;
+    }
+    return 0;
+}
+
+static void completeAsyncRequest(CHiP* pCHiP, int result)
+{
+    pCHiP->asyncResult = result;
+    pCHiP->asyncState = ASYNC_COMPLETE;
+    unlockRequests(pCHiP);
+}
+
+static void cancelAsyncRequest(CHiP* pCHiP)
+{
+    if (pCHiP->asyncState != ASYNC_WAITING)
+        return;
+    chipTransportAbandonRequest(pCHiP->pTransport);
+    completeAsyncRequest(pCHiP, CHIP_ERROR_NO_REQUEST);
+}
@@ -0,0 +1,61 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Compiles a text choreography into the binary form played back by chipChoreographyPlay().
+
+   Usage: choreoc source.txt output.chrg
+*/
+#include <stdio.h>
+#include "chip-choreography.h"
+
+
+int main(int argc, char** argv)
+{
+    const CHiPChoreographyHeader* pHeader;
+    CHiPChoreography*             pChoreography;
+    size_t                        errorLine = 0;
+    int                           result;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s source.txt output.chrg\n", argv[0]);
+        return 1;
+    }
+
+    result = chipChoreographyCompile(argv[1], argv[2], &errorLine);
+    if (result == CHIP_ERROR_PARAM)
+    {
+        fprintf(stderr, "%s:%zu: error: invalid cue\n", argv[1], errorLine);
+        return 1;
+    }
+    if (result)
+    {
+        fprintf(stderr, "error: failed to compile %s into %s\n", argv[1], argv[2]);
+        return 1;
+    }
+
+    // Map the result back in as a check that it will load for playback.
+    pChoreography = chipChoreographyOpen(argv[2]);
+    if (!pChoreography)
+    {
+        fprintf(stderr, "error: failed to open compiled %s\n", argv[2]);
+        return 1;
+    }
+    pHeader = chipChoreographyGetHeader(pChoreography);
+    printf("%s: %u frames, %u.%06u seconds\n", argv[2], pHeader->frameCount,
+           pHeader->durationMicroseconds / 1000000, pHeader->durationMicroseconds % 1000000);
+    chipChoreographyClose(pChoreography);
+
+    return 0;
+}
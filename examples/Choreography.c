@@ -0,0 +1,70 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Example used in following API documentation:
+    chipChoreographyOpen()
+    chipChoreographyPlay()
+    chipChoreographyClose()
+
+   Usage: Choreography routine.chrg
+   Compile examples/Choreography.txt with bin/choreoc to get a routine to try.
+*/
+#include <stdio.h>
+#include "chip.h"
+#include "chip-choreography.h"
+#include "osxble.h"
+
+
+static const char* g_pFilename;
+
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s routine.chrg\n", argv[0]);
+        return 1;
+    }
+    g_pFilename = argv[1];
+
+    // Initialize the Core Bluetooth stack on this the main thread and start the worker robot thread to run the
+    // code found in robotMain() below.
+    osxCHiPInitAndRun();
+    return 0;
+}
+
+void robotMain(void)
+{
+    int               result = -1;
+    CHiP*             pCHiP = chipInit(NULL);
+    CHiPChoreography* pChoreography = chipChoreographyOpen(g_pFilename);
+
+    printf("\tChoreography.c - Use chipChoreographyPlay() function.\n");
+    if (!pChoreography)
+    {
+        printf("Failed to open %s\n", g_pFilename);
+        chipUninit(pCHiP);
+        return;
+    }
+
+    // Connect to first CHiP robot discovered.
+    result = chipConnectToRobot(pCHiP, NULL);
+
+    printf("Playing %s\n", g_pFilename);
+    result = chipChoreographyPlay(pCHiP, pChoreography, 0);
+    printf("Finished with result = %d\n", result);
+
+    chipChoreographyClose(pChoreography);
+    chipUninit(pCHiP);
+}
@@ -52,6 +52,9 @@ void robotMain(void)
     CHiP* pCHiP = chipInit(NULL);
     chipConnectToRobot(pCHiP, NULL);
 
+    // Keep the battery level up to date in the background so that showing it never waits on the robot.
+    chipStartBatteryPoller(pCHiP, 5000, 60000);
+
     // Initialize curses to get direct keyboard input for controlling CHiP.
     // Use halfdelay(1) to disable line buffering and only block 1/10th of a second waiting for next keypress.
     // Use noecho() to not echo each character to the console and keypad(*, TRUE) to enable arrow keys.
@@ -177,7 +180,8 @@ static void showCommands()
 static void showBatteryLevel(CHiP* pCHiP)
 {
     CHiPBatteryLevel batteryLevel;
-    chipGetBatteryLevel(pCHiP, &batteryLevel);
+    if (chipGetLastBatteryLevel(pCHiP, &batteryLevel, NULL) != CHIP_ERROR_NONE)
+        chipGetBatteryLevel(pCHiP, &batteryLevel);
 
     printw("  Battery level: %.1f%%\n", batteryLevel.batteryLevel * 100.0f);
 
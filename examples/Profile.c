@@ -0,0 +1,73 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Example used in following API documentation:
+    chipProfileCapture()
+    chipProfileApply()
+*/
+#include <stdio.h>
+#include <time.h>
+#include "chip.h"
+#include "chip-profile.h"
+#include "osxble.h"
+
+
+int main(int argc, char *argv[])
+{
+    // Initialize the Core Bluetooth stack on this the main thread and start the worker robot thread to run the
+    // code found in robotMain() below.
+    osxCHiPInitAndRun();
+    return 0;
+}
+
+void robotMain(void)
+{
+    int               result = -1;
+    CHiP*             pCHiP = chipInit(NULL);
+    CHiPProfile       profile;
+    CHiPProfileReport report;
+    time_t            now;
+    struct tm*        pNow;
+
+    printf("\tProfile.c - Use chipProfileCapture() and chipProfileApply().\n");
+
+    // Connect to first CHiP robot discovered.
+    result = chipConnectToRobot(pCHiP, NULL);
+
+    result = chipProfileCapture(pCHiP, &profile);
+    printf("Captured volume = %u, eye brightness = %u\n", profile.volume, profile.eyeBrightness);
+
+    // Turn the volume down, cancel any alarm and set the robot's clock if it is more than 2 seconds off.
+    now = time(NULL);
+    pNow = localtime(&now);
+    profile.fieldMask = CHIP_STATUS_VOLUME | CHIP_STATUS_CURRENT_DATE_TIME | CHIP_STATUS_ALARM_DATE_TIME;
+    profile.volume = 3;
+    profile.currentDateTime.year = pNow->tm_year + 1900;
+    profile.currentDateTime.month = pNow->tm_mon + 1;
+    profile.currentDateTime.day = pNow->tm_mday;
+    profile.currentDateTime.hour = pNow->tm_hour;
+    profile.currentDateTime.minute = pNow->tm_min;
+    profile.currentDateTime.second = pNow->tm_sec < 60 ? pNow->tm_sec : 59;
+    profile.currentDateTime.dayOfWeek = pNow->tm_wday;
+    profile.clockToleranceSeconds = 2;
+    profile.alarmDateTime.month = 0;
+
+    // Applying the same profile a second time finds nothing left to write.
+    result = chipProfileApply(pCHiP, &profile, &report);
+    printf("First apply: written = 0x%02X, unchanged = 0x%02X\n", report.writtenMask, report.unchangedMask);
+    result = chipProfileApply(pCHiP, &profile, &report);
+    printf("Second apply: written = 0x%02X, unchanged = 0x%02X\n", report.writtenMask, report.unchangedMask);
+
+    chipUninit(pCHiP);
+}
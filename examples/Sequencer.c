@@ -0,0 +1,65 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Example used in following API documentation:
+    chipActionAndWait()
+    chipSequencerCreate()
+    chipSequencerAddSound()
+    chipSequencerAddAction()
+    chipSequencerAddPause()
+    chipSequencerRun()
+    chipSequencerFree()
+*/
+#include <stdio.h>
+#include "chip.h"
+#include "chip-sequencer.h"
+#include "osxble.h"
+
+
+int main(int argc, char *argv[])
+{
+    // Initialize the Core Bluetooth stack on this the main thread and start the worker robot thread to run the
+    // code found in robotMain() below.
+    osxCHiPInitAndRun();
+    return 0;
+}
+
+void robotMain(void)
+{
+    int            result = -1;
+    CHiP*          pCHiP = chipInit(NULL);
+    CHiPSequencer* pSequencer = chipSequencerCreate();
+
+    printf("\tSequencer.c - Use chipSequencer*() functions.\n");
+
+    // Connect to first CHiP robot discovered.
+    result = chipConnectToRobot(pCHiP, NULL);
+
+    printf("Sit and wait for it to finish\n");
+    result = chipActionAndWait(pCHiP, CHIP_ACTION_SIT);
+
+    // Count to three, bark and then stand back up, with each step starting as the last one ends.
+    result = chipSequencerAddSound(pSequencer, CHIP_SOUND_ONE_A34);
+    result = chipSequencerAddSound(pSequencer, CHIP_SOUND_TWO_A34);
+    result = chipSequencerAddSound(pSequencer, CHIP_SOUND_THREE_A34);
+    result = chipSequencerAddPause(pSequencer, 250000);
+    result = chipSequencerAddSound(pSequencer, CHIP_SOUND_CHIP_DOG_BARK_MULTI_1);
+    result = chipSequencerAddAction(pSequencer, CHIP_ACTION_RESET);
+    printf("Playing a %.1f second sequence\n", chipSequencerGetDuration(pSequencer) / 1000000.0);
+    result = chipSequencerRun(pSequencer, pCHiP, NULL);
+    printf("Finished with result = %d\n", result);
+
+    chipSequencerFree(pSequencer);
+    chipUninit(pCHiP);
+}
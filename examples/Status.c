@@ -0,0 +1,64 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Example used in following API documentation:
+    chipGetStatusSnapshot()
+*/
+#include <stdio.h>
+#include "chip.h"
+#include "osxble.h"
+
+
+int main(int argc, char *argv[])
+{
+    // Initialize the Core Bluetooth stack on this the main thread and start the worker robot thread to run the
+    // code found in robotMain() below.
+    osxCHiPInitAndRun();
+    return 0;
+}
+
+void robotMain(void)
+{
+    int        result = -1;
+    CHiP*      pCHiP = chipInit(NULL);
+    CHiPStatus status;
+
+    printf("\tStatus.c - Use chipGetStatusSnapshot() to read all of the robot's status at once.\n");
+
+    // Connect to first CHiP robot discovered.
+    result = chipConnectToRobot(pCHiP, NULL);
+
+    // Fields which couldn't be read are left out of validMask even when other fields were read successfully.
+    result = chipGetStatusSnapshot(pCHiP, &status);
+    if (status.validMask & CHIP_STATUS_BATTERY_LEVEL)
+        printf("battery level = %.2f%%\n", status.batteryLevel.batteryLevel * 100.0f);
+    if (status.validMask & CHIP_STATUS_SPEED)
+        printf("speed = %s\n", status.speed == CHIP_SPEED_ADULT ? "adult" : "kid");
+    if (status.validMask & CHIP_STATUS_VOLUME)
+        printf("volume = %u\n", status.volume);
+    if (status.validMask & CHIP_STATUS_EYE_BRIGHTNESS)
+        printf("eye brightness = %u\n", status.eyeBrightness);
+    if (status.validMask & CHIP_STATUS_CURRENT_DATE_TIME)
+        printf("current date/time = %04u/%02u/%02u %02u:%02u:%02u\n",
+               status.currentDateTime.year, status.currentDateTime.month, status.currentDateTime.day,
+               status.currentDateTime.hour, status.currentDateTime.minute, status.currentDateTime.second);
+    if (status.validMask & CHIP_STATUS_ALARM_DATE_TIME)
+        printf("alarm date/time = %04u/%02u/%02u %02u:%02u\n",
+               status.alarmDateTime.year, status.alarmDateTime.month, status.alarmDateTime.day,
+               status.alarmDateTime.hour, status.alarmDateTime.minute);
+    if (result)
+        printf("chipGetStatusSnapshot() failed with error %d\n", result);
+
+    chipUninit(pCHiP);
+}
@@ -0,0 +1,83 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Example used in following API documentation:
+    chipTimelineCreate()
+    chipTimelineAddRequest()
+    chipTimelineAddCall()
+    chipTimelineRun()
+    chipTimelineFree()
+*/
+#include <stdio.h>
+#include "chip.h"
+#include "chip-timeline.h"
+#include "osxble.h"
+
+
+static int playSound(CHiP* pCHiP, void* pContext)
+{
+    return chipPlaySound(pCHiP, CHIP_SOUND_BARK_X1_CURIOUS_PLAYFUL_HAPPY_A34);
+}
+
+
+int main(int argc, char *argv[])
+{
+    // Initialize the Core Bluetooth stack on this the main thread and start the worker robot thread to run the
+    // code found in robotMain() below.
+    osxCHiPInitAndRun();
+    return 0;
+}
+
+void robotMain(void)
+{
+    static const int8_t directions[][3] = { { 8, 0, 0 }, { -8, 0, 0 }, { 0, 8, 0 }, { 0, -8, 0 } };
+    int                 result = -1;
+    size_t              i;
+    size_t              j;
+    uint64_t            offset = 0;
+    CHiP*               pCHiP = chipInit(NULL);
+    CHiPTimeline*       pTimeline = chipTimelineCreate(5000);
+    CHiPTimelineReport  report;
+
+    printf("\tTimeline.c - Use chipTimeline*() functions.\n");
+
+    // Connect to first CHiP robot discovered.
+    result = chipConnectToRobot(pCHiP, NULL);
+
+    // Drive in each direction for 1 second, sending a drive frame every 50 milliseconds, with a 500 millisecond
+    // pause and a sound between each one.
+    for (i = 0 ; i < sizeof(directions) / sizeof(directions[0]) ; i++)
+    {
+        for (j = 0 ; j < 20 ; j++)
+        {
+            uint8_t request[CHIP_CMD_DRIVE_REQUEST_LEN];
+
+            chipEncodeDriveFrames(&directions[i][0], &directions[i][1], &directions[i][2], 1, request);
+            result = chipTimelineAddRequest(pTimeline, offset, request, sizeof(request));
+            offset += 50000;
+        }
+        offset += 500000;
+        result = chipTimelineAddCall(pTimeline, offset, playSound, NULL);
+    }
+
+    result = chipTimelineRun(pTimeline, pCHiP, &report);
+    printf("Dispatched %u commands in %llu microseconds\n",
+           report.commandCount, (unsigned long long)report.durationMicroseconds);
+    printf("Lateness: mean = %u us, p99 = %u us, max = %u us, late = %u\n",
+           report.meanLatenessMicroseconds, report.p99LatenessMicroseconds, report.maxLatenessMicroseconds,
+           report.lateCount);
+
+    chipTimelineFree(pTimeline);
+    chipUninit(pCHiP);
+}
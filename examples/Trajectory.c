@@ -0,0 +1,65 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Example used in following API documentation:
+    chipTrajectoryCreate()
+    chipTrajectorySetTarget()
+    chipTrajectoryAddToTimeline()
+    chipTrajectoryFree()
+*/
+#include <stdio.h>
+#include "chip.h"
+#include "chip-timeline.h"
+#include "chip-trajectory.h"
+#include "osxble.h"
+
+
+int main(int argc, char *argv[])
+{
+    // Initialize the Core Bluetooth stack on this the main thread and start the worker robot thread to run the
+    // code found in robotMain() below.
+    osxCHiPInitAndRun();
+    return 0;
+}
+
+void robotMain(void)
+{
+    static const CHiPTrajectoryLimits driveLimits = { 48.0f, 192.0f };
+    static const CHiPTrajectoryLimits spinLimits = { 96.0f, 0.0f };
+    int                               result = -1;
+    size_t                            rampUpFrames = 0;
+    size_t                            rampDownFrames = 0;
+    CHiP*                             pCHiP = chipInit(NULL);
+    CHiPTimeline*                     pTimeline = chipTimelineCreate(5000);
+    CHiPTrajectory*                   pTrajectory = chipTrajectoryCreate(&driveLimits, &driveLimits, &spinLimits,
+                                                                         50000, 0);
+
+    printf("\tTrajectory.c - Use chipTrajectory*() functions.\n");
+
+    // Connect to first CHiP robot discovered.
+    result = chipConnectToRobot(pCHiP, NULL);
+
+    // Smoothly ramp up to 75% forward speed and then back down to a stop 2 seconds later.
+    result = chipTrajectorySetTarget(pTrajectory, 24, 0, 0);
+    result = chipTrajectoryAddToTimeline(pTrajectory, pTimeline, 0, &rampUpFrames);
+    result = chipTrajectorySetTarget(pTrajectory, 0, 0, 0);
+    result = chipTrajectoryAddToTimeline(pTrajectory, pTimeline, 2000000, &rampDownFrames);
+    printf("Ramp up takes %zu frames and ramp down takes %zu frames\n", rampUpFrames, rampDownFrames);
+
+    result = chipTimelineRun(pTimeline, pCHiP, NULL);
+
+    chipTrajectoryFree(pTrajectory);
+    chipTimelineFree(pTimeline);
+    chipUninit(pCHiP);
+}
@@ -0,0 +1,105 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Example used in following API documentation:
+    chipStartRequest()
+    chipGetRequestResponse()
+    chipWaitAny()
+*/
+#include <stdio.h>
+#include <unistd.h>
+#include "chip.h"
+#include "chip-protocol.h"
+#include "osxble.h"
+
+#define MAX_ROBOTS      4
+#define READS_PER_ROBOT 5
+
+
+int main(int argc, char *argv[])
+{
+    // Initialize the Core Bluetooth stack on this the main thread and start the worker robot thread to run the
+    // code found in robotMain() below.
+    osxCHiPInitAndRun();
+    return 0;
+}
+
+void robotMain(void)
+{
+    static const uint8_t getBatteryLevel[1] = { CHIP_CMD_GET_BATTERY_LEVEL };
+    int                  result = -1;
+    size_t               robotCount = 0;
+    size_t               remaining = 0;
+    size_t               i;
+    CHiP*                pDiscovery = chipInit(NULL);
+    CHiP*                robots[MAX_ROBOTS];
+    uint32_t             events[MAX_ROBOTS];
+    int                  readCounts[MAX_ROBOTS] = { 0 };
+
+    printf("\tWaitAny.c - Use chipWaitAny() to read the battery level of several robots from one thread.\n");
+
+    // Give every powered up robot a chance to be discovered and then connect to each of them.
+    result = chipStartRobotDiscovery(pDiscovery);
+    do
+    {
+        result = chipGetDiscoveredRobotCount(pDiscovery, &robotCount);
+    } while (robotCount == 0);
+    sleep(3);
+    result = chipGetDiscoveredRobotCount(pDiscovery, &robotCount);
+    if (robotCount > MAX_ROBOTS)
+        robotCount = MAX_ROBOTS;
+    for (i = 0 ; i < robotCount ; i++)
+    {
+        const char* pRobotName = NULL;
+
+        result = chipGetDiscoveredRobotName(pDiscovery, i, &pRobotName);
+        robots[i] = chipInit(NULL);
+        result = chipConnectToRobot(robots[i], pRobotName);
+        printf("Connected to %s\n", pRobotName);
+    }
+    result = chipStopRobotDiscovery(pDiscovery);
+    chipUninit(pDiscovery);
+
+    // One request can be outstanding on each robot at a time.  Start the next one as each response comes in.
+    for (i = 0 ; i < robotCount ; i++)
+        result = chipStartRequest(robots[i], getBatteryLevel, sizeof(getBatteryLevel));
+    remaining = robotCount * READS_PER_ROBOT;
+    while (remaining > 0 && chipWaitAny(robots, robotCount, 5000, events, NULL) == CHIP_ERROR_NONE)
+    {
+        for (i = 0 ; i < robotCount ; i++)
+        {
+            uint8_t      response[CHIP_RESPONSE_MAX_LEN];
+            size_t       responseLength = 0;
+            CHiPResponse decoded;
+
+            // A background thread of the library was using the robot when the request was first started.
+            if (events[i] & CHIP_EVENT_READY)
+                result = chipStartRequest(robots[i], getBatteryLevel, sizeof(getBatteryLevel));
+            if ((events[i] & CHIP_EVENT_RESPONSE) == 0)
+                continue;
+
+            result = chipGetRequestResponse(robots[i], response, sizeof(response), &responseLength);
+            if (result == CHIP_ERROR_NONE && chipDecodeResponse(response, responseLength, &decoded) == CHIP_ERROR_NONE)
+                printf("robot %zu: battery level = %.1f%%\n", i, decoded.batteryLevel.batteryLevel * 100.0f);
+            else
+                printf("robot %zu: failed with %d\n", i, result);
+            remaining--;
+            if (++readCounts[i] < READS_PER_ROBOT)
+                result = chipStartRequest(robots[i], getBatteryLevel, sizeof(getBatteryLevel));
+        }
+    }
+
+    for (i = 0 ; i < robotCount ; i++)
+        chipUninit(robots[i]);
+}
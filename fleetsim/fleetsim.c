@@ -0,0 +1,893 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Implementation of the fleet simulator transport.
+   The robots live in one shared array.  A transport owns the robot it is connected to and guards the robot's state with
+   its own robotMutex, since the request path and chipRawReceiveNotification() can run on different threads at once.
+   The fleet mutex only protects connecting, disconnecting and the profile table.
+*/
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "chip.h"
+#include "chip-protocol.h"
+#include "chip-transport.h"
+#include "chip-clock.h"
+#include "chip-response-queue.h"
+#include "fleetsim.h"
+
+
+// Same retry and timeout behaviour as the BLE transport.
+#define FLEETSIM_MAXIMUM_REQUEST_RETRIES 2
+#define FLEETSIM_RESPONSE_TIMEOUT_US     1000000
+
+// Each drive command keeps the robot moving for this long.
+#define FLEETSIM_DRIVE_DURATION_US       50000
+
+// Size of out of band response queue.  The queue will overwrite the oldest item once this size is hit.
+#define FLEETSIM_OOB_RESPONSE_QUEUE_SIZE 10
+
+// Real time clocks of the robots start at 2018-01-01 00:00:00 plus the current clock time.
+#define FLEETSIM_EPOCH_YEAR              2018
+
+#define MICROSECONDS_PER_HOUR            3600000000.0f
+
+
+typedef struct SimRobot
+{
+    uint64_t            lastUpdate;     // Clock time up to which battery and alarm state has been advanced.
+    uint64_t            driveEnd;       // Clock time at which the last drive command stops.
+    int64_t             clockOffset;    // Robot's real time clock in seconds minus clock time in seconds.
+    CHiPTransport*      pTransport;     // Transport currently connected to this robot or NULL.
+    float               batteryLevel;
+    uint32_t            random;
+    _Atomic uint16_t    profileIndex;
+    uint8_t             alarm[6];       // As sent with CHIP_CMD_SET_ALARM_DATE_TIME.  All zero when cancelled.
+    uint8_t             chargingStatus;
+    uint8_t             volume;
+    uint8_t             speed;
+    uint8_t             eyeBrightness;
+} SimRobot;
+
+typedef struct Fleet
+{
+    pthread_mutex_t     mutex;
+    SimRobot*           pRobots;
+    uint32_t            robotCount;
+    uint32_t            nextFree;
+    _Atomic uint32_t    profileCount;
+    FleetSimProfile     profiles[FLEETSIM_MAX_PROFILES];
+} Fleet;
+
+struct CHiPTransport
+{
+    // Held while the connected robot's state is advanced, changed by a request or read into a response.
+    pthread_mutex_t           robotMutex;
+    CHiPClock*                pClock;
+    CHiPResponseQueue*        pResponseQueue;
+    SimRobot*                 pRobot;
+    CHiPTransportEventHandler eventHandler;
+    void*                     pEventContext;
+    uint64_t                  responseTime;
+    int                       responseLost;
+    int                       waitingForResponse;
+    size_t                    requestLength;
+    size_t                    responseLength;
+    uint8_t                   request[CHIP_REQUEST_MAX_LEN];
+    uint8_t                   response[CHIP_RESPONSE_MAX_LEN];
+    char                      robotName[16];
+    _Atomic int               connected;
+    _Atomic uint32_t          retries;
+    _Atomic uint32_t          timeouts;
+};
+
+
+// Forward Declarations.
+static uint16_t findOrAddProfile(const FleetSimProfile* pProfile);
+static int      isSameProfile(const FleetSimProfile* p1, const FleetSimProfile* p2);
+static const FleetSimProfile* getProfile(SimRobot* pRobot);
+static int      parseRobotIndex(const char* pRobotName, uint32_t* pIndex);
+static uint32_t nextRandom(SimRobot* pRobot);
+static void     sendRequestToRobot(CHiPTransport* pTransport);
+static void     sendRequestToRobotLocked(CHiPTransport* pTransport);
+static void     sendBatchItemToRobot(CHiPTransport* pTransport, CHiPTransportBatchItem* pItem,
+                                     uint64_t* pResponseTime, int* pResponseLost);
+static void     updateRobot(CHiPTransport* pTransport, uint64_t now);
+static void     updateBattery(CHiPTransport* pTransport, const FleetSimProfile* pProfile, uint64_t now);
+static void     checkAlarm(CHiPTransport* pTransport, uint64_t now);
+static void     pushBatteryNotification(CHiPTransport* pTransport);
+static void     pushNotification(CHiPTransport* pTransport, const uint8_t* pNotification, size_t length);
+static void     signalEvent(CHiPTransport* pTransport, uint32_t events);
+static void     applyRequest(CHiPTransport* pTransport, uint64_t now);
+static size_t   buildResponse(CHiPTransport* pTransport, uint64_t now);
+static uint8_t  encodeBatteryLevel(float batteryLevel);
+static int64_t  daysFromCivil(int64_t year, unsigned month, unsigned day);
+static void     civilFromDays(int64_t days, int64_t* pYear, unsigned* pMonth, unsigned* pDay);
+
+
+static Fleet g_fleet = { PTHREAD_MUTEX_INITIALIZER };
+
+
+
+void fleetSimGetDefaultProfile(FleetSimProfile* pProfile)
+{
+    memset(pProfile, 0, sizeof(*pProfile));
+    pProfile->connectMicroseconds = 500000;
+    pProfile->latencyMicroseconds = 30000;
+    pProfile->jitterMicroseconds = 10000;
+    pProfile->lossPerMille = 0;
+    pProfile->initialBatteryLevel = 1.0f;
+    pProfile->idleDrainPerHour = 0.25f;
+    pProfile->driveDrainPerHour = 0.75f;
+    pProfile->chargePerHour = 0.5f;
+    pProfile->dockBelowLevel = 0.1f;
+    pProfile->chargerType = CHIP_CHARGER_TYPE_BASE;
+}
+
+int fleetSimCreate(uint32_t robotCount, const FleetSimProfile* pProfile, uint32_t seed)
+{
+    FleetSimProfile defaultProfile;
+    uint64_t        now = chipClockGetMicroseconds(chipClockGetDefault());
+    uint32_t        i;
+
+    if (g_fleet.pRobots || robotCount == 0)
+        return CHIP_ERROR_PARAM;
+    if (!pProfile)
+    {
+        fleetSimGetDefaultProfile(&defaultProfile);
+        pProfile = &defaultProfile;
+    }
+
+    g_fleet.pRobots = calloc(robotCount, sizeof(*g_fleet.pRobots));
+    if (!g_fleet.pRobots)
+        return CHIP_ERROR_MEMORY;
+    g_fleet.robotCount = robotCount;
+    g_fleet.nextFree = 0;
+    g_fleet.profiles[0] = *pProfile;
+    atomic_store(&g_fleet.profileCount, 1);
+
+    for (i = 0 ; i < robotCount ; i++)
+    {
+        SimRobot* pRobot = &g_fleet.pRobots[i];
+
+        pRobot->lastUpdate = now;
+        pRobot->clockOffset = daysFromCivil(FLEETSIM_EPOCH_YEAR, 1, 1) * 86400;
+        pRobot->batteryLevel = pProfile->initialBatteryLevel;
+        // xorshift32 can't have a zero state.
+        pRobot->random = (seed ^ (i * 0x9E3779B9U)) | 1;
+        pRobot->chargingStatus = CHIP_CHARGING_STATUS_NOT_CHARGING;
+        pRobot->volume = 11;
+        pRobot->speed = CHIP_SPEED_ADULT;
+        pRobot->eyeBrightness = 0xFF;
+    }
+
+    return CHIP_ERROR_NONE;
+}
+
+void fleetSimDestroy(void)
+{
+    pthread_mutex_lock(&g_fleet.mutex);
+    {
+        free(g_fleet.pRobots);
+        g_fleet.pRobots = NULL;
+        g_fleet.robotCount = 0;
+        atomic_store(&g_fleet.profileCount, 0);
+    }
+    pthread_mutex_unlock(&g_fleet.mutex);
+}
+
+int fleetSimSetRobotProfile(uint32_t robotIndex, const FleetSimProfile* pProfile)
+{
+    uint16_t profileIndex;
+
+    if (robotIndex >= g_fleet.robotCount)
+        return CHIP_ERROR_PARAM;
+
+    pthread_mutex_lock(&g_fleet.mutex);
+        profileIndex = findOrAddProfile(pProfile);
+    pthread_mutex_unlock(&g_fleet.mutex);
+    if (profileIndex == UINT16_MAX)
+        return CHIP_ERROR_MEMORY;
+
+    atomic_store(&g_fleet.pRobots[robotIndex].profileIndex, profileIndex);
+    return CHIP_ERROR_NONE;
+}
+
+static uint16_t findOrAddProfile(const FleetSimProfile* pProfile)
+{
+    uint32_t count = atomic_load(&g_fleet.profileCount);
+    uint32_t i;
+
+    for (i = 0 ; i < count ; i++)
+    {
+        if (isSameProfile(&g_fleet.profiles[i], pProfile))
+            return i;
+    }
+    if (count == FLEETSIM_MAX_PROFILES)
+        return UINT16_MAX;
+
+    // Entries are never modified once published so readers don't need to take the mutex.
+    g_fleet.profiles[count] = *pProfile;
+    atomic_store(&g_fleet.profileCount, count + 1);
+    return count;
+}
+
+static int isSameProfile(const FleetSimProfile* p1, const FleetSimProfile* p2)
+{
+    // Compare field by field since the padding within the structures can differ.
+    return p1->connectMicroseconds == p2->connectMicroseconds &&
+           p1->latencyMicroseconds == p2->latencyMicroseconds &&
+           p1->jitterMicroseconds == p2->jitterMicroseconds &&
+           p1->lossPerMille == p2->lossPerMille &&
+           p1->initialBatteryLevel == p2->initialBatteryLevel &&
+           p1->idleDrainPerHour == p2->idleDrainPerHour &&
+           p1->driveDrainPerHour == p2->driveDrainPerHour &&
+           p1->chargePerHour == p2->chargePerHour &&
+           p1->dockBelowLevel == p2->dockBelowLevel &&
+           p1->chargerType == p2->chargerType;
+}
+
+static const FleetSimProfile* getProfile(SimRobot* pRobot)
+{
+    return &g_fleet.profiles[atomic_load_explicit(&pRobot->profileIndex, memory_order_relaxed)];
+}
+
+int fleetSimGetRobotName(uint32_t robotIndex, char* pBuffer, size_t bufferSize)
+{
+    if (robotIndex >= g_fleet.robotCount)
+        return CHIP_ERROR_PARAM;
+    snprintf(pBuffer, bufferSize, FLEETSIM_ROBOT_NAME_FORMAT, robotIndex);
+    return CHIP_ERROR_NONE;
+}
+
+static int parseRobotIndex(const char* pRobotName, uint32_t* pIndex)
+{
+    char     name[16];
+    unsigned index;
+
+    if (1 != sscanf(pRobotName, FLEETSIM_ROBOT_NAME_FORMAT, &index) || index >= g_fleet.robotCount)
+        return CHIP_ERROR_PARAM;
+    // Reject names like "CHiP-Sim-1" which scan but aren't formatted exactly as we would.
+    snprintf(name, sizeof(name), FLEETSIM_ROBOT_NAME_FORMAT, index);
+    if (0 != strcmp(name, pRobotName))
+        return CHIP_ERROR_PARAM;
+    *pIndex = index;
+    return CHIP_ERROR_NONE;
+}
+
+static uint32_t nextRandom(SimRobot* pRobot)
+{
+    uint32_t x = pRobot->random;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pRobot->random = x;
+    return x;
+}
+
+
+
+CHiPTransport* chipTransportInit(const char* pInitOptions)
+{
+    CHiPTransport* pTransport = NULL;
+
+    pTransport = calloc(1, sizeof(*pTransport));
+    if (!pTransport)
+        return NULL;
+    if (pthread_mutex_init(&pTransport->robotMutex, NULL))
+    {
+        free(pTransport);
+        return NULL;
+    }
+    pTransport->pResponseQueue = chipResponseQueueAlloc(FLEETSIM_OOB_RESPONSE_QUEUE_SIZE);
+    if (!pTransport->pResponseQueue)
+        goto Error;
+    pTransport->pClock = chipClockGetDefault();
+
+    return pTransport;
+Error:
+    chipTransportUninit(pTransport);
+    return NULL;
+}
+
+void chipTransportUninit(CHiPTransport* pTransport)
+{
+    if (!pTransport)
+        return;
+    chipTransportDisconnectFromRobot(pTransport);
+    chipResponseQueueFree(pTransport->pResponseQueue);
+    pthread_mutex_destroy(&pTransport->robotMutex);
+    free(pTransport);
+}
+
+int chipTransportConnectToRobot(CHiPTransport* pTransport, const char* pRobotName)
+{
+    SimRobot* pRobot = NULL;
+    uint32_t  index = 0;
+
+    if (pTransport->pRobot)
+        return CHIP_ERROR_CONNECT;
+    if (pRobotName && parseRobotIndex(pRobotName, &index))
+        return CHIP_ERROR_CONNECT;
+
+    pthread_mutex_lock(&g_fleet.mutex);
+    {
+        if (!pRobotName)
+        {
+            // Connect to the first robot which isn't already connected.
+            for (index = g_fleet.nextFree ; index < g_fleet.robotCount ; index++)
+            {
+                if (!g_fleet.pRobots[index].pTransport)
+                    break;
+            }
+            g_fleet.nextFree = index;
+        }
+        if (index < g_fleet.robotCount && !g_fleet.pRobots[index].pTransport)
+        {
+            pRobot = &g_fleet.pRobots[index];
+            pRobot->pTransport = pTransport;
+        }
+    }
+    pthread_mutex_unlock(&g_fleet.mutex);
+    if (!pRobot)
+        return CHIP_ERROR_CONNECT;
+
+    chipClockSleepUntil(pTransport->pClock,
+                        chipClockGetMicroseconds(pTransport->pClock) + getProfile(pRobot)->connectMicroseconds);
+    pthread_mutex_lock(&pTransport->robotMutex);
+        pTransport->pRobot = pRobot;
+        updateRobot(pTransport, chipClockGetMicroseconds(pTransport->pClock));
+    pthread_mutex_unlock(&pTransport->robotMutex);
+    atomic_store(&pTransport->connected, 1);
+    signalEvent(pTransport, CHIP_TRANSPORT_EVENT_CONNECTION);
+
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportDisconnectFromRobot(CHiPTransport* pTransport)
+{
+    SimRobot* pRobot = pTransport->pRobot;
+
+    if (!pRobot)
+        return CHIP_ERROR_NONE;
+
+    atomic_store(&pTransport->connected, 0);
+    pthread_mutex_lock(&pTransport->robotMutex);
+        pTransport->pRobot = NULL;
+    pthread_mutex_unlock(&pTransport->robotMutex);
+    pTransport->waitingForResponse = 0;
+    pthread_mutex_lock(&g_fleet.mutex);
+    {
+        pRobot->pTransport = NULL;
+        if (pRobot - g_fleet.pRobots < g_fleet.nextFree)
+            g_fleet.nextFree = pRobot - g_fleet.pRobots;
+    }
+    pthread_mutex_unlock(&g_fleet.mutex);
+    signalEvent(pTransport, CHIP_TRANSPORT_EVENT_CONNECTION);
+
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportStartRobotDiscovery(CHiPTransport* pTransport)
+{
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportGetDiscoveredRobotCount(CHiPTransport* pTransport, size_t* pCount)
+{
+    *pCount = g_fleet.robotCount;
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportGetDiscoveredRobotName(CHiPTransport* pTransport, size_t robotIndex, const char** ppRobotName)
+{
+    int result;
+
+    // The name is only valid until the next call on this transport.
+    result = fleetSimGetRobotName(robotIndex, pTransport->robotName, sizeof(pTransport->robotName));
+    if (result)
+        return result;
+    *ppRobotName = pTransport->robotName;
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportStopRobotDiscovery(CHiPTransport* pTransport)
+{
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportSendRequest(CHiPTransport* pTransport, const uint8_t* pRequest, size_t requestLength, int expectResponse)
+{
+    if (!pTransport->pRobot)
+        return CHIP_ERROR_NOT_CONNECTED;
+    if (requestLength < 1 || requestLength > sizeof(pTransport->request))
+        return CHIP_ERROR_PARAM;
+
+    memcpy(pTransport->request, pRequest, requestLength);
+    pTransport->requestLength = requestLength;
+    pTransport->waitingForResponse = expectResponse;
+    sendRequestToRobot(pTransport);
+
+    return CHIP_ERROR_NONE;
+}
+
+static void sendRequestToRobot(CHiPTransport* pTransport)
+{
+    pthread_mutex_lock(&pTransport->robotMutex);
+        sendRequestToRobotLocked(pTransport);
+    pthread_mutex_unlock(&pTransport->robotMutex);
+}
+
+static void sendRequestToRobotLocked(CHiPTransport* pTransport)
+{
+    SimRobot*              pRobot = pTransport->pRobot;
+    const FleetSimProfile* pProfile = getProfile(pRobot);
+    uint64_t               now = chipClockGetMicroseconds(pTransport->pClock);
+    int                    lost = 0;
+    int                    requestLost = 0;
+    int64_t                latency;
+
+    updateRobot(pTransport, now);
+
+    // Either the request or the response can be lost.
+    lost = (nextRandom(pRobot) % 1000) < pProfile->lossPerMille;
+    requestLost = lost && (nextRandom(pRobot) & 1);
+    if (!requestLost)
+        applyRequest(pTransport, now);
+    if (!pTransport->waitingForResponse)
+        return;
+
+    latency = pProfile->latencyMicroseconds;
+    if (pProfile->jitterMicroseconds)
+        latency += (int64_t)(nextRandom(pRobot) % (2 * pProfile->jitterMicroseconds + 1)) - pProfile->jitterMicroseconds;
+    if (latency < 0)
+        latency = 0;
+    pTransport->responseTime = now + latency;
+    pTransport->responseLost = lost;
+    pTransport->responseLength = buildResponse(pTransport, now);
+}
+
+int chipTransportSendRequestBatch(CHiPTransport* pTransport, CHiPTransportBatchItem* pItems, size_t itemCount)
+{
+    uint64_t responseTimes[CHIP_TRANSPORT_MAX_BATCH];
+    int      responseLost[CHIP_TRANSPORT_MAX_BATCH];
+    int      retries = FLEETSIM_MAXIMUM_REQUEST_RETRIES;
+    uint64_t startTime;
+    size_t   i;
+
+    if (!pTransport->pRobot)
+        return CHIP_ERROR_NOT_CONNECTED;
+    if (itemCount < 1 || itemCount > CHIP_TRANSPORT_MAX_BATCH)
+        return CHIP_ERROR_PARAM;
+    for (i = 0 ; i < itemCount ; i++)
+    {
+        if (pItems[i].requestLength < 1 || pItems[i].requestLength > sizeof(pTransport->request))
+            return CHIP_ERROR_PARAM;
+    }
+
+    // Every request goes out before waiting on any of the responses so that their latencies overlap.
+    startTime = chipClockGetMicroseconds(pTransport->pClock);
+    for (i = 0 ; i < itemCount ; i++)
+        sendBatchItemToRobot(pTransport, &pItems[i], &responseTimes[i], &responseLost[i]);
+
+    for (;;)
+    {
+        uint64_t deadline = chipClockGetMicroseconds(pTransport->pClock) + FLEETSIM_RESPONSE_TIMEOUT_US;
+        uint64_t lastResponseTime = 0;
+        int      isMissing = 0;
+
+        for (i = 0 ; i < itemCount ; i++)
+        {
+            if (pItems[i].result == CHIP_ERROR_NONE)
+                continue;
+            if (!responseLost[i] && responseTimes[i] <= deadline)
+            {
+                pItems[i].result = CHIP_ERROR_NONE;
+                pItems[i].roundTrip = responseTimes[i] - startTime;
+                if (responseTimes[i] > lastResponseTime)
+                    lastResponseTime = responseTimes[i];
+            }
+            else
+            {
+                isMissing = 1;
+            }
+        }
+        if (!isMissing)
+        {
+            chipClockSleepUntil(pTransport->pClock, lastResponseTime);
+            break;
+        }
+
+        // Only the requests whose responses didn't arrive in time are sent again.
+        chipClockSleepUntil(pTransport->pClock, deadline);
+        for (i = 0 ; i < itemCount ; i++)
+        {
+            if (pItems[i].result == CHIP_ERROR_NONE)
+                continue;
+            if (retries == 0)
+            {
+                atomic_fetch_add_explicit(&pTransport->timeouts, 1, memory_order_relaxed);
+                pItems[i].result = CHIP_ERROR_TIMEOUT;
+                continue;
+            }
+            atomic_fetch_add_explicit(&pTransport->retries, 1, memory_order_relaxed);
+            sendBatchItemToRobot(pTransport, &pItems[i], &responseTimes[i], &responseLost[i]);
+        }
+        if (retries-- == 0)
+            break;
+    }
+
+    return CHIP_ERROR_NONE;
+}
+
+static void sendBatchItemToRobot(CHiPTransport* pTransport, CHiPTransportBatchItem* pItem,
+                                 uint64_t* pResponseTime, int* pResponseLost)
+{
+    // Run the item through the same path as a single request and then move its response out of the way of the next.
+    memcpy(pTransport->request, pItem->pRequest, pItem->requestLength);
+    pTransport->requestLength = pItem->requestLength;
+    pTransport->waitingForResponse = 1;
+    sendRequestToRobot(pTransport);
+    pTransport->waitingForResponse = 0;
+
+    memcpy(pItem->pResponse, pTransport->response, pTransport->responseLength);
+    pItem->responseLength = pTransport->responseLength;
+    pItem->result = CHIP_ERROR_TIMEOUT;
+    pItem->roundTrip = 0;
+    *pResponseTime = pTransport->responseTime;
+    *pResponseLost = pTransport->responseLost;
+}
+
+int chipTransportBorrowResponse(CHiPTransport* pTransport, const uint8_t** ppResponse, size_t* pResponseLength)
+{
+    int retries = FLEETSIM_MAXIMUM_REQUEST_RETRIES;
+
+    if (!pTransport->pRobot)
+        return CHIP_ERROR_NOT_CONNECTED;
+    if (!pTransport->waitingForResponse)
+        return CHIP_ERROR_NO_REQUEST;
+
+    for (;;)
+    {
+        uint64_t deadline = chipClockGetMicroseconds(pTransport->pClock) + FLEETSIM_RESPONSE_TIMEOUT_US;
+
+        if (!pTransport->responseLost && pTransport->responseTime <= deadline)
+        {
+            chipClockSleepUntil(pTransport->pClock, pTransport->responseTime);
+            break;
+        }
+        chipClockSleepUntil(pTransport->pClock, deadline);
+        if (retries-- == 0)
+        {
+            atomic_fetch_add_explicit(&pTransport->timeouts, 1, memory_order_relaxed);
+            pTransport->waitingForResponse = 0;
+            return CHIP_ERROR_TIMEOUT;
+        }
+        atomic_fetch_add_explicit(&pTransport->retries, 1, memory_order_relaxed);
+        sendRequestToRobot(pTransport);
+    }
+
+    pTransport->waitingForResponse = 0;
+    *ppResponse = pTransport->response;
+    *pResponseLength = pTransport->responseLength;
+
+    return CHIP_ERROR_NONE;
+}
+
+void chipTransportReleaseResponse(CHiPTransport* pTransport)
+{
+    // The response buffer belongs to the transport and is only rewritten by the next request.
+}
+
+int chipTransportIsResponseAvailable(CHiPTransport* pTransport)
+{
+    return pTransport->waitingForResponse && !pTransport->responseLost &&
+           chipClockGetMicroseconds(pTransport->pClock) >= pTransport->responseTime;
+}
+
+uint64_t chipTransportGetResponseTime(CHiPTransport* pTransport)
+{
+    if (!pTransport->waitingForResponse || pTransport->responseLost)
+        return UINT64_MAX;
+    return pTransport->responseTime;
+}
+
+void chipTransportAbandonRequest(CHiPTransport* pTransport)
+{
+    pTransport->waitingForResponse = 0;
+}
+
+int chipTransportGetOutOfBandResponse(CHiPTransport* pTransport,
+                                     uint8_t* pResponseBuffer,
+                                     size_t responseBufferSize,
+                                     size_t* pResponseLength)
+{
+    pthread_mutex_lock(&pTransport->robotMutex);
+    {
+        // The robot is only advanced if it is still connected, as disconnecting can happen on another thread.
+        if (pTransport->pRobot)
+            updateRobot(pTransport, chipClockGetMicroseconds(pTransport->pClock));
+    }
+    pthread_mutex_unlock(&pTransport->robotMutex);
+    if (!atomic_load(&pTransport->connected))
+        return CHIP_ERROR_NOT_CONNECTED;
+    return chipResponseQueuePop(pTransport->pResponseQueue, pResponseBuffer, responseBufferSize, pResponseLength);
+}
+
+uint32_t chipTransportGetMilliseconds(CHiPTransport* pTransport)
+{
+    return (uint32_t)(chipClockGetMicroseconds(pTransport->pClock) / 1000);
+}
+
+uint64_t chipTransportGetMicroseconds(CHiPTransport* pTransport)
+{
+    return chipClockGetMicroseconds(pTransport->pClock);
+}
+
+void chipTransportGetStats(CHiPTransport* pTransport, CHiPTransportStats* pStats)
+{
+    pStats->retries = atomic_load_explicit(&pTransport->retries, memory_order_relaxed);
+    pStats->timeouts = atomic_load_explicit(&pTransport->timeouts, memory_order_relaxed);
+    pStats->oobDrops = chipResponseQueueDropCount(pTransport->pResponseQueue);
+    pStats->oobQueueDepth = chipResponseQueueDepth(pTransport->pResponseQueue);
+    pStats->connected = atomic_load_explicit(&pTransport->connected, memory_order_relaxed);
+}
+
+void chipTransportSetEventHandler(CHiPTransport* pTransport, CHiPTransportEventHandler handler, void* pContext)
+{
+    pTransport->eventHandler = handler;
+    pTransport->pEventContext = pContext;
+}
+
+
+
+// Advance the robot's battery and alarm state from the last time it was updated up to now.
+static void updateRobot(CHiPTransport* pTransport, uint64_t now)
+{
+    SimRobot* pRobot = pTransport->pRobot;
+
+    if (now <= pRobot->lastUpdate)
+        return;
+
+    updateBattery(pTransport, getProfile(pRobot), now);
+    checkAlarm(pTransport, now);
+    pRobot->lastUpdate = now;
+}
+
+static void updateBattery(CHiPTransport* pTransport, const FleetSimProfile* pProfile, uint64_t now)
+{
+    SimRobot* pRobot = pTransport->pRobot;
+    float     hours = (float)(now - pRobot->lastUpdate) / MICROSECONDS_PER_HOUR;
+    float     driveHours = 0.0f;
+
+    if (pRobot->chargingStatus == CHIP_CHARGING_STATUS_CHARGING)
+    {
+        pRobot->batteryLevel += pProfile->chargePerHour * hours;
+        if (pRobot->batteryLevel >= 1.0f)
+        {
+            pRobot->batteryLevel = 1.0f;
+            pRobot->chargingStatus = CHIP_CHARGING_STATUS_CHARGING_FINISHED;
+            pushBatteryNotification(pTransport);
+        }
+        return;
+    }
+    if (pRobot->chargingStatus == CHIP_CHARGING_STATUS_CHARGING_FINISHED)
+        return;
+
+    if (pRobot->driveEnd > pRobot->lastUpdate)
+    {
+        uint64_t driveEnd = pRobot->driveEnd < now ? pRobot->driveEnd : now;
+        driveHours = (float)(driveEnd - pRobot->lastUpdate) / MICROSECONDS_PER_HOUR;
+    }
+    pRobot->batteryLevel -= pProfile->idleDrainPerHour * hours + pProfile->driveDrainPerHour * driveHours;
+    if (pRobot->batteryLevel < 0.0f)
+        pRobot->batteryLevel = 0.0f;
+    if (pRobot->batteryLevel < pProfile->dockBelowLevel)
+    {
+        // Robot has headed back to its charger.
+        pRobot->chargingStatus = CHIP_CHARGING_STATUS_CHARGING;
+        pushBatteryNotification(pTransport);
+    }
+}
+
+static void checkAlarm(CHiPTransport* pTransport, uint64_t now)
+{
+    SimRobot* pRobot = pTransport->pRobot;
+    const uint8_t* pAlarm = pRobot->alarm;
+    uint8_t   notification[CHIP_CMD_GET_ALARM_DATE_TIME_RESPONSE_LEN];
+    int64_t   alarmTime;
+    int64_t   robotTime;
+
+    if (pAlarm[3] == 0)
+        return;
+
+    alarmTime = daysFromCivil(((int64_t)pAlarm[0] << 8) | pAlarm[1], pAlarm[2], pAlarm[3]) * 86400 +
+                pAlarm[4] * 3600 + pAlarm[5] * 60;
+    robotTime = (int64_t)(now / 1000000) + pRobot->clockOffset;
+    if (robotTime < alarmTime)
+        return;
+
+    notification[0] = CHIP_CMD_GET_ALARM_DATE_TIME;
+    memcpy(&notification[1], pAlarm, 6);
+    pushNotification(pTransport, notification, sizeof(notification));
+    memset(pRobot->alarm, 0, sizeof(pRobot->alarm));
+}
+
+static void pushBatteryNotification(CHiPTransport* pTransport)
+{
+    SimRobot* pRobot = pTransport->pRobot;
+    uint8_t   notification[CHIP_CMD_GET_BATTERY_LEVEL_RESPONSE_LEN];
+
+    notification[0] = CHIP_CMD_GET_BATTERY_LEVEL;
+    notification[1] = pRobot->chargingStatus;
+    notification[2] = getProfile(pRobot)->chargerType;
+    notification[3] = encodeBatteryLevel(pRobot->batteryLevel);
+    pushNotification(pTransport, notification, sizeof(notification));
+}
+
+static void pushNotification(CHiPTransport* pTransport, const uint8_t* pNotification, size_t length)
+{
+    chipResponseQueuePush(pTransport->pResponseQueue, pNotification, length);
+    signalEvent(pTransport, CHIP_TRANSPORT_EVENT_NOTIFICATION);
+}
+
+static void signalEvent(CHiPTransport* pTransport, uint32_t events)
+{
+    if (pTransport->eventHandler)
+        pTransport->eventHandler(pTransport->pEventContext, events);
+}
+
+static void applyRequest(CHiPTransport* pTransport, uint64_t now)
+{
+    SimRobot*      pRobot = pTransport->pRobot;
+    const uint8_t* pRequest = pTransport->request;
+    size_t         requestLength = pTransport->requestLength;
+
+    switch (pRequest[0])
+    {
+    case CHIP_CMD_SET_VOLUME:
+        if (requestLength == CHIP_CMD_SET_VOLUME_REQUEST_LEN)
+            pRobot->volume = pRequest[1];
+        break;
+    case CHIP_CMD_SET_SPEED:
+        if (requestLength == CHIP_CMD_SET_SPEED_REQUEST_LEN)
+            pRobot->speed = pRequest[1];
+        break;
+    case CHIP_CMD_SET_EYE_BRIGHTNESS:
+        if (requestLength == CHIP_CMD_SET_EYE_BRIGHTNESS_REQUEST_LEN)
+            pRobot->eyeBrightness = pRequest[1];
+        break;
+    case CHIP_CMD_SET_CURRENT_DATE_TIME:
+        if (requestLength == CHIP_CMD_SET_CURRENT_DATE_TIME_REQUEST_LEN)
+        {
+            int64_t robotTime = daysFromCivil(((int64_t)pRequest[1] << 8) | pRequest[2], pRequest[3], pRequest[4]) *
+                                86400 + pRequest[5] * 3600 + pRequest[6] * 60 + pRequest[7];
+            pRobot->clockOffset = robotTime - (int64_t)(now / 1000000);
+        }
+        break;
+    case CHIP_CMD_SET_ALARM_DATE_TIME:
+        if (requestLength == 1 + sizeof(pRobot->alarm))
+            memcpy(pRobot->alarm, &pRequest[1], sizeof(pRobot->alarm));
+        break;
+    case CHIP_CMD_DRIVE:
+        // Driving takes the robot off of its charger.
+        pRobot->chargingStatus = CHIP_CHARGING_STATUS_NOT_CHARGING;
+        pRobot->driveEnd = now + FLEETSIM_DRIVE_DURATION_US;
+        break;
+    }
+}
+
+static size_t buildResponse(CHiPTransport* pTransport, uint64_t now)
+{
+    static const uint8_t dogVersion[CHIP_CMD_GET_DOG_VERSION_RESPONSE_LEN] =
+    {
+        CHIP_CMD_GET_DOG_VERSION, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+    };
+    SimRobot*            pRobot = pTransport->pRobot;
+    uint8_t*             pResponse = pTransport->response;
+    const uint8_t*       pRequest = pTransport->request;
+
+    pResponse[0] = pRequest[0];
+    switch (pRequest[0])
+    {
+    case CHIP_CMD_GET_DOG_VERSION:
+        memcpy(pResponse, dogVersion, sizeof(dogVersion));
+        return sizeof(dogVersion);
+    case CHIP_CMD_GET_VOLUME:
+        pResponse[1] = pRobot->volume;
+        return CHIP_CMD_GET_VOLUME_RESPONSE_LEN;
+    case CHIP_CMD_GET_SPEED:
+        pResponse[1] = pRobot->speed;
+        return CHIP_CMD_GET_SPEED_RESPONSE_LEN;
+    case CHIP_CMD_GET_EYE_BRIGHTNESS:
+        pResponse[1] = pRobot->eyeBrightness;
+        return CHIP_CMD_GET_EYE_BRIGHTNESS_RESPONSE_LEN;
+    case CHIP_CMD_GET_BATTERY_LEVEL:
+        pResponse[1] = pRobot->chargingStatus;
+        pResponse[2] = getProfile(pRobot)->chargerType;
+        pResponse[3] = encodeBatteryLevel(pRobot->batteryLevel);
+        return CHIP_CMD_GET_BATTERY_LEVEL_RESPONSE_LEN;
+    case CHIP_CMD_GET_CURRENT_DATE_TIME:
+    {
+        int64_t  robotTime = (int64_t)(now / 1000000) + pRobot->clockOffset;
+        int64_t  days = robotTime / 86400;
+        int64_t  seconds = robotTime % 86400;
+        int64_t  year;
+        unsigned month;
+        unsigned day;
+
+        civilFromDays(days, &year, &month, &day);
+        pResponse[1] = (year >> 8) & 0xFF;
+        pResponse[2] = year & 0xFF;
+        pResponse[3] = month;
+        pResponse[4] = day;
+        pResponse[5] = seconds / 3600;
+        pResponse[6] = (seconds / 60) % 60;
+        pResponse[7] = seconds % 60;
+        // 1970-01-01 was a Thursday and Sunday is day 0.
+        pResponse[8] = (days + 4) % 7;
+        return CHIP_CMD_GET_CURRENT_DATE_TIME_RESPONSE_LEN;
+    }
+    case CHIP_CMD_GET_ALARM_DATE_TIME:
+        memcpy(&pResponse[1], pRobot->alarm, sizeof(pRobot->alarm));
+        return 1 + sizeof(pRobot->alarm);
+    default:
+        // Unknown requests are echoed back.
+        memcpy(pResponse, pRequest, pTransport->requestLength);
+        return pTransport->requestLength;
+    }
+}
+
+static uint8_t encodeBatteryLevel(float batteryLevel)
+{
+    // Inverse of the decoding done in chipGetBatteryLevel().
+    return 0x7D + (uint8_t)(batteryLevel * 34.0f + 0.5f);
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar.
+static int64_t daysFromCivil(int64_t year, unsigned month, unsigned day)
+{
+    int64_t  era;
+    unsigned yearOfEra;
+    unsigned dayOfYear;
+    unsigned dayOfEra;
+
+    year -= month <= 2;
+    era = (year >= 0 ? year : year - 399) / 400;
+    yearOfEra = (unsigned)(year - era * 400);
+    dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + (int64_t)dayOfEra - 719468;
+}
+
+static void civilFromDays(int64_t days, int64_t* pYear, unsigned* pMonth, unsigned* pDay)
+{
+    int64_t  era;
+    unsigned dayOfEra;
+    unsigned yearOfEra;
+    unsigned dayOfYear;
+    unsigned monthIndex;
+
+    days += 719468;
+    era = (days >= 0 ? days : days - 146096) / 146097;
+    dayOfEra = (unsigned)(days - era * 146097);
+    yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    monthIndex = (5 * dayOfYear + 2) / 153;
+    *pDay = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    *pMonth = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    *pYear = (int64_t)yearOfEra + era * 400 + (*pMonth <= 2);
+}
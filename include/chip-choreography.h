@@ -0,0 +1,120 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the compiled choreography format along with its compiler and player.
+
+   A choreography is a routine of drive, action, sound and eye brightness cues.  It is written as text and compiled
+   into a binary file which holds every request already encoded, so playing it back needs no parsing at all: the player
+   maps the file into memory and sends each frame through the transport when its time comes.
+
+   The text format has one cue per line.  Blank lines and anything following a '#' are ignored.  Each cue starts with
+   its time in seconds from the start of the routine.  Cues don't need to be in time order.
+       <seconds> drive <forwardReverse> <leftRight> <spin> [<durationSeconds>]
+       <seconds> action <CHiPAction value>
+       <seconds> sound <CHiPSoundIndex value>
+       <seconds> stop-sound
+       <seconds> volume <1 - 11>
+       <seconds> eyes <0 - 255>
+       <seconds> raw <hex byte> [<hex byte> ...]
+   A drive cue given a duration is repeated every CHIP_CHOREOGRAPHY_DRIVE_INTERVAL_US until the duration has passed.
+
+   The compiled file is laid out as a CHiPChoreographyHeader, then frameCount CHiPChoreographyFrame records sorted by
+   time and finally indexCount uint32_t seek index entries.  Entry i of the index is the number of the first frame
+   due at or after i * indexIntervalMicroseconds.  The player uses the file in place so every field is stored in the
+   byte order of the host which compiled it.  The magic number doubles as a byte order mark: a file moved to a host of
+   the other byte order fails chipChoreographyOpen() and needs to be compiled again there.
+*/
+#ifndef CHIP_CHOREOGRAPHY_H_
+#define CHIP_CHOREOGRAPHY_H_
+
+#include "chip.h"
+
+
+// First 4 bytes of a compiled choreography file: "CHRG" on a little endian host and "GRHC" on a big endian one.
+#define CHIP_CHOREOGRAPHY_MAGIC             0x47524843
+#define CHIP_CHOREOGRAPHY_VERSION           1
+
+// Time between the repeated frames of a drive cue which is given a duration.
+#define CHIP_CHOREOGRAPHY_DRIVE_INTERVAL_US 50000
+
+// Time covered by each entry of the seek index.
+#define CHIP_CHOREOGRAPHY_INDEX_INTERVAL_US 1000000
+
+
+typedef struct CHiPChoreographyHeader
+{
+    uint32_t magic;                     // CHIP_CHOREOGRAPHY_MAGIC
+    uint16_t version;                   // CHIP_CHOREOGRAPHY_VERSION
+    uint16_t frameSize;                 // sizeof(CHiPChoreographyFrame)
+    uint32_t frameCount;
+    uint32_t indexCount;
+    uint32_t indexIntervalMicroseconds;
+    uint32_t durationMicroseconds;      // Time of the last frame.
+    uint32_t framesOffset;              // Offset of the first frame from the start of the file.
+    uint32_t indexOffset;               // Offset of the first index entry from the start of the file.
+} CHiPChoreographyHeader;
+
+typedef struct CHiPChoreographyFrame
+{
+    uint32_t offsetMicroseconds;        // Time of this frame from the start of the routine.
+    uint8_t  length;                    // Number of valid bytes in request.
+    uint8_t  request[11];               // Request exactly as passed to chipRawSend().
+} CHiPChoreographyFrame;
+
+// Abstraction of the pointer type returned by chipChoreographyOpen().
+typedef struct CHiPChoreography CHiPChoreography;
+
+
+// Compile a text choreography into its binary form.
+//
+//   pSourceFilename: Name of the text file to be compiled.
+//   pOutputFilename: Name of the binary file to be written.
+//   pErrorLine: Set to the line number of the first bad cue when CHIP_ERROR_PARAM is returned and 0 otherwise.  Can be
+//               NULL.
+//   Returns: CHIP_ERROR_NONE on success.
+//            CHIP_ERROR_PARAM if the text contains a cue which can't be parsed or has an out of range value.
+//            CHIP_ERROR_MEMORY if memory or file operations fail.
+int chipChoreographyCompile(const char* pSourceFilename, const char* pOutputFilename, size_t* pErrorLine);
+
+// Map a compiled choreography into memory.  Only the header is checked; the frames aren't touched until played.
+//
+//   pFilename: Name of a file written by chipChoreographyCompile().
+//   Returns: NULL if the file can't be mapped or isn't a valid compiled choreography.
+//            A valid pointer to a choreography object otherwise.
+CHiPChoreography* chipChoreographyOpen(const char* pFilename);
+
+// Unmap a choreography returned from chipChoreographyOpen().
+void chipChoreographyClose(CHiPChoreography* pChoreography);
+
+// Access the mapped header and frames of a choreography.
+const CHiPChoreographyHeader* chipChoreographyGetHeader(const CHiPChoreography* pChoreography);
+const CHiPChoreographyFrame*  chipChoreographyGetFrames(const CHiPChoreography* pChoreography);
+
+// Find the first frame due at or after a time, using the seek index.
+//
+//   pChoreography: An object that was previously returned from the chipChoreographyOpen() call.
+//   offsetMicroseconds: Time from the start of the routine.
+//   Returns: Index of the frame.  frameCount if no frames are left after that time.
+uint32_t chipChoreographySeek(const CHiPChoreography* pChoreography, uint32_t offsetMicroseconds);
+
+// Play a choreography on a robot, sending each frame with chipRawSend() when it is due.  Blocks until the last frame
+// has been sent.  Timing uses the clock returned by chipClockGetDefault().
+//
+//   pCHiP: An object that was previously returned from the chipInit() call.
+//   pChoreography: An object that was previously returned from the chipChoreographyOpen() call.
+//   startMicroseconds: Point in the routine from which to start playing.  0 plays it from the beginning.
+//   Returns: CHIP_ERROR_NONE on success and the error from the first failed chipRawSend() otherwise.
+int chipChoreographyPlay(CHiP* pCHiP, const CHiPChoreography* pChoreography, uint32_t startMicroseconds);
+
+#endif // CHIP_CHOREOGRAPHY_H_
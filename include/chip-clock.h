@@ -0,0 +1,99 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the clock interface used by the transports for all of their timing: response deadlines,
+   retries, pacing and keepalives.  Transports capture the default clock when chipInit() creates them, so the clock
+   can be swapped out before then to run timeout and retry logic in simulated time.
+
+   Two implementations are provided:
+   * The real clock, which is the default, uses the platform's monotonic clock and really blocks.
+   * A virtual clock, created with chipClockCreateVirtual(), which never blocks waiting for time to pass.  Instead,
+     once every participating thread is waiting, virtual time jumps straight to the earliest deadline and that waiter
+     times out.  A 3 second timeout therefore takes microseconds of real time and always happens in the same order.
+*/
+#ifndef CHIP_CLOCK_H_
+#define CHIP_CLOCK_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+
+// Clocks are implemented as a table of functions so that an application can also inject its own.  The chipClock*()
+// wrappers below should be used to call through this table.
+typedef struct CHiPClock CHiPClock;
+struct CHiPClock
+{
+    // Returns a monotonically increasing microsecond count.
+    uint64_t (*getMicroseconds)(CHiPClock* pClock);
+    // Same as pthread_cond_timedwait() but the deadline is an absolute time from getMicroseconds().  The caller must
+    // hold pMutex.  Returns CHIP_ERROR_NONE when woken up, which may be spurious, or CHIP_ERROR_TIMEOUT once the
+    // deadline has passed.
+    int      (*waitUntil)(CHiPClock* pClock, pthread_cond_t* pCondition, pthread_mutex_t* pMutex, uint64_t deadline);
+    // Blocks until getMicroseconds() returns a value >= deadline.
+    void     (*sleepUntil)(CHiPClock* pClock, uint64_t deadline);
+};
+
+
+// Get the clock which uses the platform's monotonic clock.
+CHiPClock* chipClockGetReal(void);
+
+// Get the clock that transports created from now on should use.  Defaults to the real clock.
+CHiPClock* chipClockGetDefault(void);
+
+// Set the clock that transports created by subsequent chipInit() calls should use.  Pass in NULL to restore the real
+// clock.  The clock must stay valid until all of those transports have been uninitialized.
+void chipClockSetDefault(CHiPClock* pClock);
+
+
+// Create a virtual clock.
+//
+//   startMicroseconds: The initial value to be returned from chipClockGetMicroseconds().
+//   threadCount: The number of threads which make timed waits on this clock.  Virtual time only advances when this
+//                many threads are waiting in chipClockWaitUntil() or chipClockSleepUntil().  Threads which only
+//                signal conditions, without waiting on this clock, shouldn't be counted.
+//   Returns: NULL on error.
+//            A valid pointer to the clock otherwise.
+CHiPClock* chipClockCreateVirtual(uint64_t startMicroseconds, uint32_t threadCount);
+
+// Free a clock previously returned from chipClockCreateVirtual().  No threads can still be waiting on it.
+void chipClockFreeVirtual(CHiPClock* pClock);
+
+// Change the number of threads which participate in a virtual clock.  A thread should detach from the clock before
+// it exits so that the remaining threads can keep advancing time.  Has no effect on other clocks.
+void chipClockAttachThread(CHiPClock* pClock);
+void chipClockDetachThread(CHiPClock* pClock);
+
+// Move a virtual clock forward by the specified number of microseconds, timing out any waits whose deadline has now
+// passed.  Has no effect on other clocks.
+void chipClockAdvance(CHiPClock* pClock, uint64_t microseconds);
+
+
+// Wrappers used to call through a clock's function table.
+static inline uint64_t chipClockGetMicroseconds(CHiPClock* pClock)
+{
+    return pClock->getMicroseconds(pClock);
+}
+
+static inline int chipClockWaitUntil(CHiPClock* pClock, pthread_cond_t* pCondition, pthread_mutex_t* pMutex,
+                                     uint64_t deadline)
+{
+    return pClock->waitUntil(pClock, pCondition, pMutex, deadline);
+}
+
+static inline void chipClockSleepUntil(CHiPClock* pClock, uint64_t deadline)
+{
+    pClock->sleepUntil(pClock, deadline);
+}
+
+#endif // CHIP_CLOCK_H_
@@ -0,0 +1,884 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes a header only C++20 coroutine front end for the CHiP API.
+
+   Each robot is represented by a chip::Robot bound to a chip::EventLoop.  Round trips to the robot return awaitables
+   so that a workflow reads as straight line code:
+
+       chip::Task<> checkBattery(chip::Robot& robot)
+       {
+           chip::Result<void>             connected = co_await robot.connect("CHiP-1234");
+           chip::Result<CHiPBatteryLevel> level = co_await robot.batteryLevel();
+
+           if (connected && level)
+               printf("battery = %.0f%%\n", level->batteryLevel * 100.0f);
+       }
+
+   Requests are issued with chipStartRequest() and the loop sleeps in poll() on the descriptor from chipGetPollFd() of
+   every robot bound to it.  Each coroutine is resumed by chipProcessEvents() reporting the response, notification or
+   timeout which completes what it was waiting for, so no thread ever blocks on a round trip.  The one exception is
+   connect(), which hands the blocking chipConnectToRobot() to a small pool of threads owned by the loop.
+
+   A loop, its robots and the coroutines using them must all stay on the thread which calls EventLoop::run().  Spread
+   a large fleet over a small pool of threads by giving each thread its own loop.  Requests to the same robot are
+   queued and sent one at a time.
+
+   Every round trip takes a RequestOptions with a deadline and a std::stop_token.  When the deadline passes first the
+   awaitable completes with CHIP_ERROR_TIMEOUT and when a stop is requested, from any thread, it completes with
+   CHIP_ERROR_NO_REQUEST.  Either way the request is abandoned and its response discarded.  Passing the same options
+   down through nested tasks cancels the whole workflow at once.
+*/
+#ifndef CHIP_COROUTINE_HPP_
+#define CHIP_COROUTINE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "chip.hpp"
+
+
+namespace chip
+{
+
+using Clock = std::chrono::steady_clock;
+
+class EventLoop;
+class Robot;
+
+
+// Limits placed on a single round trip.  The defaults wait for as long as the library keeps retrying.
+struct RequestOptions
+{
+    Clock::time_point deadline = Clock::time_point::max();
+    std::stop_token   stopToken;
+};
+
+
+namespace detail
+{
+
+// Resumes whoever awaited a Task once it has finished.
+struct FinalAwaiter
+{
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+    {
+        std::coroutine_handle<> continuation = handle.promise().continuation;
+
+        return continuation ? continuation : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+};
+
+struct PromiseBase
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr      exception;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase
+{
+    std::optional<T> value;
+
+    template <typename U>
+    void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+};
+
+template <>
+struct Promise<void> : PromiseBase
+{
+    void return_void() {}
+};
+
+// Top level coroutine started by EventLoop::spawn().  Its frame frees itself once the task has finished.
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object() { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// A chipConnectToRobot() call run on one of an EventLoop's connect threads.  It is shared between that thread and the
+// robot so that the coroutine awaiting it can give up before the call returns.
+struct ConnectJob
+{
+    enum State { RUNNING, ABANDONED, FINISHED };
+
+    ConnectJob(CHiP* pCHiP, const std::string& name, bool hasName) : pCHiP(pCHiP), name(name), hasName(hasName) {}
+
+    void run()
+    {
+        int expected = RUNNING;
+
+        if (state.load() == RUNNING)
+            result = chipConnectToRobot(pCHiP, hasName ? name.c_str() : nullptr);
+        // Nobody is waiting for a connection which was abandoned so leave the robot disconnected, as it was found.
+        if (!state.compare_exchange_strong(expected, FINISHED))
+        {
+            if (result == CHIP_ERROR_NONE)
+                chipDisconnectFromRobot(pCHiP);
+            state.store(FINISHED);
+        }
+        state.notify_all();
+    }
+
+    CHiP*            pCHiP;
+    std::string      name;
+    bool             hasName;
+    int              result = CHIP_ERROR_NOT_CONNECTED;
+    std::atomic<int> state = RUNNING;
+};
+
+} // namespace detail
+
+
+// Lazily started coroutine which produces a T.  It starts running when it is first awaited and resumes the awaiting
+// coroutine when it finishes.  Tasks which aren't awaited by another coroutine are started with EventLoop::spawn().
+template <typename T = void>
+class [[nodiscard]] Task
+{
+public:
+    struct promise_type : detail::Promise<T>
+    {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task()
+    {
+        if (m_handle)
+            m_handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+    {
+        m_handle.promise().continuation = caller;
+        return m_handle;
+    }
+    T await_resume()
+    {
+        if (m_handle.promise().exception)
+            std::rethrow_exception(m_handle.promise().exception);
+        if constexpr (!std::is_void_v<T>)
+            return std::move(*m_handle.promise().value);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+
+// Runs the coroutines for a set of robots from the thread which calls run().
+class EventLoop
+{
+public:
+    static constexpr size_t DEFAULT_CONNECT_THREADS = 4;
+
+    // connectThreadCount: Number of threads which run the blocking chipConnectToRobot() calls for the loop's robots.
+    //                     Any more connections than this wait in line.  The threads are started by the first connect().
+    explicit EventLoop(size_t connectThreadCount = DEFAULT_CONNECT_THREADS);
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Start a task the next time the loop runs.  Any exception which escapes it terminates the program.
+    void spawn(Task<> task);
+
+    // Run until every spawned task has finished.
+    void run();
+
+    // Resume a coroutine on the loop's thread.  Can be called from any thread.
+    void post(std::coroutine_handle<> handle);
+
+    // Wake the loop so that it checks for cancelled requests.  Can be called from any thread.
+    void wake();
+
+private:
+    friend class Robot;
+
+    static detail::Detached runDetached(EventLoop* pLoop, Task<> task);
+    void resumeReady();
+    void pollOnce();
+    void queueConnect(std::shared_ptr<detail::ConnectJob> pJob);
+    void runConnects();
+
+    std::vector<Robot*>                             m_robots;
+    std::deque<std::coroutine_handle<>>             m_ready;
+    std::vector<pollfd>                             m_pollFds;
+    std::mutex                                      m_postMutex;
+    std::vector<std::coroutine_handle<>>            m_posted;
+    size_t                                          m_taskCount = 0;
+    int                                             m_wakeFds[2] = { -1, -1 };
+
+    std::mutex                                      m_connectMutex;
+    std::condition_variable                         m_connectCondition;
+    std::deque<std::shared_ptr<detail::ConnectJob>> m_connects;
+    std::vector<std::thread>                        m_connectThreads;
+    size_t                                          m_connectThreadCount;
+    bool                                            m_isShuttingDown = false;
+};
+
+
+// A CHiP robot whose round trips are awaitable from coroutines running on its EventLoop.
+class Robot
+{
+public:
+    class ConnectAwaiter;
+    class RequestAwaiter;
+    class NotificationAwaiter;
+
+    // Calls chipInit().  Check that it succeeded with operator bool before using the robot.
+    explicit Robot(EventLoop& loop, const char* pInitOptions = nullptr);
+    ~Robot();
+    Robot(const Robot&) = delete;
+    Robot& operator=(const Robot&) = delete;
+
+    explicit operator bool() const { return static_cast<bool>(m_handle); }
+    CHiP* get() const { return m_handle.get(); }
+
+    // Connect to the named robot, or to the first one discovered if pRobotName is NULL.  Requests made while the
+    // connection is in progress are held until it completes.  Only one connection attempt can be made at a time and a
+    // second completes with CHIP_ERROR_BUSY.  chipConnectToRobot() itself can't be interrupted so a connection which
+    // times out or is cancelled carries on in the background and is disconnected again if it succeeds.
+    ConnectAwaiter connect(const char* pRobotName = nullptr, RequestOptions options = {});
+
+    // Disconnect straight away, completing any requests which are outstanding with CHIP_ERROR_NOT_CONNECTED.
+    Result<void> disconnect();
+
+    // Send a raw request, as chipRawReceive() would, and await its response.
+    RequestAwaiter request(std::span<const uint8_t> request, RequestOptions options = {});
+
+    // Await the next out of band notification, as returned by chipRawReceiveNotification().
+    NotificationAwaiter notification(RequestOptions options = {});
+
+    // Typed getters which decode the response with chipDecodeResponse().  A response which doesn't decode completes
+    // with CHIP_ERROR_BAD_RESPONSE.
+    Task<Result<CHiPBatteryLevel>> batteryLevel(RequestOptions options = {});
+    Task<Result<CHiPDogVersion>> dogVersion(RequestOptions options = {});
+    Task<Result<CHiPSpeed>> speed(RequestOptions options = {});
+    Task<Result<uint8_t>> volume(RequestOptions options = {});
+    Task<Result<uint8_t>> eyeBrightness(RequestOptions options = {});
+    Task<Result<CHiPCurrentDateTime>> currentDateTime(RequestOptions options = {});
+    Task<Result<CHiPAlarmDateTime>> alarmDateTime(RequestOptions options = {});
+
+private:
+    friend class EventLoop;
+
+    // State shared by the awaitables which complete from the loop.
+    class Waiter
+    {
+    public:
+        explicit Waiter(Robot& robot, const RequestOptions& options) : m_robot(robot), m_options(options) {}
+        Waiter(const Waiter&) = delete;
+        Waiter& operator=(const Waiter&) = delete;
+
+    protected:
+        friend class Robot;
+
+        struct CancelCallback
+        {
+            Waiter* pWaiter;
+            void operator()() const
+            {
+                pWaiter->m_isCancelled.store(true);
+                pWaiter->m_robot.m_loop.wake();
+            }
+        };
+
+        void suspend(std::coroutine_handle<> handle)
+        {
+            m_handle = handle;
+            m_stopCallback.emplace(m_options.stopToken, CancelCallback{ this });
+        }
+        bool isExpired(Clock::time_point now) const { return m_isCancelled.load() || now >= m_options.deadline; }
+        int expiredResult() const { return m_isCancelled.load() ? CHIP_ERROR_NO_REQUEST : CHIP_ERROR_TIMEOUT; }
+        void complete(int result)
+        {
+            m_result = result;
+            m_stopCallback.reset();
+            m_robot.m_loop.m_ready.push_back(m_handle);
+        }
+
+        Robot&                                           m_robot;
+        RequestOptions                                   m_options;
+        std::coroutine_handle<>                          m_handle;
+        std::optional<std::stop_callback<CancelCallback>> m_stopCallback;
+        std::atomic<bool>                                m_isCancelled = false;
+        int                                              m_result = CHIP_ERROR_NONE;
+        RawResponse                                      m_response = {};
+    };
+
+    template <typename T>
+    Task<Result<T>> query(uint8_t command, T CHiPResponse::* pMember, RequestOptions options);
+    void dispatch(uint32_t events, Clock::time_point now);
+    void startNext();
+    void failAll(int result);
+    bool isWaiting() const { return m_pConnect || m_pActive || !m_requests.empty() || !m_notifications.empty(); }
+    Clock::time_point nextDeadline() const;
+
+    EventLoop&                          m_loop;
+    Handle                              m_handle;
+    int                                 m_pollFd = -1;
+    RequestAwaiter*                     m_pActive = nullptr;
+    std::deque<RequestAwaiter*>         m_requests;
+    std::deque<NotificationAwaiter*>    m_notifications;
+    std::shared_ptr<detail::ConnectJob> m_pConnect;
+    ConnectAwaiter*                     m_pConnectWaiter = nullptr;
+    bool                                m_isStartRefused = false;
+};
+
+class Robot::ConnectAwaiter : public Robot::Waiter
+{
+public:
+    bool await_ready()
+    {
+        if (m_options.stopToken.stop_requested())
+            m_result = CHIP_ERROR_NO_REQUEST;
+        else if (m_robot.m_pConnect)
+            m_result = CHIP_ERROR_BUSY;
+        else
+            return false;
+        return true;
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        suspend(handle);
+        m_robot.m_pConnect = std::make_shared<detail::ConnectJob>(m_robot.get(), m_name, m_hasName);
+        m_robot.m_pConnectWaiter = this;
+        m_robot.m_loop.queueConnect(m_robot.m_pConnect);
+    }
+    Result<void> await_resume() const
+    {
+        return Error{ m_result };
+    }
+
+private:
+    friend class Robot;
+
+    ConnectAwaiter(Robot& robot, const char* pRobotName, const RequestOptions& options)
+        : Waiter(robot, options), m_name(pRobotName ? pRobotName : ""), m_hasName(pRobotName != nullptr) {}
+
+    std::string m_name;
+    bool        m_hasName;
+};
+
+class Robot::RequestAwaiter : public Robot::Waiter
+{
+public:
+    bool await_ready()
+    {
+        if (m_requestLength < 1 || m_requestLength > CHIP_REQUEST_MAX_LEN)
+            m_result = CHIP_ERROR_PARAM;
+        else if (m_options.stopToken.stop_requested())
+            m_result = CHIP_ERROR_NO_REQUEST;
+        else
+            return false;
+        return true;
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        suspend(handle);
+        m_robot.m_requests.push_back(this);
+        m_robot.startNext();
+    }
+    Result<RawResponse> await_resume() const
+    {
+        if (m_result)
+            return Error{ m_result };
+        return m_response;
+    }
+
+private:
+    friend class Robot;
+
+    RequestAwaiter(Robot& robot, std::span<const uint8_t> request, const RequestOptions& options)
+        : Waiter(robot, options), m_requestLength(request.size())
+    {
+        if (m_requestLength <= sizeof(m_request))
+            memcpy(m_request, request.data(), m_requestLength);
+    }
+
+    uint8_t m_request[CHIP_REQUEST_MAX_LEN];
+    size_t  m_requestLength;
+};
+
+class Robot::NotificationAwaiter : public Robot::Waiter
+{
+public:
+    bool await_ready()
+    {
+        // Notifications already queued are handed out straight away, unless earlier waiters are still in line.
+        if (m_options.stopToken.stop_requested())
+        {
+            m_result = CHIP_ERROR_NO_REQUEST;
+            return true;
+        }
+        if (!m_robot.m_notifications.empty())
+            return false;
+        m_result = chipRawReceiveNotification(m_robot.get(), m_response.data, sizeof(m_response.data),
+                                              &m_response.length);
+        return m_result != CHIP_ERROR_EMPTY;
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        suspend(handle);
+        m_robot.m_notifications.push_back(this);
+    }
+    Result<RawResponse> await_resume() const
+    {
+        if (m_result)
+            return Error{ m_result };
+        return m_response;
+    }
+
+private:
+    friend class Robot;
+
+    NotificationAwaiter(Robot& robot, const RequestOptions& options) : Waiter(robot, options) {}
+};
+
+
+inline EventLoop::EventLoop(size_t connectThreadCount) : m_connectThreadCount(std::max<size_t>(connectThreadCount, 1))
+{
+    // Self pipe used by wake() and post() to interrupt the poll() from other threads.
+    if (pipe(m_wakeFds) == 0)
+    {
+        for (int fd : m_wakeFds)
+        {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+}
+
+inline EventLoop::~EventLoop()
+{
+    assert( m_robots.empty() );
+    {
+        std::lock_guard<std::mutex> lock(m_connectMutex);
+        m_isShuttingDown = true;
+    }
+    m_connectCondition.notify_all();
+    for (std::thread& thread : m_connectThreads)
+        thread.join();
+    for (int fd : m_wakeFds)
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+inline void EventLoop::spawn(Task<> task)
+{
+    m_taskCount++;
+    m_ready.push_back(runDetached(this, std::move(task)).handle);
+}
+
+inline detail::Detached EventLoop::runDetached(EventLoop* pLoop, Task<> task)
+{
+    co_await task;
+    pLoop->m_taskCount--;
+}
+
+inline void EventLoop::run()
+{
+    for (;;)
+    {
+        resumeReady();
+        if (m_taskCount == 0)
+            break;
+        pollOnce();
+    }
+}
+
+inline void EventLoop::post(std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        m_posted.push_back(handle);
+    }
+    wake();
+}
+
+inline void EventLoop::wake()
+{
+    uint8_t byte = 0;
+
+    // A full pipe already wakes the loop so a failed write doesn't matter.
+    while (write(m_wakeFds[1], &byte, sizeof(byte)) < 0 && errno == EINTR)
+    {
+    }
+}
+
+inline void EventLoop::queueConnect(std::shared_ptr<detail::ConnectJob> pJob)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_connectMutex);
+
+        while (m_connectThreads.size() < m_connectThreadCount)
+            m_connectThreads.emplace_back(&EventLoop::runConnects, this);
+        m_connects.push_back(std::move(pJob));
+    }
+    m_connectCondition.notify_one();
+}
+
+inline void EventLoop::runConnects()
+{
+    for (;;)
+    {
+        std::shared_ptr<detail::ConnectJob> pJob;
+
+        {
+            std::unique_lock<std::mutex> lock(m_connectMutex);
+
+            m_connectCondition.wait(lock, [this] { return m_isShuttingDown || !m_connects.empty(); });
+            if (m_connects.empty())
+                return;
+            pJob = std::move(m_connects.front());
+            m_connects.pop_front();
+        }
+        pJob->run();
+        wake();
+    }
+}
+
+inline void EventLoop::resumeReady()
+{
+    while (!m_ready.empty())
+    {
+        std::coroutine_handle<> handle = m_ready.front();
+
+        m_ready.pop_front();
+        handle.resume();
+    }
+}
+
+inline void EventLoop::pollOnce()
+{
+    Clock::time_point deadline = Clock::time_point::max();
+    Clock::time_point now = Clock::now();
+    int               timeout = -1;
+    uint8_t           buffer[64];
+
+    m_pollFds.clear();
+    m_pollFds.push_back({ m_wakeFds[0], POLLIN, 0 });
+    for (Robot* pRobot : m_robots)
+    {
+        int robotTimeout = chipGetPollTimeout(pRobot->get());
+
+        m_pollFds.push_back({ pRobot->m_pollFd, POLLIN, 0 });
+        if (robotTimeout >= 0 && (timeout < 0 || robotTimeout < timeout))
+            timeout = robotTimeout;
+        deadline = std::min(deadline, pRobot->nextDeadline());
+    }
+    if (deadline != Clock::time_point::max())
+    {
+        // Round up so that the deadline has always passed by the time the poll() times out.
+        Clock::duration remaining = std::max(deadline - now, Clock::duration::zero());
+        int64_t         milliseconds = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+
+        if (timeout < 0 || milliseconds < timeout)
+            timeout = (int)std::min<int64_t>(milliseconds, std::numeric_limits<int>::max());
+    }
+    poll(m_pollFds.data(), m_pollFds.size(), timeout);
+
+    while (read(m_wakeFds[0], buffer, sizeof(buffer)) > 0)
+    {
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        m_ready.insert(m_ready.end(), m_posted.begin(), m_posted.end());
+        m_posted.clear();
+    }
+    // Robots with nothing outstanding only need attention when their descriptor is readable.
+    now = Clock::now();
+    for (size_t i = 0 ; i < m_robots.size() ; i++)
+    {
+        Robot* pRobot = m_robots[i];
+
+        if (m_pollFds[i + 1].revents || pRobot->isWaiting())
+            pRobot->dispatch(chipProcessEvents(pRobot->get()), now);
+    }
+}
+
+
+inline Robot::Robot(EventLoop& loop, const char* pInitOptions) : m_loop(loop)
+{
+    Result<Handle> handle = Handle::create(pInitOptions);
+
+    if (!handle)
+        return;
+    m_pollFd = chipGetPollFd(handle->get());
+    if (m_pollFd < 0)
+        return;
+    m_handle = std::move(handle).value();
+    m_loop.m_robots.push_back(this);
+}
+
+inline Robot::~Robot()
+{
+    // Coroutines which are still waiting on the robot would be left with a dangling reference.
+    assert( !m_pActive && m_requests.empty() && m_notifications.empty() && !m_pConnectWaiter );
+    // A connection which was given up on may still be running on one of the loop's threads.
+    if (m_pConnect)
+        m_pConnect->state.wait(detail::ConnectJob::ABANDONED);
+    if (m_handle)
+        m_loop.m_robots.erase(std::find(m_loop.m_robots.begin(), m_loop.m_robots.end(), this));
+}
+
+inline Robot::ConnectAwaiter Robot::connect(const char* pRobotName, RequestOptions options)
+{
+    return ConnectAwaiter(*this, pRobotName, options);
+}
+
+inline Result<void> Robot::disconnect()
+{
+    if (m_pActive)
+        chipCancelRequest(get());
+    failAll(CHIP_ERROR_NOT_CONNECTED);
+    return Error{ chipDisconnectFromRobot(get()) };
+}
+
+inline Robot::RequestAwaiter Robot::request(std::span<const uint8_t> request, RequestOptions options)
+{
+    return RequestAwaiter(*this, request, options);
+}
+
+inline Robot::NotificationAwaiter Robot::notification(RequestOptions options)
+{
+    return NotificationAwaiter(*this, options);
+}
+
+template <typename T>
+Task<Result<T>> Robot::query(uint8_t command, T CHiPResponse::* pMember, RequestOptions options)
+{
+    const uint8_t       requestBytes[1] = { command };
+    Result<RawResponse> response = co_await request(requestBytes, options);
+    CHiPResponse        decoded;
+
+    if (!response)
+        co_return Error{ response.error() };
+    if (chipDecodeResponse(response->data, response->length, &decoded) != CHIP_ERROR_NONE || decoded.command != command)
+        co_return Error{ CHIP_ERROR_BAD_RESPONSE };
+    co_return decoded.*pMember;
+}
+
+inline Task<Result<CHiPBatteryLevel>> Robot::batteryLevel(RequestOptions options)
+{
+    return query(CHIP_CMD_GET_BATTERY_LEVEL, &CHiPResponse::batteryLevel, options);
+}
+
+inline Task<Result<CHiPDogVersion>> Robot::dogVersion(RequestOptions options)
+{
+    return query(CHIP_CMD_GET_DOG_VERSION, &CHiPResponse::dogVersion, options);
+}
+
+inline Task<Result<CHiPSpeed>> Robot::speed(RequestOptions options)
+{
+    return query(CHIP_CMD_GET_SPEED, &CHiPResponse::speed, options);
+}
+
+inline Task<Result<uint8_t>> Robot::volume(RequestOptions options)
+{
+    return query(CHIP_CMD_GET_VOLUME, &CHiPResponse::volume, options);
+}
+
+inline Task<Result<uint8_t>> Robot::eyeBrightness(RequestOptions options)
+{
+    return query(CHIP_CMD_GET_EYE_BRIGHTNESS, &CHiPResponse::eyeBrightness, options);
+}
+
+inline Task<Result<CHiPCurrentDateTime>> Robot::currentDateTime(RequestOptions options)
+{
+    return query(CHIP_CMD_GET_CURRENT_DATE_TIME, &CHiPResponse::currentDateTime, options);
+}
+
+inline Task<Result<CHiPAlarmDateTime>> Robot::alarmDateTime(RequestOptions options)
+{
+    return query(CHIP_CMD_GET_ALARM_DATE_TIME, &CHiPResponse::alarmDateTime, options);
+}
+
+inline void Robot::dispatch(uint32_t events, Clock::time_point now)
+{
+    if (m_pConnect && m_pConnect->state.load() == detail::ConnectJob::FINISHED)
+    {
+        if (m_pConnectWaiter)
+            std::exchange(m_pConnectWaiter, nullptr)->complete(m_pConnect->result);
+        m_pConnect.reset();
+    }
+    else if (m_pConnectWaiter && m_pConnectWaiter->isExpired(now))
+    {
+        int expected = detail::ConnectJob::RUNNING;
+
+        // Losing the race to the connect thread means that the result is about to be reported instead.
+        if (m_pConnect->state.compare_exchange_strong(expected, detail::ConnectJob::ABANDONED))
+        {
+            ConnectAwaiter* pWaiter = std::exchange(m_pConnectWaiter, nullptr);
+
+            pWaiter->complete(pWaiter->expiredResult());
+        }
+    }
+
+    if (m_pActive && (events & CHIP_EVENT_RESPONSE))
+    {
+        RequestAwaiter* pActive = std::exchange(m_pActive, nullptr);
+
+        pActive->complete(chipGetRequestResponse(get(), pActive->m_response.data, sizeof(pActive->m_response.data),
+                                                 &pActive->m_response.length));
+    }
+    else if (m_pActive && m_pActive->isExpired(now))
+    {
+        RequestAwaiter* pActive = std::exchange(m_pActive, nullptr);
+
+        chipCancelRequest(get());
+        pActive->complete(pActive->expiredResult());
+    }
+
+    for (auto it = m_requests.begin() ; it != m_requests.end() ; )
+    {
+        RequestAwaiter* pWaiter = *it;
+
+        if (!pWaiter->isExpired(now))
+        {
+            ++it;
+            continue;
+        }
+        it = m_requests.erase(it);
+        pWaiter->complete(pWaiter->expiredResult());
+    }
+    for (auto it = m_notifications.begin() ; it != m_notifications.end() ; )
+    {
+        NotificationAwaiter* pWaiter = *it;
+
+        if (!pWaiter->isExpired(now))
+        {
+            ++it;
+            continue;
+        }
+        it = m_notifications.erase(it);
+        pWaiter->complete(pWaiter->expiredResult());
+    }
+
+    while ((events & CHIP_EVENT_NOTIFICATION) && !m_notifications.empty())
+    {
+        NotificationAwaiter* pWaiter = m_notifications.front();
+        int                  result;
+
+        result = chipRawReceiveNotification(get(), pWaiter->m_response.data, sizeof(pWaiter->m_response.data),
+                                            &pWaiter->m_response.length);
+        if (result == CHIP_ERROR_EMPTY)
+            break;
+        m_notifications.pop_front();
+        pWaiter->complete(result);
+    }
+
+    if (events & CHIP_EVENT_READY)
+        m_isStartRefused = false;
+    startNext();
+}
+
+inline void Robot::startNext()
+{
+    // A refusal means one of the library's background threads is using the robot.  CHIP_EVENT_READY follows once it
+    // is done.
+    while (!m_pActive && !m_requests.empty() && !m_pConnect && !m_isStartRefused)
+    {
+        RequestAwaiter* pWaiter = m_requests.front();
+        int             result;
+
+        result = chipStartRequest(get(), pWaiter->m_request, pWaiter->m_requestLength);
+        if (result == CHIP_ERROR_BUSY)
+        {
+            m_isStartRefused = true;
+            break;
+        }
+        m_requests.pop_front();
+        if (result == CHIP_ERROR_NONE)
+            m_pActive = pWaiter;
+        else
+            pWaiter->complete(result);
+    }
+}
+
+inline void Robot::failAll(int result)
+{
+    if (m_pActive)
+        std::exchange(m_pActive, nullptr)->complete(result);
+    while (!m_requests.empty())
+    {
+        m_requests.front()->complete(result);
+        m_requests.pop_front();
+    }
+    while (!m_notifications.empty())
+    {
+        m_notifications.front()->complete(result);
+        m_notifications.pop_front();
+    }
+}
+
+inline Clock::time_point Robot::nextDeadline() const
+{
+    Clock::time_point deadline = m_pActive ? m_pActive->m_options.deadline : Clock::time_point::max();
+
+    if (m_pConnectWaiter)
+        deadline = std::min(deadline, m_pConnectWaiter->m_options.deadline);
+    for (const RequestAwaiter* pWaiter : m_requests)
+        deadline = std::min(deadline, pWaiter->m_options.deadline);
+    for (const NotificationAwaiter* pWaiter : m_notifications)
+        deadline = std::min(deadline, pWaiter->m_options.deadline);
+    return deadline;
+}
+
+} // namespace chip
+
+#endif // CHIP_COROUTINE_HPP_
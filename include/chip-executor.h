@@ -0,0 +1,108 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the work-stealing executor used to run the same operation across a fleet of robots.
+   The robots are split evenly between a pool of worker threads.  A worker which runs out of robots steals half of the
+   remaining robots from another worker so a few slow links don't leave the other workers idle.  Each robot is
+   handled by exactly one worker and the results are gathered into arrays indexed the same as the array of robots.
+
+   Timing uses the clock returned by chipClockGetDefault() when the executor was created.  With a virtual clock, the
+   workers attach to the clock when an operation starts and detach once they run out of work, so the clock should be
+   created with a threadCount that doesn't include them.  The thread blocked in chipExecutorRun() doesn't wait on the
+   clock either so it shouldn't be counted while the operation runs.
+*/
+#ifndef CHIP_EXECUTOR_H_
+#define CHIP_EXECUTOR_H_
+
+#include "chip.h"
+
+
+// Number of worker threads started when chipExecutorCreate() is passed a workerCount of 0.
+#define CHIP_EXECUTOR_DEFAULT_WORKERS 8
+
+
+// Abstraction of the pointer type returned by chipExecutorCreate() and passed into the other chipExecutor*() functions.
+typedef struct CHiPExecutor CHiPExecutor;
+
+// Function run by chipExecutorRun() for each robot.
+//
+//   pContext: The pContext value passed into chipExecutorRun().
+//   pCHiP: The robot to be operated on.
+//   robotIndex: Index of pCHiP in the array passed into chipExecutorRun().
+//   pResult: Pointer to this robot's resultSize bytes in the results array.  NULL if no results array was given.
+//   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.
+typedef int (*CHiPExecutorTask)(void* pContext, CHiP* pCHiP, size_t robotIndex, void* pResult);
+
+// Per-worker counters for the most recent chipExecutorRun() call.
+typedef struct CHiPWorkerStats
+{
+    uint32_t tasksRun;              // Number of robots handled by this worker.
+    uint32_t tasksStolen;           // Number of robots this worker stole from other workers.
+    uint64_t busyMicroseconds;      // Time spent running tasks.
+    uint64_t elapsedMicroseconds;   // Time from the start to the end of the whole operation.
+    float    utilization;           // busyMicroseconds / elapsedMicroseconds.
+} CHiPWorkerStats;
+
+
+// Create an executor and start its worker threads.
+//
+//   workerCount: The number of worker threads.  0 selects CHIP_EXECUTOR_DEFAULT_WORKERS.  Most of a worker's time is
+//                spent waiting on its robot so this can usefully be larger than the number of cores.
+//   Returns: NULL on error.
+//            A valid pointer to an executor object otherwise.
+CHiPExecutor* chipExecutorCreate(uint32_t workerCount);
+
+// Stop the worker threads and free the executor.
+//
+//   pExecutor: An object that was previously returned from the chipExecutorCreate() call.
+void chipExecutorDestroy(CHiPExecutor* pExecutor);
+
+// Number of worker threads started by chipExecutorCreate().
+uint32_t chipExecutorGetWorkerCount(CHiPExecutor* pExecutor);
+
+// Run a task for each robot in an array and wait for all of them to complete.  Only one operation runs at a time on
+// an executor; concurrent callers are serialized.
+//
+//   pExecutor: An object that was previously returned from the chipExecutorCreate() call.
+//   ppCHiPs: Array of robots.  The same robot shouldn't appear more than once.
+//   robotCount: Number of robots in ppCHiPs.
+//   task: Function to be called for each robot.
+//   pContext: Value to be passed through to each task call.
+//   pResults: Array of robotCount results, each resultSize bytes long, into which the tasks write.  Can be NULL.
+//   resultSize: Size of each element in pResults.
+//   pResultCodes: Array of robotCount integers which will be filled in with each task's return value.  Can be NULL.
+//   Returns: CHIP_ERROR_NONE if every task succeeded.
+//            Otherwise the error returned by the failing task with the lowest robot index.
+int chipExecutorRun(CHiPExecutor* pExecutor, CHiP** ppCHiPs, size_t robotCount, CHiPExecutorTask task, void* pContext,
+                    void* pResults, size_t resultSize, int* pResultCodes);
+
+// Get one worker's counters for the most recent chipExecutorRun() call.
+//
+//   pExecutor: An object that was previously returned from the chipExecutorCreate() call.
+//   workerIndex: Must be < the count returned from chipExecutorGetWorkerCount().
+//   pStats: A pointer to where the counters should be placed.
+//   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.
+int chipExecutorGetWorkerStats(CHiPExecutor* pExecutor, uint32_t workerIndex, CHiPWorkerStats* pStats);
+
+
+// Bulk versions of common API calls.  Each one runs the API call for every robot in ppCHiPs and places the results in
+// arrays with the same indexing.  pResultCodes can be NULL.  The return value follows chipExecutorRun().
+int chipExecutorGetBatteryLevels(CHiPExecutor* pExecutor, CHiP** ppCHiPs, size_t robotCount,
+                                 CHiPBatteryLevel* pBatteryLevels, int* pResultCodes);
+int chipExecutorSetCurrentDateTimes(CHiPExecutor* pExecutor, CHiP** ppCHiPs, size_t robotCount,
+                                    const CHiPCurrentDateTime* pDateTime, int* pResultCodes);
+int chipExecutorGetDogVersions(CHiPExecutor* pExecutor, CHiP** ppCHiPs, size_t robotCount,
+                               CHiPDogVersion* pVersions, int* pResultCodes);
+
+#endif // CHIP_EXECUTOR_H_
@@ -0,0 +1,73 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the optional metrics exporter.  It runs on its own background thread and publishes the
+   health of one or more CHiP robots in the Prometheus text exposition format, either by periodically rewriting a file
+   (for use with the node_exporter textfile collector) or by serving the metrics to each client which connects to a
+   local Unix domain socket.  Metrics are gathered with chipGetStats() and chipGetLastBatteryLevel() which never block
+   on the robot so exporting adds no jitter to the thread issuing commands.
+*/
+#ifndef CHIP_EXPORTER_H_
+#define CHIP_EXPORTER_H_
+
+#include "chip.h"
+
+
+// Abstraction of the pointer type returned by chipExporterStart*() and passed into the other chipExporter*() functions.
+typedef struct CHiPExporter CHiPExporter;
+
+
+// Start exporting metrics to a file.
+// The metrics are written to a temporary file which is then renamed over pFilename so that readers never see a
+// partially written file.
+//
+//   pFilename: The name of the file to be periodically rewritten with the latest metrics.
+//   intervalMilliseconds: How often the file should be rewritten.
+//   Returns: NULL on error.
+//            A valid pointer to an exporter object otherwise.
+CHiPExporter* chipExporterStartFile(const char* pFilename, uint32_t intervalMilliseconds);
+
+// Start serving metrics over a local Unix domain socket.
+// Each client which connects to the socket is sent the latest metrics and then the connection is closed.  For example:
+//   socat - UNIX-CONNECT:/tmp/chip-metrics.sock
+//
+//   pSocketPath: The filesystem path at which the socket should be created.  Any existing socket at this path is
+//                removed first.
+//   Returns: NULL on error.
+//            A valid pointer to an exporter object otherwise.
+CHiPExporter* chipExporterStartSocket(const char* pSocketPath);
+
+// Stop the exporter's background thread and free its resources.
+//
+//   pExporter: An object that was previously returned from one of the chipExporterStart*() calls.
+void chipExporterStop(CHiPExporter* pExporter);
+
+// Add a robot to those being exported.
+//
+//   pExporter: An object that was previously returned from one of the chipExporterStart*() calls.
+//   pCHiP: An object that was previously returned from the chipInit() call.  It must stay valid until it is removed
+//          with chipExporterRemoveRobot() or the exporter is stopped.
+//   pRobotLabel: The value of the robot="" label attached to each of this robot's metrics.  A copy is made.
+//   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.
+int chipExporterAddRobot(CHiPExporter* pExporter, CHiP* pCHiP, const char* pRobotLabel);
+
+// Remove a robot from those being exported.
+// Once this function returns, the exporter no longer references pCHiP so it is safe to pass it into chipUninit().
+//
+//   pExporter: An object that was previously returned from one of the chipExporterStart*() calls.
+//   pCHiP: An object that was previously added with chipExporterAddRobot().
+//   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.
+int chipExporterRemoveRobot(CHiPExporter* pExporter, CHiP* pCHiP);
+
+#endif // CHIP_EXPORTER_H_
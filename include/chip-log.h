@@ -0,0 +1,130 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the low overhead logging facility used by the CHiP API and its transports.
+   Logging a message only records its level, timestamp, format string pointer and up to CHIP_LOG_MAX_ARGS integer
+   arguments into a lock free in-memory ring.  The message isn't formatted until chipLogFlush() hands it to the sink,
+   normally on a background flusher thread, so logging from a hot path never blocks on formatting or I/O.
+
+   Restrictions that come with deferred formatting:
+   * The format string must be a string literal.
+   * Arguments must be integers, characters, pointers (%p) or string literals (%s).  Floating point isn't supported.
+   * There can be at most CHIP_LOG_MAX_ARGS arguments.
+*/
+#ifndef CHIP_LOG_H_
+#define CHIP_LOG_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+
+// Log levels.
+#define CHIP_LOG_LEVEL_DEBUG    0
+#define CHIP_LOG_LEVEL_INFO     1
+#define CHIP_LOG_LEVEL_WARNING  2
+#define CHIP_LOG_LEVEL_ERROR    3
+#define CHIP_LOG_LEVEL_NONE     4
+
+// Log statements below this level are compiled out completely.  Can be overridden on the compiler command line.
+#ifndef CHIP_LOG_COMPILE_LEVEL
+#define CHIP_LOG_COMPILE_LEVEL  CHIP_LOG_LEVEL_INFO
+#endif
+
+// Maximum number of arguments which can be passed to a single log statement.
+#define CHIP_LOG_MAX_ARGS       4
+
+// Number of records which can be waiting in the ring to be flushed.  Records logged while the ring is full are dropped
+// and counted.
+#define CHIP_LOG_RING_SIZE      1024
+
+
+typedef struct CHiPLogRecord
+{
+    uint64_t    timestamp;  // Microseconds from a monotonic clock.
+    const char* pFormat;
+    uint8_t     level;
+    uint8_t     argCount;
+    uint64_t    args[CHIP_LOG_MAX_ARGS];
+} CHiPLogRecord;
+
+// Sinks are called from whichever thread calls chipLogFlush() with the raw record and its formatted message.
+typedef void (*CHiPLogSink)(void* pContext, const CHiPLogRecord* pRecord, const char* pMessage);
+
+
+// Set the minimum level of messages to be recorded at runtime.  Defaults to CHIP_LOG_LEVEL_INFO.
+void chipLogSetLevel(int level);
+
+// Set the sink to which flushed messages are sent.  Pass in NULL to restore the default sink which writes each
+// message to stderr.
+void chipLogSetSink(CHiPLogSink sink, void* pContext);
+
+// Format and send all of the records currently in the ring to the sink.
+//
+//   Returns: The number of records flushed.
+size_t chipLogFlush(void);
+
+// Start a background thread which calls chipLogFlush() every intervalMilliseconds.
+//
+//   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.
+int chipLogStartFlusher(uint32_t intervalMilliseconds);
+
+// Stop the background flusher thread, after a final flush.
+void chipLogStopFlusher(void);
+
+// Number of records which were dropped because the ring was full.
+uint32_t chipLogGetDropCount(void);
+
+// Format a record into pBuffer.  This is what chipLogFlush() uses to create the message passed into the sink.
+void chipLogFormat(const CHiPLogRecord* pRecord, char* pBuffer, size_t bufferSize);
+
+// Record a message.  Normally called through the CHIP_LOG_*() macros below rather than directly.
+void chipLogWrite(int level, const char* pFormat, int argCount,
+                  uint64_t arg0, uint64_t arg1, uint64_t arg2, uint64_t arg3);
+
+
+// Macros used to log messages.  For example:
+//  CHIP_LOG_WARNING("Retrying request 0x%02X", pRequest[0]);
+#if CHIP_LOG_COMPILE_LEVEL <= CHIP_LOG_LEVEL_DEBUG
+#define CHIP_LOG_DEBUG(...)     CHIP_LOG_(CHIP_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define CHIP_LOG_DEBUG(...)     ((void)0)
+#endif
+#if CHIP_LOG_COMPILE_LEVEL <= CHIP_LOG_LEVEL_INFO
+#define CHIP_LOG_INFO(...)      CHIP_LOG_(CHIP_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define CHIP_LOG_INFO(...)      ((void)0)
+#endif
+#if CHIP_LOG_COMPILE_LEVEL <= CHIP_LOG_LEVEL_WARNING
+#define CHIP_LOG_WARNING(...)   CHIP_LOG_(CHIP_LOG_LEVEL_WARNING, __VA_ARGS__)
+#else
+#define CHIP_LOG_WARNING(...)   ((void)0)
+#endif
+#if CHIP_LOG_COMPILE_LEVEL <= CHIP_LOG_LEVEL_ERROR
+#define CHIP_LOG_ERROR(...)     CHIP_LOG_(CHIP_LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define CHIP_LOG_ERROR(...)     ((void)0)
+#endif
+
+
+// Implementation details of the above macros.  Counts the arguments after the format string and widens each of them
+// to 64 bits, padding with zeroes up to CHIP_LOG_MAX_ARGS.
+#define CHIP_LOG_(LEVEL, ...) \
+    chipLogWrite(LEVEL, CHIP_LOG_FORMAT_(__VA_ARGS__, _), CHIP_LOG_COUNT_(__VA_ARGS__, 4, 3, 2, 1, 0, _), \
+                 CHIP_LOG_ARGS_(__VA_ARGS__, 0, 0, 0, 0, _))
+#define CHIP_LOG_FORMAT_(FORMAT, ...)                   FORMAT
+#define CHIP_LOG_COUNT_(FORMAT, A, B, C, D, COUNT, ...) COUNT
+#define CHIP_LOG_ARGS_(FORMAT, A, B, C, D, ...) \
+    (uint64_t)(uintptr_t)(A), (uint64_t)(uintptr_t)(B), (uint64_t)(uintptr_t)(C), (uint64_t)(uintptr_t)(D)
+
+#endif // CHIP_LOG_H_
@@ -0,0 +1,72 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes settings profiles which are pushed to robots as minimal diffs.
+
+   A profile holds the settings which are normally pushed to a robot when it is provisioned or reconnects: speed,
+   volume, eye brightness, the real time clock and the alarm.  Its fieldMask uses the same CHIP_STATUS_* flags as
+   CHiPStatus to select which of those fields it carries.  chipProfileCapture() reads them all from a robot in a
+   single pass.  chipProfileApply() first reads the robot's current values, taking them from the settings cache where
+   it is fresh and reading the rest in one batch with chipGetStatusFields(), and then writes only the fields which
+   differ, back to back.  A robot which already matches the profile costs at most one round trip and no writes.
+*/
+#ifndef CHIP_PROFILE_H_
+#define CHIP_PROFILE_H_
+
+#include "chip.h"
+
+
+// The fields which can be carried by a profile.
+#define CHIP_PROFILE_FIELDS (CHIP_STATUS_SPEED | CHIP_STATUS_VOLUME | CHIP_STATUS_EYE_BRIGHTNESS | \
+                             CHIP_STATUS_CURRENT_DATE_TIME | CHIP_STATUS_ALARM_DATE_TIME)
+
+
+typedef struct CHiPProfile
+{
+    uint32_t            fieldMask;              // CHIP_STATUS_* flags of the fields to be applied.
+    CHiPSpeed           speed;
+    uint8_t             volume;                 // 1 to 11.
+    uint8_t             eyeBrightness;
+    CHiPCurrentDateTime currentDateTime;        // Time to set the robot's clock to.
+    uint32_t            clockToleranceSeconds;  // Robot's clock is left alone if it is within this many seconds.
+    CHiPAlarmDateTime   alarmDateTime;          // A month of 0 means that the alarm should be cancelled.
+} CHiPProfile;
+
+// What chipProfileApply() did with each field, as CHIP_STATUS_* flags.
+typedef struct CHiPProfileReport
+{
+    uint32_t writtenMask;       // Fields which differed from the robot, or couldn't be read, and were written.
+    uint32_t unchangedMask;     // Fields which already matched the robot and weren't sent.
+    uint32_t failedMask;        // Fields whose write failed.
+} CHiPProfileReport;
+
+
+// Read the settings carried by a profile from a robot.  The clock tolerance is left at 0.
+//
+//   pCHiP: An object that was previously returned from the chipInit() call.
+//   pProfile: Filled in with the robot's settings.  fieldMask has a flag set for each field which could be read.
+//   Returns: CHIP_ERROR_NONE if every field was read and the error from chipGetStatusFields() otherwise.
+int chipProfileCapture(CHiP* pCHiP, CHiPProfile* pProfile);
+
+// Write the fields of a profile which differ from the robot's current settings.
+//
+//   pCHiP: An object that was previously returned from the chipInit() call.
+//   pProfile: The settings to apply.  Only the fields flagged in its fieldMask are considered.
+//   pReport: Filled in with the fields which were written, already matched or failed.  Can be NULL.
+//   Returns: CHIP_ERROR_NONE on success.
+//            CHIP_ERROR_PARAM if fieldMask contains other flags or a field to apply is out of range.  Nothing is sent.
+//            Otherwise the error from the first write to fail.  The remaining fields are still written.
+int chipProfileApply(CHiP* pCHiP, const CHiPProfile* pProfile, CHiPProfileReport* pReport);
+
+#endif // CHIP_PROFILE_H_
@@ -0,0 +1,142 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file holds the single table describing the CHiP BLE protocol.  The CHIP_CMD_* command codes, the request
+   and response lengths, CHIP_REQUEST_MAX_LEN / CHIP_RESPONSE_MAX_LEN, the response validation rules and the
+   command-code lookup table used by chipDecodeResponse() are all generated from CHIP_PROTOCOL_TABLE so that they can't
+   drift apart.  See https://github.com/WowWeeLabs/CHiP-BLE-Protocol/blob/master/CHiP-Protocol.md for more information.
+*/
+#ifndef CHIP_PROTOCOL_H_
+#define CHIP_PROTOCOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Each row of the table is:
+//   X(NAME, CODE, REQUEST_LEN, RESPONSE_LEN, DECODER, RANGES)
+//
+//   NAME: Generates CHIP_CMD_NAME, CHIP_CMD_NAME_REQUEST_LEN and CHIP_CMD_NAME_RESPONSE_LEN.
+//   CODE: Command code placed in the first byte of the request and of its response.
+//   REQUEST_LEN: Length of the request, including the command byte.
+//   RESPONSE_LEN: Length of the response, including the command byte.  0 if the robot doesn't respond.
+//   DECODER: Suffix of the function which converts a validated response into a CHiPResponse.  None if no response.
+//   RANGES: CHIP_PROTOCOL_RANGE(offset, min, max) entries, separated by spaces, giving the valid range of bytes in
+//           the response.  Bytes without an entry can take any value.
+#define CHIP_PROTOCOL_TABLE(X) \
+    X(PLAY_SOUND,            0x06, 1+2, 0,    None,             ) \
+    X(ACTION,                0x07, 1+1, 0,    None,             ) \
+    X(GET_DOG_VERSION,       0x14, 1,   1+10, DogVersion,       ) \
+    X(GET_VOLUME,            0x16, 1,   1+1,  Volume,           CHIP_PROTOCOL_RANGE(1, 1, 11)) \
+    X(SET_VOLUME,            0x18, 1+1, 0,    None,             ) \
+    X(GET_BATTERY_LEVEL,     0x1C, 1,   1+3,  BatteryLevel,     CHIP_PROTOCOL_RANGE(1, 0, CHIP_CHARGING_STATUS_CHARGING_FINISHED) \
+                                                                CHIP_PROTOCOL_RANGE(2, 0, CHIP_CHARGER_TYPE_BASE)) \
+    X(GET_CURRENT_DATE_TIME, 0x3A, 1,   1+8,  CurrentDateTime,  CHIP_PROTOCOL_RANGE(3, 0, 12) /* Month */ \
+                                                                CHIP_PROTOCOL_RANGE(4, 0, 31) /* Day */ \
+                                                                CHIP_PROTOCOL_RANGE(5, 0, 23) /* Hour */ \
+                                                                CHIP_PROTOCOL_RANGE(6, 0, 59) /* Minute */ \
+                                                                CHIP_PROTOCOL_RANGE(7, 0, 59) /* Second */ \
+                                                                CHIP_PROTOCOL_RANGE(8, 0, 7)  /* Day of Week */) \
+    X(SET_CURRENT_DATE_TIME, 0x43, 1+8, 0,    None,             ) \
+    X(SET_ALARM_DATE_TIME,   0x44, 1+6, 0,    None,             ) \
+    X(SET_SPEED,             0x45, 1+1, 0,    None,             ) \
+    X(GET_SPEED,             0x46, 1,   1+1,  Speed,            CHIP_PROTOCOL_RANGE(1, 0, CHIP_SPEED_KID)) \
+    X(SET_EYE_BRIGHTNESS,    0x48, 1+1, 0,    None,             ) \
+    X(GET_EYE_BRIGHTNESS,    0x49, 1,   1+1,  EyeBrightness,    ) \
+    X(GET_ALARM_DATE_TIME,   0x4A, 1,   1+6,  AlarmDateTime,    CHIP_PROTOCOL_RANGE(3, 0, 12) /* Month */ \
+                                                                CHIP_PROTOCOL_RANGE(4, 0, 31) /* Day */ \
+                                                                CHIP_PROTOCOL_RANGE(5, 0, 23) /* Hour */ \
+                                                                CHIP_PROTOCOL_RANGE(6, 0, 59) /* Minute */) \
+    X(DRIVE,                 0x78, 1+3, 0,    None,             ) \
+    X(FORCE_SLEEP,           0xFA, 1+2, 0,    None,             )
+
+
+// CHiP Protocol Commands.
+// These command codes are placed in the first byte of requests sent to the CHiP and responses sent back from the CHiP.
+#define CHIP_PROTOCOL_CODE_ENUM(NAME, CODE, REQUEST_LEN, RESPONSE_LEN, DECODER, RANGES) \
+    CHIP_CMD_##NAME = CODE,
+enum
+{
+    CHIP_PROTOCOL_TABLE(CHIP_PROTOCOL_CODE_ENUM)
+};
+#undef CHIP_PROTOCOL_CODE_ENUM
+
+// Request and response lengths, including the command byte, for each command.
+#define CHIP_PROTOCOL_LENGTH_ENUM(NAME, CODE, REQUEST_LEN, RESPONSE_LEN, DECODER, RANGES) \
+    CHIP_CMD_##NAME##_REQUEST_LEN = REQUEST_LEN, \
+    CHIP_CMD_##NAME##_RESPONSE_LEN = RESPONSE_LEN,
+enum
+{
+    CHIP_PROTOCOL_TABLE(CHIP_PROTOCOL_LENGTH_ENUM)
+};
+#undef CHIP_PROTOCOL_LENGTH_ENUM
+
+// Sound index, one past the end of CHiPSoundIndex, which PLAY_SOUND treats as a request to stop the current sound.
+#define CHIP_SOUND_SHORT_MUTE_FOR_STOP 138
+
+// Only ever used with sizeof() to find the longest request and response in the table.
+#define CHIP_PROTOCOL_REQUEST_MEMBER(NAME, CODE, REQUEST_LEN, RESPONSE_LEN, DECODER, RANGES) \
+    uint8_t NAME[REQUEST_LEN];
+#define CHIP_PROTOCOL_RESPONSE_MEMBER(NAME, CODE, REQUEST_LEN, RESPONSE_LEN, DECODER, RANGES) \
+    uint8_t NAME[(RESPONSE_LEN) ? (RESPONSE_LEN) : 1];
+union CHiPProtocolRequestLengths
+{
+    CHIP_PROTOCOL_TABLE(CHIP_PROTOCOL_REQUEST_MEMBER)
+};
+union CHiPProtocolResponseLengths
+{
+    CHIP_PROTOCOL_TABLE(CHIP_PROTOCOL_RESPONSE_MEMBER)
+};
+#undef CHIP_PROTOCOL_REQUEST_MEMBER
+#undef CHIP_PROTOCOL_RESPONSE_MEMBER
+
+
+// Valid range of one byte in a response.
+typedef struct CHiPProtocolRange
+{
+    uint8_t offset;
+    uint8_t min;
+    uint8_t max;
+} CHiPProtocolRange;
+
+#define CHIP_PROTOCOL_RANGE(OFFSET, MIN, MAX) { OFFSET, MIN, MAX },
+
+// Entry in the command-code lookup table.
+typedef struct CHiPProtocolCommand
+{
+    const char*              pName;
+    const CHiPProtocolRange* pRanges;
+    uint8_t                  rangeCount;
+    uint8_t                  code;
+    uint8_t                  requestLength;
+    uint8_t                  responseLength;
+} CHiPProtocolCommand;
+
+
+// Find the table entry for a command code.
+//
+//   code: The command code, as found in the first byte of a request or response.
+//   Returns: NULL if the code isn't in the table.
+//            A pointer to the command's entry otherwise.
+const CHiPProtocolCommand* chipProtocolLookup(uint8_t code);
+
+// Check that a response has the length and field ranges given in the table for its command code.
+//
+//   pResponse: The response, starting with its command byte.
+//   responseLength: Length of pResponse in bytes.
+//   Returns: CHIP_ERROR_NONE if the response is valid.
+//            CHIP_ERROR_BAD_RESPONSE otherwise.
+int chipProtocolValidateResponse(const uint8_t* pResponse, size_t responseLength);
+
+#endif // CHIP_PROTOCOL_H_
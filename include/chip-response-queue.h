@@ -0,0 +1,58 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the fixed size circular queue that transports use to hold out of band responses until
+   they are retrieved with chipTransportGetOutOfBandResponse().  Once the queue is full, each push overwrites the
+   oldest item.  All of the functions are thread safe.
+*/
+#ifndef CHIP_RESPONSE_QUEUE_H_
+#define CHIP_RESPONSE_QUEUE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+
+typedef struct CHiPResponseQueue CHiPResponseQueue;
+
+
+// Allocate a response queue with room for itemCount responses.
+//
+//   Returns: NULL on error.
+//            A valid pointer to the queue otherwise.
+CHiPResponseQueue* chipResponseQueueAlloc(size_t itemCount);
+
+// Free a queue previously returned from chipResponseQueueAlloc().  pQueue can be NULL.
+void chipResponseQueueFree(CHiPResponseQueue* pQueue);
+
+// Push a copy of a response onto the queue, dropping the oldest item if the queue was already full.
+// Responses longer than CHIP_RESPONSE_MAX_LEN are truncated.
+void chipResponseQueuePush(CHiPResponseQueue* pQueue, const uint8_t* pData, size_t length);
+
+// Pop the oldest response from the queue.
+//
+//   pBuffer: Is a pointer to the array of bytes into which the response should be copied.
+//   size: Is the number of bytes in pBuffer.
+//   pActual: Is a pointer to where the actual number of bytes copied should be placed.  This value may be truncated
+//            to size if the response was > size.
+//   Returns: CHIP_ERROR_NONE on success.
+//            CHIP_ERROR_EMPTY if there are no responses in the queue.
+int chipResponseQueuePop(CHiPResponseQueue* pQueue, uint8_t* pBuffer, size_t size, size_t* pActual);
+
+// Number of responses currently in the queue.
+uint32_t chipResponseQueueDepth(CHiPResponseQueue* pQueue);
+
+// Number of responses which have been dropped because they were pushed while the queue was already full.
+uint32_t chipResponseQueueDropCount(CHiPResponseQueue* pQueue);
+
+#endif // CHIP_RESPONSE_QUEUE_H_
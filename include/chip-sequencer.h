@@ -0,0 +1,95 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the duration tables for sounds and actions along with the sequencer which uses them to
+   play clips and actions back to back.
+
+   The robot doesn't report when a sound or action has finished so the library keeps a table with the length of each
+   CHiPSoundIndex clip and CHiPAction routine.  The built in lengths are nominal values which may be a little off for
+   a given firmware version and can be calibrated with chipSetSoundDuration() and chipSetActionDuration().  Actions
+   which put the robot into a mode, such as CHIP_ACTION_GUARD_MODE, have no end and are given a duration of 0.
+
+   The sequencer queues sounds, actions and pauses and schedules each one on a timeline at the moment the previous one
+   is due to end.  The "AndWait" functions send a single sound or action and then sleep until its end, so neither of
+   them poll the robot.
+*/
+#ifndef CHIP_SEQUENCER_H_
+#define CHIP_SEQUENCER_H_
+
+#include "chip.h"
+#include "chip-timeline.h"
+
+
+// Abstraction of the pointer type returned by chipSequencerCreate().
+typedef struct CHiPSequencer CHiPSequencer;
+
+
+// Get the length of a sound clip or action routine in microseconds.  Returns 0 for values which aren't in the
+// CHiPSoundIndex or CHiPAction enumerations and for actions which never end on their own.
+uint32_t chipGetSoundDuration(CHiPSoundIndex sound);
+uint32_t chipGetActionDuration(CHiPAction action);
+
+// Replace the length used for a sound clip or action routine.  These update a table shared by all robots so they
+// should be called during startup, before other threads start using the durations.
+//
+//   Returns: CHIP_ERROR_NONE on success.
+//            CHIP_ERROR_PARAM if the sound or action isn't in its enumeration.
+int chipSetSoundDuration(CHiPSoundIndex sound, uint32_t durationMicroseconds);
+int chipSetActionDuration(CHiPAction action, uint32_t durationMicroseconds);
+
+// Play a sound or start an action and then block until it is due to end.  Timing uses the clock returned by
+// chipClockGetDefault().
+//
+//   Returns: CHIP_ERROR_NONE on success.
+//            CHIP_ERROR_PARAM if the sound or action has no known duration to wait for.
+//            Otherwise the error returned from chipPlaySound() or chipAction().
+int chipPlaySoundAndWait(CHiP* pCHiP, CHiPSoundIndex sound);
+int chipActionAndWait(CHiP* pCHiP, CHiPAction action);
+
+
+// Create an empty sequence.
+//
+//   Returns: NULL on error.
+//            A valid pointer to the sequencer otherwise.
+CHiPSequencer* chipSequencerCreate(void);
+
+// Free a sequencer returned from chipSequencerCreate().
+void chipSequencerFree(CHiPSequencer* pSequencer);
+
+// Remove everything from a sequence so that it can be reused.
+void chipSequencerClear(CHiPSequencer* pSequencer);
+
+// Append a sound, an action or a pause to the end of the sequence.  Each starts as the previous one ends.
+//
+//   pSequencer: An object that was previously returned from the chipSequencerCreate() call.
+//   Returns: CHIP_ERROR_NONE on success.
+//            CHIP_ERROR_PARAM if the sound or action has no known duration, since nothing could follow it.
+//            CHIP_ERROR_MEMORY if the sequence couldn't be grown.
+int chipSequencerAddSound(CHiPSequencer* pSequencer, CHiPSoundIndex sound);
+int chipSequencerAddAction(CHiPSequencer* pSequencer, CHiPAction action);
+int chipSequencerAddPause(CHiPSequencer* pSequencer, uint32_t durationMicroseconds);
+
+// Total length of the sequence in microseconds, from the start of the first entry to the end of the last.
+uint64_t chipSequencerGetDuration(const CHiPSequencer* pSequencer);
+
+// Play the sequence on a robot.  Blocks until the last entry has ended.  Timing uses the clock returned by
+// chipClockGetDefault().
+//
+//   pSequencer: An object that was previously returned from the chipSequencerCreate() call.
+//   pCHiP: An object that was previously returned from the chipInit() call.
+//   pReport: Filled in with the dispatch lateness of each entry, as described in chip-timeline.h.  Can be NULL.
+//   Returns: CHIP_ERROR_NONE on success and the error from the first entry to fail otherwise.
+int chipSequencerRun(CHiPSequencer* pSequencer, CHiP* pCHiP, CHiPTimelineReport* pReport);
+
+#endif // CHIP_SEQUENCER_H_
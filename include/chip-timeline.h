@@ -0,0 +1,112 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the timeline scheduler used to send commands to a robot at set times.
+
+   Commands are queued with the time, relative to the start of the run, at which they should be sent.  When the
+   timeline is run, each command's deadline is computed once from the start time and the runner sleeps until that
+   absolute deadline before dispatching it.  The time taken to send one command therefore never pushes out the
+   commands which follow it, unlike a sequence of relative sleeps whose error grows with every step.
+
+   The difference between a command's deadline and the time it was actually dispatched is its lateness.  Every run
+   records the lateness of each command and summarizes it in a CHiPTimelineReport.
+*/
+#ifndef CHIP_TIMELINE_H_
+#define CHIP_TIMELINE_H_
+
+#include "chip.h"
+
+
+// Abstraction of the pointer type returned by chipTimelineCreate().
+typedef struct CHiPTimeline CHiPTimeline;
+
+// Function queued with chipTimelineAddCall().  Returns CHIP_ERROR_NONE on success.  Any other value stops the run.
+typedef int (*CHiPTimelineFunction)(CHiP* pCHiP, void* pContext);
+
+// Summary of the dispatch lateness seen during a chipTimelineRun() call.
+typedef struct CHiPTimelineReport
+{
+    uint32_t commandCount;                  // Number of commands dispatched.
+    uint32_t lateCount;                     // Number dispatched more than lateThresholdMicroseconds after deadline.
+    uint32_t maxLatenessIndex;              // Index of the latest command.
+    uint32_t maxLatenessMicroseconds;
+    uint32_t meanLatenessMicroseconds;
+    uint32_t p99LatenessMicroseconds;
+    uint64_t durationMicroseconds;          // Time from the start of the run until the last dispatch completed.
+} CHiPTimelineReport;
+
+
+// Create an empty timeline.
+//
+//   lateThresholdMicroseconds: Commands dispatched more than this long after their deadline are counted in the
+//                              lateCount field of the report.
+//   Returns: NULL on error.
+//            A valid pointer to the timeline otherwise.
+CHiPTimeline* chipTimelineCreate(uint32_t lateThresholdMicroseconds);
+
+// Free a timeline returned from chipTimelineCreate().
+void chipTimelineFree(CHiPTimeline* pTimeline);
+
+// Remove all of the commands from a timeline so that it can be reused.
+void chipTimelineClear(CHiPTimeline* pTimeline);
+
+// Queue a raw request to be sent with chipRawSend() at a set time.  Commands can be added in any order.  Commands with
+// the same time are dispatched in the order they were added.
+//
+//   pTimeline: An object that was previously returned from the chipTimelineCreate() call.
+//   offsetMicroseconds: Time from the start of the run at which to send the request.
+//   pRequest: The request exactly as it would be passed to chipRawSend().
+//   requestLength: Length of pRequest in bytes.
+//   Returns: CHIP_ERROR_NONE on success.
+//            CHIP_ERROR_PARAM if requestLength is 0 or larger than CHIP_REQUEST_MAX_LEN.
+//            CHIP_ERROR_MEMORY if the timeline couldn't be grown.
+int chipTimelineAddRequest(CHiPTimeline* pTimeline, uint64_t offsetMicroseconds,
+                           const uint8_t* pRequest, size_t requestLength);
+
+// Queue a function to be called at a set time.  This allows any of the chip*() functions to be scheduled.
+//
+//   pTimeline: An object that was previously returned from the chipTimelineCreate() call.
+//   offsetMicroseconds: Time from the start of the run at which to call the function.
+//   pFunction: Function to be called with the robot passed into chipTimelineRun().
+//   pContext: Passed through to pFunction.
+//   Returns: CHIP_ERROR_NONE on success.
+//            CHIP_ERROR_MEMORY if the timeline couldn't be grown.
+int chipTimelineAddCall(CHiPTimeline* pTimeline, uint64_t offsetMicroseconds,
+                        CHiPTimelineFunction pFunction, void* pContext);
+
+// Number of commands queued on a timeline.
+size_t chipTimelineGetCount(const CHiPTimeline* pTimeline);
+
+// Dispatch each of the queued commands at its deadline.  Blocks until the last command has been dispatched.  Timing
+// uses the clock returned by chipClockGetDefault().  The timeline can be run again afterwards.
+//
+//   pTimeline: An object that was previously returned from the chipTimelineCreate() call.
+//   pCHiP: An object that was previously returned from the chipInit() call.
+//   pReport: Filled in with the lateness summary for the commands dispatched before the run ended.  Can be NULL.
+//   Returns: CHIP_ERROR_NONE on success and the error from the first command to fail otherwise.
+int chipTimelineRun(CHiPTimeline* pTimeline, CHiP* pCHiP, CHiPTimelineReport* pReport);
+
+// Get the lateness recorded for one command during the last chipTimelineRun() call.
+//
+//   pTimeline: An object that was previously returned from the chipTimelineCreate() call.
+//   index: Index of the command in dispatch order, from 0 to chipTimelineGetCount() - 1.
+//   pOffsetMicroseconds: Set to the command's time from the start of the run.  Can be NULL.
+//   pLatenessMicroseconds: Set to how long after its deadline the command was dispatched.
+//   Returns: CHIP_ERROR_NONE on success.
+//            CHIP_ERROR_PARAM if index is out of range.
+//            CHIP_ERROR_EMPTY if the command wasn't dispatched during the last run.
+int chipTimelineGetLateness(const CHiPTimeline* pTimeline, size_t index,
+                            uint64_t* pOffsetMicroseconds, uint32_t* pLatenessMicroseconds);
+
+#endif // CHIP_TIMELINE_H_
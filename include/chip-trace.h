@@ -0,0 +1,81 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the opt-in request tracing API.  When enabled, the CHiP API and transport record a timed
+   span for each stage a request passes through into a ring buffer owned by the recording thread.  The recorded spans
+   can then be written out in the Chrome trace event JSON format and viewed in chrome://tracing or Perfetto.
+*/
+#ifndef CHIP_TRACE_H_
+#define CHIP_TRACE_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+// Default number of spans kept in each thread's ring buffer if 0 is passed into chipTraceStart().
+#define CHIP_TRACE_DEFAULT_EVENTS_PER_THREAD 4096
+
+
+// Start recording trace spans.
+// Each thread which records a span gets its own ring buffer, allocated on its first span.  Once a ring buffer is full,
+// its oldest spans are overwritten.
+//
+//   eventsPerThread: The number of spans to be kept per thread.  Set to 0 to use
+//                    CHIP_TRACE_DEFAULT_EVENTS_PER_THREAD.  Only used for ring buffers allocated after this call.
+//   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.
+int chipTraceStart(size_t eventsPerThread);
+
+// Stop recording trace spans.  Spans recorded so far are kept until chipTraceClear() is called.
+void chipTraceStop(void);
+
+// Discard all of the spans recorded so far.  Safe to call while tracing is running.
+void chipTraceClear(void);
+
+// Write all of the recorded spans to a file in the Chrome trace event JSON format.
+// The file is a snapshot of rings which other threads may still be recording into.  If tracing is running, spans
+// recorded during the write may or may not be included and the oldest spans of a full ring are skipped if they get
+// overwritten before they are written out.  Stop tracing first to get an exact dump.
+//
+//   pFilename: The name of the JSON file to be created.
+//   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.
+int chipTraceWriteJson(const char* pFilename);
+
+
+
+// *** The following are used by the CHiP API and transports to record spans. ***
+extern _Atomic int g_chipTraceEnabled;
+
+uint64_t chipTraceGetMicroseconds(void);
+void     chipTraceRecord(const char* pName, uint32_t requestId, uint64_t startTime, uint64_t endTime);
+uint32_t chipTraceNewRequest(void);
+uint32_t chipTraceCurrentRequest(void);
+
+// Returns the start time to be passed into chipTraceEnd() or 0 if tracing is disabled.
+static inline uint64_t chipTraceBegin(void)
+{
+    if (!atomic_load_explicit(&g_chipTraceEnabled, memory_order_relaxed))
+        return 0;
+    return chipTraceGetMicroseconds();
+}
+
+// Records a span named pName which started at startTime and ends now.  pName must be a string literal as only its
+// pointer is recorded.  Does nothing if startTime is 0 since tracing was disabled when the span started.
+static inline void chipTraceEnd(const char* pName, uint32_t requestId, uint64_t startTime)
+{
+    if (startTime)
+        chipTraceRecord(pName, requestId, startTime, chipTraceGetMicroseconds());
+}
+
+#endif // CHIP_TRACE_H_
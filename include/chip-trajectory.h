@@ -0,0 +1,104 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the trajectory generator used to ramp the robot's velocity smoothly between chipDrive()
+   values.
+
+   Each of the forward/reverse, left/right and spin axes is given its own acceleration and jerk limits.  When a new
+   target velocity is set, the generator moves every axis from its current velocity towards the target without
+   exceeding those limits, simulating the ramp in fixed time steps.  The velocity is quantized to the -32 to 32 range
+   accepted by chipDrive() at each step and a frame is only produced when the quantized value changes, no more often
+   than a minimum interval.  A ramp therefore costs a handful of frames, with the last one always landing exactly on
+   the target, rather than one frame per step or per unit of change.
+*/
+#ifndef CHIP_TRAJECTORY_H_
+#define CHIP_TRAJECTORY_H_
+
+#include "chip.h"
+#include "chip-timeline.h"
+
+
+// Time between steps of the simulated ramp.
+#define CHIP_TRAJECTORY_STEP_US 10000
+
+
+// Motion limits for one axis.  Velocities are in chipDrive() units so a value of 32 is full speed.
+typedef struct CHiPTrajectoryLimits
+{
+    float maxAcceleration;      // Units per second per second.  Must be greater than 0.
+    float maxJerk;              // Units per second cubed.  0 removes the jerk limit so acceleration changes instantly.
+} CHiPTrajectoryLimits;
+
+// Drive frame produced by the generator, ready to be passed to chipDrive().
+typedef struct CHiPTrajectoryFrame
+{
+    uint32_t offsetMicroseconds;    // Time of this frame since the last chipTrajectorySetTarget() call.
+    int8_t   forwardReverse;
+    int8_t   leftRight;
+    int8_t   spin;
+} CHiPTrajectoryFrame;
+
+// Abstraction of the pointer type returned by chipTrajectoryCreate().
+typedef struct CHiPTrajectory CHiPTrajectory;
+
+
+// Create a trajectory generator, starting at rest.
+//
+//   pForwardReverse: Limits for the forward/reverse axis.
+//   pLeftRight: Limits for the left/right (strafe) axis.
+//   pSpin: Limits for the spin axis.
+//   minIntervalMicroseconds: Shortest time allowed between frames.  Changes in the quantized velocity which happen
+//                            sooner are merged into the next frame.  0 sends every change.
+//   maxIntervalMicroseconds: Longest time allowed between frames while the velocity is still ramping, even if the
+//                            quantized value hasn't changed.  0 only sends frames when the value changes.
+//   Returns: NULL if any of the limits are invalid or on error.
+//            A valid pointer to the generator otherwise.
+CHiPTrajectory* chipTrajectoryCreate(const CHiPTrajectoryLimits* pForwardReverse,
+                                     const CHiPTrajectoryLimits* pLeftRight,
+                                     const CHiPTrajectoryLimits* pSpin,
+                                     uint32_t minIntervalMicroseconds,
+                                     uint32_t maxIntervalMicroseconds);
+
+// Free a generator returned from chipTrajectoryCreate().
+void chipTrajectoryFree(CHiPTrajectory* pTrajectory);
+
+// Set the velocity for each axis to ramp towards.  The ramp starts from the current velocity and acceleration so a
+// target can be changed part way through a ramp.  Frame offsets are restarted from 0.
+//
+//   pTrajectory: An object that was previously returned from the chipTrajectoryCreate() call.
+//   forwardReverse, leftRight, spin: Target velocities in the range -32 to 32, with the same meaning as the parameters
+//                                    of chipDrive().
+//   Returns: CHIP_ERROR_NONE on success.
+//            CHIP_ERROR_PARAM if a target is out of range.
+int chipTrajectorySetTarget(CHiPTrajectory* pTrajectory, int8_t forwardReverse, int8_t leftRight, int8_t spin);
+
+// Get the next frame needed to follow the ramp towards the current target.
+//
+//   pTrajectory: An object that was previously returned from the chipTrajectoryCreate() call.
+//   pFrame: Filled in with the next frame.
+//   Returns: CHIP_ERROR_NONE if pFrame was filled in.
+//            CHIP_ERROR_EMPTY once the target has been reached and the frame for it has already been returned.
+int chipTrajectoryNext(CHiPTrajectory* pTrajectory, CHiPTrajectoryFrame* pFrame);
+
+// Queue the rest of the ramp towards the current target on a timeline as drive requests.
+//
+//   pTrajectory: An object that was previously returned from the chipTrajectoryCreate() call.
+//   pTimeline: An object that was previously returned from the chipTimelineCreate() call.
+//   startMicroseconds: Time on the timeline corresponding to the chipTrajectorySetTarget() call.
+//   pFrameCount: Set to the number of frames queued.  Can be NULL.
+//   Returns: CHIP_ERROR_NONE on success and the error from chipTimelineAddRequest() otherwise.
+int chipTrajectoryAddToTimeline(CHiPTrajectory* pTrajectory, CHiPTimeline* pTimeline, uint64_t startMicroseconds,
+                                size_t* pFrameCount);
+
+#endif // CHIP_TRAJECTORY_H_
@@ -23,11 +23,44 @@
 #define CHIP_EXPECT_NO_RESPONSE 0
 #define CHIP_EXPECT_RESPONSE    1
 
+// Maximum number of requests which can be passed to chipTransportSendRequestBatch() in one call.
+#define CHIP_TRANSPORT_MAX_BATCH 8
+
+// Bits passed to the CHiPTransportEventHandler registered with chipTransportSetEventHandler().
+#define CHIP_TRANSPORT_EVENT_RESPONSE     (1 << 0) // Response to the last request has arrived.
+#define CHIP_TRANSPORT_EVENT_NOTIFICATION (1 << 1) // Out of band response has been queued.
+#define CHIP_TRANSPORT_EVENT_CONNECTION   (1 << 2) // Connection to the robot was made or lost.
+
+// Counters maintained by the transport and returned from chipTransportGetStats().
+typedef struct CHiPTransportStats
+{
+    uint32_t retries;       // Number of times a request was resent because its response didn't arrive in time.
+    uint32_t timeouts;      // Number of requests which failed with CHIP_ERROR_TIMEOUT after all retries.
+    uint32_t oobDrops;      // Number of out of band responses overwritten before being read.
+    uint32_t oobQueueDepth; // Number of out of band responses currently waiting to be read.
+    int      connected;     // Non-zero if currently connected to a robot.
+} CHiPTransportStats;
+
+// One request and its response as passed to chipTransportSendRequestBatch().
+typedef struct CHiPTransportBatchItem
+{
+    const uint8_t* pRequest;        // Request to be sent.  Its first byte must differ from all others in the batch.
+    size_t         requestLength;
+    uint8_t*       pResponse;       // Buffer of at least CHIP_RESPONSE_MAX_LEN bytes to receive the response.
+    size_t         responseLength;  // Set to the length of the response.
+    int            result;          // Set to CHIP_ERROR_NONE if the response arrived or CHIP_ERROR_* otherwise.
+    uint64_t       roundTrip;       // Set to the microseconds from the batch being sent until this response arrived.
+} CHiPTransportBatchItem;
+
 // An abstract object type used by the CHiP API to provide transport specific information to each transport function.
 // It will be initially created by a call to chipTransportInit() and then passed in as the first parameter to each of the
 // other chipTransport*() functions.  It can be freed at the end with a call to chipTransportUninit;
 typedef struct CHiPTransport CHiPTransport;
 
+// Function called by the transport when one of the CHIP_TRANSPORT_EVENT_* conditions occurs.  It can be called from
+// any thread, including threads internal to the transport, so it must not block or call back into the transport.
+typedef void (*CHiPTransportEventHandler)(void* pContext, uint32_t events);
+
 // Initialize a CHiPTransport object.
 // Will be the first chipTransport*() function called so it can be used for any setup that the transport needs to take
 // care of.  Transport specific data can be stored in the returned in the object pointed to by the returned pointer.
@@ -105,30 +138,66 @@ int chipTransportStopRobotDiscovery(CHiPTransport* pTransport);
 //   requestLength: Is the number of bytes in the pRequest buffer to be sent to the robot.
 //   expectResponse: Set to 0 if the robot is not expected to send a response to this request.  Set to non-zero if the
 //                   robot will send a response to this request - a response which can be read by a subsequent call to
-//                   chipTransportGetResponse().
+//                   chipTransportBorrowResponse().
 //   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.
 int chipTransportSendRequest(CHiPTransport* pTransport, const uint8_t* pRequest, size_t requestLength, int expectResponse);
 
-// Retrieve the response from the CHiP robot for the last request made.
+// Retrieve the response from the CHiP robot for the last request made without copying it.
+// The response is left in the transport's own storage and the returned pointer remains valid until
+// chipTransportReleaseResponse() is called.  It must be released before the next request is sent.
 //
 //   pTransport: An object that was previously returned from the chipTransportInit() call.
-//   pResponseBuffer: Is a pointer to the array of bytes into which the response should be copied.
-//   responseBufferSize: Is the number of bytes in the pResponseBuffer.
-//   pResponseLength: Is a pointer to where the actual number of bytes in the response should be placed.  This value
-//                    may be truncated to responseBufferSize if the actual response was > responseBufferSize.
-//   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.
-int chipTransportGetResponse(CHiPTransport* pTransport,
-                            uint8_t* pResponseBuffer,
-                            size_t responseBufferSize,
-                            size_t* pResponseLength);
+//   ppResponse: Is a pointer to where the address of the response bytes should be placed.
+//   pResponseLength: Is a pointer to where the number of bytes in the response should be placed.  This will never be
+//                    larger than CHIP_RESPONSE_MAX_LEN.
+//   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.  chipTransportReleaseResponse()
+//            should only be called after a successful call.
+int chipTransportBorrowResponse(CHiPTransport* pTransport, const uint8_t** ppResponse, size_t* pResponseLength);
+
+// Hand back the response storage obtained from a successful chipTransportBorrowResponse() call.
+//
+//   pTransport: An object that was previously returned from the chipTransportInit() call.
+void chipTransportReleaseResponse(CHiPTransport* pTransport);
+
+// Send a batch of requests which each expect a response and wait for all of the responses.
+// The requests are sent back to back without waiting for any responses in between so that their round trips overlap
+// and the whole batch takes about as long as a single request.  Responses are matched to requests by their first byte
+// which is why no two requests in a batch can be for the same command.  Each request is retried on its own if its
+// response doesn't arrive in time, the same as chipTransportBorrowResponse() does.  Sending a batch cancels any
+// request still waiting for chipTransportBorrowResponse().
+//
+//   pTransport: An object that was previously returned from the chipTransportInit() call.
+//   pItems: Is a pointer to the array of requests to be sent.  The response fields of each are filled in.
+//   itemCount: Is the number of items in pItems.  Must be between 1 and CHIP_TRANSPORT_MAX_BATCH.
+//   Returns: CHIP_ERROR_NONE if the batch was sent, in which case the result field of each item indicates whether its
+//            own response was received.  A non-zero CHIP_ERROR_* code otherwise.
+int chipTransportSendRequestBatch(CHiPTransport* pTransport, CHiPTransportBatchItem* pItems, size_t itemCount);
 
 // Has the robot yet responded to the last request made?
 //
-//   Returns: 0 if still waiting for the response which means that a call to chipTransportGetResponse() would block
+//   Returns: 0 if still waiting for the response which means that a call to chipTransportBorrowResponse() would block
 //                waiting for the response to arrive.
 //            non-zero if the response has been received.
 int chipTransportIsResponseAvailable(CHiPTransport* pTransport);
 
+// Get the time at which the response to the last request will become available, for transports which know it ahead of
+// time.  Transports which simulate the robot have no thread of their own to call the event handler when a response
+// arrives so the caller instead checks chipTransportIsResponseAvailable() again at this time.
+//
+//   pTransport: An object that was previously returned from the chipTransportInit() call.
+//   Returns: Time on the clock used by chipTransportGetMicroseconds().
+//            UINT64_MAX if no response is expected, if it is known to be lost or if the transport reports the arrival
+//            of responses with CHIP_TRANSPORT_EVENT_RESPONSE instead.
+uint64_t chipTransportGetResponseTime(CHiPTransport* pTransport);
+
+// Give up on the response to the last request without waiting for it.  A response which arrives later is dropped
+// rather than being mistaken for the response to a newer request.  Used by callers which poll with
+// chipTransportIsResponseAvailable() and apply their own timeout rather than blocking in
+// chipTransportBorrowResponse().
+//
+//   pTransport: An object that was previously returned from the chipTransportInit() call.
+void chipTransportAbandonRequest(CHiPTransport* pTransport);
+
 
 // Get an out of band response sent by the CHiP robot.
 // Sometimes the CHiP robot sends notifications which aren't in direct response to the last request made.  This
@@ -152,4 +221,29 @@ int chipTransportGetOutOfBandResponse(CHiPTransport* pTransport,
 //   Returns: Millisecond count.
 uint32_t chipTransportGetMilliseconds(CHiPTransport* pTransport);
 
+// Get a monotonically increasing microsecond count using transport / platform specific functionality.
+// Used by the CHiP API to measure request round trip times.
+//
+//   pTransport: An object that was previously returned from the chipTransportInit() call.
+//   Returns: Microsecond count.
+uint64_t chipTransportGetMicroseconds(CHiPTransport* pTransport);
+
+// Get the counters and current state maintained by the transport layer.
+// The counters only ever increase.  All of the fields are safe to read from any thread while requests are in flight
+// and reading them never blocks on, or waits for, the robot.
+//
+//   pTransport: An object that was previously returned from the chipTransportInit() call.
+//   pStats: A pointer to where the current counter values should be placed.  Shouldn't be NULL.
+void chipTransportGetStats(CHiPTransport* pTransport, CHiPTransportStats* pStats);
+
+// Register the function to be called when responses, out of band responses or connection changes occur.  Called once
+// by chipInit() before any connection is made.  A handler is never required and transports are free to skip events
+// which can't occur for them.  The osxble transport shares one Bluetooth connection across the process so it only
+// reports events to the first transport which registers a handler, until that transport registers NULL.
+//
+//   pTransport: An object that was previously returned from the chipTransportInit() call.
+//   handler: The function to be called.  NULL stops events from being reported.
+//   pContext: Passed through to each call of handler.
+void chipTransportSetEventHandler(CHiPTransport* pTransport, CHiPTransportEventHandler handler, void* pContext);
+
 #endif // CHIP_TRANSPORT_H_
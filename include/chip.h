@@ -20,6 +20,11 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include "chip-protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 
 // Integer error codes that can be returned from most of these CHiP API functions.
@@ -32,10 +37,25 @@
 #define CHIP_ERROR_TIMEOUT       6 // Timed out waiting for response.
 #define CHIP_ERROR_EMPTY         7 // The queue was empty.
 #define CHIP_ERROR_BAD_RESPONSE  8 // Unexpected response from CHiP.
+#define CHIP_ERROR_BUSY          9 // Another request is still in progress.
+
+// Maximum length of CHiP request and response buffer lengths.  Generated from the table in chip-protocol.h.
+#define CHIP_REQUEST_MAX_LEN    sizeof(union CHiPProtocolRequestLengths)
+#define CHIP_RESPONSE_MAX_LEN   sizeof(union CHiPProtocolResponseLengths)
+
+// Maximum age passed to chipSetCacheMaxAge() for a cached setting which never goes stale.
+#define CHIP_CACHE_FOREVER           UINT32_MAX
 
-// Maximum length of CHiP request and response buffer lengths.
-#define CHIP_REQUEST_MAX_LEN    (8 + 1)     // Longest request is CHIP_CMD_SET_CURRENT_DATE_TIME.
-#define CHIP_RESPONSE_MAX_LEN   (10 + 1)    // Longest response is CHIP_CMD_GET_DOG_VERSION.
+// Number of log-linear buckets in each round trip latency histogram returned by chipGetStats().
+#define CHIP_STATS_HISTOGRAM_BUCKETS 96
+// Maximum number of distinct command codes for which chipGetStats() tracks round trip latency.
+#define CHIP_STATS_MAX_COMMANDS      16
+
+// Bits returned by chipProcessEvents() for each kind of event which has occurred since the last call.
+#define CHIP_EVENT_RESPONSE          (1 << 0) // Request started with chipStartRequest() has completed.
+#define CHIP_EVENT_NOTIFICATION      (1 << 1) // Notification is waiting to be read by chipRawReceiveNotification().
+#define CHIP_EVENT_CONNECTION        (1 << 2) // Connection to the robot was made or lost.
+#define CHIP_EVENT_READY             (1 << 3) // Request refused by chipStartRequest() can now be started.
 
 
 typedef enum CHiPChargingStatus
@@ -224,6 +244,18 @@ typedef enum CHiPAction
 } CHiPAction;
 
 
+// Settings which can be served from the per-robot cache.  See chipSetCacheMaxAge().
+typedef enum CHiPCacheField
+{
+    CHIP_CACHE_SPEED,
+    CHIP_CACHE_EYE_BRIGHTNESS,
+    CHIP_CACHE_VOLUME,
+    CHIP_CACHE_ALARM_DATE_TIME,
+    CHIP_CACHE_DOG_VERSION,
+    CHIP_CACHE_FIELD_COUNT
+} CHiPCacheField;
+
+
 typedef struct CHiPDogVersion
 {
     uint8_t bodyHardware;
@@ -265,6 +297,76 @@ typedef struct CHiPAlarmDateTime
     uint8_t  minute;
 } CHiPAlarmDateTime;
 
+// Bits set in the validMask field of CHiPStatus for each field which chipGetStatusSnapshot() was able to read.
+#define CHIP_STATUS_BATTERY_LEVEL       (1 << 0)
+#define CHIP_STATUS_SPEED               (1 << 1)
+#define CHIP_STATUS_VOLUME              (1 << 2)
+#define CHIP_STATUS_EYE_BRIGHTNESS      (1 << 3)
+#define CHIP_STATUS_CURRENT_DATE_TIME   (1 << 4)
+#define CHIP_STATUS_ALARM_DATE_TIME     (1 << 5)
+#define CHIP_STATUS_ALL                 0x3F
+
+typedef struct CHiPStatus
+{
+    uint32_t            validMask;
+    CHiPBatteryLevel    batteryLevel;
+    CHiPSpeed           speed;
+    uint8_t             volume;
+    uint8_t             eyeBrightness;
+    CHiPCurrentDateTime currentDateTime;
+    CHiPAlarmDateTime   alarmDateTime;
+} CHiPStatus;
+
+// A response or notification decoded by chipDecodeResponse().  command selects the valid member of the union.
+typedef struct CHiPResponse
+{
+    uint8_t command;
+    union
+    {
+        CHiPSpeed           speed;
+        uint8_t             eyeBrightness;
+        uint8_t             volume;
+        CHiPBatteryLevel    batteryLevel;
+        CHiPCurrentDateTime currentDateTime;
+        CHiPAlarmDateTime   alarmDateTime;
+        CHiPDogVersion      dogVersion;
+    };
+} CHiPResponse;
+
+// A response borrowed from the transport by chipRawReceiveView().  pData points into the transport's own storage and
+// is only valid until the view is passed to chipReleaseResponseView().
+typedef struct CHiPResponseView
+{
+    const uint8_t* pData;
+    size_t         length;
+} CHiPResponseView;
+
+typedef struct CHiPCommandStats
+{
+    uint8_t  command;
+    uint32_t count;
+    uint64_t totalMicroseconds;
+    uint32_t maxMicroseconds;
+    uint32_t histogram[CHIP_STATS_HISTOGRAM_BUCKETS];
+} CHiPCommandStats;
+
+typedef struct CHiPStats
+{
+    uint32_t         writes;
+    uint64_t         bytesSent;
+    uint64_t         bytesReceived;
+    uint32_t         retries;
+    uint32_t         timeouts;
+    uint32_t         oobDrops;
+    uint32_t         badResponses;
+    uint32_t         coalesced;
+    uint32_t         debounced;
+    uint32_t         oobQueueDepth;
+    int              connected;
+    size_t           commandCount;
+    CHiPCommandStats commands[CHIP_STATS_MAX_COMMANDS];
+} CHiPStats;
+
 
 // Abstraction of the pointer type returned by chipInit() and subsequently passed into all other chip*() functions.
 typedef struct CHiP CHiP;
@@ -284,6 +386,8 @@ int chipGetDiscoveredRobotName(CHiP* pCHiP, size_t robotIndex, const char** ppRo
 int chipStopRobotDiscovery(CHiP* pCHiP);
 
 int chipDrive(CHiP* pCHiP, int8_t forwardReverse, int8_t leftRight, int8_t spin);
+int chipEncodeDriveFrames(const int8_t* pForwardReverse, const int8_t* pLeftRight, const int8_t* pSpin,
+                          size_t frameCount, uint8_t* pFrames);
 
 int chipAction(CHiP* pCHiP, CHiPAction action);
 
@@ -299,6 +403,9 @@ int chipGetVolume(CHiP* pCHiP, uint8_t* pVolume);
 int chipSetVolume(CHiP* pCHiP, uint8_t volume);
 
 int chipGetBatteryLevel(CHiP* pCHiP, CHiPBatteryLevel* pBatteryLevel);
+int chipGetLastBatteryLevel(CHiP* pCHiP, CHiPBatteryLevel* pBatteryLevel, uint32_t* pAgeMilliseconds);
+int chipStartBatteryPoller(CHiP* pCHiP, uint32_t minIntervalMilliseconds, uint32_t maxIntervalMilliseconds);
+void chipStopBatteryPoller(CHiP* pCHiP);
 
 int chipGetCurrentDateTime(CHiP* pCHiP, CHiPCurrentDateTime* pDateTime);
 int chipSetCurrentDateTime(CHiP* pCHiP, const CHiPCurrentDateTime* pDateTime);
@@ -310,9 +417,37 @@ int chipGetDogVersion(CHiP* pCHiP, CHiPDogVersion* pVersion);
 
 int chipForceSleep(CHiP* pCHiP);
 
+int chipGetStatusSnapshot(CHiP* pCHiP, CHiPStatus* pStatus);
+int chipGetStatusFields(CHiP* pCHiP, uint32_t fieldMask, CHiPStatus* pStatus);
+
 int chipRawSend(CHiP* pCHiP, const uint8_t* pRequest, size_t requestLength);
 int chipRawReceive(CHiP* pCHiP, const uint8_t* pRequest, size_t requestLength,
                    uint8_t* pResponseBuffer, size_t responseBufferSize, size_t* pResponseLength);
+int chipRawReceiveView(CHiP* pCHiP, const uint8_t* pRequest, size_t requestLength, CHiPResponseView* pView);
+void chipReleaseResponseView(CHiP* pCHiP, CHiPResponseView* pView);
 int chipRawReceiveNotification(CHiP* pCHiP, uint8_t* pNotifyBuffer, size_t notifyBufferSize, size_t* pNotifyLength);
+int chipDecodeResponse(const uint8_t* pResponse, size_t responseLength, CHiPResponse* pDecoded);
+
+int chipSetCacheMaxAge(CHiP* pCHiP, CHiPCacheField field, uint32_t maxAgeMilliseconds);
+void chipInvalidateCache(CHiP* pCHiP);
+
+int chipSetDebounceWindow(CHiP* pCHiP, uint32_t windowMilliseconds);
+int chipFlushDebounced(CHiP* pCHiP);
+
+int chipGetPollFd(CHiP* pCHiP);
+uint32_t chipProcessEvents(CHiP* pCHiP);
+int chipGetPollTimeout(CHiP* pCHiP);
+int chipStartRequest(CHiP* pCHiP, const uint8_t* pRequest, size_t requestLength);
+int chipGetRequestResponse(CHiP* pCHiP, uint8_t* pResponseBuffer, size_t responseBufferSize, size_t* pResponseLength);
+void chipCancelRequest(CHiP* pCHiP);
+int chipWaitAny(CHiP** ppCHiPs, size_t count, int timeoutMilliseconds, uint32_t* pEvents, size_t* pReadyCount);
+
+int chipGetStats(CHiP* pCHiP, CHiPStats* pStats);
+uint32_t chipStatsGetPercentile(const CHiPCommandStats* pCommandStats, float percentile);
+uint32_t chipStatsGetBucketLimit(size_t bucket);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif // CHIP_H_
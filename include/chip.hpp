@@ -0,0 +1,441 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes a header only C++20 wrapper for the CHiP API.
+
+   chip::Handle owns a CHiP object, calling chipUninit() when it goes out of scope, and returns each result as a
+   chip::Result which holds either the value or the CHIP_ERROR_* code explaining why there isn't one, in the style of
+   C++23's std::expected.
+
+   Requests are built by the constexpr functions in chip::command.  Their range limited parameters are chip::Checked
+   values whose constructor is consteval, so a constant argument which is out of range fails to compile and one which
+   is in range costs nothing at run time:
+
+       constexpr auto forward = chip::command::drive(16, 0, 0);     // {0x78, 0x10, 0x00, 0x00}
+       chip::command::setVolume(12);                                // Error: not a constant expression.
+
+   Each builder returns a std::array holding exactly the bytes of the request and encodes them without branching.
+   Values only known at run time are range checked once with Checked::check(), which returns CHIP_ERROR_PARAM instead
+   of asserting.
+*/
+#ifndef CHIP_HPP_
+#define CHIP_HPP_
+
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "chip.h"
+
+
+namespace chip
+{
+
+// Error held by a Result in place of its value.  code is one of the CHIP_ERROR_* values.
+struct Error
+{
+    int code;
+};
+
+// Either a T or the CHIP_ERROR_* code which explains why there isn't one.
+template <typename T>
+class Result
+{
+public:
+    using value_type = T;
+
+    constexpr Result(const T& value) : m_value(value), m_error(CHIP_ERROR_NONE) {}
+    constexpr Result(T&& value) : m_value(std::move(value)), m_error(CHIP_ERROR_NONE) {}
+    constexpr Result(Error error) : m_error(error.code)
+    {
+        assert( error.code != CHIP_ERROR_NONE );
+    }
+    constexpr Result(const Result& other) : m_error(other.m_error)
+    {
+        if (other.has_value())
+            std::construct_at(&m_value, other.m_value);
+    }
+    constexpr Result(Result&& other) noexcept : m_error(other.m_error)
+    {
+        if (other.has_value())
+            std::construct_at(&m_value, std::move(other.m_value));
+    }
+    constexpr Result& operator=(const Result& other)
+    {
+        if (this != &other)
+        {
+            this->~Result();
+            std::construct_at(this, other);
+        }
+        return *this;
+    }
+    constexpr Result& operator=(Result&& other) noexcept
+    {
+        if (this != &other)
+        {
+            this->~Result();
+            std::construct_at(this, std::move(other));
+        }
+        return *this;
+    }
+    constexpr ~Result()
+    {
+        if (has_value())
+            m_value.~T();
+    }
+
+    constexpr bool has_value() const noexcept { return m_error == CHIP_ERROR_NONE; }
+    constexpr explicit operator bool() const noexcept { return has_value(); }
+    constexpr int error() const noexcept { return m_error; }
+
+    // The value can only be read from a Result which has one.
+    constexpr T& value() & { assert( has_value() ); return m_value; }
+    constexpr const T& value() const & { assert( has_value() ); return m_value; }
+    constexpr T&& value() && { assert( has_value() ); return std::move(m_value); }
+    constexpr T& operator*() & { return value(); }
+    constexpr const T& operator*() const & { return value(); }
+    constexpr T&& operator*() && { return std::move(*this).value(); }
+    constexpr T* operator->() { return &value(); }
+    constexpr const T* operator->() const { return &value(); }
+    template <typename U>
+    constexpr T value_or(U&& defaultValue) const &
+    {
+        return has_value() ? m_value : static_cast<T>(std::forward<U>(defaultValue));
+    }
+
+private:
+    union
+    {
+        T m_value;
+    };
+    int m_error;
+};
+
+template <>
+class Result<void>
+{
+public:
+    using value_type = void;
+
+    constexpr Result() : m_error(CHIP_ERROR_NONE) {}
+    // CHIP_ERROR_NONE is accepted so that the return value of a C API call can be wrapped directly.
+    constexpr Result(Error error) : m_error(error.code) {}
+
+    constexpr bool has_value() const noexcept { return m_error == CHIP_ERROR_NONE; }
+    constexpr explicit operator bool() const noexcept { return has_value(); }
+    constexpr int error() const noexcept { return m_error; }
+
+private:
+    int m_error;
+};
+
+// Raw response or notification bytes, as chipRawReceive() would return them.
+struct RawResponse
+{
+    uint8_t data[CHIP_RESPONSE_MAX_LEN];
+    size_t  length;
+};
+
+// Request of a fixed length, ready to be sent with chipRawSend().
+template <size_t Length>
+using Request = std::array<uint8_t, Length>;
+
+
+namespace detail
+{
+
+// Not constexpr, so reaching it while evaluating a consteval function stops the build.
+inline void argumentOutOfRange() {}
+
+} // namespace detail
+
+// Parameter which is known to be in the range Min to Max.  Constants are checked when they are converted, at compile
+// time, and other values with check().
+template <typename T, int Min, int Max>
+class Checked
+{
+public:
+    using Argument = std::conditional_t<std::is_enum_v<T>, T, int>;
+
+    consteval Checked(Argument value) : m_value(static_cast<T>(value))
+    {
+        if (static_cast<int>(value) < Min || static_cast<int>(value) > Max)
+            detail::argumentOutOfRange();
+    }
+
+    // Returns CHIP_ERROR_PARAM if value is out of range.
+    static constexpr Result<Checked> check(Argument value)
+    {
+        if (static_cast<int>(value) < Min || static_cast<int>(value) > Max)
+            return Error{ CHIP_ERROR_PARAM };
+        return Checked(static_cast<T>(value), Unchecked{});
+    }
+
+    constexpr T get() const { return m_value; }
+
+private:
+    struct Unchecked {};
+
+    constexpr Checked(T value, Unchecked) : m_value(value) {}
+
+    T m_value;
+};
+
+
+// Builders for the bytes of each request.  These match what the chip*() functions of the same name send.
+namespace command
+{
+
+using DriveSpeed = Checked<int8_t, -32, 32>;
+using Volume = Checked<uint8_t, 1, 11>;
+using Speed = Checked<CHiPSpeed, CHIP_SPEED_ADULT, CHIP_SPEED_KID>;
+using Action = Checked<CHiPAction, CHIP_ACTION_RESET, CHIP_ACTION_FACE_DOWN_FOR_CONTROLLING_CHIPPIES>;
+// Sound played by chipStopSound().  It is one past the end of CHiPSoundIndex.
+constexpr CHiPSoundIndex SOUND_SHORT_MUTE_FOR_STOP = static_cast<CHiPSoundIndex>(CHIP_SOUND_SHORT_MUTE_FOR_STOP);
+
+using Sound = Checked<CHiPSoundIndex, CHIP_SOUND_BARK_X1_ANGRY_A34, SOUND_SHORT_MUTE_FOR_STOP>;
+using Month = Checked<uint8_t, 1, 12>;
+using Day = Checked<uint8_t, 1, 31>;
+using Hour = Checked<uint8_t, 0, 23>;
+using Minute = Checked<uint8_t, 0, 59>;
+using Second = Checked<uint8_t, 0, 59>;
+using DayOfWeek = Checked<uint8_t, 0, 6>;
+
+namespace detail
+{
+
+// Same arithmetic as the C encoder: the magnitude added to a base which depends on the sign, with 0 sent as 0x00.
+constexpr uint8_t encodeDriveAxis(int8_t value, uint8_t positiveBase, uint8_t negativeBase)
+{
+    uint8_t negativeMask = static_cast<uint8_t>(value >> 7);
+    uint8_t magnitude = static_cast<uint8_t>((static_cast<uint8_t>(value) ^ negativeMask) - negativeMask);
+    uint8_t nonZeroMask = static_cast<uint8_t>(-static_cast<uint8_t>(magnitude != 0));
+
+    return static_cast<uint8_t>(magnitude + (nonZeroMask & positiveBase) +
+                                (negativeMask & static_cast<uint8_t>(negativeBase - positiveBase)));
+}
+
+} // namespace detail
+
+constexpr Request<CHIP_CMD_DRIVE_REQUEST_LEN> drive(DriveSpeed forwardReverse, DriveSpeed leftRight, DriveSpeed spin)
+{
+    return { CHIP_CMD_DRIVE,
+             detail::encodeDriveAxis(forwardReverse.get(), 0x00, 0x20),
+             detail::encodeDriveAxis(spin.get(), 0x40, 0x60),
+             detail::encodeDriveAxis(leftRight.get(), 0x80, 0xA0) };
+}
+
+constexpr Request<CHIP_CMD_ACTION_REQUEST_LEN> action(Action action)
+{
+    return { CHIP_CMD_ACTION, static_cast<uint8_t>(action.get()) };
+}
+
+constexpr Request<CHIP_CMD_PLAY_SOUND_REQUEST_LEN> playSound(Sound sound)
+{
+    return { CHIP_CMD_PLAY_SOUND, static_cast<uint8_t>(sound.get()), 0 };
+}
+
+constexpr Request<CHIP_CMD_PLAY_SOUND_REQUEST_LEN> stopSound()
+{
+    return playSound(SOUND_SHORT_MUTE_FOR_STOP);
+}
+
+constexpr Request<CHIP_CMD_SET_SPEED_REQUEST_LEN> setSpeed(Speed speed)
+{
+    return { CHIP_CMD_SET_SPEED, static_cast<uint8_t>(speed.get()) };
+}
+
+constexpr Request<CHIP_CMD_SET_VOLUME_REQUEST_LEN> setVolume(Volume volume)
+{
+    return { CHIP_CMD_SET_VOLUME, volume.get() };
+}
+
+constexpr Request<CHIP_CMD_SET_EYE_BRIGHTNESS_REQUEST_LEN> setEyeBrightness(uint8_t brightness)
+{
+    return { CHIP_CMD_SET_EYE_BRIGHTNESS, brightness };
+}
+
+constexpr Request<CHIP_CMD_SET_CURRENT_DATE_TIME_REQUEST_LEN>
+setCurrentDateTime(uint16_t year, Month month, Day day, Hour hour, Minute minute, Second second, DayOfWeek dayOfWeek)
+{
+    return { CHIP_CMD_SET_CURRENT_DATE_TIME, static_cast<uint8_t>(year >> 8), static_cast<uint8_t>(year),
+             month.get(), day.get(), hour.get(), minute.get(), second.get(), dayOfWeek.get() };
+}
+
+constexpr Request<CHIP_CMD_SET_ALARM_DATE_TIME_REQUEST_LEN>
+setAlarmDateTime(uint16_t year, Month month, Day day, Hour hour, Minute minute)
+{
+    return { CHIP_CMD_SET_ALARM_DATE_TIME, static_cast<uint8_t>(year >> 8), static_cast<uint8_t>(year),
+             month.get(), day.get(), hour.get(), minute.get() };
+}
+
+constexpr Request<CHIP_CMD_SET_ALARM_DATE_TIME_REQUEST_LEN> cancelAlarm()
+{
+    return { CHIP_CMD_SET_ALARM_DATE_TIME, 0, 0, 0, 0, 0, 0 };
+}
+
+constexpr Request<CHIP_CMD_FORCE_SLEEP_REQUEST_LEN> forceSleep()
+{
+    return { CHIP_CMD_FORCE_SLEEP, 0x12, 0x34 };
+}
+
+constexpr Request<CHIP_CMD_GET_SPEED_REQUEST_LEN> getSpeed() { return { CHIP_CMD_GET_SPEED }; }
+constexpr Request<CHIP_CMD_GET_VOLUME_REQUEST_LEN> getVolume() { return { CHIP_CMD_GET_VOLUME }; }
+constexpr Request<CHIP_CMD_GET_EYE_BRIGHTNESS_REQUEST_LEN> getEyeBrightness()
+{
+    return { CHIP_CMD_GET_EYE_BRIGHTNESS };
+}
+constexpr Request<CHIP_CMD_GET_BATTERY_LEVEL_REQUEST_LEN> getBatteryLevel() { return { CHIP_CMD_GET_BATTERY_LEVEL }; }
+constexpr Request<CHIP_CMD_GET_DOG_VERSION_REQUEST_LEN> getDogVersion() { return { CHIP_CMD_GET_DOG_VERSION }; }
+constexpr Request<CHIP_CMD_GET_CURRENT_DATE_TIME_REQUEST_LEN> getCurrentDateTime()
+{
+    return { CHIP_CMD_GET_CURRENT_DATE_TIME };
+}
+constexpr Request<CHIP_CMD_GET_ALARM_DATE_TIME_REQUEST_LEN> getAlarmDateTime()
+{
+    return { CHIP_CMD_GET_ALARM_DATE_TIME };
+}
+
+} // namespace command
+
+
+// Owner of a CHiP object.  Move only.  The object is passed to chipUninit() when the handle is destroyed.
+class Handle
+{
+public:
+    Handle() noexcept = default;
+    explicit Handle(CHiP* pCHiP) noexcept : m_pCHiP(pCHiP) {}
+    Handle(Handle&& other) noexcept : m_pCHiP(std::exchange(other.m_pCHiP, nullptr)) {}
+    Handle& operator=(Handle&& other) noexcept
+    {
+        if (this != &other)
+            reset(std::exchange(other.m_pCHiP, nullptr));
+        return *this;
+    }
+    Handle(const Handle&) = delete;
+    Handle& operator=(const Handle&) = delete;
+    ~Handle() { chipUninit(m_pCHiP); }
+
+    // Calls chipInit().  Returns CHIP_ERROR_MEMORY if it fails.
+    static Result<Handle> create(const char* pInitOptions = nullptr)
+    {
+        CHiP* pCHiP = chipInit(pInitOptions);
+
+        if (!pCHiP)
+            return Error{ CHIP_ERROR_MEMORY };
+        return Handle(pCHiP);
+    }
+
+    CHiP* get() const noexcept { return m_pCHiP; }
+    explicit operator bool() const noexcept { return m_pCHiP != nullptr; }
+    CHiP* release() noexcept { return std::exchange(m_pCHiP, nullptr); }
+    void reset(CHiP* pCHiP = nullptr) noexcept { chipUninit(std::exchange(m_pCHiP, pCHiP)); }
+
+    Result<void> connect(const char* pRobotName = nullptr) { return Error{ chipConnectToRobot(m_pCHiP, pRobotName) }; }
+    Result<void> disconnect() { return Error{ chipDisconnectFromRobot(m_pCHiP) }; }
+
+    // Send a request built by chip::command, or any other fixed length request, with chipRawSend().
+    template <size_t Length>
+    Result<void> send(const Request<Length>& request)
+    {
+        static_assert(Length >= 1 && Length <= CHIP_REQUEST_MAX_LEN, "Request length isn't valid.");
+        return Error{ chipRawSend(m_pCHiP, request.data(), Length) };
+    }
+
+    // Send a request with chipRawReceive() and return its response.
+    template <size_t Length>
+    Result<RawResponse> receive(const Request<Length>& request)
+    {
+        RawResponse response;
+        int         result;
+
+        static_assert(Length >= 1 && Length <= CHIP_REQUEST_MAX_LEN, "Request length isn't valid.");
+        result = chipRawReceive(m_pCHiP, request.data(), Length,
+                                response.data, sizeof(response.data), &response.length);
+        if (result)
+            return Error{ result };
+        return response;
+    }
+
+    Result<void> drive(command::DriveSpeed forwardReverse, command::DriveSpeed leftRight, command::DriveSpeed spin)
+    {
+        return send(command::drive(forwardReverse, leftRight, spin));
+    }
+    Result<void> action(command::Action action) { return send(command::action(action)); }
+    Result<void> playSound(command::Sound sound) { return send(command::playSound(sound)); }
+    Result<void> stopSound() { return send(command::stopSound()); }
+    Result<void> setSpeed(command::Speed speed) { return send(command::setSpeed(speed)); }
+    Result<void> cancelAlarm() { return send(command::cancelAlarm()); }
+    Result<void> forceSleep() { return send(command::forceSleep()); }
+
+    // These go through the C setters so that they still take part in chipSetDebounceWindow().
+    Result<void> setVolume(command::Volume volume) { return Error{ chipSetVolume(m_pCHiP, volume.get()) }; }
+    Result<void> setEyeBrightness(uint8_t brightness) { return Error{ chipSetEyeBrightness(m_pCHiP, brightness) }; }
+
+    // Dates read at run time are range checked here, returning CHIP_ERROR_PARAM, rather than asserting in the C setter.
+    Result<void> setCurrentDateTime(const CHiPCurrentDateTime& dateTime)
+    {
+        Result<command::Month>     month = command::Month::check(dateTime.month);
+        Result<command::Day>       day = command::Day::check(dateTime.day);
+        Result<command::Hour>      hour = command::Hour::check(dateTime.hour);
+        Result<command::Minute>    minute = command::Minute::check(dateTime.minute);
+        Result<command::Second>    second = command::Second::check(dateTime.second);
+        Result<command::DayOfWeek> dayOfWeek = command::DayOfWeek::check(dateTime.dayOfWeek);
+
+        if (!month || !day || !hour || !minute || !second || !dayOfWeek)
+            return Error{ CHIP_ERROR_PARAM };
+        return send(command::setCurrentDateTime(dateTime.year, *month, *day, *hour, *minute, *second, *dayOfWeek));
+    }
+    Result<void> setAlarmDateTime(const CHiPAlarmDateTime& dateTime)
+    {
+        Result<command::Month>  month = command::Month::check(dateTime.month);
+        Result<command::Day>    day = command::Day::check(dateTime.day);
+        Result<command::Hour>   hour = command::Hour::check(dateTime.hour);
+        Result<command::Minute> minute = command::Minute::check(dateTime.minute);
+
+        if (!month || !day || !hour || !minute)
+            return Error{ CHIP_ERROR_PARAM };
+        return send(command::setAlarmDateTime(dateTime.year, *month, *day, *hour, *minute));
+    }
+
+    // Getters are served from the settings cache when it is fresh, just like the chipGet*() functions they call.
+    Result<CHiPSpeed> speed() { return get<CHiPSpeed>(chipGetSpeed); }
+    Result<uint8_t> volume() { return get<uint8_t>(chipGetVolume); }
+    Result<uint8_t> eyeBrightness() { return get<uint8_t>(chipGetEyeBrightness); }
+    Result<CHiPBatteryLevel> batteryLevel() { return get<CHiPBatteryLevel>(chipGetBatteryLevel); }
+    Result<CHiPDogVersion> dogVersion() { return get<CHiPDogVersion>(chipGetDogVersion); }
+    Result<CHiPCurrentDateTime> currentDateTime() { return get<CHiPCurrentDateTime>(chipGetCurrentDateTime); }
+    Result<CHiPAlarmDateTime> alarmDateTime() { return get<CHiPAlarmDateTime>(chipGetAlarmDateTime); }
+    Result<CHiPStatus> statusSnapshot() { return get<CHiPStatus>(chipGetStatusSnapshot); }
+
+private:
+    template <typename T>
+    Result<T> get(int (*pGetter)(CHiP*, T*))
+    {
+        T   value;
+        int result = pGetter(m_pCHiP, &value);
+
+        if (result)
+            return Error{ result };
+        return value;
+    }
+
+    CHiP* m_pCHiP = nullptr;
+};
+
+} // namespace chip
+
+#endif // CHIP_HPP_
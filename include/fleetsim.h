@@ -0,0 +1,101 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the fleet simulator transport.  It hosts a fleet of virtual CHiP robots in the current
+   process behind the same chipTransport*() interface used by the BLE transport, so an application can manage
+   thousands of robots without any hardware.  Link with lib/libchipcapi_fleetsim.a instead of
+   lib/libchipcapi_osxble.a.
+
+   Each virtual robot models:
+   * Battery drain while idle and while driving, charging on its DC charger or base, and the matching
+     CHiPChargingStatus / CHiPChargerType values.  A robot can be configured to head back to its base to charge when
+     its battery runs low.
+   * A real time clock and an alarm.  When the alarm time passes, the robot sends an out of band notification
+     containing the alarm command byte and the alarm is cleared.
+   * Volume, speed and eye brightness settings.
+   * Its own latency, jitter and loss profile.  Lost requests are retried and eventually time out exactly as they do
+     on the BLE transport.
+
+   All of the timing, including response latency, uses the clock returned by chipClockGetDefault() when chipInit() is
+   called.  Pair the simulator with a virtual clock from chip-clock.h to run hours of fleet activity in seconds.
+
+   Robot state is updated lazily from the elapsed time whenever a connected robot is accessed, so each idle robot only
+   costs the memory of its state (well under 100 bytes) and no CPU.  Connect to the robots by name, as returned from the
+   discovery functions, or pass a NULL name to chipConnectToRobot() to connect to the first robot not already in use.
+*/
+#ifndef FLEETSIM_H_
+#define FLEETSIM_H_
+
+#include "chip.h"
+
+
+// Format of the names given to the virtual robots, indexed from 0.
+#define FLEETSIM_ROBOT_NAME_FORMAT  "CHiP-Sim-%05u"
+
+// Maximum number of distinct profiles which can be in use across a fleet at once.
+#define FLEETSIM_MAX_PROFILES       256
+
+
+typedef struct FleetSimProfile
+{
+    uint32_t        connectMicroseconds;    // Time taken by chipConnectToRobot().
+    uint32_t        latencyMicroseconds;    // Typical time between a request and its response.
+    uint32_t        jitterMicroseconds;     // Responses arrive uniformly within latency +/- jitter.
+    uint16_t        lossPerMille;           // Chance in 1000 that a request, or its response, is lost.
+    float           initialBatteryLevel;    // 0.0 (empty) to 1.0 (full).
+    float           idleDrainPerHour;       // Fraction of a full battery used per hour while idle.
+    float           driveDrainPerHour;      // Extra fraction of a full battery used per hour of driving.
+    float           chargePerHour;          // Fraction of a full battery added per hour while on the charger.
+    float           dockBelowLevel;         // Go to the charger once the battery drops below this level.  0 disables.
+    CHiPChargerType chargerType;            // Charger used by this robot.
+} FleetSimProfile;
+
+
+// Create the fleet of virtual robots.  Only one fleet exists at a time and it must be created before any chipInit()
+// calls.  The robots start running from the current time of the clock returned by chipClockGetDefault() so any
+// virtual clock should be installed first.
+//
+//   robotCount: The number of robots in the fleet.
+//   pProfile: The profile given to every robot.  NULL selects the default profile returned from
+//             fleetSimGetDefaultProfile().  A copy is made.
+//   seed: Seed for the random number generators used to model latency and loss.  Runs made with the same seed, on a
+//         virtual clock, behave identically.
+//   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.
+int fleetSimCreate(uint32_t robotCount, const FleetSimProfile* pProfile, uint32_t seed);
+
+// Destroy the fleet.  All of the CHiP objects using it must have been passed into chipUninit() first.
+void fleetSimDestroy(void);
+
+// Get the profile used by fleetSimCreate() when pProfile is NULL: 30ms latency, 10ms jitter, no loss, a battery that
+// lasts 4 hours idle and charges in 2 hours on its base.
+void fleetSimGetDefaultProfile(FleetSimProfile* pProfile);
+
+// Change the profile of a single robot.  Takes effect from the next request made to that robot.
+//
+//   robotIndex: Index of the robot whose profile is to be changed.  Must be < the robotCount given to fleetSimCreate().
+//   pProfile: The new profile.  A copy is made.
+//   Returns: CHIP_ERROR_NONE on success.
+//            CHIP_ERROR_PARAM if robotIndex is out of range.
+//            CHIP_ERROR_MEMORY if FLEETSIM_MAX_PROFILES distinct profiles are already in use.
+int fleetSimSetRobotProfile(uint32_t robotIndex, const FleetSimProfile* pProfile);
+
+// Get the name of a robot in the fleet.  Same as the names returned by chipGetDiscoveredRobotName().
+//
+//   robotIndex: Index of the robot.  Must be < the robotCount given to fleetSimCreate().
+//   pBuffer: Buffer into which the name is written.
+//   bufferSize: Size of pBuffer in bytes.  16 bytes is always enough.
+//   Returns: CHIP_ERROR_NONE on success and a non-zero CHIP_ERROR_* code otherwise.
+int fleetSimGetRobotName(uint32_t robotIndex, char* pBuffer, size_t bufferSize);
+
+#endif // FLEETSIM_H_
@@ -0,0 +1,37 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* This header file describes the in-process loopback transport.  Rather than talking to a real robot, it answers each
+   request itself, the way a CHiP robot would, after an optional delay.  It builds on any POSIX platform and is used by
+   the benchmarks in bench/ to measure the CHiP API without Bluetooth hardware.
+
+   Link with lib/libchipcapi_loopback.a instead of lib/libchipcapi_osxble.a and pass options to chipInit() as a
+   string of space separated key=value pairs:
+     delay=<microseconds>  Time between a request being sent and its response becoming available.  Defaults to 0.
+
+   For example:
+     CHiP* pCHiP = chipInit("delay=20000");
+
+   The delay is measured with the clock returned by chipClockGetDefault() when chipInit() is called so, when paired
+   with a virtual clock from chip-clock.h, the loopback transport runs in simulated time.
+*/
+#ifndef LOOPBACK_H_
+#define LOOPBACK_H_
+
+#include "chip.h"
+
+// Name of the single robot reported by the loopback transport's discovery functions.
+#define LOOPBACK_ROBOT_NAME "CHiP-Loopback"
+
+#endif // LOOPBACK_H_
@@ -0,0 +1,348 @@
+/* Copyright (C) 2018  Adam Green (https://github.com/adamgreen)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+/* Implementation of an in-process loopback CHiP transport.
+   Requests are answered immediately by a simple model of the robot which remembers the values written by the set
+   commands and returns them from the matching get commands.  Responses only become available once the configured
+   delay has elapsed since the request was sent.
+*/
+#include <stdatomic.h>
+#include <string.h>
+#include "chip.h"
+#include "chip-protocol.h"
+#include "chip-transport.h"
+#include "chip-clock.h"
+#include "chip-response-queue.h"
+#include "loopback.h"
+
+
+// Size of out of band response queue.  The queue will overwrite the oldest item once this size is hit.
+#define LOOPBACK_OOB_RESPONSE_QUEUE_SIZE 10
+
+
+struct CHiPTransport
+{
+    CHiPResponseQueue*        pResponseQueue;
+    CHiPClock*                pClock;
+    CHiPTransportEventHandler eventHandler;
+    void*                     pEventContext;
+    uint64_t                  startTime;
+    uint64_t                  responseDelay;
+    uint64_t                  responseReadyTime;
+    int                       waitingForResponse;
+    size_t                    responseLength;
+    uint8_t                   response[CHIP_RESPONSE_MAX_LEN];
+    _Atomic int               connected;
+
+    // Robot state.
+    uint8_t                   volume;
+    uint8_t                   speed;
+    uint8_t                   eyeBrightness;
+    uint8_t                   currentDateTime[8];
+    uint8_t                   alarmDateTime[6];
+};
+
+
+// Forward Declarations.
+static void     parseOptions(CHiPTransport* pTransport, const char* pInitOptions);
+static size_t   buildResponse(CHiPTransport* pTransport, const uint8_t* pRequest, size_t requestLength,
+                              uint8_t* pResponse);
+static void     updateRobotState(CHiPTransport* pTransport, const uint8_t* pRequest, size_t requestLength);
+static void     signalEvent(CHiPTransport* pTransport, uint32_t events);
+
+
+
+CHiPTransport* chipTransportInit(const char* pInitOptions)
+{
+    static const uint8_t defaultDateTime[8] = { 0x07, 0xE2, 1, 1, 0, 0, 0, 1 };
+    CHiPTransport*       pTransport = NULL;
+
+    pTransport = calloc(1, sizeof(*pTransport));
+    if (!pTransport)
+        goto Error;
+    pTransport->pResponseQueue = chipResponseQueueAlloc(LOOPBACK_OOB_RESPONSE_QUEUE_SIZE);
+    if (!pTransport->pResponseQueue)
+        goto Error;
+    parseOptions(pTransport, pInitOptions);
+
+    pTransport->pClock = chipClockGetDefault();
+    pTransport->startTime = chipClockGetMicroseconds(pTransport->pClock);
+    pTransport->volume = 11;
+    pTransport->speed = CHIP_SPEED_ADULT;
+    pTransport->eyeBrightness = 0xFF;
+    memcpy(pTransport->currentDateTime, defaultDateTime, sizeof(pTransport->currentDateTime));
+
+    return pTransport;
+Error:
+    chipTransportUninit(pTransport);
+    return NULL;
+}
+
+static void parseOptions(CHiPTransport* pTransport, const char* pInitOptions)
+{
+    const char* pDelay = NULL;
+
+    if (!pInitOptions)
+        return;
+    pDelay = strstr(pInitOptions, "delay=");
+    if (pDelay)
+        pTransport->responseDelay = strtoull(pDelay + 6, NULL, 0);
+}
+
+void chipTransportUninit(CHiPTransport* pTransport)
+{
+    if (!pTransport)
+        return;
+    chipResponseQueueFree(pTransport->pResponseQueue);
+    free(pTransport);
+}
+
+int chipTransportConnectToRobot(CHiPTransport* pTransport, const char* pRobotName)
+{
+    if (pRobotName && strcmp(pRobotName, LOOPBACK_ROBOT_NAME) != 0)
+        return CHIP_ERROR_CONNECT;
+    atomic_store(&pTransport->connected, 1);
+    signalEvent(pTransport, CHIP_TRANSPORT_EVENT_CONNECTION);
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportDisconnectFromRobot(CHiPTransport* pTransport)
+{
+    atomic_store(&pTransport->connected, 0);
+    pTransport->waitingForResponse = 0;
+    signalEvent(pTransport, CHIP_TRANSPORT_EVENT_CONNECTION);
+    return CHIP_ERROR_NONE;
+}
+
+static void signalEvent(CHiPTransport* pTransport, uint32_t events)
+{
+    if (pTransport->eventHandler)
+        pTransport->eventHandler(pTransport->pEventContext, events);
+}
+
+int chipTransportStartRobotDiscovery(CHiPTransport* pTransport)
+{
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportGetDiscoveredRobotCount(CHiPTransport* pTransport, size_t* pCount)
+{
+    *pCount = 1;
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportGetDiscoveredRobotName(CHiPTransport* pTransport, size_t robotIndex, const char** ppRobotName)
+{
+    if (robotIndex != 0)
+        return CHIP_ERROR_PARAM;
+    *ppRobotName = LOOPBACK_ROBOT_NAME;
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportStopRobotDiscovery(CHiPTransport* pTransport)
+{
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportSendRequest(CHiPTransport* pTransport, const uint8_t* pRequest, size_t requestLength, int expectResponse)
+{
+    if (!atomic_load(&pTransport->connected))
+        return CHIP_ERROR_NOT_CONNECTED;
+    if (requestLength < 1 || requestLength > CHIP_REQUEST_MAX_LEN)
+        return CHIP_ERROR_PARAM;
+
+    updateRobotState(pTransport, pRequest, requestLength);
+    pTransport->waitingForResponse = expectResponse;
+    if (expectResponse)
+    {
+        pTransport->responseLength = buildResponse(pTransport, pRequest, requestLength, pTransport->response);
+        pTransport->responseReadyTime = chipClockGetMicroseconds(pTransport->pClock) + pTransport->responseDelay;
+    }
+    return CHIP_ERROR_NONE;
+}
+
+static void updateRobotState(CHiPTransport* pTransport, const uint8_t* pRequest, size_t requestLength)
+{
+    switch (pRequest[0])
+    {
+    case CHIP_CMD_SET_VOLUME:
+        if (requestLength == CHIP_CMD_SET_VOLUME_REQUEST_LEN)
+            pTransport->volume = pRequest[1];
+        break;
+    case CHIP_CMD_SET_SPEED:
+        if (requestLength == CHIP_CMD_SET_SPEED_REQUEST_LEN)
+            pTransport->speed = pRequest[1];
+        break;
+    case CHIP_CMD_SET_EYE_BRIGHTNESS:
+        if (requestLength == CHIP_CMD_SET_EYE_BRIGHTNESS_REQUEST_LEN)
+            pTransport->eyeBrightness = pRequest[1];
+        break;
+    case CHIP_CMD_SET_CURRENT_DATE_TIME:
+        if (requestLength == 1 + sizeof(pTransport->currentDateTime))
+            memcpy(pTransport->currentDateTime, &pRequest[1], sizeof(pTransport->currentDateTime));
+        break;
+    case CHIP_CMD_SET_ALARM_DATE_TIME:
+        if (requestLength == 1 + sizeof(pTransport->alarmDateTime))
+            memcpy(pTransport->alarmDateTime, &pRequest[1], sizeof(pTransport->alarmDateTime));
+        break;
+    }
+}
+
+static size_t buildResponse(CHiPTransport* pTransport, const uint8_t* pRequest, size_t requestLength,
+                            uint8_t* pResponse)
+{
+    static const uint8_t dogVersion[CHIP_CMD_GET_DOG_VERSION_RESPONSE_LEN] =
+    {
+        CHIP_CMD_GET_DOG_VERSION, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+    };
+
+    pResponse[0] = pRequest[0];
+    switch (pRequest[0])
+    {
+    case CHIP_CMD_GET_DOG_VERSION:
+        memcpy(pResponse, dogVersion, sizeof(dogVersion));
+        return sizeof(dogVersion);
+    case CHIP_CMD_GET_VOLUME:
+        pResponse[1] = pTransport->volume;
+        return CHIP_CMD_GET_VOLUME_RESPONSE_LEN;
+    case CHIP_CMD_GET_SPEED:
+        pResponse[1] = pTransport->speed;
+        return CHIP_CMD_GET_SPEED_RESPONSE_LEN;
+    case CHIP_CMD_GET_EYE_BRIGHTNESS:
+        pResponse[1] = pTransport->eyeBrightness;
+        return CHIP_CMD_GET_EYE_BRIGHTNESS_RESPONSE_LEN;
+    case CHIP_CMD_GET_BATTERY_LEVEL:
+        pResponse[1] = CHIP_CHARGING_STATUS_NOT_CHARGING;
+        pResponse[2] = CHIP_CHARGER_TYPE_BASE;
+        pResponse[3] = 0x7D + 34;
+        return CHIP_CMD_GET_BATTERY_LEVEL_RESPONSE_LEN;
+    case CHIP_CMD_GET_CURRENT_DATE_TIME:
+        memcpy(&pResponse[1], pTransport->currentDateTime, sizeof(pTransport->currentDateTime));
+        return 1 + sizeof(pTransport->currentDateTime);
+    case CHIP_CMD_GET_ALARM_DATE_TIME:
+        memcpy(&pResponse[1], pTransport->alarmDateTime, sizeof(pTransport->alarmDateTime));
+        return 1 + sizeof(pTransport->alarmDateTime);
+    default:
+        // Unknown requests are echoed back.
+        memcpy(pResponse, pRequest, requestLength);
+        return requestLength;
+    }
+}
+
+int chipTransportSendRequestBatch(CHiPTransport* pTransport, CHiPTransportBatchItem* pItems, size_t itemCount)
+{
+    uint64_t startTime;
+    uint64_t roundTrip;
+    size_t   i;
+
+    if (!atomic_load(&pTransport->connected))
+        return CHIP_ERROR_NOT_CONNECTED;
+    if (itemCount < 1 || itemCount > CHIP_TRANSPORT_MAX_BATCH)
+        return CHIP_ERROR_PARAM;
+    for (i = 0 ; i < itemCount ; i++)
+    {
+        if (pItems[i].requestLength < 1 || pItems[i].requestLength > CHIP_REQUEST_MAX_LEN)
+            return CHIP_ERROR_PARAM;
+    }
+
+    // All of the responses are ready after a single delay since the requests are sent together.
+    startTime = chipClockGetMicroseconds(pTransport->pClock);
+    pTransport->waitingForResponse = 0;
+    for (i = 0 ; i < itemCount ; i++)
+    {
+        CHiPTransportBatchItem* pItem = &pItems[i];
+
+        updateRobotState(pTransport, pItem->pRequest, pItem->requestLength);
+        pItem->responseLength = buildResponse(pTransport, pItem->pRequest, pItem->requestLength, pItem->pResponse);
+        pItem->result = CHIP_ERROR_NONE;
+    }
+    chipClockSleepUntil(pTransport->pClock, startTime + pTransport->responseDelay);
+    roundTrip = chipClockGetMicroseconds(pTransport->pClock) - startTime;
+    for (i = 0 ; i < itemCount ; i++)
+        pItems[i].roundTrip = roundTrip;
+
+    return CHIP_ERROR_NONE;
+}
+
+int chipTransportBorrowResponse(CHiPTransport* pTransport, const uint8_t** ppResponse, size_t* pResponseLength)
+{
+    if (!atomic_load(&pTransport->connected))
+        return CHIP_ERROR_NOT_CONNECTED;
+    if (!pTransport->waitingForResponse)
+        return CHIP_ERROR_NO_REQUEST;
+
+    chipClockSleepUntil(pTransport->pClock, pTransport->responseReadyTime);
+    pTransport->waitingForResponse = 0;
+
+    *ppResponse = pTransport->response;
+    *pResponseLength = pTransport->responseLength;
+
+    return CHIP_ERROR_NONE;
+}
+
+void chipTransportReleaseResponse(CHiPTransport* pTransport)
+{
+    // The response buffer belongs to the transport and is only rewritten by the next request.
+}
+
+int chipTransportIsResponseAvailable(CHiPTransport* pTransport)
+{
+    return pTransport->waitingForResponse &&
+           chipClockGetMicroseconds(pTransport->pClock) >= pTransport->responseReadyTime;
+}
+
+uint64_t chipTransportGetResponseTime(CHiPTransport* pTransport)
+{
+    return pTransport->waitingForResponse ? pTransport->responseReadyTime : UINT64_MAX;
+}
+
+void chipTransportAbandonRequest(CHiPTransport* pTransport)
+{
+    pTransport->waitingForResponse = 0;
+}
+
+int chipTransportGetOutOfBandResponse(CHiPTransport* pTransport,
+                                     uint8_t* pResponseBuffer,
+                                     size_t responseBufferSize,
+                                     size_t* pResponseLength)
+{
+    if (!atomic_load(&pTransport->connected))
+        return CHIP_ERROR_NOT_CONNECTED;
+    return chipResponseQueuePop(pTransport->pResponseQueue, pResponseBuffer, responseBufferSize, pResponseLength);
+}
+
+uint32_t chipTransportGetMilliseconds(CHiPTransport* pTransport)
+{
+    return (uint32_t)((chipClockGetMicroseconds(pTransport->pClock) - pTransport->startTime) / 1000ULL);
+}
+
+uint64_t chipTransportGetMicroseconds(CHiPTransport* pTransport)
+{
+    return chipClockGetMicroseconds(pTransport->pClock);
+}
+
+void chipTransportGetStats(CHiPTransport* pTransport, CHiPTransportStats* pStats)
+{
+    pStats->retries = 0;
+    pStats->timeouts = 0;
+    pStats->oobDrops = chipResponseQueueDropCount(pTransport->pResponseQueue);
+    pStats->oobQueueDepth = chipResponseQueueDepth(pTransport->pResponseQueue);
+    pStats->connected = atomic_load_explicit(&pTransport->connected, memory_order_relaxed);
+}
+
+void chipTransportSetEventHandler(CHiPTransport* pTransport, CHiPTransportEventHandler handler, void* pContext)
+{
+    pTransport->eventHandler = handler;
+    pTransport->pEventContext = pContext;
+}
@@ -19,10 +19,13 @@
 #import <Cocoa/Cocoa.h>
 #import <CoreBluetooth/CoreBluetooth.h>
 #import <pthread.h>
-#import <sys/time.h>
-#import <mach/mach_time.h>
+#import <stdatomic.h>
 #import "chip.h"
 #import "chip-transport.h"
+#import "chip-clock.h"
+#import "chip-log.h"
+#import "chip-response-queue.h"
+#import "chip-trace.h"
 #import "osxble.h"
 
 
@@ -52,9 +55,26 @@ static void* robotThread(void* pArg);
 // Maximum number of retries for sending a request when the expected response isn't received.
 #define CHIP_MAXIMUM_REQEUST_RETRIES 2
 
+// Wait for a maximum of 1 second for a response as responses typically come back in just less than 0.5 seconds.
+#define CHIP_RESPONSE_TIMEOUT_US 1000000
+
+// Time given to the robot to finish disconnecting before another connection attempt can be made.
+#define CHIP_DISCONNECT_DELAY_US 1000000
+
 // Size of out of band response queue.  The queue will overwrite the oldest item once this size is hit.
 #define CHIP_OOB_RESPONSE_QUEUE_SIZE 10
 
+// How often the background thread flushes the log ring to its sink.
+#define CHIP_LOG_FLUSH_INTERVAL_MS 100
+
+
+// Arguments of chipTransportSetEventHandler() boxed in an NSValue for the trip to the main thread.
+typedef struct EventHandlerRegistration
+{
+    CHiPTransport*            pTransport;
+    CHiPTransportEventHandler handler;
+    void*                     pContext;
+} EventHandlerRegistration;
 
 
 // This class contains the information for a single request and its matching response (if it has one).
@@ -67,6 +87,8 @@ static void* robotThread(void* pArg);
     uint8_t         responseLength;
     uint8_t         request[CHIP_REQUEST_MAX_LEN];
     uint8_t         response[CHIP_RESPONSE_MAX_LEN];
+    uint32_t        traceId;
+    uint64_t        traceSignalTime;
 }
 
 - (id) initWithRequest:(const uint8_t*)p length:(size_t)len expectResponse:(BOOL) expectResponse;
@@ -76,11 +98,13 @@ static void* robotThread(void* pArg);
 - (size_t) requestLength;
 
 - (BOOL) waitingForResponse;
-- (BOOL) waitForResponse;
+- (BOOL) waitForResponseUsingClock:(CHiPClock*) pClock;
 
 - (void) setResponse:(const uint8_t*)p length:(size_t)len;
 - (const uint8_t*) response;
 - (size_t) responseLength;
+
+- (uint32_t) traceId;
 @end
 
 
@@ -108,6 +132,7 @@ static void* robotThread(void* pArg);
 
     [self setRequest:p length:len];
     waitingForResponse = expect;
+    traceId = chipTraceCurrentRequest();
     return self;
 }
 
@@ -146,28 +171,31 @@ static void* robotThread(void* pArg);
 }
 
 // Block and wait for the response to the last request to actually arrive from the robot.
-- (BOOL) waitForResponse
+- (BOOL) waitForResponseUsingClock:(CHiPClock*) pClock
 {
-    // Wait for a maximum of 1 second for a response as responses typically come back in just less than 0.5 seconds.
-    int res = 0;
-    struct timeval tv;
-    struct timespec ts;
-    gettimeofday(&tv, NULL);
-    ts.tv_sec = tv.tv_sec + 1;
-    ts.tv_nsec = tv.tv_usec * 1000;
+    int res = CHIP_ERROR_NONE;
+    uint64_t deadline = chipClockGetMicroseconds(pClock) + CHIP_RESPONSE_TIMEOUT_US;
+    uint64_t traceStart = chipTraceBegin();
+    uint64_t signalTime = 0;
 
     pthread_mutex_lock(&mutex);
-    while (waitingForResponse && res != ETIMEDOUT)
-        res = pthread_cond_timedwait(&condition, &mutex, &ts);
+    while (waitingForResponse && res != CHIP_ERROR_TIMEOUT)
+        res = chipClockWaitUntil(pClock, &condition, &mutex, deadline);
+    signalTime = traceSignalTime;
     pthread_mutex_unlock(&mutex);
+    chipTraceEnd("waitForResponse", traceId, traceStart);
+    // Time between setResponse: signalling the condition on the main thread and this thread waking up.
+    if (traceStart && signalTime)
+        chipTraceEnd("conditionWake", traceId, signalTime);
 
     // Return FALSE if we timed out waiting to receive response.
-    if (res == ETIMEDOUT)
+    if (res == CHIP_ERROR_TIMEOUT)
         return FALSE;
     return TRUE;
 }
 
-// Make a deep copy of the response received from the robot.
+// Make a deep copy of the response received from the robot.  The worker thread borrows this copy rather than making
+// another one of its own.
 // Also unblocks any calls to the waitForResponse selector.
 - (void) setResponse:(const uint8_t*)p length:(size_t)len
 {
@@ -176,6 +204,7 @@ static void* robotThread(void* pArg);
         memcpy(response, p, len);
         responseLength = len;
         waitingForResponse = FALSE;
+        traceSignalTime = chipTraceBegin();
     pthread_mutex_unlock(&mutex);
     pthread_cond_signal(&condition);
 }
@@ -191,112 +220,11 @@ static void* robotThread(void* pArg);
 {
     return (size_t)responseLength;
 }
-@end
-
 
-
-// This class implements a fixed sized circular queue which supports push overflow.
-@interface CHiPResponseQueue : NSObject
+// Accessor for the trace request id which was current on the worker thread when this request was created.
+- (uint32_t) traceId
 {
-    struct Response
-    {
-        uint8_t length;
-        uint8_t content[CHIP_RESPONSE_MAX_LEN];
-    } *pResponses;
-    size_t          alloc;
-    size_t          count;
-    size_t          push;
-    size_t          pop;
-    pthread_mutex_t mutex;
-}
-
-- (id) initWithSize:(size_t) itemCount;
-- (void) push:(const uint8_t*)pData length:(size_t)length;
-- (int)  pop:(uint8_t*)pBuffer size:(size_t)size actualLength:(size_t*)pActual;
-@end
-
-
-
-@implementation CHiPResponseQueue
-// Initialize the response queue.  Allocate room for the specified number of responses in the queue.
-- (id) initWithSize:(size_t) itemCount
-{
-    int mutexInit = -1;
-
-    self = [super init];
-    if (!self)
-        goto Error;
-
-    pResponses = malloc(itemCount * sizeof(*pResponses));
-    if (!pResponses)
-        goto Error;
-    mutexInit = pthread_mutex_init(&mutex, NULL);
-    if (mutexInit)
-        goto Error;
-    alloc = itemCount;
-
-    return self;
-Error:
-    if (mutexInit == 0)
-        pthread_mutex_destroy(&mutex);
-    free(pResponses);
-    pResponses = NULL;
-    return nil;
-}
-
-// Free pthread synchronization objects when this object is finally freed.
-- (void) dealloc
-{
-    pthread_mutex_destroy(&mutex);
-    free(pResponses);
-    pResponses = NULL;
-    [super dealloc];
-}
-
-- (void) push:(const uint8_t*)pData length:(size_t)length
-{
-    size_t copyLen = length;
-    if (copyLen > sizeof(pResponses[0].content))
-        copyLen = sizeof(pResponses[0].content);
-    pthread_mutex_lock(&mutex);
-    {
-        memcpy(pResponses[push].content, pData, copyLen);
-        pResponses[push].length = copyLen;
-        push = (push + 1) % alloc;
-        if (count == alloc)
-        {
-            // Queue was already full so drop oldest item by advancing the pop index.
-            pop = (pop + 1) % alloc;
-        }
-        else
-        {
-            count++;
-        }
-    }
-    pthread_mutex_unlock(&mutex);
-}
-
-- (int)  pop:(uint8_t*)pBuffer size:(size_t)size actualLength:(size_t*)pActual
-{
-    int ret = CHIP_ERROR_EMPTY;
-
-    pthread_mutex_lock(&mutex);
-    {
-        if (count > 0)
-        {
-            size_t copyLen = pResponses[pop].length;
-            if (copyLen > size)
-                copyLen = size;
-            memcpy(pBuffer, pResponses[pop].content, copyLen);
-            *pActual = copyLen;
-            pop = (pop + 1) % alloc;
-            count--;
-            ret = CHIP_ERROR_NONE;
-        }
-    }
-    pthread_mutex_unlock(&mutex);
-
-    return ret;
+    return traceId;
 }
 @end
 
@@ -310,7 +238,9 @@ Error:
     CBPeripheral*       peripheral;
     CBCharacteristic*   sendDataWriteCharacteristic;
 
-    CHiPRequestResponse* requestResponse;
+    // Requests still waiting for their responses.  Usually just one but a batch can have several outstanding at once.
+    // Only accessed from the main thread.
+    NSMutableArray*     pendingRequests;
 
     int                 error;
     int32_t             characteristicsToFind;
@@ -323,7 +253,14 @@ Error:
     pthread_t           thread;
 
     // Out of band CHiP responses go into this queue.
-    CHiPResponseQueue*   responseQueue;
+    CHiPResponseQueue*  pResponseQueue;
+
+    // Called from the main thread as responses, notifications and connection changes arrive.  Only read and written on
+    // the main thread.  There is a single CoreBluetooth connection per process so only one transport, pEventTransport,
+    // can own the handler at a time.
+    CHiPTransportEventHandler eventHandler;
+    void*               pEventContext;
+    CHiPTransport*      pEventTransport;
 }
 
 - (id) initForApp:(NSApplication*) app;
@@ -340,7 +277,13 @@ Error:
 - (NSUInteger) getDiscoveredRobotCount;
 - (NSString*) getDiscoveredRobotAtIndex:(NSUInteger) index;
 - (void) handleCHiPRequest:(id) request;
+- (void) handleCHiPRequestAbandon:(id) request;
 - (int) popOobResponse:(uint8_t*) pOobResponse size:(size_t) size actualLength:(size_t*) pActual;
+- (uint32_t) oobDropCount;
+- (uint32_t) oobQueueDepth;
+- (BOOL) isConnected;
+- (void) handleSetEventHandler:(id) registration;
+- (void) signalEvent:(uint32_t) events;
 - (void) handleQuitRequest:(id) dummy;
 - (void) startScan;
 - (void) stopScan;
@@ -364,8 +307,11 @@ Error:
     discoveredRobots = [[NSMutableArray alloc] init];
     if (!discoveredRobots)
         goto Error;
-    responseQueue = [[CHiPResponseQueue alloc] initWithSize:CHIP_OOB_RESPONSE_QUEUE_SIZE];
-    if (!responseQueue)
+    pendingRequests = [[NSMutableArray alloc] init];
+    if (!pendingRequests)
+        goto Error;
+    pResponseQueue = chipResponseQueueAlloc(CHIP_OOB_RESPONSE_QUEUE_SIZE);
+    if (!pResponseQueue)
         goto Error;
 
     connectMutexResult = pthread_mutex_init(&connectMutex, NULL);
@@ -383,7 +329,8 @@ Error:
         pthread_cond_destroy(&connectCondition);
     if (connectMutexResult == 0)
         pthread_mutex_destroy(&connectMutex);
-    [responseQueue release];
+    chipResponseQueueFree(pResponseQueue);
+    [pendingRequests release];
     [discoveredRobots release];
     return nil;
 }
@@ -412,8 +359,10 @@ Error:
     }
 
     // Free up resources here rather than dealloc which doesn't appear to be called during NSApplication shutdown.
-    [responseQueue release];
-    responseQueue = nil;
+    chipResponseQueueFree(pResponseQueue);
+    pResponseQueue = NULL;
+    [pendingRequests release];
+    pendingRequests = nil;
     [discoveredRobots release];
     discoveredRobots = nil;
 
@@ -422,6 +371,9 @@ Error:
 
     pthread_cond_destroy(&connectCondition);
     pthread_mutex_destroy(&connectMutex);
+
+    // Make sure that any messages still in the log ring make it out before the process exits.
+    chipLogStopFlusher();
 }
 
 // Request CBCentralManager to stop scanning for CHiP robots.
@@ -559,16 +511,15 @@ Error:
 // Invoked whenever an existing connection with the peripheral is torn down.
 - (void)centralManager:(CBCentralManager *)central didDisconnectPeripheral:(CBPeripheral *)aPeripheral error:(NSError *)err
 {
-    NSLog(@"didDisconnectPeripheral");
-    NSLog(@"err = %@", err);
+    CHIP_LOG_WARNING("didDisconnectPeripheral error=%ld", (long)[err code]);
     [self clearPeripheral];
+    [self signalEvent:CHIP_TRANSPORT_EVENT_CONNECTION];
 }
 
 // Invoked whenever the central manager fails to create a connection with the peripheral.
 - (void)centralManager:(CBCentralManager *)central didFailToConnectPeripheral:(CBPeripheral *)aPeripheral error:(NSError *)err
 {
-    NSLog(@"didFailToConnectPeripheral");
-    NSLog(@"err = %@", err);
+    CHIP_LOG_ERROR("didFailToConnectPeripheral error=%ld", (long)[err code]);
     [self clearPeripheral];
     [self signalConnectionError];
 }
@@ -636,10 +587,15 @@ Error:
 // The worker thread will be waiting for both of these characteristics to be found so there is code to unblock it.
 - (void) foundCharacteristic
 {
+    BOOL isConnected;
+
     pthread_mutex_lock(&connectMutex);
         characteristicsToFind--;
+        isConnected = characteristicsToFind == 0;
     pthread_mutex_unlock(&connectMutex);
     pthread_cond_signal(&connectCondition);
+    if (isConnected)
+        [self signalEvent:CHIP_TRANSPORT_EVENT_CONNECTION];
 }
 
 // The worker thread calls this selector to wait for the connection to the robot to complete.
@@ -726,57 +682,80 @@ Error:
 
     // Prepare data to send to CHiP robot via Core Bluetooth.
     CHiPRequestResponse* request = (CHiPRequestResponse*)object;
+    uint64_t traceStart = chipTraceBegin();
     NSData* cmdData = [NSData dataWithBytes:[request request] length:[request requestLength]];
 
-    // Retain a copy of the request if expecting a response and it isn't a retry (requestResponse == request for retry).
-    if ([request waitingForResponse] && requestResponse != request)
-    {
-        [request retain];
-        requestResponse = request;
-    }
+    // Keep the request, retained by the array, if expecting a response and it isn't a retry which is already pending.
+    if ([request waitingForResponse] && ![pendingRequests containsObject:request])
+        [pendingRequests addObject:request];
 
     // Send request to CHiP robot via Core Bluetooth.
+    uint64_t writeStart = chipTraceBegin();
     [peripheral writeValue:cmdData forCharacteristic:sendDataWriteCharacteristic type:CBCharacteristicWriteWithoutResponse];
+    chipTraceEnd("writeValue", [request traceId], writeStart);
+    chipTraceEnd("handleCHiPRequest", [request traceId], traceStart);
 
     // If there is no response then this release will free the object now that we don't need it anymore.
     // If there will be a response then there are already another 2 additional references to keep it alive until the
-    // response has been received and copied into the worker threads' buffer.
+    // response has been received and released by the worker thread.
     [object release];
 }
 
+// Handle a request whose response the worker thread has given up waiting on.  It is dropped from the pending list so
+// that a late response can't be matched to it in place of a newer request for the same command.
+- (void) handleCHiPRequestAbandon:(id) request
+{
+    [pendingRequests removeObjectIdenticalTo:request];
+}
+
 // Invoked upon completion of a -[readValueForCharacteristic:] request or on the reception of a notification/indication.
 - (void) peripheral:(CBPeripheral *)aPeripheral didUpdateValueForCharacteristic:(CBCharacteristic *)characteristic error:(NSError *)err
 {
+    uint64_t traceStart = chipTraceBegin();
+
     if (err)
-        NSLog(@"Read encountered error (%@)", err);
+        CHIP_LOG_WARNING("Read encountered error=%ld", (long)[err code]);
 
     // Response from CHiP command has been received.
     if ([characteristic.UUID isEqual:[CBUUID UUIDWithString:@CHIP_RECEIVE_DATA_NOTIFY_CHARACTERISTIC]])
     {
+        // Copy straight from the characteristic's value into the request object or out of band queue.
         const uint8_t* pResponseBytes = characteristic.value.bytes;
         NSUInteger responseLength = [characteristic.value length];
-        uint8_t response[CHIP_RESPONSE_MAX_LEN];
-        if (responseLength > sizeof(response))
-            responseLength = sizeof(response);
-        memcpy(response, pResponseBytes, responseLength);
+        if (responseLength > CHIP_RESPONSE_MAX_LEN)
+            responseLength = CHIP_RESPONSE_MAX_LEN;
 
-        if (requestResponse && [requestResponse request][0] == response[0])
+        CHiPRequestResponse* requestResponse = nil;
+        if (responseLength > 0)
         {
-            // Have received the response for the currently pending request.
-            [requestResponse setResponse:response length:responseLength];
-            [requestResponse release];
-            requestResponse = nil;
+            for (CHiPRequestResponse* pending in pendingRequests)
+            {
+                if ([pending request][0] == pResponseBytes[0])
+                {
+                    requestResponse = pending;
+                    break;
+                }
+            }
+        }
+
+        if (requestResponse)
+        {
+            // Have received the response for one of the pending requests.
+            chipTraceEnd("didUpdateValueForCharacteristic", [requestResponse traceId], traceStart);
+            [requestResponse setResponse:pResponseBytes length:responseLength];
+            [pendingRequests removeObjectIdenticalTo:requestResponse];
+            [self signalEvent:CHIP_TRANSPORT_EVENT_RESPONSE];
         }
         else
         {
             // Received Out of Band response from CHiP.
-            [responseQueue push:response length:responseLength];
+            chipResponseQueuePush(pResponseQueue, pResponseBytes, responseLength);
+            [self signalEvent:CHIP_TRANSPORT_EVENT_NOTIFICATION];
         }
     }
     else
     {
-        NSLog(@"Unexpected characteristic %@", characteristic.UUID);
-        NSLog(@"characteristic = %@", characteristic.value.bytes);
+        CHIP_LOG_INFO("Unexpected characteristic update of %lu bytes", (unsigned long)[characteristic.value length]);
     }
 }
 
@@ -790,7 +769,55 @@ Error:
 // responses are notifications sent from CHiP robot even though no explicit request has been made.
 - (int) popOobResponse:(uint8_t*) pOobResponse size:(size_t) size actualLength:(size_t*) pActual
 {
-    return [responseQueue pop:pOobResponse size:size actualLength:pActual];
+    return chipResponseQueuePop(pResponseQueue, pOobResponse, size, pActual);
+}
+
+// The worker thread calls this selector to find out how many out of band responses have been overwritten in the queue
+// before they could be popped.
+- (uint32_t) oobDropCount
+{
+    return chipResponseQueueDropCount(pResponseQueue);
+}
+
+// The worker thread calls this selector to find out how many out of band responses are waiting to be popped.
+- (uint32_t) oobQueueDepth
+{
+    return chipResponseQueueDepth(pResponseQueue);
+}
+
+// Is there currently a connection to a robot with the characteristic used for sending requests?
+- (BOOL) isConnected
+{
+    BOOL connected = FALSE;
+
+    pthread_mutex_lock(&connectMutex);
+        connected = peripheral != nil && sendDataWriteCharacteristic != nil && characteristicsToFind <= 0;
+    pthread_mutex_unlock(&connectMutex);
+    return connected;
+}
+
+// Register the function to be called by signalEvent.  Runs on the main thread so that it can't race with signalEvent.
+// A transport other than the current owner can't take over or clear the handler.
+- (void) handleSetEventHandler:(id) registration
+{
+    EventHandlerRegistration eventRegistration;
+
+    [registration getValue:&eventRegistration];
+    if (pEventTransport && pEventTransport != eventRegistration.pTransport)
+    {
+        CHIP_LOG_WARNING("chipTransportSetEventHandler() ignored: another transport already owns the event handler");
+        return;
+    }
+    eventHandler = eventRegistration.handler;
+    pEventContext = eventRegistration.pContext;
+    pEventTransport = eventRegistration.handler ? eventRegistration.pTransport : NULL;
+}
+
+// Report a response, notification or connection change to the CHiP API so that it can wake up an event loop.
+- (void) signalEvent:(uint32_t) events
+{
+    if (eventHandler)
+        eventHandler(pEventContext, events);
 }
 
 // Invoked whenever the central manager's state is updated.
@@ -840,6 +867,7 @@ static CHiPAppDelegate* g_appDelegate;
 //   developer provides this code in their implementation of the robotMain() function.
 void osxCHiPInitAndRun(void)
 {
+    chipLogStartFlusher(CHIP_LOG_FLUSH_INTERVAL_MS);
     [NSApplication sharedApplication];
     g_appDelegate = [[CHiPAppDelegate alloc] initForApp:NSApp];
     [NSApp run];
@@ -858,8 +886,10 @@ static void* robotThread(void* pArg)
 
 struct CHiPTransport
 {
-    CHiPRequestResponse*       lastRequest; // Remember last request here that requires a response.
-    mach_timebase_info_data_t machTimebaseInfo;
+    CHiPRequestResponse* lastRequest; // Remember last request here that requires a response.
+    CHiPClock*           pClock;
+    _Atomic uint32_t     retries;
+    _Atomic uint32_t     timeouts;
 };
 
 
@@ -867,7 +897,9 @@ struct CHiPTransport
 CHiPTransport* chipTransportInit(const char* pInitOptions)
 {
     CHiPTransport* pTransport = calloc(1, sizeof(*pTransport));
-    mach_timebase_info(&pTransport->machTimebaseInfo);
+    if (!pTransport)
+        return NULL;
+    pTransport->pClock = chipClockGetDefault();
     return pTransport;
 }
 
@@ -895,7 +927,7 @@ int chipTransportDisconnectFromRobot(CHiPTransport* pTransport)
 {
     [g_appDelegate performSelectorOnMainThread:@selector(handleCHiPDisconnect:) withObject:nil waitUntilDone:YES];
     [g_appDelegate waitForDisconnectToComplete];
-    sleep(1);
+    chipClockSleepUntil(pTransport->pClock, chipClockGetMicroseconds(pTransport->pClock) + CHIP_DISCONNECT_DELAY_US);
 
     return [g_appDelegate error];
 }
@@ -939,11 +971,99 @@ int chipTransportSendRequest(CHiPTransport* pTransport, const uint8_t* pRequest,
         [p retain];
         pTransport->lastRequest = p;
     }
+    uint64_t traceStart = chipTraceBegin();
     [g_appDelegate performSelectorOnMainThread:@selector(handleCHiPRequest:) withObject:p waitUntilDone:YES];
+    chipTraceEnd("performSelectorOnMainThread", chipTraceCurrentRequest(), traceStart);
     return [g_appDelegate error];
 }
 
-int chipTransportGetResponse(CHiPTransport* pTransport, uint8_t* pResponseBuffer, size_t responseBufferSize, size_t* pResponseLength)
+int chipTransportSendRequestBatch(CHiPTransport* pTransport, CHiPTransportBatchItem* pItems, size_t itemCount)
+{
+    CHiPRequestResponse* requests[CHIP_TRANSPORT_MAX_BATCH];
+    int                  result = CHIP_ERROR_NONE;
+    size_t               sentCount = 0;
+    size_t               i;
+    uint64_t             startTime;
+
+    if (itemCount < 1 || itemCount > CHIP_TRANSPORT_MAX_BATCH)
+        return CHIP_ERROR_PARAM;
+
+    // Send every request before waiting on any of them.  The main thread matches each response to its request by
+    // command byte as it arrives.
+    [pTransport->lastRequest release];
+    pTransport->lastRequest = nil;
+    startTime = chipClockGetMicroseconds(pTransport->pClock);
+    for (sentCount = 0 ; sentCount < itemCount ; sentCount++)
+    {
+        CHiPTransportBatchItem* pItem = &pItems[sentCount];
+        CHiPRequestResponse*    p = [[CHiPRequestResponse alloc] initWithRequest:pItem->pRequest
+                                                                          length:pItem->requestLength
+                                                                  expectResponse:TRUE];
+        if (!p)
+        {
+            result = CHIP_ERROR_MEMORY;
+            break;
+        }
+        requests[sentCount] = p;
+        [p retain];
+        [g_appDelegate performSelectorOnMainThread:@selector(handleCHiPRequest:) withObject:p waitUntilDone:YES];
+        result = [g_appDelegate error];
+        if (result)
+        {
+            sentCount++;
+            break;
+        }
+    }
+
+    // Responses which arrived while waiting on earlier ones are picked up straight away, so their round trip times
+    // are when they were picked up rather than when they arrived.
+    for (i = 0 ; i < sentCount ; i++)
+    {
+        CHiPTransportBatchItem* pItem = &pItems[i];
+        CHiPRequestResponse*    p = requests[i];
+        int                     retries = CHIP_MAXIMUM_REQEUST_RETRIES;
+        BOOL                    waitResult = FALSE;
+
+        if (result == CHIP_ERROR_NONE)
+        {
+            do
+            {
+                waitResult = [p waitForResponseUsingClock:pTransport->pClock];
+                if (!waitResult && retries > 0)
+                {
+                    CHIP_LOG_WARNING("Retrying batched request 0x%02X", [p request][0]);
+                    atomic_fetch_add_explicit(&pTransport->retries, 1, memory_order_relaxed);
+                    [p retain];
+                    [g_appDelegate performSelectorOnMainThread:@selector(handleCHiPRequest:) withObject:p waitUntilDone:YES];
+                }
+            } while (!waitResult && retries-- > 0);
+        }
+        if (waitResult)
+        {
+            memcpy(pItem->pResponse, [p response], [p responseLength]);
+            pItem->responseLength = [p responseLength];
+            pItem->result = CHIP_ERROR_NONE;
+            pItem->roundTrip = chipClockGetMicroseconds(pTransport->pClock) - startTime;
+        }
+        else
+        {
+            if (result == CHIP_ERROR_NONE)
+            {
+                CHIP_LOG_WARNING("Returning time out error for batched request 0x%02X", [p request][0]);
+                atomic_fetch_add_explicit(&pTransport->timeouts, 1, memory_order_relaxed);
+            }
+            [g_appDelegate performSelectorOnMainThread:@selector(handleCHiPRequestAbandon:) withObject:p waitUntilDone:YES];
+            pItem->responseLength = 0;
+            pItem->result = CHIP_ERROR_TIMEOUT;
+            pItem->roundTrip = 0;
+        }
+        [p release];
+    }
+
+    return result;
+}
+
+int chipTransportBorrowResponse(CHiPTransport* pTransport, const uint8_t** ppResponse, size_t* pResponseLength)
 {
     if (!pTransport->lastRequest)
         return CHIP_ERROR_NO_REQUEST;
@@ -954,31 +1074,34 @@ int chipTransportGetResponse(CHiPTransport* pTransport, uint8_t* pResponseBuffer
     BOOL waitResult = FALSE;
     do
     {
-        waitResult = [pTransport->lastRequest waitForResponse];
+        waitResult = [pTransport->lastRequest waitForResponseUsingClock:pTransport->pClock];
         if (!waitResult && retries > 0)
         {
-            NSLog(@"Retrying request");
+            CHIP_LOG_WARNING("Retrying request 0x%02X", [pTransport->lastRequest request][0]);
+            atomic_fetch_add_explicit(&pTransport->retries, 1, memory_order_relaxed);
             [pTransport->lastRequest retain];
             [g_appDelegate performSelectorOnMainThread:@selector(handleCHiPRequest:) withObject:pTransport->lastRequest waitUntilDone:YES];
         }
     } while (!waitResult && retries-- > 0);
     if (!waitResult)
     {
-        NSLog(@"Returning time out error");
+        CHIP_LOG_WARNING("Returning time out error for request 0x%02X", [pTransport->lastRequest request][0]);
+        atomic_fetch_add_explicit(&pTransport->timeouts, 1, memory_order_relaxed);
+        [g_appDelegate performSelectorOnMainThread:@selector(handleCHiPRequestAbandon:) withObject:pTransport->lastRequest waitUntilDone:YES];
         return CHIP_ERROR_TIMEOUT;
     }
 
-    size_t srcLength = [pTransport->lastRequest responseLength];
-    size_t copyLength = srcLength;
-    if (copyLength > responseBufferSize)
-        copyLength = responseBufferSize;
-    memcpy(pResponseBuffer, [pTransport->lastRequest response], copyLength);
-    *pResponseLength = copyLength;
+    // The request object keeps the response alive until chipTransportReleaseResponse() drops the last reference.
+    *ppResponse = [pTransport->lastRequest response];
+    *pResponseLength = [pTransport->lastRequest responseLength];
 
+    return CHIP_ERROR_NONE;
+}
+
+void chipTransportReleaseResponse(CHiPTransport* pTransport)
+{
     [pTransport->lastRequest release];
     pTransport->lastRequest = nil;
-
-    return CHIP_ERROR_NONE;
 }
 
 int chipTransportIsResponseAvailable(CHiPTransport* pTransport)
@@ -988,6 +1111,21 @@ int chipTransportIsResponseAvailable(CHiPTransport* pTransport)
     return ![pTransport->lastRequest waitingForResponse];
 }
 
+uint64_t chipTransportGetResponseTime(CHiPTransport* pTransport)
+{
+    // The arrival of responses is reported with CHIP_TRANSPORT_EVENT_RESPONSE as soon as Core Bluetooth delivers them.
+    return UINT64_MAX;
+}
+
+void chipTransportAbandonRequest(CHiPTransport* pTransport)
+{
+    if (!pTransport->lastRequest)
+        return;
+    [g_appDelegate performSelectorOnMainThread:@selector(handleCHiPRequestAbandon:) withObject:pTransport->lastRequest waitUntilDone:YES];
+    [pTransport->lastRequest release];
+    pTransport->lastRequest = nil;
+}
+
 int chipTransportGetOutOfBandResponse(CHiPTransport* pTransport, uint8_t* pResponseBuffer, size_t responseBufferSize, size_t* pResponseLength)
 {
     return [g_appDelegate popOobResponse:pResponseBuffer size:responseBufferSize actualLength:pResponseLength];
@@ -995,8 +1133,30 @@ int chipTransportGetOutOfBandResponse(CHiPTransport* pTransport, uint8_t* pRespo
 
 uint32_t chipTransportGetMilliseconds(CHiPTransport* pTransport)
 {
-    static const uint64_t nanoPerMilli = 1000000;
+    return (uint32_t)(chipClockGetMicroseconds(pTransport->pClock) / 1000);
+}
+
+uint64_t chipTransportGetMicroseconds(CHiPTransport* pTransport)
+{
+    return chipClockGetMicroseconds(pTransport->pClock);
+}
+
+void chipTransportGetStats(CHiPTransport* pTransport, CHiPTransportStats* pStats)
+{
+    pStats->retries = atomic_load_explicit(&pTransport->retries, memory_order_relaxed);
+    pStats->timeouts = atomic_load_explicit(&pTransport->timeouts, memory_order_relaxed);
+    pStats->oobDrops = [g_appDelegate oobDropCount];
+    pStats->oobQueueDepth = [g_appDelegate oobQueueDepth];
+    pStats->connected = [g_appDelegate isConnected];
+}
+
+void chipTransportSetEventHandler(CHiPTransport* pTransport, CHiPTransportEventHandler handler, void* pContext)
+{
+    EventHandlerRegistration registration = { pTransport, handler, pContext };
+    NSValue*                 registrationObject = [NSValue valueWithBytes:&registration
+                                                                   objCType:@encode(EventHandlerRegistration)];
 
-    return (uint32_t)((mach_absolute_time() * pTransport->machTimebaseInfo.numer) /
-                      (nanoPerMilli * pTransport->machTimebaseInfo.denom));
+    [g_appDelegate performSelectorOnMainThread:@selector(handleSetEventHandler:)
+                                    withObject:registrationObject
+                                 waitUntilDone:YES];
 }